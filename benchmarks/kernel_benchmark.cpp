@@ -0,0 +1,522 @@
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Measures the Maya-independent mesh and particle conversion kernels on synthetic inputs of increasing size, and
+// reports the throughput of each. It does not require Maya.
+//
+// The splat benchmarks accumulate particles into a voxel grid, as the volume renderers downstream of the particle
+// streams do, once in emission order and once after sort_particles_by_morton_code. They report the cost of the sort
+// together with the speedup it gives the splat.
+//
+// Usage: thinkboxmylibrary_benchmarks [maxGridSize [repeats]]
+//   maxGridSize  the side length, in quads, of the largest synthetic grid mesh. Defaults to 1024.
+//   repeats      the number of times each kernel is run at each size. The fastest run is reported. Defaults to 5.
+//
+#include "stdafx.h"
+
+#include <frantic/maya/geometry/color_graph.hpp>
+#include <frantic/maya/geometry/mesh_kernels.hpp>
+#include <frantic/maya/geometry/smoothing_groups.hpp>
+#include <frantic/maya/particles/channel_conversion.hpp>
+#include <frantic/maya/particles/spatial_sort.hpp>
+
+#include <frantic/channels/channel_map.hpp>
+#include <frantic/graphics/vector3.hpp>
+#include <frantic/graphics/vector3f.hpp>
+#include <frantic/particles/particle_array.hpp>
+
+#include <boost/array.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_real_distribution.hpp>
+
+#include <tbb/tick_count.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using frantic::graphics::vector3;
+using frantic::graphics::vector3f;
+
+namespace {
+
+/**
+ * A regular grid of quads in the XY plane, with its edges listed explicitly as MFnMesh would report them.
+ */
+struct grid_mesh {
+    std::size_t vertexCount;
+    std::vector<int> faceCounts;
+    std::vector<int> faceVertices;
+    std::vector<int> edgeVertices;
+    std::vector<char> edgeSmooth;
+    std::vector<vector3f> positions;
+    std::vector<float> offsetPositions;
+    std::vector<vector3> triangles;
+
+    /**
+     * @param size the number of quads along each side of the grid.
+     * @param hardEdgeInterval every hardEdgeInterval'th edge is hard, the rest are smooth.
+     * @param hardGridLines if true, the edges on every hardEdgeInterval'th grid line are hard instead, which splits the
+     *                      grid into square patches of smooth faces.
+     */
+    grid_mesh( int size, int hardEdgeInterval, bool hardGridLines = false ) {
+        const int side = size + 1;
+        vertexCount = static_cast<std::size_t>( side ) * side;
+
+        positions.reserve( vertexCount );
+        offsetPositions.reserve( 3 * vertexCount );
+        for( int y = 0; y < side; ++y ) {
+            for( int x = 0; x < side; ++x ) {
+                positions.push_back( vector3f( (float)x, (float)y, 0.0f ) );
+                offsetPositions.push_back( (float)x + 0.01f * ( y % 3 ) );
+                offsetPositions.push_back( (float)y );
+                offsetPositions.push_back( 0.01f * ( x % 5 ) );
+            }
+        }
+
+        faceCounts.assign( static_cast<std::size_t>( size ) * size, 4 );
+        faceVertices.reserve( 4 * faceCounts.size() );
+        triangles.reserve( 2 * faceCounts.size() );
+        for( int y = 0; y < size; ++y ) {
+            for( int x = 0; x < size; ++x ) {
+                const int v = y * side + x;
+                faceVertices.push_back( v );
+                faceVertices.push_back( v + 1 );
+                faceVertices.push_back( v + side + 1 );
+                faceVertices.push_back( v + side );
+                triangles.push_back( vector3( v, v + 1, v + side + 1 ) );
+                triangles.push_back( vector3( v, v + side + 1, v + side ) );
+            }
+        }
+
+        for( int y = 0; y < side; ++y ) {
+            for( int x = 0; x < size; ++x ) {
+                edgeVertices.push_back( y * side + x );
+                edgeVertices.push_back( y * side + x + 1 );
+                edgeSmooth.push_back( !hardGridLines || ( y % hardEdgeInterval ) != 0 );
+            }
+        }
+        for( int y = 0; y < size; ++y ) {
+            for( int x = 0; x < side; ++x ) {
+                edgeVertices.push_back( y * side + x );
+                edgeVertices.push_back( ( y + 1 ) * side + x );
+                edgeSmooth.push_back( !hardGridLines || ( x % hardEdgeInterval ) != 0 );
+            }
+        }
+
+        if( !hardGridLines ) {
+            for( std::size_t i = 0, ie = edgeSmooth.size(); i < ie; ++i ) {
+                edgeSmooth[i] = ( i % hardEdgeInterval ) != 0;
+            }
+        }
+    }
+
+    std::size_t face_count() const { return faceCounts.size(); }
+    std::size_t edge_count() const { return edgeVertices.size() / 2; }
+};
+
+// Provides face( faceIndex ) over a triangle list, like the trimesh3 accessors used by mesh.cpp.
+class triangle_faces {
+    const std::vector<vector3>& m_triangles;
+
+    triangle_faces& operator=( const triangle_faces& ); // not implemented
+
+  public:
+    triangle_faces( const std::vector<vector3>& triangles )
+        : m_triangles( triangles ) {}
+
+    const vector3& face( std::size_t faceIndex ) const { return m_triangles[faceIndex]; }
+};
+
+// Stands in for MVector in the particle channel conversions.
+struct double_vector {
+    double x;
+    double y;
+    double z;
+};
+
+/**
+ * Runs kernel() the given number of times.
+ * @return the duration of the fastest run, in seconds.
+ */
+template <class Kernel>
+double time_kernel( Kernel& kernel, int repeats ) {
+    double best = std::numeric_limits<double>::max();
+    for( int i = 0; i < repeats; ++i ) {
+        const tbb::tick_count start = tbb::tick_count::now();
+        kernel();
+        best = std::min( best, ( tbb::tick_count::now() - start ).seconds() );
+    }
+    return best;
+}
+
+void print_header() {
+    std::cout << std::left << std::setw( 32 ) << "kernel" << std::right << std::setw( 12 ) << "items"
+              << std::setw( 14 ) << "seconds" << std::setw( 16 ) << "Mitems/s" << std::endl;
+}
+
+void print_result( const std::string& kernelName, std::size_t items, double seconds ) {
+    const double throughput = seconds > 0 ? items / seconds / 1e6 : 0;
+    std::cout << std::left << std::setw( 32 ) << kernelName << std::right << std::setw( 12 ) << items
+              << std::setw( 14 ) << std::fixed << std::setprecision( 6 ) << seconds << std::setw( 16 )
+              << std::setprecision( 2 ) << throughput << std::endl;
+}
+
+struct edge_to_faces_kernel {
+    const grid_mesh& mesh;
+    std::vector<boost::array<int, 2>> edgeToFaces;
+
+    edge_to_faces_kernel( const grid_mesh& mesh )
+        : mesh( mesh ) {}
+
+    void operator()() {
+        frantic::maya::geometry::build_edge_to_faces( mesh.vertexCount, mesh.faceCounts, mesh.faceVertices,
+                                                      mesh.edgeVertices, edgeToFaces );
+    }
+};
+
+struct face_adjacency_kernel {
+    const grid_mesh& mesh;
+    const std::vector<boost::array<int, 2>>& edgeToFaces;
+    frantic::maya::geometry::adjacency_list inputs;
+
+    face_adjacency_kernel( const grid_mesh& mesh, const std::vector<boost::array<int, 2>>& edgeToFaces )
+        : mesh( mesh )
+        , edgeToFaces( edgeToFaces ) {}
+
+    void operator()() {
+        frantic::maya::geometry::build_face_adjacency( static_cast<boost::uint32_t>( mesh.face_count() ),
+                                                       edgeToFaces, mesh.edgeSmooth, inputs );
+    }
+};
+
+struct color_graph_kernel {
+    const frantic::maya::geometry::adjacency_list& inputs;
+    boost::uint32_t faceCount;
+    std::vector<boost::uint32_t> encoding;
+
+    color_graph_kernel( const frantic::maya::geometry::adjacency_list& inputs, std::size_t faceCount )
+        : inputs( inputs )
+        , faceCount( static_cast<boost::uint32_t>( faceCount ) ) {}
+
+    void operator()() { frantic::maya::geometry::color_graph( inputs, faceCount, encoding ); }
+};
+
+struct parallel_color_graph_kernel {
+    const frantic::maya::geometry::adjacency_list& inputs;
+    boost::uint32_t faceCount;
+    bool deterministic;
+    std::vector<boost::uint32_t> encoding;
+
+    parallel_color_graph_kernel( const frantic::maya::geometry::adjacency_list& inputs, std::size_t faceCount,
+                                 bool deterministic )
+        : inputs( inputs )
+        , faceCount( static_cast<boost::uint32_t>( faceCount ) )
+        , deterministic( deterministic ) {}
+
+    void operator()() {
+        frantic::maya::geometry::parallel_color_graph( inputs, faceCount, encoding, deterministic );
+    }
+};
+
+struct smoothing_groups_kernel {
+    frantic::maya::geometry::smoothing_group_mesh smoothingMesh;
+    std::vector<boost::uint32_t> encoding;
+
+    smoothing_groups_kernel( const grid_mesh& mesh ) {
+        smoothingMesh.vertexCount = mesh.vertexCount;
+        smoothingMesh.faceCounts = mesh.faceCounts;
+        smoothingMesh.faceVertices = mesh.faceVertices;
+        smoothingMesh.edgeVertices = mesh.edgeVertices;
+        smoothingMesh.edgeSmooth = mesh.edgeSmooth;
+    }
+
+    void operator()() {
+        // Discard the previous run's result, so that the groups are recomputed instead of reused.
+        encoding.clear();
+        frantic::maya::geometry::compute_smoothing_groups( smoothingMesh, encoding );
+    }
+};
+
+struct vertex_velocities_kernel {
+    const grid_mesh& mesh;
+    std::vector<vector3f> velocities;
+
+    vertex_velocities_kernel( const grid_mesh& mesh )
+        : mesh( mesh )
+        , velocities( mesh.vertexCount ) {}
+
+    void operator()() {
+        frantic::maya::geometry::compute_vertex_velocities( &mesh.positions[0], &mesh.offsetPositions[0],
+                                                            mesh.vertexCount, 24.0f, &velocities[0] );
+    }
+};
+
+struct face_corners_kernel {
+    const grid_mesh& mesh;
+    std::vector<int> counts;
+    std::vector<int> indices;
+
+    face_corners_kernel( const grid_mesh& mesh )
+        : mesh( mesh )
+        , counts( mesh.triangles.size() )
+        , indices( 3 * mesh.triangles.size() ) {}
+
+    void operator()() {
+        const triangle_faces faces( mesh.triangles );
+        frantic::maya::geometry::fill_face_corners( mesh.triangles.size(), faces, 4096, &counts, indices );
+    }
+};
+
+struct vertex_corner_map_kernel {
+    const grid_mesh& mesh;
+    frantic::maya::geometry::vertex_corner_map vertexCorners;
+
+    vertex_corner_map_kernel( const grid_mesh& mesh )
+        : mesh( mesh ) {}
+
+    void operator()() {
+        frantic::maya::geometry::build_vertex_corner_map( mesh.vertexCount, &mesh.triangles[0], mesh.triangles.size(),
+                                                          vertexCorners );
+    }
+};
+
+struct particle_channels_kernel {
+    const std::vector<double_vector>& positions;
+    const std::vector<double>& densities;
+    const std::vector<unsigned int>* selection;
+    frantic::particles::particle_array particles;
+
+    particle_channels_kernel( const frantic::channels::channel_map& channelMap,
+                              const std::vector<double_vector>& positions, const std::vector<double>& densities,
+                              const std::vector<unsigned int>* selection )
+        : positions( positions )
+        , densities( densities )
+        , selection( selection )
+        , particles( channelMap ) {
+        particles.resize( selection ? selection->size() : positions.size() );
+    }
+
+    void operator()() {
+        const frantic::channels::channel_map& channelMap = particles.get_channel_map();
+        frantic::maya::particles::copy_vector_channel( positions, selection,
+                                                       channelMap.get_cvt_accessor<vector3f>( _T("Position") ),
+                                                       particles );
+        frantic::maya::particles::copy_scalar_channel( densities, selection,
+                                                       channelMap.get_cvt_accessor<double>( _T("Density") ),
+                                                       particles );
+    }
+};
+
+struct morton_sort_kernel {
+    const frantic::particles::particle_array& source;
+    frantic::particles::particle_array particles;
+
+    morton_sort_kernel( const frantic::particles::particle_array& source )
+        : source( source )
+        , particles( source.get_channel_map() ) {}
+
+    void operator()() {
+        // Sort a fresh copy each run, since sorting particles that are already in order is cheaper.
+        particles = source;
+        frantic::maya::particles::sort_particles_by_morton_code( particles );
+    }
+};
+
+/**
+ * Splats the density of each particle into the eight voxels around it, in the order the particles are stored.
+ */
+struct splat_kernel {
+    const frantic::particles::particle_array& particles;
+    int gridSize;
+    std::vector<float> grid;
+
+    splat_kernel( const frantic::particles::particle_array& particles, int gridSize )
+        : particles( particles )
+        , gridSize( gridSize )
+        , grid( static_cast<std::size_t>( gridSize ) * gridSize * gridSize ) {}
+
+    void operator()() {
+        std::fill( grid.begin(), grid.end(), 0.0f );
+
+        const frantic::channels::channel_map& channelMap = particles.get_channel_map();
+        const frantic::channels::channel_accessor<vector3f> position =
+            channelMap.get_accessor<vector3f>( _T("Position") );
+        const frantic::channels::channel_accessor<float> density = channelMap.get_accessor<float>( _T("Density") );
+        const std::size_t stride = static_cast<std::size_t>( gridSize );
+        const float scale = static_cast<float>( gridSize - 1 );
+
+        for( std::size_t i = 0, ie = particles.size(); i < ie; ++i ) {
+            const char* particle = particles[i];
+            const vector3f p = position.get( particle ) * scale;
+            const int x = std::min( static_cast<int>( p.x ), gridSize - 2 );
+            const int y = std::min( static_cast<int>( p.y ), gridSize - 2 );
+            const int z = std::min( static_cast<int>( p.z ), gridSize - 2 );
+            const float fx = p.x - x, fy = p.y - y, fz = p.z - z;
+            const float d = density.get( particle );
+
+            float* cell = &grid[( z * stride + y ) * stride + x];
+            cell[0] += d * ( 1 - fx ) * ( 1 - fy ) * ( 1 - fz );
+            cell[1] += d * fx * ( 1 - fy ) * ( 1 - fz );
+            cell[stride] += d * ( 1 - fx ) * fy * ( 1 - fz );
+            cell[stride + 1] += d * fx * fy * ( 1 - fz );
+            cell[stride * stride] += d * ( 1 - fx ) * ( 1 - fy ) * fz;
+            cell[stride * stride + 1] += d * fx * ( 1 - fy ) * fz;
+            cell[stride * stride + stride] += d * ( 1 - fx ) * fy * fz;
+            cell[stride * stride + stride + 1] += d * fx * fy * fz;
+        }
+    }
+};
+
+// Compares color_graph with parallel_color_graph on the given mesh.
+void run_coloring_benchmarks( const grid_mesh& mesh, const std::string& suffix, int repeats ) {
+    std::vector<boost::array<int, 2>> edgeToFaces;
+    frantic::maya::geometry::build_edge_to_faces( mesh.vertexCount, mesh.faceCounts, mesh.faceVertices,
+                                                  mesh.edgeVertices, edgeToFaces );
+    frantic::maya::geometry::adjacency_list inputs;
+    frantic::maya::geometry::build_face_adjacency( static_cast<boost::uint32_t>( mesh.face_count() ), edgeToFaces,
+                                                   mesh.edgeSmooth, inputs );
+
+    color_graph_kernel coloring( inputs, mesh.face_count() );
+    print_result( "color_graph" + suffix, mesh.face_count(), time_kernel( coloring, repeats ) );
+
+    parallel_color_graph_kernel parallelColoring( inputs, mesh.face_count(), true );
+    print_result( "parallel_color_graph" + suffix, mesh.face_count(), time_kernel( parallelColoring, repeats ) );
+
+    parallel_color_graph_kernel nondeterministicColoring( inputs, mesh.face_count(), false );
+    print_result( "parallel_color_graph/nd" + suffix, mesh.face_count(),
+                  time_kernel( nondeterministicColoring, repeats ) );
+
+    if( !frantic::maya::geometry::is_smoothing_encoding_valid( mesh.face_count(), edgeToFaces, mesh.edgeSmooth,
+                                                               parallelColoring.encoding ) ||
+        !frantic::maya::geometry::is_smoothing_encoding_valid( mesh.face_count(), edgeToFaces, mesh.edgeSmooth,
+                                                               nondeterministicColoring.encoding ) ) {
+        throw std::runtime_error( "run_coloring_benchmarks Error: parallel_color_graph produced invalid smoothing "
+                                  "groups" );
+    }
+}
+
+void run_mesh_benchmarks( int gridSize, int repeats ) {
+    const grid_mesh mesh( gridSize, 7 );
+
+    edge_to_faces_kernel edgeToFaces( mesh );
+    print_result( "build_edge_to_faces", mesh.edge_count(), time_kernel( edgeToFaces, repeats ) );
+
+    face_adjacency_kernel adjacency( mesh, edgeToFaces.edgeToFaces );
+    print_result( "build_face_adjacency", mesh.edge_count(), time_kernel( adjacency, repeats ) );
+
+    run_coloring_benchmarks( mesh, "", repeats );
+    run_coloring_benchmarks( grid_mesh( gridSize, 16, true ), "/patches", repeats );
+
+    smoothing_groups_kernel smoothingGroups( mesh );
+    print_result( "compute_smoothing_groups", mesh.face_count(), time_kernel( smoothingGroups, repeats ) );
+
+    vertex_velocities_kernel velocities( mesh );
+    print_result( "compute_vertex_velocities", mesh.vertexCount, time_kernel( velocities, repeats ) );
+
+    face_corners_kernel faceCorners( mesh );
+    print_result( "fill_face_corners", mesh.triangles.size(), time_kernel( faceCorners, repeats ) );
+
+    vertex_corner_map_kernel vertexCorners( mesh );
+    print_result( "build_vertex_corner_map", mesh.triangles.size(), time_kernel( vertexCorners, repeats ) );
+}
+
+void run_particle_benchmarks( std::size_t particleCount, int repeats ) {
+    frantic::channels::channel_map channelMap;
+    channelMap.define_channel<vector3f>( _T("Position") );
+    channelMap.define_channel<float>( _T("Density") );
+    channelMap.end_channel_definition();
+
+    std::vector<double_vector> positions( particleCount );
+    std::vector<double> densities( particleCount );
+    std::vector<unsigned int> selection;
+    for( std::size_t i = 0; i < particleCount; ++i ) {
+        const double_vector p = { (double)i, 0.5 * i, 0.25 * i };
+        positions[i] = p;
+        densities[i] = ( i % 100 ) / 100.0;
+        if( i % 4 == 0 ) {
+            selection.push_back( static_cast<unsigned int>( i ) );
+        }
+    }
+
+    particle_channels_kernel allParticles( channelMap, positions, densities, NULL );
+    print_result( "copy_particle_channels", particleCount, time_kernel( allParticles, repeats ) );
+
+    particle_channels_kernel selectedParticles( channelMap, positions, densities, &selection );
+    print_result( "copy_particle_channels/sel", selection.size(), time_kernel( selectedParticles, repeats ) );
+}
+
+/**
+ * Splats particles scattered through a unit cube, in the random order of an emitter, into a voxel grid with about one
+ * voxel per particle, with and without sorting them first.
+ */
+void run_splat_benchmarks( std::size_t particleCount, int repeats ) {
+    frantic::channels::channel_map channelMap;
+    channelMap.define_channel<vector3f>( _T("Position") );
+    channelMap.define_channel<vector3f>( _T("Velocity") );
+    channelMap.define_channel<float>( _T("Density") );
+    channelMap.end_channel_definition();
+
+    frantic::particles::particle_array particles( channelMap );
+    particles.resize( particleCount );
+    const frantic::channels::channel_accessor<vector3f> position = channelMap.get_accessor<vector3f>( _T("Position") );
+    const frantic::channels::channel_accessor<vector3f> velocity = channelMap.get_accessor<vector3f>( _T("Velocity") );
+    const frantic::channels::channel_accessor<float> density = channelMap.get_accessor<float>( _T("Density") );
+    boost::random::mt19937 generator( 42 );
+    boost::random::uniform_real_distribution<float> unit( 0.0f, 1.0f );
+    for( std::size_t i = 0; i < particleCount; ++i ) {
+        char* particle = particles[i];
+        const float x = unit( generator ), y = unit( generator ), z = unit( generator );
+        position.get( particle ) = vector3f( x, y, z );
+        velocity.get( particle ) = vector3f( 0.0f );
+        density.get( particle ) = 1.0f;
+    }
+
+    const int gridSize = std::max( 2, static_cast<int>( std::pow( static_cast<double>( particleCount ), 1.0 / 3.0 ) ) );
+
+    morton_sort_kernel sort( particles );
+    const double sortSeconds = time_kernel( sort, repeats );
+    print_result( "sort_particles_by_morton_code", particleCount, sortSeconds );
+
+    splat_kernel emissionOrder( particles, gridSize );
+    const double emissionSeconds = time_kernel( emissionOrder, repeats );
+    print_result( "splat/emission", particleCount, emissionSeconds );
+
+    splat_kernel mortonOrder( sort.particles, gridSize );
+    const double mortonSeconds = time_kernel( mortonOrder, repeats );
+    print_result( "splat/morton", particleCount, mortonSeconds );
+
+    // The sort pays for itself when it saves more splat time than it costs
+    std::cout << std::left << std::setw( 32 ) << "splat/morton speedup" << std::right << std::setw( 12 ) << ""
+              << std::setw( 14 ) << std::fixed << std::setprecision( 2 )
+              << ( mortonSeconds > 0 ? emissionSeconds / mortonSeconds : 0 ) << "x, net "
+              << ( emissionSeconds - mortonSeconds - sortSeconds ) << "s" << std::endl;
+}
+
+} // anonymous namespace
+
+int main( int argc, char* argv[] ) {
+    try {
+        const int maxGridSize = argc > 1 ? boost::lexical_cast<int>( argv[1] ) : 1024;
+        const int repeats = argc > 2 ? boost::lexical_cast<int>( argv[2] ) : 5;
+
+        print_header();
+        for( int gridSize = 64; gridSize <= maxGridSize; gridSize *= 4 ) {
+            run_mesh_benchmarks( gridSize, repeats );
+            run_particle_benchmarks( static_cast<std::size_t>( gridSize ) * gridSize, repeats );
+            run_splat_benchmarks( static_cast<std::size_t>( gridSize ) * gridSize, repeats );
+        }
+    } catch( std::exception& e ) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
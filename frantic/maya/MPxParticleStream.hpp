@@ -33,6 +33,15 @@ class MPxParticleStream : public MPxData {
     getRenderParticleStream( const frantic::graphics::transform4f& objectSpace,
                              const MDGContext& context = MDGContext::fsNormal ) const = 0;
 
+    /**
+     * Same as getRenderParticleStream, but only returns the particles whose Position is inside a region.  The default
+     * culls the particles of getRenderParticleStream as they are read, like particle_stream_source does.
+     */
+    virtual frantic::particles::streams::particle_istream_ptr
+    getRenderParticleStream( const frantic::graphics::transform4f& objectSpace,
+                             const frantic::maya::particles::particle_culling_region& region,
+                             const MDGContext& context = MDGContext::fsNormal ) const;
+
     virtual frantic::particles::streams::particle_istream_ptr
     getViewportParticleStream( const frantic::graphics::transform4f& objectSpace,
                                const MDGContext& context = MDGContext::fsNormal ) const = 0;
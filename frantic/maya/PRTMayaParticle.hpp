@@ -3,8 +3,14 @@
 #pragma once
 
 #include <frantic/maya/PRTObject_base.hpp>
+#include <frantic/maya/particles/constant_channel_particle_istream.hpp>
+
 #include <maya/MFnParticleSystem.h>
+#include <maya/MPlugArray.h>
 #include <maya/MPxNode.h>
+#include <maya/MTime.h>
+
+#include <mutex>
 
 namespace frantic {
 namespace maya {
@@ -27,6 +33,13 @@ class PRTMayaParticle : public MPxNode, public PRTObjectBase {
     // Output particles
     static MObject outParticleStream;
 
+    // Viewport display controls
+    static MObject viewportPercentage;
+    static MObject viewportLimit;
+
+    // If true, the particles are output in Morton order of their positions instead of Maya's order
+    static MObject spatialSort;
+
   public:
     PRTMayaParticle();
     virtual ~PRTMayaParticle();
@@ -38,18 +51,117 @@ class PRTMayaParticle : public MPxNode, public PRTObjectBase {
         return getParticleStream( objectTransform, context, false );
     }
 
+    /**
+     * Tests the raw positions of the Maya particles against the region first, and only converts the particles inside
+     * it.
+     */
+    virtual frantic::particles::streams::particle_istream_ptr
+    getRenderParticleStream( const frantic::graphics::transform4f& objectTransform,
+                             const frantic::maya::particles::particle_culling_region& region,
+                             const MDGContext& context ) const {
+        return getParticleStream( objectTransform, context, false, &region );
+    }
+
     virtual frantic::particles::streams::particle_istream_ptr
     getViewportParticleStream( const frantic::graphics::transform4f& objectTransform,
                                const MDGContext& context ) const {
         return getParticleStream( objectTransform, context, true );
     }
 
+    virtual double getViewportFraction( const MDGContext& context = MDGContext::fsNormal ) const;
+
+    virtual boost::int64_t getViewportLimit( const MDGContext& context = MDGContext::fsNormal ) const;
+
+    /**
+     * @return true if the particles are sorted along a Morton curve through their positions, so that particles close
+     *         together in space are also close together in the stream.  See sort_particles_by_morton_code.
+     */
+    bool getSpatialSort( const MDGContext& context = MDGContext::fsNormal ) const;
+
+    /**
+     * Finds the statistics straight from the connected Maya particle system's arrays, without converting its
+     * particles.  They are cached until the time, the particle system's transform or particle count changes, or this
+     * node is dirtied.
+     */
+    virtual void getParticleStreamStatistics( const frantic::graphics::transform4f& objectSpace,
+                                              frantic::maya::particles::particle_stream_statistics& outStats,
+                                              const MDGContext& context = MDGContext::fsNormal ) const;
+
+    virtual MStatus setDependentsDirty( const MPlug& plug, MPlugArray& plugArray );
+
+    /**
+     * Converts the connected Maya particle system to a particle stream.
+     * @param isViewport if true, only the fraction of particles given by the viewportPercentage and viewportLimit
+     *                   attributes are read from Maya and converted.
+     * @param region if not NULL, only the particles inside this region, in the space of the returned particles, are
+     *               converted.
+     */
     frantic::particles::streams::particle_istream_ptr
     getParticleStream( const frantic::graphics::transform4f& objectTransform, const MDGContext& context,
-                       bool isViewport ) const;
+                       bool isViewport,
+                       const frantic::maya::particles::particle_culling_region* region = NULL ) const;
+
+    /**
+     * Captures the connected Maya particle system once, and extrapolates each sample from that capture using the
+     * particles' velocity, and their acceleration if the particle system has a per-particle acceleration.
+     */
+    virtual void getMotionSampledParticleStreams( const frantic::graphics::transform4f& objectSpace,
+                                                  const std::vector<double>& sampleOffsets,
+                                                  std::vector<particle_istream_ptr>& outStreams,
+                                                  const MDGContext& context = MDGContext::fsNormal ) const;
 
     MObject getConnectedMayaParticleStream( MStatus* status = NULL ) const;
 
+  private:
+    /**
+     * Reads the connected Maya particle system into an array, in the particle system's object space.
+     * @param isViewport if true, only the particles displayed in the viewport are read.
+     * @param includeAcceleration if true, the Acceleration channel is also read.
+     * @param region if not NULL, only the particles inside this region are read.
+     * @param outParticles receives the per-particle channels.
+     * @param outConstants receives the channels with the same value for every particle.
+     * @return false if the particle system could not be read.
+     */
+    bool getParticleSnapshot( const frantic::graphics::transform4f& objectSpace, const MDGContext& context,
+                              bool isViewport, bool includeAcceleration,
+                              const frantic::maya::particles::particle_culling_region* region,
+                              boost::shared_ptr<frantic::particles::particle_array>& outParticles,
+                              frantic::maya::particles::constant_channel_table& outConstants ) const;
+
+    /**
+     * Gets the Maya particle system connected to this node.
+     * @return false if there is none.
+     */
+    bool getConnectedParticleSystem( MFnParticleSystem& outParticleSystem ) const;
+
+    /**
+     * Gets the world transform of the particle system, which the particles are returned relative to.
+     * @param objectSpace used if the particle system's transform can't be found.
+     */
+    frantic::graphics::transform4f getBaseObjectSpace( const MFnParticleSystem& particleNode,
+                                                       const frantic::graphics::transform4f& objectSpace,
+                                                       const MDGContext& context ) const;
+
+    // The last statistics found by getParticleStreamStatistics, and what they were found for
+    struct statistics_cache {
+        bool valid;
+        MTime time;
+        frantic::graphics::transform4f baseObjectSpace;
+        std::size_t particleCount;
+        frantic::maya::particles::particle_stream_statistics statistics;
+
+        statistics_cache()
+            : valid( false )
+            , particleCount( 0 ) {}
+
+        bool matches( const MTime& t, const frantic::graphics::transform4f& objectSpace, std::size_t count ) const {
+            return valid && time == t && baseObjectSpace == objectSpace && particleCount == count;
+        }
+    };
+
+    mutable std::mutex m_statisticsMutex;
+    mutable statistics_cache m_statisticsCache;
+
   public:
     /**
      * Retrieves the PRT Wrapper from the given maya particle system
@@ -8,15 +8,20 @@
 
 #include <frantic/geometry/trimesh3.hpp>
 #include <frantic/graphics/transform4f.hpp>
+#include <frantic/maya/particles/particle_statistics.hpp>
+#include <frantic/maya/particles/region_culling_particle_istream.hpp>
 #include <frantic/particles/particle_array.hpp>
 #include <frantic/particles/streams/particle_istream.hpp>
 
+#include <boost/cstdint.hpp>
 #include <boost/shared_ptr.hpp>
 #include <vector>
 
 namespace frantic {
 namespace maya {
 
+class plugin_manager;
+
 //////////////////////////////////////////////////////////////////////////////////////////////////////
 
 class particle_stream_source {
@@ -31,6 +36,29 @@ class particle_stream_source {
     virtual frantic::particles::streams::particle_istream_ptr
     getViewportParticleStream( const frantic::graphics::transform4f& objectSpace,
                                const MDGContext& context = MDGContext::fsNormal ) const = 0;
+
+    /**
+     * Same as getRenderParticleStream, but only returns the particles whose Position is inside a region, such as a
+     * camera's frustum.  The default culls the particles of getRenderParticleStream as they are read, sources that can
+     * test the positions before converting the particles should override it.
+     * @param region the region to keep the particles of, in the same space as the returned particles.
+     * @param context specify the evaluation context.  Defaults to the current context
+     */
+    virtual frantic::particles::streams::particle_istream_ptr
+    getRenderParticleStream( const frantic::graphics::transform4f& objectSpace,
+                             const frantic::maya::particles::particle_culling_region& region,
+                             const MDGContext& context = MDGContext::fsNormal ) const;
+
+    /**
+     * Gets the particle count, the Position bounds and the channel ranges of the particles returned by
+     * getRenderParticleStream, without the caller having to read them.  The default reads every particle of
+     * getRenderParticleStream, sources that can find the statistics more cheaply should override it.
+     * @param[out] outStats the statistics.
+     * @param context specify the evaluation context.  Defaults to the current context
+     */
+    virtual void getParticleStreamStatistics( const frantic::graphics::transform4f& objectSpace,
+                                              frantic::maya::particles::particle_stream_statistics& outStats,
+                                              const MDGContext& context = MDGContext::fsNormal ) const;
 };
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -40,6 +68,8 @@ class PRTObjectBase : public particle_stream_source {
   public:
     typedef frantic::particles::streams::particle_istream_ptr particle_istream_ptr;
 
+    using particle_stream_source::getRenderParticleStream;
+
     /**
      * Returns the particle stream to use in a full-scale render
      * @param context specify the evaluation context.  Defaults to the current context
@@ -54,6 +84,33 @@ class PRTObjectBase : public particle_stream_source {
     virtual particle_istream_ptr getViewportParticleStream( const frantic::graphics::transform4f& objectSpace,
                                                             const MDGContext& context = MDGContext::fsNormal ) const;
 
+    /**
+     * Returns the fraction of particles, in [0,1], to display in the viewport. The default displays all particles.
+     * @param context specify the evaluation context.  Defaults to the current context
+     */
+    virtual double getViewportFraction( const MDGContext& context = MDGContext::fsNormal ) const;
+
+    /**
+     * Returns the maximum number of particles to display in the viewport, or a negative value for no limit.  The
+     * default has no limit.
+     * @param context specify the evaluation context.  Defaults to the current context
+     */
+    virtual boost::int64_t getViewportLimit( const MDGContext& context = MDGContext::fsNormal ) const;
+
+    /**
+     * Returns render particle streams at several times around the context's time, such as the shutter samples of
+     * motion blur.  The default calls getRenderParticleStream once for each sample.  Objects that can only capture
+     * their particles at the current time should override it to capture them once, and move that capture to each
+     * sample's time, for example with a motion_extrapolation_particle_istream.
+     * @param sampleOffsets the time of each sample, in frames relative to the context's time.
+     * @param outStreams receives one stream for each sample, in the order of sampleOffsets.
+     * @param context specify the evaluation context.  Defaults to the current context
+     */
+    virtual void getMotionSampledParticleStreams( const frantic::graphics::transform4f& objectSpace,
+                                                  const std::vector<double>& sampleOffsets,
+                                                  std::vector<particle_istream_ptr>& outStreams,
+                                                  const MDGContext& context = MDGContext::fsNormal ) const;
+
   public:
     /**
      * Gets the final render or viewport particle stream taking into account additional transformations to be applied to
@@ -65,6 +122,18 @@ class PRTObjectBase : public particle_stream_source {
                                                         bool isViewport = false,
                                                         MString outParticleStreamAttr = "outParticleStream" );
 
+    /**
+     * Same as getFinalParticleStream for a render stream, but only returns the particles inside a region.  The end of
+     * the chain is asked for the culled stream, so sources that override the region overload of
+     * getRenderParticleStream can skip the culled particles before converting them.
+     * @param region the region to keep the particles of, in the same space as the returned particles.
+     */
+    static particle_istream_ptr getFinalParticleStream( const MFnDependencyNode& depNode,
+                                                        const frantic::graphics::transform4f& objectSpace,
+                                                        const frantic::maya::particles::particle_culling_region& region,
+                                                        const MDGContext& context = MDGContext::fsNormal,
+                                                        MString outParticleStreamAttr = "outParticleStream" );
+
     /**
      * Helper method to get the particle stream from the MPxData object
      */
@@ -74,6 +143,15 @@ class PRTObjectBase : public particle_stream_source {
                                                               bool isViewport = false,
                                                               MString outParticleStreamAttr = "outParticleStream" );
 
+    /**
+     * Helper method to get the render particle stream, culled to a region, from the MPxData object
+     */
+    static particle_istream_ptr
+    getParticleStreamFromMPxData( const MFnDependencyNode& depNode, const frantic::graphics::transform4f& objectSpace,
+                                  const frantic::maya::particles::particle_culling_region& region,
+                                  const MDGContext& context = MDGContext::fsNormal,
+                                  MString outParticleStreamAttr = "outParticleStream" );
+
     /**
      * Helper method to iterate to the final dependency node in the particle stream chain
      */
@@ -81,13 +159,35 @@ class PRTObjectBase : public particle_stream_source {
                                         MString outParticleStreamAttr = "outParticleStream" );
 
     /**
-     * Helper method to get the next element in the chain.  Return kNullObj if we walk off the end.
+     * Gets every node of the particle stream chain that starts at depNode, in order.  The first element is depNode and
+     * the last is the node returned by getEndOfStreamChain.  If registerStreamChainCallbacks was called, the chain is
+     * cached until a connection to or from one of its nodes' stream attributes changes.
+     */
+    static void getStreamChain( const MFnDependencyNode& depNode, std::vector<MObject>& outChain,
+                                MString outParticleStreamAttr = "outParticleStream" );
+
+    /**
+     * Registers the callbacks that invalidate cached stream chains, and enables the cache.  The cache holds the chains
+     * of getStreamChain and getEndOfStreamChain, and the neighbors found by nextElementInChain and
+     * previousElementInChain.  pluginManager.unregister_all() removes the callbacks and disables the cache.
+     */
+    static MStatus registerStreamChainCallbacks( plugin_manager& pluginManager );
+
+    /**
+     * Discards all cached stream chains and neighbors.
+     */
+    static void invalidateStreamChainCache();
+
+    /**
+     * Helper method to get the next element in the chain.  Return kNullObj if we walk off the end.  The result is
+     * cached like the chains of getStreamChain.
      */
     static MObject nextElementInChain( const MFnDependencyNode& depNode,
                                        MString outParticleStreamAttr = "outParticleStream" );
 
     /**
-     * Helper method to get the previous element in the chain.  Return kNullObj if we walk off the end.
+     * Helper method to get the previous element in the chain.  Return kNullObj if we walk off the end.  The result is
+     * cached like the chains of getStreamChain.
      */
     static MObject previousElementInChain( const MFnDependencyNode& depNode,
                                            MString inParticleStreamAttr = "inParticleStream" );
@@ -4,16 +4,21 @@
 
 #include <maya/MAngle.h>
 #include <maya/MDGContext.h>
+#include <maya/MFnEnumAttribute.h>
 #include <maya/MFnDependencyNode.h>
 #include <maya/MGlobal.h>
 #include <maya/MPlug.h>
 #include <maya/MStatus.h>
 #include <maya/MString.h>
 #include <maya/MTime.h>
+#include <maya/MTypeId.h>
 
 #include <frantic/graphics/color3f.hpp>
 
 #include <boost/lexical_cast.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <vector>
 
 namespace frantic {
 namespace maya {
@@ -37,15 +42,30 @@ inline MString get_string_attribute( const MFnDependencyNode& node, const MStrin
 }
 
 /**
- * Gets an enum attribute as a string.  The implementation is a little weird because this is a feature that is only
- * available in Mel.
+ * Gets an enum attribute as a string.  Attributes that are not enums are converted to a string by Mel's
+ * 'getAttr -asString'.
  */
 inline MString get_enum_attribute( const MFnDependencyNode& node, const MString& attribute,
                                    const MDGContext& context = MDGContext::fsNormal, MStatus* outStatus = NULL ) {
+    MStatus returnState;
+    MPlug plug = node.findPlug( attribute, &returnState );
+    if( returnState && plug.attribute().hasFn( MFn::kEnumAttribute ) ) {
+        MFnEnumAttribute fnEnum( plug.attribute() );
+        const short value = plug.asShort( const_cast<MDGContext&>( context ), &returnState );
+        MString result;
+        if( returnState )
+            result = fnEnum.fieldName( value, &returnState );
+
+        if( outStatus != NULL )
+            *outStatus = returnState;
+
+        return result;
+    }
+
     MString result;
     MTime currentTime;
     context.getTime( currentTime );
-    MStatus returnState = MGlobal::executeCommand(
+    returnState = MGlobal::executeCommand(
         MString( "getAttr -asString -time " ) +
             MString( boost::lexical_cast<std::string>( currentTime.as( MTime::uiUnit() ) ).c_str() ) +
             MString( " \"" ) + node.name() + MString( "." ) + attribute + MString( "\";" ),
@@ -92,5 +112,118 @@ inline MAngle get_angle_attribute( const MFnDependencyNode& node, const MString&
     return plug.asMAngle( const_cast<MDGContext&>( context ) );
 }
 
+/**
+ * Reads a named attribute from many nodes without looking the attribute up by name each time.
+ *
+ * The attribute object of a static attribute is the same for every node of a type, so it is resolved once per node
+ * type and attribute name, and cached.  Plugs are then built directly from the node and the attribute object.  Dynamic
+ * attributes are specific to each node, and are still looked up by name.  An attribute that is not a static attribute
+ * of a type is only looked up by name on the nodes of that type that have dynamic attributes.
+ *
+ * The cache is shared by every accessor in the process.  plugin_manager clears it when it registers a node type and
+ * when the plugin is unloaded, so that attribute objects of node types that are no longer registered are not reused.
+ * Like the rest of the Maya API, accessors must only be used from the main thread.
+ */
+class attribute_accessor {
+  public:
+    explicit attribute_accessor( const MString& attributeName );
+    ~attribute_accessor();
+
+    const MString& name() const { return m_attributeName; }
+
+    /**
+     * Discards the cached attribute objects of every accessor.  Call this when node types are registered or
+     * deregistered.
+     */
+    static void clear_cache();
+
+    /**
+     * @return the plug for this attribute on node.  Sets outStatus to a failure if node has no such attribute.
+     */
+    MPlug get_plug( const MFnDependencyNode& node, MStatus* outStatus = NULL ) const;
+
+    float get_float( const MFnDependencyNode& node, const MDGContext& context = MDGContext::fsNormal,
+                     MStatus* outStatus = NULL ) const;
+
+    int get_int( const MFnDependencyNode& node, const MDGContext& context = MDGContext::fsNormal,
+                 MStatus* outStatus = NULL ) const;
+
+    bool get_boolean( const MFnDependencyNode& node, const MDGContext& context = MDGContext::fsNormal,
+                      MStatus* outStatus = NULL ) const;
+
+    MString get_string( const MFnDependencyNode& node, const MDGContext& context = MDGContext::fsNormal,
+                        MStatus* outStatus = NULL ) const;
+
+    /**
+     * Gets an enum attribute's field name.  Sets outStatus to a failure if the attribute is not an enum.
+     */
+    MString get_enum( const MFnDependencyNode& node, const MDGContext& context = MDGContext::fsNormal,
+                      MStatus* outStatus = NULL ) const;
+
+    /**
+     * See get_angle_attribute.
+     */
+    MAngle get_angle( const MFnDependencyNode& node, const MDGContext& context = MDGContext::fsNormal,
+                      MStatus* outStatus = NULL ) const;
+
+    /**
+     * See get_color_attribute.
+     */
+    frantic::graphics::color3f get_color( const MFnDependencyNode& node,
+                                          const MDGContext& context = MDGContext::fsNormal,
+                                          MStatus* outStatus = NULL ) const;
+
+  private:
+    attribute_accessor( const attribute_accessor& );            // not implemented
+    attribute_accessor& operator=( const attribute_accessor& ); // not implemented
+
+    friend class attribute_set;
+
+    MPlug get_plug( const MFnDependencyNode& node, const MTypeId& typeId, bool hasTypeId, MStatus* outStatus ) const;
+
+    MString m_attributeName;
+};
+
+/**
+ * Reads several attributes of one node in a single call.  The node's type is resolved once for all of the attributes,
+ * and the attribute objects are cached per node type as in attribute_accessor.
+ */
+class attribute_set {
+  public:
+    attribute_set() {}
+
+    /**
+     * @param attributeNames the attributes to read, in the order their values are returned.
+     */
+    explicit attribute_set( const std::vector<MString>& attributeNames );
+
+    /**
+     * Adds an attribute to the set.
+     * @return the index of the attribute's value in the get_plugs and get_doubles results.
+     */
+    std::size_t add( const MString& attributeName );
+
+    std::size_t size() const { return m_accessors.size(); }
+
+    const MString& name( std::size_t index ) const { return m_accessors[index]->name(); }
+
+    /**
+     * Gets the plugs of every attribute in the set.
+     * @return false if the node is missing one of the attributes.  The plug of a missing attribute is left null.
+     */
+    bool get_plugs( const MFnDependencyNode& node, std::vector<MPlug>& outPlugs ) const;
+
+    /**
+     * Reads every attribute in the set as a double.  This works for numeric, boolean, enum and distance attributes.
+     * @return false if the node is missing one of the attributes, or if one could not be read.  The value of such an
+     *         attribute is set to 0.
+     */
+    bool get_doubles( const MFnDependencyNode& node, std::vector<double>& outValues,
+                      const MDGContext& context = MDGContext::fsNormal ) const;
+
+  private:
+    std::vector<boost::shared_ptr<attribute_accessor>> m_accessors;
+};
+
 } // namespace maya
 } // namespace frantic
@@ -0,0 +1,95 @@
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+#pragma once
+
+#include <boost/cstdint.hpp>
+
+#include <algorithm>
+#include <vector>
+
+namespace frantic {
+namespace maya {
+namespace geometry {
+
+// Represents the relation ships between the nodes/groups in the mesh.
+class adjacency_list {
+  public:
+    typedef std::vector<boost::uint32_t>::const_iterator const_iterator;
+
+  private:
+    // One vector for the soft connections, and one for the hard connections
+    // Each index in the vector corresponds to a node number, and contains a vector of all the nodes it has a connection
+    // too It is used both for node relationships as well as group relationships
+    std::vector<std::vector<boost::uint32_t>> m_softEntries;
+    std::vector<std::vector<boost::uint32_t>> m_hardEntries;
+
+  public:
+    adjacency_list() {}
+
+    explicit adjacency_list( boost::uint32_t capacity ) {
+        m_softEntries.reserve( capacity );
+        m_hardEntries.reserve( capacity );
+    }
+
+    void soft_insert( boost::uint32_t left, boost::uint32_t right );
+    void hard_insert( boost::uint32_t left, boost::uint32_t right );
+
+    size_t size() const;
+
+    // IMPORTANT: None of these do bounds checking; it's up to you to ensure that there are enough entries
+    inline size_t soft_count( boost::uint32_t entry ) const { return m_softEntries[entry].size(); }
+    inline size_t hard_count( boost::uint32_t entry ) const { return m_hardEntries[entry].size(); }
+
+    // These allow you to ensure the vectors have the right size
+    inline void soft_ensure( size_t size ) { m_softEntries.resize( std::max( size, m_softEntries.size() ) ); }
+    inline void hard_ensure( size_t size ) { m_hardEntries.resize( std::max( size, m_hardEntries.size() ) ); }
+
+    // These add right to the connections of left only, which allows a graph to be copied without changing the order
+    // of each node's connections. They do not do bounds checking either.
+    inline void soft_push_back( boost::uint32_t left, boost::uint32_t right ) {
+        m_softEntries[left].push_back( right );
+    }
+    inline void hard_push_back( boost::uint32_t left, boost::uint32_t right ) {
+        m_hardEntries[left].push_back( right );
+    }
+
+    // These also do not do bound checking
+    inline const_iterator soft_begin( boost::uint32_t entry ) const { return m_softEntries[entry].begin(); }
+    inline const_iterator soft_end( boost::uint32_t entry ) const { return m_softEntries[entry].end(); }
+    inline const_iterator hard_begin( boost::uint32_t entry ) const { return m_hardEntries[entry].begin(); }
+    inline const_iterator hard_end( boost::uint32_t entry ) const { return m_hardEntries[entry].end(); }
+};
+
+/**
+ * Assigns a smoothing group bit to each face, so that faces joined by a soft edge share a bit and faces joined by a
+ * hard edge do not. This does not use the Maya API.
+ * @param inputs the soft and hard connections between faces.
+ * @param numFaces the number of faces.
+ * @param result the smoothing group flags of each face.
+ */
+void color_graph( const adjacency_list& inputs, boost::uint32_t numFaces, std::vector<boost::uint32_t>& result );
+
+/**
+ * A parallel version of color_graph, for large meshes. The result follows the same rules as color_graph, but the
+ * flags chosen for each face may differ from it.
+ *
+ * Faces are first split into their soft-connected components concurrently. Components with no hard edge between
+ * their own faces are each a single group; the others are split into groups as color_graph does, with the
+ * components processed in parallel. The groups are then colored in rounds: each pending pair of soft-connected
+ * groups speculatively picks the lowest flag not used by their hard neighbours, and a pair whose flag conflicts with
+ * that of a higher priority pair is retried in the next round. Pairs of the most connected groups have the highest
+ * priority, as in color_graph.
+ *
+ * @param inputs the soft and hard connections between faces.
+ * @param numFaces the number of faces.
+ * @param result the smoothing group flags of each face.
+ * @param deterministic if true, the flags are the same on every run. If false, the group connections are not sorted
+ *                      after they are gathered in parallel, so the flags may vary from run to run, although they are
+ *                      always valid.
+ */
+void parallel_color_graph( const adjacency_list& inputs, boost::uint32_t numFaces, std::vector<boost::uint32_t>& result,
+                           bool deterministic = true );
+
+} // namespace geometry
+} // namespace maya
+} // namespace frantic
@@ -2,6 +2,8 @@
 // SPDX-License-Identifier: Apache-2.0
 #pragma once
 
+#include <frantic/maya/geometry/color_graph.hpp>
+
 #include <boost/unordered_map.hpp>
 //#include <boost/unordered_set.hpp>
 #include <boost/function.hpp>
@@ -13,48 +15,6 @@
 namespace frantic {
 namespace maya {
 namespace geometry {
-// Represents the relation ships between the nodes/groups in the mesh.
-class adjacency_list {
-  public:
-    typedef std::vector<boost::uint32_t>::const_iterator const_iterator;
-
-  private:
-    // One vector for the soft connections, and one for the hard connections
-    // Each index in the vector corresponds to a node number, and contains a vector of all the nodes it has a connection
-    // too It is used both for node relationships as well as group relationships
-    std::vector<std::vector<boost::uint32_t>> m_softEntries;
-    std::vector<std::vector<boost::uint32_t>> m_hardEntries;
-
-  public:
-    adjacency_list() {}
-
-    explicit adjacency_list( boost::uint32_t capacity ) {
-        m_softEntries.reserve( capacity );
-        m_hardEntries.reserve( capacity );
-    }
-
-    void soft_insert( boost::uint32_t left, boost::uint32_t right );
-    void hard_insert( boost::uint32_t left, boost::uint32_t right );
-
-    size_t size() const;
-
-    // IMPORTANT: None of these do bounds checking; it's up to you to ensure that there are enough entries
-    inline size_t soft_count( boost::uint32_t entry ) const { return m_softEntries[entry].size(); }
-    inline size_t hard_count( boost::uint32_t entry ) const { return m_hardEntries[entry].size(); }
-
-    // These allow you to ensure the vectors have the right size
-    inline void soft_ensure( size_t size ) { m_softEntries.resize( std::max( size, m_softEntries.size() ) ); }
-    inline void hard_ensure( size_t size ) { m_hardEntries.resize( std::max( size, m_hardEntries.size() ) ); }
-
-    // These also do not do bound checking
-    inline const_iterator soft_begin( boost::uint32_t entry ) const { return m_softEntries[entry].begin(); }
-    inline const_iterator soft_end( boost::uint32_t entry ) const { return m_softEntries[entry].end(); }
-    inline const_iterator hard_begin( boost::uint32_t entry ) const { return m_hardEntries[entry].begin(); }
-    inline const_iterator hard_end( boost::uint32_t entry ) const { return m_hardEntries[entry].end(); }
-};
-
-void color_graph( const adjacency_list& inputs, boost::uint32_t numFaces, std::vector<boost::uint32_t>& result );
-
 std::vector<boost::tuple<int, int, std::vector<int>>> find_faces( const MFnMesh& fnMesh );
 
 namespace testsuite {
@@ -4,9 +4,12 @@
 
 #include <maya/MFnMesh.h>
 
+#include <frantic/maya/geometry/smoothing_groups.hpp>
+
 #include <frantic/channels/channel_propagation_policy.hpp>
 #include <frantic/geometry/polymesh3.hpp>
 #include <frantic/geometry/trimesh3.hpp>
+#include <frantic/logging/progress_logger.hpp>
 
 namespace frantic {
 namespace maya {
@@ -15,11 +18,14 @@ namespace geometry {
 /**
  * Create a polymesh3 object from a Maya mesh.
  * Does not produce velocity channel. Does not consider smooth mesh options.
+ * @param progress if not NULL, the number of faces and vertices copied are reported to it with add_progress_count, so
+ *        that a logger from create_progress_logger records the conversion's throughput in batch mode.
  */
 frantic::geometry::polymesh3_ptr polymesh_copy( const MDagPath& dagPath, bool worldSpace,
                                                 const frantic::channels::channel_propagation_policy& cpp,
                                                 bool colorFromCurrentColorSet = false,
-                                                bool textureCoordFromCurrentUVSet = false );
+                                                bool textureCoordFromCurrentUVSet = false,
+                                                frantic::logging::progress_logger* progress = NULL );
 
 /**
  * Uses the crease information stored in the edges of fnMesh to create an EdgeSharpness channel that is stored in
@@ -33,6 +39,12 @@ void copy_edge_creases( const MDagPath& dagPath, const MFnMesh& srcMesh, frantic
  */
 void copy_vertex_creases( const MDagPath& dagPath, const MFnMesh& srcMesh, frantic::geometry::polymesh3_ptr outMesh );
 
+/**
+ * Copies the topology and edge smoothing of fnMesh into the arrays used by compute_smoothing_groups(). This is the
+ * only part of computing smoothing groups that uses the Maya API, so the rest may be done on another thread.
+ */
+void get_smoothing_group_mesh( const MFnMesh& fnMesh, smoothing_group_mesh& outMesh );
+
 /**
  * Uses the smoothing information stored in the edges of fnMesh to create a SmoothingGroup channel that is stored in
  * outMesh.
@@ -59,9 +71,11 @@ void create_smoothing_groups( const MFnMesh& fnMesh, std::vector<boost::uint32_t
  * copied into the frantic mesh.
  * @param useSmoothedMeshSubdivs If true, the mesh will respect the user's "smoothed mesh" subdivision options. The
  * subdivided mesh is used by renderers. If false, the base mesh will be returned.
+ * @param progress If not NULL, the number of faces and vertices copied are reported to it, as for polymesh_copy.
  */
 void copy_maya_mesh( MPlug meshPlug, frantic::geometry::trimesh3& outMesh, bool generateNormals, bool generateUVCoords,
-                     bool generateVelocity, bool generateColors, bool useSmoothedMeshSubdivs );
+                     bool generateVelocity, bool generateColors, bool useSmoothedMeshSubdivs,
+                     frantic::logging::progress_logger* progress = NULL );
 
 /**
  * Copy a trimesh3 into a new Maya mesh.
@@ -77,8 +91,26 @@ void mesh_copy( MObject parentOrOwner, const frantic::geometry::trimesh3& mesh )
  * @param mesh the mesh to copy.
  * @param timeOffset the time offset used to move the vertices based on the
  *        Velocity channel of the mesh.
+ * @param updateMatchingTopology if true, and the mesh last created for parentOrOwner was created from a mesh with
+ *        the same topology as mesh, only the vertex positions of that mesh are updated. See mesh_update_time_offset().
+ */
+void mesh_copy_time_offset( MObject parentOrOwner, const frantic::geometry::trimesh3& mesh, float timeOffset,
+                            bool updateMatchingTopology = true );
+
+/**
+ * Update the vertex positions of a Maya mesh previously created by mesh_copy_time_offset(), with the vertices
+ * offset according to the mesh's Velocity channel and the specified timeOffset. The faces, UVs, normals and color
+ * sets of the Maya mesh are left untouched.
+ * @param parentOrOwner the parentOrOwner that was passed to mesh_copy_time_offset(). For a transform, the mesh shape
+ *        that was created under it is updated, rather than any other mesh shape it has.
+ * @param mesh the mesh to copy the vertices from.
+ * @param timeOffset the time offset used to move the vertices based on the
+ *        Velocity channel of the mesh.
+ * @return true if the Maya mesh was created from a mesh with the same vertex count and faces as mesh, still has
+ *         those counts, and was updated. false if no mesh was found or its topology differs, in which case nothing is
+ *         modified.
  */
-void mesh_copy_time_offset( MObject parentOrOwner, const frantic::geometry::trimesh3& mesh, float timeOffset );
+bool mesh_update_time_offset( MObject parentOrOwner, const frantic::geometry::trimesh3& mesh, float timeOffset );
 
 } // namespace geometry
 } // namespace maya
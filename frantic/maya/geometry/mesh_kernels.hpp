@@ -0,0 +1,174 @@
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+#pragma once
+
+#include <frantic/maya/geometry/color_graph.hpp>
+
+#include <frantic/graphics/vector3.hpp>
+#include <frantic/graphics/vector3f.hpp>
+
+#include <boost/array.hpp>
+#include <boost/cstdint.hpp>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include <cstddef>
+#include <vector>
+
+// The mesh conversion kernels in this file work on plain arrays and do not use the Maya API. The MFnMesh conversions
+// in mesh.cpp gather their inputs from Maya and call these, and the benchmarks directory measures them on synthetic
+// meshes.
+
+namespace frantic {
+namespace maya {
+namespace geometry {
+
+/**
+ * Finds the faces on either side of each edge of a polygon mesh.
+ * @param vertexCount the number of vertices in the mesh.
+ * @param faceCounts the number of corners of each face.
+ * @param faceVertices the vertex index of each face corner, in face order.
+ * @param edgeVertices the two vertex indices of each edge, two entries per edge.
+ * @param[out] outEdgeToFaces the first two faces incident on each edge, in increasing order. "No face" is indicated
+ *                            by the value -1.
+ */
+void build_edge_to_faces( std::size_t vertexCount, const std::vector<int>& faceCounts,
+                          const std::vector<int>& faceVertices, const std::vector<int>& edgeVertices,
+                          std::vector<boost::array<int, 2>>& outEdgeToFaces );
+
+/**
+ * Builds the face connections used by color_graph. Faces that share a smooth edge get a soft connection, and faces
+ * that share a hard edge get a hard connection. Boundary edges add no connection.
+ * @param faceCount the number of faces in the mesh.
+ * @param edgeToFaces the faces on either side of each edge, as produced by build_edge_to_faces.
+ * @param edgeSmooth non-zero for each smooth edge.
+ * @param[out] outInputs the face connections. Any existing connections are discarded.
+ */
+void build_face_adjacency( boost::uint32_t faceCount, const std::vector<boost::array<int, 2>>& edgeToFaces,
+                           const std::vector<char>& edgeSmooth, adjacency_list& outInputs );
+
+/**
+ * Checks whether an existing smoothing group encoding still agrees with the mesh's edges, so that it can be reused
+ * instead of coloring the graph again.
+ * @param faceCount the number of faces in the mesh.
+ * @param edgeToFaces the faces on either side of each edge, as produced by build_edge_to_faces.
+ * @param edgeSmooth non-zero for each smooth edge.
+ * @param encoding the smoothing group flags of each face, from a previous call to color_graph.
+ * @return true if every interior edge is smooth exactly when its two faces share a smoothing group.
+ */
+bool is_smoothing_encoding_valid( std::size_t faceCount, const std::vector<boost::array<int, 2>>& edgeToFaces,
+                                  const std::vector<char>& edgeSmooth, const std::vector<boost::uint32_t>& encoding );
+
+/**
+ * Computes vertex velocities by differencing two sets of positions of the same vertices.
+ * @param positions the vertex positions at the start of the step.
+ * @param offsetPositions the vertex positions at the end of the step, three floats per vertex.
+ * @param count the number of vertices.
+ * @param scale the factor that converts a change in position to a velocity, usually frames per second over the step
+ *              length in frames.
+ * @param[out] outVelocities the velocity of each vertex.
+ * @return true if any of the velocities is non-zero.
+ */
+bool compute_vertex_velocities( const frantic::graphics::vector3f* positions, const float* offsetPositions,
+                                std::size_t count, float scale, frantic::graphics::vector3f* outVelocities );
+
+/**
+ * The face corners of a triangle mesh that use each vertex.  A corner is identified by 3 * faceIndex + corner, and
+ * the corners of vertex v are corners[offsets[v]] to corners[offsets[v + 1] - 1], in increasing order.
+ */
+struct vertex_corner_map {
+    std::vector<std::size_t> offsets;
+    std::vector<std::size_t> corners;
+
+    std::size_t vertex_count() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+
+    std::size_t corner_count( std::size_t vertex ) const { return offsets[vertex + 1] - offsets[vertex]; }
+
+    /**
+     * Picks one corner to represent a vertex: the last corner that uses it, in face order.
+     * @param vertex the vertex index.
+     * @param[out] outFace the face of the corner.
+     * @param[out] outCorner the corner of the face, from 0 to 2.
+     * @return false if no face uses the vertex.
+     */
+    bool get_representative_corner( std::size_t vertex, std::size_t& outFace, std::size_t& outCorner ) const {
+        if( offsets[vertex + 1] == offsets[vertex] ) {
+            return false;
+        }
+        const std::size_t faceCorner = corners[offsets[vertex + 1] - 1];
+        outFace = faceCorner / 3;
+        outCorner = faceCorner % 3;
+        return true;
+    }
+
+    void clear() {
+        offsets.clear();
+        corners.clear();
+    }
+};
+
+/**
+ * Finds the face corners that use each vertex of a triangle mesh, in parallel.  The corners are counted, placed and
+ * then sorted per vertex, so the result doesn't depend on the number of threads.
+ * @param vertexCount the number of vertices in the mesh.
+ * @param faces the three vertex indices of each face.
+ * @param faceCount the number of faces.
+ * @param[out] outMap the corners of each vertex.
+ */
+void build_vertex_corner_map( std::size_t vertexCount, const frantic::graphics::vector3* faces, std::size_t faceCount,
+                              vertex_corner_map& outMap );
+
+/**
+ * Writes the per-face corner count and the three corner indices of each face into pre-sized arrays.
+ * FaceAccessor must provide face( faceIndex ) returning the three indices of that face, and IndexArray must provide
+ * an int-assignable operator[], such as MIntArray or std::vector<int>.
+ */
+template <class FaceAccessor, class IndexArray>
+class fill_face_corner_body {
+    const FaceAccessor& m_faces;
+    IndexArray* m_outCounts;
+    IndexArray& m_outIndices;
+
+    fill_face_corner_body& operator=( const fill_face_corner_body& ); // not implemented
+
+  public:
+    fill_face_corner_body( const FaceAccessor& faces, IndexArray* outCounts, IndexArray& outIndices )
+        : m_faces( faces )
+        , m_outCounts( outCounts )
+        , m_outIndices( outIndices ) {}
+
+    void operator()( const tbb::blocked_range<std::size_t>& range ) const {
+        for( std::size_t faceIndex = range.begin(); faceIndex != range.end(); ++faceIndex ) {
+            const frantic::graphics::vector3 f( m_faces.face( faceIndex ) );
+            const unsigned int i = static_cast<unsigned int>( 3 * faceIndex );
+            m_outIndices[i] = f.x;
+            m_outIndices[i + 1] = f.y;
+            m_outIndices[i + 2] = f.z;
+        }
+        if( m_outCounts ) {
+            for( std::size_t faceIndex = range.begin(); faceIndex != range.end(); ++faceIndex ) {
+                ( *m_outCounts )[static_cast<unsigned int>( faceIndex )] = 3;
+            }
+        }
+    }
+};
+
+/**
+ * Fills the face-varying index array of a triangle mesh channel, three entries per face, in parallel.
+ * @param faceCount the number of faces in the mesh.
+ * @param faces an accessor providing face( faceIndex ).
+ * @param grainSize the number of faces processed by each task.
+ * @param[out] outCounts if not NULL, the number of corners of each face. It must hold faceCount entries.
+ * @param[out] outIndices the index of each face corner. It must hold 3 * faceCount entries.
+ */
+template <class FaceAccessor, class IndexArray>
+void fill_face_corners( std::size_t faceCount, const FaceAccessor& faces, std::size_t grainSize,
+                        IndexArray* outCounts, IndexArray& outIndices ) {
+    tbb::parallel_for( tbb::blocked_range<std::size_t>( 0, faceCount, grainSize ),
+                       fill_face_corner_body<FaceAccessor, IndexArray>( faces, outCounts, outIndices ) );
+}
+
+} // namespace geometry
+} // namespace maya
+} // namespace frantic
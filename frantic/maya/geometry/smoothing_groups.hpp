@@ -0,0 +1,59 @@
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+#pragma once
+
+#include <frantic/maya/geometry/color_graph.hpp>
+
+#include <boost/array.hpp>
+#include <boost/cstdint.hpp>
+
+#include <cstddef>
+#include <vector>
+
+namespace frantic {
+namespace maya {
+namespace geometry {
+
+/**
+ * The topology and edge smoothing of a polygon mesh, as used to compute its smoothing groups.
+ * It holds plain arrays only. A Maya mesh can be copied into it with get_smoothing_group_mesh() in mesh.hpp, and it
+ * can then be processed without access to the Maya API.
+ */
+struct smoothing_group_mesh {
+    std::size_t vertexCount;
+    std::vector<int> faceCounts;   // the number of corners of each face
+    std::vector<int> faceVertices; // the vertex index of each face corner, in face order
+    std::vector<int> edgeVertices; // the two vertex indices of each edge
+    std::vector<char> edgeSmooth;  // non-zero for each smooth edge
+
+    smoothing_group_mesh()
+        : vertexCount( 0 ) {}
+
+    std::size_t face_count() const { return faceCounts.size(); }
+    std::size_t edge_count() const { return edgeSmooth.size(); }
+};
+
+/**
+ * Adds a hard connection between faces that share a vertex, and are separated around that vertex by hard edges or
+ * boundaries, but that do not share a hard edge. Without these, such faces can be given the same smoothing group.
+ * @param mesh the mesh.
+ * @param edgeToFaces the faces on either side of each edge, as produced by build_edge_to_faces.
+ * @param[in,out] inputs the face connections built from the mesh's edges.
+ */
+void add_cross_vertex_hard_edges( const smoothing_group_mesh& mesh,
+                                  const std::vector<boost::array<int, 2>>& edgeToFaces, adjacency_list& inputs );
+
+/**
+ * Computes the smoothing group flags of each face of a mesh, from its edge smoothing.
+ * This does not use the Maya API or any shared state, so it may run on any thread, and on several meshes at once.
+ * Large meshes are colored with parallel_color_graph, so the flags chosen may differ from those of color_graph.
+ * @param mesh the mesh.
+ * @param[in,out] encoding the smoothing group flags of each face. If it holds the flags computed for a previous state
+ *                         of the mesh, and they still agree with the mesh's edges, they are kept as they are.
+ * @return true if the flags were recomputed, or false if the existing flags were kept.
+ */
+bool compute_smoothing_groups( const smoothing_group_mesh& mesh, std::vector<boost::uint32_t>& encoding );
+
+} // namespace geometry
+} // namespace maya
+} // namespace frantic
@@ -3,6 +3,14 @@
 #pragma once
 
 #include <frantic/geometry/trimesh3.hpp>
+#include <frantic/particles/streams/particle_istream.hpp>
+
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <map>
+#include <vector>
 
 namespace frantic {
 namespace maya {
@@ -13,6 +21,195 @@ void gl_draw( const frantic::geometry::trimesh3& mesh );
 
 void gl_draw_box_wireframe( const frantic::graphics::boundbox3f& box );
 
+/**
+ * Retained-mode drawing data for a trimesh3. It holds the vertex positions, the triangle index buffer, and the
+ * wireframe edge index buffer derived from the mesh's FaceEdgeVisibility channel.
+ *
+ * If the current OpenGL context supports vertex buffer objects (OpenGL 1.5 or ARB_vertex_buffer_object, which Mesa's
+ * software renderers also provide), the data is uploaded on the first draw and the client copy is freed, so the mesh
+ * is only held in video memory until it is replaced. Otherwise it is drawn from client-side vertex arrays. The buffer
+ * functions are loaded from the current context, so no Maya renderer is needed.
+ *
+ * draw() and draw_wireframe() must be called from the drawing thread with the OpenGL context used for drawing
+ * current. The buffer objects are deleted on the next draw of any buffer after this one is destroyed, or by
+ * gl_delete_released_buffers(), so the object may be destroyed without a current context.
+ */
+class gl_mesh_buffer : boost::noncopyable {
+  public:
+    gl_mesh_buffer();
+    ~gl_mesh_buffer();
+
+    /**
+     * Copies the mesh's vertices, faces and visible edges into this buffer. They are uploaded on the next draw.
+     * @param mesh the mesh to draw.
+     * @param version an identifier for the current state of the mesh's geometry.
+     */
+    void set_mesh( const frantic::geometry::trimesh3& mesh, boost::uint64_t version );
+
+    /**
+     * @return the version passed to the last call to set_mesh().
+     */
+    boost::uint64_t get_version() const { return m_version; }
+
+    /**
+     * @return true if the mesh was uploaded to OpenGL buffer objects, and is no longer held in client memory.
+     */
+    bool is_uploaded() const { return m_hasBuffers && !m_needsUpload; }
+
+    /**
+     * Draw the mesh's triangles.
+     */
+    void draw();
+
+    /**
+     * Draw the mesh's visible edges, according to its FaceEdgeVisibility channel.
+     */
+    void draw_wireframe();
+
+  private:
+    enum buffer_index { VERTEX_BUFFER, TRIANGLE_BUFFER, EDGE_BUFFER, BUFFER_COUNT };
+
+    void draw_elements( unsigned int mode, buffer_index indexBuffer, const std::vector<boost::uint32_t>& indices,
+                        std::size_t indexCount );
+
+    boost::uint64_t m_version;
+
+    std::size_t m_vertexCount;
+    std::size_t m_triangleIndexCount;
+    std::size_t m_edgeIndexCount;
+
+    // Freed once they are uploaded
+    std::vector<float> m_vertices;
+    std::vector<boost::uint32_t> m_triangleIndices;
+    std::vector<boost::uint32_t> m_edgeIndices;
+
+    unsigned int m_buffers[BUFFER_COUNT];
+    bool m_hasBuffers;
+    bool m_needsUpload;
+};
+
+/**
+ * A cache of gl_mesh_buffer objects, keyed by the identity of the mesh's owner.
+ * Buffers are rebuilt only when the version associated with a key changes.
+ */
+class gl_mesh_buffer_cache : boost::noncopyable {
+  public:
+    /**
+     * Get the drawing buffer for a mesh, rebuilding it if the version differs from the cached one.
+     * @param meshId identifies the mesh, usually the address of the node or object that owns it.
+     * @param version an identifier for the current state of the mesh's geometry.
+     * @param mesh the mesh. It is only read if the cached buffer is missing or out of date.
+     */
+    boost::shared_ptr<gl_mesh_buffer> get( const void* meshId, boost::uint64_t version,
+                                           const frantic::geometry::trimesh3& mesh );
+
+    /**
+     * Remove the buffer associated with meshId. Callers that still hold the buffer may keep drawing it, its OpenGL
+     * objects are released once the last reference is dropped.
+     */
+    void erase( const void* meshId );
+
+    /**
+     * Remove all cached buffers, as erase() does.
+     */
+    void clear();
+
+  private:
+    typedef std::map<const void*, boost::shared_ptr<gl_mesh_buffer>> buffer_map_t;
+    buffer_map_t m_buffers;
+};
+
+/**
+ * Retained-mode drawing data for a particle point cloud. It holds packed Position and, if available, Color values,
+ * which are drawn as GL_POINTS from vertex buffer objects, or from client-side vertex arrays if vertex buffer objects
+ * are not supported. As with gl_mesh_buffer, the client copy is freed once it is uploaded.
+ *
+ * The particles are read through a viewport_particle_istream, so only a stable, ID-hash-selected fraction of them
+ * is displayed, up to a maximum point budget.
+ *
+ * draw() must be called from the drawing thread with the OpenGL context used for drawing current. The buffer objects
+ * are released as described for gl_mesh_buffer.
+ */
+class gl_particle_buffer : boost::noncopyable {
+  public:
+    gl_particle_buffer();
+    ~gl_particle_buffer();
+
+    /**
+     * Reads the particles to display from a stream. They are uploaded on the next draw.
+     * @param pin the particles to display. The stream is read to the end, or until maxPoints particles were read.
+     * @param displayFraction the fraction of particles to display, in [0,1].
+     * @param maxPoints the maximum number of particles to display, or a negative value for no limit.
+     * @param version an identifier for the current state of the particles.
+     */
+    void set_particles( boost::shared_ptr<frantic::particles::streams::particle_istream> pin, double displayFraction,
+                        boost::int64_t maxPoints, boost::uint64_t version );
+
+    /**
+     * @return the version passed to the last call to set_particles().
+     */
+    boost::uint64_t get_version() const { return m_version; }
+
+    /**
+     * @return the number of points that will be drawn.
+     */
+    std::size_t point_count() const { return m_pointCount; }
+
+    /**
+     * @return true if the particles had a Color channel, and will be drawn with per-point colors.
+     */
+    bool has_colors() const { return m_hasColors; }
+
+    /**
+     * @return true if the particles were uploaded to OpenGL buffer objects, and are no longer held in client memory.
+     */
+    bool is_uploaded() const { return m_hasBuffers && !m_needsUpload; }
+
+    /**
+     * Draw the particles as points. If the particles have no Color channel, the current OpenGL color is used.
+     * @param pointSize the size of each point, in pixels.
+     */
+    void draw( float pointSize = 1.0f );
+
+  private:
+    enum buffer_index { POSITION_BUFFER, COLOR_BUFFER, BUFFER_COUNT };
+
+    boost::uint64_t m_version;
+
+    std::size_t m_pointCount;
+    bool m_hasColors;
+
+    // Freed once they are uploaded
+    std::vector<float> m_positions;
+    std::vector<float> m_colors;
+
+    unsigned int m_buffers[BUFFER_COUNT];
+    bool m_hasBuffers;
+    bool m_needsUpload;
+};
+
+/**
+ * Deletes the OpenGL buffer objects of the gl_mesh_buffer and gl_particle_buffer objects that were destroyed. This is
+ * done by every draw, but may also be called, with the drawing context current, before the context is destroyed.
+ */
+void gl_delete_released_buffers();
+
+/**
+ * Draw a cached mesh's triangles.
+ */
+void gl_draw( gl_mesh_buffer& buffer );
+
+/**
+ * Draw a cached mesh's visible edges.
+ */
+void gl_draw_wireframe( gl_mesh_buffer& buffer );
+
+/**
+ * Draw a cached particle point cloud.
+ * @param pointSize the size of each point, in pixels.
+ */
+void gl_draw_particles( gl_particle_buffer& buffer, float pointSize = 1.0f );
+
 } // namespace graphics
 } // namespace maya
 } // namespace frantic
@@ -0,0 +1,109 @@
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+#pragma once
+
+#include <frantic/logging/progress_logger.hpp>
+
+#include <tbb/tick_count.h>
+
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <fstream>
+#include <map>
+#include <ostream>
+
+namespace frantic {
+namespace maya {
+namespace logging {
+
+/**
+ * A progress logger for batch mode, where there is no progress bar to update.
+ *
+ * Instead of displaying progress, it records how long each stage of an operation takes and writes one JSON object per
+ * line for each completed stage, for example:
+ *
+ *   {"stage":"Export Particles","seconds":1.25,"progress":100,"counts":{"particles":1000000},
+ *    "throughput":{"particles_per_second":800000},"peak_memory_bytes":1073741824}
+ *
+ * A stage starts with begin_stage or set_title, and ends when the next stage starts, when end_stage is called, or when
+ * the logger is destroyed.  Work done in a stage is recorded with add_count, or with add_progress_count by code that
+ * only has a progress_logger, and is reported as a throughput.  When the logger is destroyed it writes a final line
+ * with "summary":true and the total time.
+ */
+class batch_progress_logger : public frantic::logging::progress_logger {
+  public:
+    /**
+     * @param outputPath the file to append the records to.  If empty, they are written to stdout.
+     */
+    explicit batch_progress_logger( const frantic::tstring& outputPath = _T("") );
+    virtual ~batch_progress_logger();
+
+    /**
+     * Ends the current stage, and begins a new stage with the given name.
+     */
+    virtual void set_title( const frantic::tstring& title );
+    virtual void update_progress( long long completed, long long maximum );
+    virtual void update_progress( float percent );
+
+    /**
+     * Batch mode can't be cancelled interactively, so this never throws.
+     */
+    virtual void check_for_abort() {}
+
+    void begin_stage( const frantic::tstring& name );
+
+    /**
+     * Writes the record for the current stage, if any.
+     */
+    void end_stage();
+
+    /**
+     * Records work done in the current stage.
+     * @param unit what was counted, for example "particles" or "faces".
+     * @param count how many were processed since the last call.
+     */
+    void add_count( const frantic::tstring& unit, boost::int64_t count );
+
+    /**
+     * @return the peak resident memory of this process in bytes, or 0 if it isn't available on this platform.
+     */
+    static boost::uint64_t get_peak_memory_usage();
+
+  private:
+    std::ostream& out() { return m_file.is_open() ? m_file : *m_stdout; }
+
+    std::ofstream m_file;
+    std::ostream* m_stdout;
+
+    tbb::tick_count m_startTime;
+
+    bool m_inStage;
+    frantic::tstring m_stageName;
+    tbb::tick_count m_stageStartTime;
+    float m_stageProgress;
+    std::map<frantic::tstring, boost::int64_t> m_stageCounts;
+};
+
+/**
+ * Records work done in the current stage of a progress logger, if it is a batch_progress_logger, so that its throughput
+ * is reported.  Other progress loggers ignore it, so long operations can report their counts to whichever logger they
+ * are given.
+ * @param progress the logger of the operation.
+ * @param unit what was counted, for example "particles" or "faces".
+ * @param count how many were processed since the last call.
+ */
+void add_progress_count( frantic::logging::progress_logger& progress, const frantic::tstring& unit,
+                         boost::int64_t count );
+
+/**
+ * Creates the progress logger to use for a long operation: a batch_progress_logger in batch mode, otherwise a
+ * progress_bar_progress_logger.
+ * @param batchOutputPath the file batch mode records are written to.  If empty, they are written to stdout.
+ */
+boost::shared_ptr<frantic::logging::progress_logger>
+create_progress_logger( const frantic::tstring& batchOutputPath = _T("") );
+
+} // namespace logging
+} // namespace maya
+} // namespace frantic
@@ -0,0 +1,143 @@
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+#pragma once
+
+#include <maya/MStatus.h>
+#include <maya/MString.h>
+
+#include <tbb/tick_count.h>
+
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/preprocessor/cat.hpp>
+
+#include <atomic>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * Instrumentation of the library's hot paths: scoped timers, counters and byte counts.
+ *
+ * The FRANTIC_MAYA_* macros below compile to nothing unless FRANTIC_MAYA_INSTRUMENTATION is defined (see the
+ * FRANTIC_MAYA_INSTRUMENTATION CMake option).  When compiled in, nothing is recorded until instrumentation is enabled
+ * at runtime, either with set_instrumentation_enabled or with the command registered by
+ * register_instrumentation_command.  While disabled, each macro costs one relaxed atomic load.
+ *
+ * Names must be string literals, or otherwise outlive the recorded data.  Data is aggregated per thread, and merged
+ * when it is queried.  Queries and resets must not run concurrently with instrumented code.
+ */
+#if defined( FRANTIC_MAYA_INSTRUMENTATION )
+#define FRANTIC_MAYA_SCOPED_TIMER( name )                                                                             \
+    frantic::maya::logging::scoped_instrumentation_timer BOOST_PP_CAT( _franticScopedTimer, __LINE__ )( name )
+#define FRANTIC_MAYA_ADD_COUNT( name, value )                                                                         \
+    do {                                                                                                               \
+        if( frantic::maya::logging::is_instrumentation_enabled() )                                                     \
+            frantic::maya::logging::add_instrumentation_count( name, value );                                          \
+    } while( false )
+#define FRANTIC_MAYA_ADD_BYTES( name, value )                                                                         \
+    do {                                                                                                               \
+        if( frantic::maya::logging::is_instrumentation_enabled() )                                                     \
+            frantic::maya::logging::add_instrumentation_bytes( name, value );                                          \
+    } while( false )
+#else
+#define FRANTIC_MAYA_SCOPED_TIMER( name )
+#define FRANTIC_MAYA_ADD_COUNT( name, value )                                                                         \
+    do {                                                                                                               \
+    } while( false )
+#define FRANTIC_MAYA_ADD_BYTES( name, value )                                                                         \
+    do {                                                                                                               \
+    } while( false )
+#endif
+
+namespace frantic {
+namespace maya {
+
+class plugin_manager;
+
+namespace logging {
+
+namespace detail {
+extern std::atomic<bool> g_instrumentationEnabled;
+} // namespace detail
+
+inline bool is_instrumentation_enabled() {
+    return detail::g_instrumentationEnabled.load( std::memory_order_relaxed );
+}
+
+void set_instrumentation_enabled( bool enabled );
+
+/**
+ * The aggregated data recorded under one name.
+ */
+struct instrumentation_stat {
+    std::string name;
+    boost::int64_t calls; // the number of timed scopes
+    double totalSeconds;
+    double minSeconds;
+    double maxSeconds;
+    boost::int64_t count; // the sum of the values passed to FRANTIC_MAYA_ADD_COUNT
+    boost::uint64_t bytes; // the sum of the values passed to FRANTIC_MAYA_ADD_BYTES
+
+    instrumentation_stat();
+};
+
+void record_instrumentation_time( const char* name, const tbb::tick_count& start, const tbb::tick_count& end );
+void add_instrumentation_count( const char* name, boost::int64_t value );
+void add_instrumentation_bytes( const char* name, boost::uint64_t value );
+
+/**
+ * Gets the data recorded by all threads since the last reset, merged by name and sorted by name.
+ */
+void get_instrumentation_stats( std::vector<instrumentation_stat>& outStats );
+
+/**
+ * Discards all recorded data.
+ */
+void reset_instrumentation();
+
+/**
+ * Writes the timed scopes recorded since the last reset in the Chrome trace event format, which can be loaded in
+ * chrome://tracing or Perfetto.  Each thread keeps at most its first million scopes.
+ */
+void write_instrumentation_chrome_trace( std::ostream& out );
+
+/**
+ * Registers a command that controls and queries the instrumentation:
+ *
+ *   franticInstrumentation -enable true;            // start recording
+ *   franticInstrumentation -report;                 // returns one JSON object per name
+ *   franticInstrumentation -chromeTrace "t.json";   // writes a Chrome trace
+ *   franticInstrumentation -reset;                  // discards the recorded data
+ *
+ * Without flags, the command returns whether instrumentation is enabled.
+ */
+MStatus register_instrumentation_command( plugin_manager& pluginManager,
+                                          const MString& commandName = "franticInstrumentation" );
+
+/**
+ * Records the time between its construction and destruction, if instrumentation was enabled when it was constructed.
+ * Use it through FRANTIC_MAYA_SCOPED_TIMER.
+ */
+class scoped_instrumentation_timer : boost::noncopyable {
+    const char* m_name;
+    bool m_enabled;
+    tbb::tick_count m_start;
+
+  public:
+    explicit scoped_instrumentation_timer( const char* name )
+        : m_name( name )
+        , m_enabled( is_instrumentation_enabled() ) {
+        if( m_enabled )
+            m_start = tbb::tick_count::now();
+    }
+
+    ~scoped_instrumentation_timer() {
+        if( m_enabled )
+            record_instrumentation_time( m_name, m_start, tbb::tick_count::now() );
+    }
+};
+
+} // namespace logging
+} // namespace maya
+} // namespace frantic
@@ -4,13 +4,31 @@
 
 #include <frantic/logging/progress_logger.hpp>
 
+#include <tbb/tick_count.h>
+
+#include <atomic>
+
 namespace frantic {
 namespace maya {
 namespace logging {
 
+/**
+ * Reports progress in Maya's main progress bar.
+ *
+ * Updating and querying the progress bar goes through Mel, so both are rate-limited: the progress bar is only updated
+ * if at least the update interval has passed since the last update and the displayed value has changed, and the
+ * cancel button is polled at most once per update interval.  An update to 100% of the current stage is always
+ * displayed.  update_progress and check_for_abort are cheap enough to call for every block of a long loop.
+ *
+ * Only the thread that created the logger may call its methods, except is_cancelled, which may be called from any
+ * thread.
+ */
 class progress_bar_progress_logger : public frantic::logging::progress_logger {
   public:
-    progress_bar_progress_logger();
+    /**
+     * @param updateIntervalMilliseconds the minimum time between progress bar updates and cancel polls.
+     */
+    explicit progress_bar_progress_logger( int updateIntervalMilliseconds = 100 );
     virtual ~progress_bar_progress_logger();
 
     virtual void set_title( const frantic::tstring& title );
@@ -18,6 +36,22 @@ class progress_bar_progress_logger : public frantic::logging::progress_logger {
     virtual void update_progress( float percent );
 
     virtual void check_for_abort();
+
+    /**
+     * @return true if the user cancelled the operation, as of the last time the cancel button was polled.
+     */
+    bool is_cancelled() const { return m_cancelled.load( std::memory_order_relaxed ); }
+
+    void set_update_interval( int updateIntervalMilliseconds );
+
+  private:
+    bool poll_cancelled( const tbb::tick_count& now );
+
+    double m_updateInterval; // in seconds
+    tbb::tick_count m_lastUpdateTime;
+    tbb::tick_count m_lastPollTime;
+    int m_displayedProgress;
+    std::atomic<bool> m_cancelled;
 };
 
 } // namespace logging
@@ -37,6 +37,9 @@ void find_nodes_with_type( MFn::Type type, std::vector<MDagPath>& outNodes );
 
 void find_nodes_with_type_id( MTypeId typeId, std::vector<MDagPath>& outNodes );
 
+bool get_output_stream_node( const MObject& node, bool isBeginning, const MString& outputStreamAttr,
+                             MObject& outNode );
+
 void find_nodes_with_output_stream( std::vector<MDagPath>& outPaths, std::vector<MObject>& outNodes,
                                     bool isBeginning = true, MString outputStreamAttr = "outParticleStream" );
 
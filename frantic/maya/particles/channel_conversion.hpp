@@ -0,0 +1,122 @@
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+#pragma once
+
+#include <frantic/channels/channel_map.hpp>
+#include <frantic/graphics/vector3f.hpp>
+#include <frantic/particles/particle_array.hpp>
+
+#include <boost/cstdint.hpp>
+
+#include <cstddef>
+#include <vector>
+
+namespace frantic {
+namespace maya {
+namespace particles {
+
+/**
+ * @param selection the source index of each particle to copy, or NULL to copy every particle in order.
+ * @param i the index of the particle in the destination.
+ * @return the index in the source arrays of the i'th particle to copy.
+ */
+inline unsigned int get_source_index( const std::vector<unsigned int>* selection, std::size_t i ) {
+    return selection ? ( *selection )[i] : static_cast<unsigned int>( i );
+}
+
+/**
+ * Copies a per-particle vector array into a channel of a particle_array, converting each value to vector3f.
+ * @param source the per-particle values. VectorArray must provide operator[] returning a value with x, y and z
+ *               members, such as MVectorArray.
+ * @param selection the source index of each particle to copy, or NULL to copy every particle in order.
+ * @param accessor the destination channel.
+ * @param[out] outParticles the destination particles. One particle is written for each destination index.
+ */
+template <class VectorArray>
+void copy_vector_channel( const VectorArray& source, const std::vector<unsigned int>* selection,
+                          const frantic::channels::channel_cvt_accessor<frantic::graphics::vector3f>& accessor,
+                          frantic::particles::particle_array& outParticles ) {
+    for( std::size_t i = 0, ie = outParticles.size(); i < ie; ++i ) {
+        const unsigned int sourceIndex = get_source_index( selection, i );
+        const frantic::graphics::vector3f value( (float)source[sourceIndex].x, (float)source[sourceIndex].y,
+                                                 (float)source[sourceIndex].z );
+        accessor.set( outParticles[i], value );
+    }
+}
+
+/**
+ * Copies a per-particle scalar array into a channel of a particle_array.
+ * @param source the per-particle values. ScalarArray must provide operator[] returning a double, such as
+ *               MDoubleArray.
+ * @param selection the source index of each particle to copy, or NULL to copy every particle in order.
+ * @param accessor the destination channel.
+ * @param[out] outParticles the destination particles. One particle is written for each destination index.
+ */
+template <class ScalarArray>
+void copy_scalar_channel( const ScalarArray& source, const std::vector<unsigned int>* selection,
+                          const frantic::channels::channel_cvt_accessor<double>& accessor,
+                          frantic::particles::particle_array& outParticles ) {
+    for( std::size_t i = 0, ie = outParticles.size(); i < ie; ++i ) {
+        accessor.set( outParticles[i], static_cast<double>( source[get_source_index( selection, i )] ) );
+    }
+}
+
+/**
+ * Copies a per-particle array of integer values held as doubles, such as particleId, into an int64 channel of a
+ * particle_array. Each value is converted and written straight into its particle, without an intermediate array.
+ * @param source the per-particle values. ScalarArray must provide operator[] returning a double, such as
+ *               MDoubleArray.
+ * @param selection the source index of each particle to copy, or NULL to copy every particle in order.
+ * @param accessor the destination channel, which must be stored as int64 so that no further conversion is needed.
+ * @param[out] outParticles the destination particles. One particle is written for each destination index.
+ */
+template <class ScalarArray>
+void copy_integer_channel( const ScalarArray& source, const std::vector<unsigned int>* selection,
+                           const frantic::channels::channel_accessor<boost::int64_t>& accessor,
+                           frantic::particles::particle_array& outParticles ) {
+    for( std::size_t i = 0, ie = outParticles.size(); i < ie; ++i ) {
+        accessor( outParticles[i] ) = static_cast<boost::int64_t>( source[get_source_index( selection, i )] );
+    }
+}
+
+/**
+ * Same as above, for a destination channel of any integer type.
+ */
+template <class ScalarArray>
+void copy_integer_channel( const ScalarArray& source, const std::vector<unsigned int>* selection,
+                           const frantic::channels::channel_cvt_accessor<boost::int64_t>& accessor,
+                           frantic::particles::particle_array& outParticles ) {
+    for( std::size_t i = 0, ie = outParticles.size(); i < ie; ++i ) {
+        accessor.set( outParticles[i], static_cast<boost::int64_t>( source[get_source_index( selection, i )] ) );
+    }
+}
+
+/**
+ * Sets an int64 channel of each particle to the particle's index in the source, for particles that have no IDs of
+ * their own.
+ * @param selection the source index of each particle, or NULL if the particles are in source order.
+ * @param accessor the destination channel.
+ * @param[out] outParticles the destination particles.
+ */
+inline void fill_index_channel( const std::vector<unsigned int>* selection,
+                                const frantic::channels::channel_accessor<boost::int64_t>& accessor,
+                                frantic::particles::particle_array& outParticles ) {
+    for( std::size_t i = 0, ie = outParticles.size(); i < ie; ++i ) {
+        accessor( outParticles[i] ) = static_cast<boost::int64_t>( get_source_index( selection, i ) );
+    }
+}
+
+/**
+ * Same as above, for a destination channel of any integer type.
+ */
+inline void fill_index_channel( const std::vector<unsigned int>* selection,
+                                const frantic::channels::channel_cvt_accessor<boost::int64_t>& accessor,
+                                frantic::particles::particle_array& outParticles ) {
+    for( std::size_t i = 0, ie = outParticles.size(); i < ie; ++i ) {
+        accessor.set( outParticles[i], static_cast<boost::int64_t>( get_source_index( selection, i ) ) );
+    }
+}
+
+} // namespace particles
+} // namespace maya
+} // namespace frantic
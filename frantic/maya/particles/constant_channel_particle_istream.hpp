@@ -0,0 +1,127 @@
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+#pragma once
+
+#include <frantic/channels/channel_map.hpp>
+#include <frantic/channels/channel_map_adaptor.hpp>
+#include <frantic/particles/streams/particle_istream.hpp>
+
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <vector>
+
+namespace frantic {
+namespace maya {
+namespace particles {
+
+/**
+ * The values of channels that are the same for every particle, such as a per-object attribute standing in for a
+ * per-particle one. The values are stored once, as a single particle in the table's own channel map, instead of being
+ * copied into every particle.
+ */
+class constant_channel_table {
+    frantic::channels::channel_map m_channelMap;
+    std::vector<char> m_values;
+
+  public:
+    constant_channel_table();
+
+    /**
+     * Adds a channel to the table, or replaces its value if it is already there.
+     * @param name the name of the channel.
+     * @param arity the arity of the channel.
+     * @param dataType the data type the value is stored as.
+     * @param value the value of the channel. It is converted to dataType.
+     */
+    template <class T>
+    void set_value( const frantic::tstring& name, std::size_t arity, frantic::channels::data_type_t dataType,
+                    const T& value ) {
+        if( !m_channelMap.has_channel( name ) ) {
+            add_channel( name, arity, dataType );
+        }
+        m_channelMap.get_cvt_accessor<T>( name ).set( &m_values[0], value );
+    }
+
+    /**
+     * @return the value of a channel in the table, converted to T.
+     */
+    template <class T>
+    T get_value( const frantic::tstring& name ) const {
+        return m_channelMap.get_cvt_accessor<T>( name ).get( &m_values[0] );
+    }
+
+    bool has_channel( const frantic::tstring& name ) const { return m_channelMap.has_channel( name ); }
+    bool empty() const { return m_channelMap.channel_count() == 0; }
+    void clear();
+
+    /**
+     * @return the layout of get_values().
+     */
+    const frantic::channels::channel_map& get_channel_map() const { return m_channelMap; }
+
+    /**
+     * @return a single particle in the layout of get_channel_map(), holding the value of each channel in the table.
+     */
+    const char* get_values() const { return m_values.empty() ? NULL : &m_values[0]; }
+
+  private:
+    void add_channel( const frantic::tstring& name, std::size_t arity, frantic::channels::data_type_t dataType );
+};
+
+/**
+ * A stream that adds channels with the same value for every particle to its delegate.
+ * The constant values are placed in the stream's default particle, so they are only written into a particle when the
+ * consumer asks for their channel. The delegate is never asked for them, and a channel in the table hides a channel of
+ * the same name in the delegate.
+ */
+class constant_channel_particle_istream : public frantic::particles::streams::particle_istream {
+    boost::shared_ptr<frantic::particles::streams::particle_istream> m_delegate;
+    constant_channel_table m_constants;
+
+    boost::int64_t m_particleIndex;
+
+    frantic::channels::channel_map m_channelMap;
+    frantic::channels::channel_map m_nativeChannelMap; // the delegate's native map, plus the constant channels
+    frantic::channels::channel_map m_delegateChannelMap;
+    frantic::channels::channel_map_adaptor m_cma; // m_delegateChannelMap to m_channelMap
+
+    std::vector<char> m_delegateParticle;
+    std::vector<char> m_defaultParticle;  // as set by the consumer
+    std::vector<char> m_constantParticle; // m_defaultParticle, with the constant values written over it
+
+  public:
+    /**
+     * @param pin the stream providing the per-particle channels.
+     * @param constants the channels to add to the stream, and their values.
+     */
+    constant_channel_particle_istream( boost::shared_ptr<frantic::particles::streams::particle_istream> pin,
+                                       const constant_channel_table& constants );
+
+    virtual ~constant_channel_particle_istream() {}
+
+    void close() { m_delegate->close(); }
+    boost::int64_t particle_count() const { return m_delegate->particle_count(); }
+    boost::int64_t particle_index() const { return m_particleIndex; }
+    boost::int64_t particle_count_left() const { return m_delegate->particle_count_left(); }
+    boost::int64_t particle_progress_count() const { return m_delegate->particle_progress_count(); }
+    boost::int64_t particle_progress_index() const { return m_delegate->particle_progress_index(); }
+    boost::int64_t particle_count_guess() const { return m_delegate->particle_count_guess(); }
+    frantic::tstring name() const { return m_delegate->name(); }
+    std::size_t particle_size() const { return m_channelMap.structure_size(); }
+
+    void set_channel_map( const frantic::channels::channel_map& particleChannelMap );
+    void set_default_particle( char* rawParticleBuffer );
+    const frantic::channels::channel_map& get_channel_map() const { return m_channelMap; }
+    const frantic::channels::channel_map& get_native_channel_map() const { return m_nativeChannelMap; }
+
+    bool get_particle( char* outParticleBuffer );
+    bool get_particles( char* buffer, std::size_t& numParticles );
+
+  private:
+    void update_constant_particle();
+};
+
+} // namespace particles
+} // namespace maya
+} // namespace frantic
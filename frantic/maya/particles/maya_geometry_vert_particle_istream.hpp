@@ -9,6 +9,7 @@
 #include <frantic/particles/streams/particle_istream.hpp>
 
 #include <frantic/maya/geometry/mesh.hpp>
+#include <frantic/maya/geometry/mesh_kernels.hpp>
 
 #include <boost/optional.hpp>
 #include <boost/shared_ptr.hpp>
@@ -57,23 +58,22 @@ class maya_geometry_vert_particle_istream : public frantic::particles::streams::
         vertex_vector_acc_t uv;
     } m_vertexAccessors;
 
-    struct face_and_corner {
-        int face;
-        int corner;
-        face_and_corner()
-            : face( -1 )
-            , corner( -1 ) {}
-        void set( int face, int corner ) {
-            this->face = face;
-            this->corner = corner;
-        }
-        bool is_valid() { return face >= 0; }
-    };
-
-    std::vector<face_and_corner> m_vertexToFaceAndCorner;
+    // The face corners of each vertex, shared with any other stream open on the same mesh and frame
+    boost::shared_ptr<const frantic::maya::geometry::vertex_corner_map> m_vertexCorners;
+    bool m_averageFaceVaryingData;
 
   public:
-    maya_geometry_vert_particle_istream( MPlug meshPlug );
+    /**
+     * Opens a stream with one particle per vertex of a mesh.  The converted mesh and its vertex to face corner map are
+     * shared with the other streams open on the same mesh plug at the same frame, so they are only built once.  They
+     * are only shared while the mesh's positions, faces, normals, current UV and color sets and smooth mesh preview
+     * settings are unchanged.  Checking this reads those arrays from Maya each time a stream is opened.
+     * @param meshPlug the mesh to read.
+     * @param averageFaceVaryingData if true, face-varying channels such as TextureCoord take the average of the values
+     *                               of all the corners that use a vertex.  Otherwise the value of one of its corners is
+     *                               used.
+     */
+    maya_geometry_vert_particle_istream( MPlug meshPlug, bool averageFaceVaryingData = false );
 
     virtual ~maya_geometry_vert_particle_istream();
 
@@ -100,7 +100,6 @@ class maya_geometry_vert_particle_istream : public frantic::particles::streams::
   private:
     void init_stream( MPlug meshPlug );
     void init_accessors( const frantic::channels::channel_map& pcm );
-    void fill_vertex_to_face_and_corner_map();
     frantic::graphics::vector3f
     get_vertex_data( vertex_vector_acc_t& acc, boost::int64_t vertex,
                      frantic::graphics::vector3f fallback = frantic::graphics::vector3f( 0.0f, 0.0f, 0.0f ) );
@@ -0,0 +1,96 @@
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+#pragma once
+
+#include <frantic/channels/channel_map.hpp>
+#include <frantic/channels/channel_map_adaptor.hpp>
+#include <frantic/graphics/vector3f.hpp>
+#include <frantic/particles/streams/particle_istream.hpp>
+
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <vector>
+
+namespace frantic {
+namespace maya {
+namespace particles {
+
+/**
+ * A stream that moves its delegate's particles to another time, by extrapolating their positions from their velocity,
+ * and their acceleration if it is available:
+ *
+ *   Position' = Position + Velocity * t + 0.5 * Acceleration * t^2
+ *
+ * When there is an acceleration, the velocity channel is also moved to the new time, if it is requested.  This lets
+ * the samples of motion blur be made from a single capture of the particles, rather than one capture per sample.
+ * Particles without a Velocity or Acceleration channel, or a time offset of 0, are passed through unchanged.
+ */
+class motion_extrapolation_particle_istream : public frantic::particles::streams::particle_istream {
+    boost::shared_ptr<frantic::particles::streams::particle_istream> m_delegate;
+
+    float m_timeOffset;
+    frantic::tstring m_velocityChannelName;
+    frantic::tstring m_accelerationChannelName;
+
+    boost::int64_t m_particleIndex;
+
+    frantic::channels::channel_map m_channelMap;
+    frantic::channels::channel_map m_delegateChannelMap;
+    frantic::channels::channel_map_adaptor m_cma; // m_delegateChannelMap to m_channelMap
+
+    bool m_isExtrapolating;
+    bool m_hasVelocity;
+    bool m_hasAcceleration;
+    bool m_updateVelocity; // true if the velocity channel is requested, and is moved by the acceleration
+
+    // These are all accessors of m_delegateChannelMap
+    frantic::channels::channel_cvt_accessor<frantic::graphics::vector3f> m_positionAccessor;
+    frantic::channels::channel_cvt_accessor<frantic::graphics::vector3f> m_velocityAccessor;
+    frantic::channels::channel_cvt_accessor<frantic::graphics::vector3f> m_accelerationAccessor;
+
+    std::vector<char> m_delegateParticle;
+    std::vector<char> m_defaultParticle;
+
+  public:
+    /**
+     * @param pin the particles to move.
+     * @param timeOffset the time to move the particles by, in seconds.  Velocity and acceleration are per second.
+     * @param velocityChannelName the channel of the particles' velocities.
+     * @param accelerationChannelName the channel of the particles' accelerations, or an empty string to extrapolate
+     *                                from the velocity alone.
+     */
+    motion_extrapolation_particle_istream( boost::shared_ptr<frantic::particles::streams::particle_istream> pin,
+                                           double timeOffset,
+                                           const frantic::tstring& velocityChannelName = _T("Velocity"),
+                                           const frantic::tstring& accelerationChannelName = _T("Acceleration") );
+
+    virtual ~motion_extrapolation_particle_istream() {}
+
+    void close() { m_delegate->close(); }
+    boost::int64_t particle_count() const { return m_delegate->particle_count(); }
+    boost::int64_t particle_index() const { return m_particleIndex; }
+    boost::int64_t particle_count_left() const { return m_delegate->particle_count_left(); }
+    boost::int64_t particle_progress_count() const { return m_delegate->particle_progress_count(); }
+    boost::int64_t particle_progress_index() const { return m_delegate->particle_progress_index(); }
+    boost::int64_t particle_count_guess() const { return m_delegate->particle_count_guess(); }
+    frantic::tstring name() const { return m_delegate->name(); }
+    std::size_t particle_size() const { return m_channelMap.structure_size(); }
+
+    void set_channel_map( const frantic::channels::channel_map& particleChannelMap );
+    void set_default_particle( char* rawParticleBuffer );
+    const frantic::channels::channel_map& get_channel_map() const { return m_channelMap; }
+    const frantic::channels::channel_map& get_native_channel_map() const {
+        return m_delegate->get_native_channel_map();
+    }
+
+    bool get_particle( char* outParticleBuffer );
+    bool get_particles( char* buffer, std::size_t& numParticles );
+
+  private:
+    void extrapolate( char* particle ) const;
+};
+
+} // namespace particles
+} // namespace maya
+} // namespace frantic
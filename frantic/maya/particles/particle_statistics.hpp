@@ -0,0 +1,208 @@
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+#pragma once
+
+#include <frantic/graphics/boundbox3f.hpp>
+#include <frantic/graphics/transform4f.hpp>
+#include <frantic/graphics/vector3f.hpp>
+#include <frantic/particles/streams/particle_istream.hpp>
+#include <frantic/strings/tstring.hpp>
+
+#include <boost/cstdint.hpp>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_reduce.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <map>
+#include <vector>
+
+namespace frantic {
+namespace maya {
+namespace particles {
+
+/**
+ * The smallest and largest value of each component of a channel.
+ */
+struct particle_channel_range {
+    std::vector<double> minimum;
+    std::vector<double> maximum;
+};
+
+/**
+ * A summary of a particle stream's particles, which lets a renderer frame, cull or size its data structures without
+ * reading the particles themselves.
+ */
+struct particle_stream_statistics {
+    boost::int64_t particleCount;
+    // The bounds of the Position channel. Empty if there are no particles.
+    frantic::graphics::boundbox3f bounds;
+    // The range of each channel that has been summarized, by channel name. Channels with no particles are left out.
+    std::map<frantic::tstring, particle_channel_range> channelRanges;
+
+    particle_stream_statistics()
+        : particleCount( 0 ) {}
+
+    void clear() {
+        particleCount = 0;
+        bounds.set_to_empty();
+        channelRanges.clear();
+    }
+};
+
+/**
+ * Finds the statistics of a stream by reading all of its particles.  The Position bounds and the range of every channel
+ * of the stream's native channel map with 1 or 3 components are found.  The stream's channel map is changed to its
+ * native channel map.
+ * @param stream the particles to summarize.  They are all read.
+ * @param[out] outStats the statistics.
+ */
+void compute_particle_stream_statistics( frantic::particles::streams::particle_istream& stream,
+                                         particle_stream_statistics& outStats );
+
+/**
+ * Finds the range of a per-particle vector array, after transforming each vector, in parallel.
+ * VectorArray must provide operator[] returning a value with x, y and z members, such as MVectorArray.
+ */
+template <class VectorArray>
+class vector_range_body {
+    const VectorArray& m_vectors;
+    const frantic::graphics::transform4f& m_transform;
+    bool m_isPoint;
+
+    vector_range_body& operator=( const vector_range_body& ); // not implemented
+
+  public:
+    frantic::graphics::vector3f minimum;
+    frantic::graphics::vector3f maximum;
+
+    vector_range_body( const VectorArray& vectors, const frantic::graphics::transform4f& transform, bool isPoint )
+        : m_vectors( vectors )
+        , m_transform( transform )
+        , m_isPoint( isPoint )
+        , minimum( std::numeric_limits<float>::max() )
+        , maximum( -std::numeric_limits<float>::max() ) {}
+
+    vector_range_body( vector_range_body& other, tbb::split )
+        : m_vectors( other.m_vectors )
+        , m_transform( other.m_transform )
+        , m_isPoint( other.m_isPoint )
+        , minimum( std::numeric_limits<float>::max() )
+        , maximum( -std::numeric_limits<float>::max() ) {}
+
+    void operator()( const tbb::blocked_range<std::size_t>& range ) {
+        // Accumulate in locals, so that the loop is free of stores to the body and can be vectorized
+        float minX = minimum.x, minY = minimum.y, minZ = minimum.z;
+        float maxX = maximum.x, maxY = maximum.y, maxZ = maximum.z;
+        for( std::size_t i = range.begin(); i != range.end(); ++i ) {
+            const unsigned int index = static_cast<unsigned int>( i );
+            // Convert to float before transforming, as the particle streams do
+            const frantic::graphics::vector3f source( (float)m_vectors[index].x, (float)m_vectors[index].y,
+                                                      (float)m_vectors[index].z );
+            const frantic::graphics::vector3f v =
+                m_isPoint ? m_transform * source : m_transform.transform_no_translation( source );
+            minX = std::min( minX, v.x );
+            minY = std::min( minY, v.y );
+            minZ = std::min( minZ, v.z );
+            maxX = std::max( maxX, v.x );
+            maxY = std::max( maxY, v.y );
+            maxZ = std::max( maxZ, v.z );
+        }
+        minimum = frantic::graphics::vector3f( minX, minY, minZ );
+        maximum = frantic::graphics::vector3f( maxX, maxY, maxZ );
+    }
+
+    void join( const vector_range_body& other ) {
+        minimum = frantic::graphics::vector3f( std::min( minimum.x, other.minimum.x ),
+                                               std::min( minimum.y, other.minimum.y ),
+                                               std::min( minimum.z, other.minimum.z ) );
+        maximum = frantic::graphics::vector3f( std::max( maximum.x, other.maximum.x ),
+                                               std::max( maximum.y, other.maximum.y ),
+                                               std::max( maximum.z, other.maximum.z ) );
+    }
+};
+
+/**
+ * Finds the range of a per-particle scalar array in parallel.
+ * ScalarArray must provide operator[] returning a double, such as MDoubleArray.
+ */
+template <class ScalarArray>
+class scalar_range_body {
+    const ScalarArray& m_values;
+
+    scalar_range_body& operator=( const scalar_range_body& ); // not implemented
+
+  public:
+    double minimum;
+    double maximum;
+
+    scalar_range_body( const ScalarArray& values )
+        : m_values( values )
+        , minimum( std::numeric_limits<double>::max() )
+        , maximum( -std::numeric_limits<double>::max() ) {}
+
+    scalar_range_body( scalar_range_body& other, tbb::split )
+        : m_values( other.m_values )
+        , minimum( std::numeric_limits<double>::max() )
+        , maximum( -std::numeric_limits<double>::max() ) {}
+
+    void operator()( const tbb::blocked_range<std::size_t>& range ) {
+        double localMin = minimum, localMax = maximum;
+        for( std::size_t i = range.begin(); i != range.end(); ++i ) {
+            const double value = m_values[static_cast<unsigned int>( i )];
+            localMin = std::min( localMin, value );
+            localMax = std::max( localMax, value );
+        }
+        minimum = localMin;
+        maximum = localMax;
+    }
+
+    void join( const scalar_range_body& other ) {
+        minimum = std::min( minimum, other.minimum );
+        maximum = std::max( maximum, other.maximum );
+    }
+};
+
+/**
+ * Finds the range of the first count entries of a per-particle vector array, in parallel.
+ * @param vectors the per-particle values, see vector_range_body.
+ * @param count the number of particles. Must be greater than 0.
+ * @param transform applied to each vector before it is measured.
+ * @param isPoint if true, the vectors are transformed as points, otherwise the translation is left out.
+ * @param[out] outRange the range of each component.
+ */
+template <class VectorArray>
+void compute_vector_range( const VectorArray& vectors, std::size_t count,
+                           const frantic::graphics::transform4f& transform, bool isPoint,
+                           particle_channel_range& outRange ) {
+    vector_range_body<VectorArray> body( vectors, transform, isPoint );
+    tbb::parallel_reduce( tbb::blocked_range<std::size_t>( 0, count, 4096 ), body );
+
+    outRange.minimum.resize( 3 );
+    outRange.maximum.resize( 3 );
+    for( int axis = 0; axis < 3; ++axis ) {
+        outRange.minimum[axis] = body.minimum[axis];
+        outRange.maximum[axis] = body.maximum[axis];
+    }
+}
+
+/**
+ * Finds the range of the first count entries of a per-particle scalar array, in parallel.
+ * @param values the per-particle values, see scalar_range_body.
+ * @param count the number of particles. Must be greater than 0.
+ * @param[out] outRange the range.
+ */
+template <class ScalarArray>
+void compute_scalar_range( const ScalarArray& values, std::size_t count, particle_channel_range& outRange ) {
+    scalar_range_body<ScalarArray> body( values );
+    tbb::parallel_reduce( tbb::blocked_range<std::size_t>( 0, count, 4096 ), body );
+
+    outRange.minimum.assign( 1, body.minimum );
+    outRange.maximum.assign( 1, body.maximum );
+}
+
+} // namespace particles
+} // namespace maya
+} // namespace frantic
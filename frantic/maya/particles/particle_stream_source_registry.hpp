@@ -0,0 +1,74 @@
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+#pragma once
+
+#include <maya/MDagPath.h>
+#include <maya/MObject.h>
+#include <maya/MStatus.h>
+#include <maya/MString.h>
+
+#include <vector>
+
+namespace frantic {
+namespace maya {
+
+class plugin_manager;
+
+namespace particles {
+
+/**
+ * A scene-wide list of the DAG nodes that may provide particle streams: nodes with a particle stream output attribute,
+ * and Maya particle systems.
+ *
+ * Once its callbacks are registered, the list is kept up to date by node added, node removed and connection
+ * callbacks, so finding the particle streams in a scene does not require a walk of the whole DAG.  The other DAG
+ * nodes are watched by attribute added callbacks, so that a node is tracked as soon as the particle stream output
+ * attribute is added to it as a dynamic attribute.  The list is rebuilt from the DAG once after a new scene is created
+ * or a scene is opened.
+ */
+class particle_stream_source_registry {
+  public:
+    /**
+     * Registers the callbacks that maintain the registry, and activates it.  pluginManager.unregister_all() removes
+     * the callbacks and deactivates the registry.
+     * @param pluginManager the plugin manager of the plugin that owns the registry.
+     * @param outputStreamAttr the particle stream output attribute of the nodes to track.
+     */
+    static MStatus register_callbacks( plugin_manager& pluginManager,
+                                       const MString& outputStreamAttr = "outParticleStream" );
+
+    /**
+     * @return true if the registry's callbacks were registered.
+     */
+    static bool is_active();
+
+    /**
+     * Forgets the tracked nodes and removes the attribute added callbacks.  They will be found again by walking the DAG
+     * the next time the registry is queried.
+     */
+    static void invalidate();
+
+    /**
+     * Gets the tracked nodes.  Not every tracked node is guaranteed to provide a particle stream: each still has to be
+     * checked with maya_util::get_output_stream_node.
+     * @param outNodes the tracked nodes, in the depth-first order of the DAG when the registry was last rebuilt,
+     *                 followed by the nodes added since in the order they were added.
+     */
+    static void get_sources( std::vector<MObject>& outNodes );
+
+    /**
+     * Does the same search as maya_util::find_nodes_with_output_stream, but only checks the tracked nodes.  Paths are
+     * returned for every instance of each node, in the order of get_sources.
+     * @return false if the registry is not active or does not track outputStreamAttr, in which case the outputs are not
+     *         modified.
+     */
+    static bool find_nodes_with_output_stream( std::vector<MDagPath>& outPaths, std::vector<MObject>& outNodes,
+                                               bool isBeginning, const MString& outputStreamAttr );
+
+  private:
+    particle_stream_source_registry();
+};
+
+} // namespace particles
+} // namespace maya
+} // namespace frantic
@@ -3,11 +3,19 @@
 #pragma once
 
 #include <frantic/channels/channel_map.hpp>
+#include <frantic/graphics/transform4f.hpp>
+#include <frantic/maya/particles/constant_channel_particle_istream.hpp>
+#include <frantic/maya/particles/particle_statistics.hpp>
+#include <frantic/maya/particles/region_culling_particle_istream.hpp>
 #include <frantic/particles/particle_array.hpp>
 #include <frantic/strings/tstring.hpp>
 #include <maya/MDGContext.h>
 #include <maya/MFnParticleSystem.h>
 
+#include <boost/cstdint.hpp>
+
+#include <vector>
+
 namespace frantic {
 namespace maya {
 namespace particles {
@@ -26,6 +34,7 @@ extern const frantic::tstring MayaGlobalBlueChannelName;
 extern const frantic::tstring MayaRotationChannelName;
 extern const frantic::tstring MayaAgeChannelName;
 extern const frantic::tstring MayaLifeSpanChannelName;
+extern const frantic::tstring MayaAccelerationChannelName;
 
 extern const frantic::tstring PRTPositionChannelName;
 extern const frantic::tstring PRTVelocityChannelName;
@@ -39,6 +48,7 @@ extern const frantic::tstring PRTAbsorptionChannelName;
 extern const frantic::tstring PRTRotationChannelName;
 extern const frantic::tstring PRTAgeChannelName;
 extern const frantic::tstring PRTLifeSpanChannelName;
+extern const frantic::tstring PRTAccelerationChannelName;
 
 bool get_prt_channel_name( const frantic::tstring& mayaName, frantic::tstring& prtName );
 void get_prt_channel_name_default( const frantic::tstring& mayaName, frantic::tstring& resultName );
@@ -49,6 +59,79 @@ bool grab_maya_particles( const MFnParticleSystem& particleSystem, const MDGCont
                           const frantic::channels::channel_map& channelMap,
                           frantic::particles::particle_array& outParticleArray );
 
+/**
+ * Same as grab_maya_particles, but only copies the particles whose indices are listed in selection. The other
+ * particles are never converted, so the cost scales with the number of selected particles.
+ *
+ * @param selection the indices of the particles to copy, in increasing order, or NULL to copy all particles.
+ */
+bool grab_maya_particles( const MFnParticleSystem& particleSystem, const MDGContext& currentContext,
+                          const frantic::channels::channel_map& channelMap, const std::vector<unsigned int>* selection,
+                          frantic::particles::particle_array& outParticleArray );
+
+/**
+ * Same as grab_maya_particles, but the channels that have the same value for every particle, such as per-object
+ * attributes and vector channels the particle system doesn't have, are stored once in outConstants instead of being
+ * copied into every particle. outParticleArray only holds the other channels. Use a
+ * constant_channel_particle_istream to provide all of the channels as a stream.
+ *
+ * @param selection the indices of the particles to copy, in increasing order, or NULL to copy all particles.
+ * @param outConstants receives the constant channels. If it is NULL, they are copied into every particle instead.
+ */
+bool grab_maya_particles( const MFnParticleSystem& particleSystem, const MDGContext& currentContext,
+                          const frantic::channels::channel_map& channelMap, const std::vector<unsigned int>* selection,
+                          frantic::particles::particle_array& outParticleArray, constant_channel_table* outConstants );
+
+/**
+ * Chooses which particles of a Maya particle system to display in the viewport.
+ * Particles are chosen by hashing their particleId, so the same particles are displayed from frame to frame. If the
+ * system has no particle IDs, evenly strided samples are taken instead. When a limit is given, the fraction is
+ * reduced so that the selected particles remain spread over the whole system.
+ *
+ * @param particleSystem the particle system to select from.
+ * @param fraction the fraction of particles to display, in [0,1].
+ * @param limit the maximum number of particles to display, or a negative value for no limit.
+ * @param outSelection the indices of the selected particles, in increasing order.
+ * @return false if every particle should be displayed, in which case outSelection is empty.
+ */
+bool select_viewport_particles( const MFnParticleSystem& particleSystem, double fraction, boost::int64_t limit,
+                                std::vector<unsigned int>& outSelection );
+
+/**
+ * Chooses the particles of a Maya particle system that are inside a region, from its position array alone, so that
+ * grab_maya_particles only needs to convert the other channels of those particles. The positions are tested in
+ * parallel.
+ *
+ * @param particleSystem the particle system to select from.
+ * @param toRegionSpace the transform from world space to the space of the region.
+ * @param region the region to keep the particles of.
+ * @param candidates the indices of the particles to test, in increasing order, such as those chosen by
+ *                   select_viewport_particles, or NULL to test every particle.  It must not be outSelection.
+ * @param outSelection the indices of the particles inside the region, in increasing order.
+ * @return false if the particle system's positions could not be read.
+ */
+bool select_maya_particles_in_region( const MFnParticleSystem& particleSystem, const MDGContext& currentContext,
+                                      const frantic::graphics::transform4f& toRegionSpace,
+                                      const particle_culling_region& region,
+                                      const std::vector<unsigned int>* candidates,
+                                      std::vector<unsigned int>& outSelection );
+
+/**
+ * Finds the statistics of a Maya particle system's particles straight from its position, velocity, color, opacity,
+ * age and lifespan arrays, without converting the particles. The ranges are found in parallel. They match those of
+ * the particles returned by grab_maya_particles, after the positions have been transformed by toObjectSpace and the
+ * velocities by its rotation and scale, up to the precision the channels are stored with.
+ *
+ * @param particleSystem the particle system to summarize.
+ * @param toObjectSpace the transform from world space to the space the particles are returned in.
+ * @param outStats the particle count, Position bounds and the ranges of the Position, Velocity, Color, Density, Age
+ *                 and LifeSpan channels.
+ * @return false if the particle system's arrays could not be read.
+ */
+bool get_maya_particle_statistics( const MFnParticleSystem& particleSystem, const MDGContext& currentContext,
+                                   const frantic::graphics::transform4f& toObjectSpace,
+                                   particle_stream_statistics& outStats );
+
 } // namespace particles
 } // namespace maya
 } // namespace frantic
@@ -0,0 +1,136 @@
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+#pragma once
+
+#include <frantic/maya/PRTObject_base.hpp>
+
+#include <frantic/channels/channel_map.hpp>
+#include <frantic/particles/particle_array.hpp>
+#include <frantic/strings/tstring.hpp>
+
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+
+namespace frantic {
+namespace maya {
+namespace particles {
+
+/**
+ * Settings for prt_cache_particle_source.
+ */
+struct prt_cache_options {
+    // The number of frames past the requested one, in the direction of playback, that are loaded in the background.
+    // If 0, no background thread is started, and each frame is loaded when it is requested.
+    std::size_t prefetchFrames;
+    // The number of loaded frames kept in memory, including the prefetched ones.  When there are more, the frames
+    // furthest from the last requested frame are released.
+    std::size_t maxCachedFrames;
+    // The fraction of particles, in [0,1], and the maximum number of particles, or a negative value for no limit,
+    // returned by getViewportParticleStream.
+    double viewportFraction;
+    boost::int64_t viewportLimit;
+
+    // Defaults to prefetching 2 frames and caching 8, with every particle displayed in the viewport.
+    prt_cache_options();
+};
+
+/**
+ * A particle_stream_source that plays back per-frame particle files, such as those written by export_prt_sequence,
+ * instead of evaluating the particle system they were exported from.
+ *
+ * Each frame is read into memory once, and every stream returned for that frame reads from the same copy.  While a
+ * frame is played, the frames after it are read ahead on a background thread, so playback is limited by the rate at
+ * which the files can be read rather than by evaluating the scene.  When the requested frames go backwards, the frames
+ * before the current one are read ahead instead.
+ *
+ * The particles are returned as they were stored, with the channels of the file.  Frames without a file give an empty
+ * stream.  Methods may be called from any thread.
+ */
+class prt_cache_particle_source : public particle_stream_source, boost::noncopyable {
+  public:
+    using particle_stream_source::getRenderParticleStream;
+
+    /**
+     * @param filenamePattern the file of each frame, see get_prt_sequence_filename.  Any format that
+     *                        particle_file_stream_factory_object can read may be used.
+     * @param options the prefetch and cache settings.
+     */
+    explicit prt_cache_particle_source( const frantic::tstring& filenamePattern,
+                                        const prt_cache_options& options = prt_cache_options() );
+
+    /**
+     * Stops the background thread.  Streams that were returned remain valid.
+     */
+    virtual ~prt_cache_particle_source();
+
+    /**
+     * Gets the particles of the frame at the context's time, rounded to the nearest frame.
+     * @param objectSpace not applied, since the particles were stored in the space they are used in.
+     */
+    virtual frantic::particles::streams::particle_istream_ptr
+    getRenderParticleStream( const frantic::graphics::transform4f& objectSpace,
+                             const MDGContext& context = MDGContext::fsNormal ) const;
+
+    /**
+     * Same as getRenderParticleStream, decimated by the viewport fraction and limit given in the options.  The
+     * displayed particles are chosen from the frame's ID channel with select_viewport_indices, and only those are
+     * copied.
+     */
+    virtual frantic::particles::streams::particle_istream_ptr
+    getViewportParticleStream( const frantic::graphics::transform4f& objectSpace,
+                               const MDGContext& context = MDGContext::fsNormal ) const;
+
+    /**
+     * Gets the particles of a frame, reading them now if they have not already been read, and starts reading ahead
+     * from that frame.
+     * @return the frame's particles, or NULL if the frame has no file.  They must not be modified.
+     */
+    boost::shared_ptr<frantic::particles::particle_array> get_frame( int frame ) const;
+
+    /**
+     * Releases every cached frame, for example after the files have been rewritten.
+     */
+    void clear_cache();
+
+    const frantic::tstring& get_filename_pattern() const { return m_filenamePattern; }
+
+  private:
+    typedef std::map<int, boost::shared_ptr<frantic::particles::particle_array>> frame_map_t;
+
+    boost::shared_ptr<frantic::particles::particle_array> load_frame( int frame ) const;
+    void update_prefetch_requests( int frame ) const;
+    void insert_frame( int frame, const boost::shared_ptr<frantic::particles::particle_array>& particles ) const;
+    void prefetch_main();
+
+    frantic::tstring m_filenamePattern;
+    prt_cache_options m_options;
+
+    // Guards all of the members below
+    mutable std::mutex m_mutex;
+    mutable std::condition_variable m_requestsChanged; // wakes the background thread
+    mutable std::condition_variable m_frameLoaded;     // wakes threads waiting for a frame that is being read
+
+    mutable frame_map_t m_frames;
+    mutable std::set<int> m_loadingFrames; // frames being read by some thread
+    mutable std::deque<int> m_prefetchRequests;
+    mutable int m_currentFrame;
+    mutable int m_playbackStep; // the step between played frames, negative when playing backward
+    mutable frantic::channels::channel_map m_lastChannelMap; // the channels of empty streams
+    mutable boost::uint64_t m_generation; // incremented by clear_cache, so that reads in progress aren't cached
+    bool m_stopping;
+
+    std::thread m_prefetchThread;
+};
+
+} // namespace particles
+} // namespace maya
+} // namespace frantic
@@ -0,0 +1,150 @@
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+#pragma once
+
+#include <maya/MFnDependencyNode.h>
+
+#include <frantic/graphics/transform4f.hpp>
+#include <frantic/logging/progress_logger.hpp>
+#include <frantic/particles/streams/particle_istream.hpp>
+#include <frantic/strings/tstring.hpp>
+
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <cstddef>
+#include <vector>
+
+namespace frantic {
+namespace maya {
+namespace particles {
+
+namespace detail {
+class prt_write_block;
+} // namespace detail
+
+/**
+ * Settings for prt_writer.
+ */
+struct prt_writer_options {
+    // The number of bytes of particle data that are read, and then compressed, as a unit.  Each block is rounded down
+    // to a whole number of particles.
+    std::size_t blockSize;
+    // The number of blocks that may be read but not yet written.  The writer's memory use is bounded by this number of
+    // input and compressed blocks, regardless of the number of particles.
+    std::size_t maxBlocksInFlight;
+    // A zlib compression level, from 0 (none) to 9 (best), or -1 for zlib's default.
+    int compressionLevel;
+
+    // Defaults to 1 MB blocks, with two blocks in flight per hardware thread.
+    prt_writer_options();
+};
+
+/**
+ * The work done writing one PRT file.
+ */
+struct prt_write_stats {
+    boost::int64_t particleCount;
+    boost::uint64_t uncompressedBytes; // the size of the particle data before compression
+    boost::uint64_t compressedBytes;   // the size of the particle data in the file, not counting the header
+    double seconds;                    // including the time spent reading the stream
+
+    prt_write_stats();
+
+    double particles_per_second() const;
+    double uncompressed_bytes_per_second() const;
+};
+
+/**
+ * Writes particle streams to PRT files.
+ *
+ * The stream is read on the calling thread one block at a time, and each block is compressed as an independent part
+ * of the file's zlib stream by TBB worker threads while the following blocks are read.  Compressed blocks are written
+ * in order as soon as they are ready.  At most prt_writer_options::maxBlocksInFlight blocks are held at once, so memory
+ * use does not depend on the number of particles, or on the stream knowing its particle count in advance.
+ *
+ * The block buffers and compressors are kept between calls to write, so writing a sequence of files with one
+ * prt_writer only allocates them once.  A prt_writer must not be used by more than one thread at a time.
+ */
+class prt_writer : boost::noncopyable {
+  public:
+    explicit prt_writer( const prt_writer_options& options = prt_writer_options() );
+    ~prt_writer();
+
+    /**
+     * Writes all of the remaining particles of a stream to a PRT file, with the channels of the stream's current
+     * channel map.  The stream's channel map is replaced by a packed copy of itself, which is the layout written.
+     * @param pin the stream to write.
+     * @param path the file to write.  It is overwritten if it exists.
+     * @return the number of particles written, and the throughput.
+     */
+    prt_write_stats write( frantic::particles::streams::particle_istream& pin, const frantic::tstring& path );
+
+    /**
+     * Frees the block buffers and compressors.  They are allocated again by the next write.
+     */
+    void release_buffers();
+
+    const prt_writer_options& get_options() const { return m_options; }
+
+  private:
+    prt_writer_options m_options;
+    std::vector<boost::shared_ptr<detail::prt_write_block>> m_blocks;
+};
+
+/**
+ * The result of exporting one frame with export_prt_sequence.
+ */
+struct prt_export_frame_stats {
+    int frame;
+    frantic::tstring path;
+    prt_write_stats stats;
+};
+
+/**
+ * Gets the file that a frame is written to by export_prt_sequence.
+ * @param filenamePattern a path whose file name contains a run of '#' characters, such as "particles_####.prt".  The
+ *                        last run is replaced by the frame number, padded with zeros to the length of the run.  If the
+ *                        file name has no '#' characters, the frame number is padded to four digits and inserted
+ *                        before the extension.
+ * @param frame the frame number.
+ * @return the path of the frame's file.
+ */
+frantic::tstring get_prt_sequence_filename( const frantic::tstring& filenamePattern, int frame );
+
+/**
+ * Exports the final particle stream of a node, as returned by PRTObjectBase::getFinalParticleStream, to one PRT file
+ * per frame.  A single prt_writer is used for every frame, so its buffers are reused rather than allocated for each
+ * frame.  The export is one stage of the progress logger, titled "Export PRT Sequence", and the particles and bytes
+ * written are reported to it with add_progress_count, so a batch_progress_logger records their throughput.  The
+ * throughput of each frame is also returned.  The scene time is set to each frame before it is evaluated, and restored
+ * afterwards, even if the export fails.
+ * @param depNode the first node of the particle stream chain to export.
+ * @param objectSpace the transform applied to the particles.
+ * @param filenamePattern the files to write, see get_prt_sequence_filename.
+ * @param startFrame the first frame to export, in the current time unit.
+ * @param endFrame the last frame to export, which is included if it is a whole number of steps after startFrame.
+ * @param frameStep the number of frames between exported frames.  It must be positive.
+ * @param progress reports the number of frames exported.  It can abort the export.
+ * @param[out] outFrameStats the result of each frame that was exported.
+ * @param options the settings of the prt_writer.
+ */
+void export_prt_sequence( const MFnDependencyNode& depNode, const frantic::graphics::transform4f& objectSpace,
+                          const frantic::tstring& filenamePattern, int startFrame, int endFrame, int frameStep,
+                          frantic::logging::progress_logger& progress,
+                          std::vector<prt_export_frame_stats>& outFrameStats,
+                          const prt_writer_options& options = prt_writer_options() );
+
+/**
+ * Same as export_prt_sequence, with the progress logger given by create_progress_logger: a batch_progress_logger in
+ * batch mode, writing to stdout, and Maya's progress bar otherwise.
+ */
+void export_prt_sequence( const MFnDependencyNode& depNode, const frantic::graphics::transform4f& objectSpace,
+                          const frantic::tstring& filenamePattern, int startFrame, int endFrame, int frameStep,
+                          std::vector<prt_export_frame_stats>& outFrameStats,
+                          const prt_writer_options& options = prt_writer_options() );
+
+} // namespace particles
+} // namespace maya
+} // namespace frantic
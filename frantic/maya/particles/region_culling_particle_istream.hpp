@@ -0,0 +1,220 @@
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+#pragma once
+
+#include <frantic/channels/channel_map.hpp>
+#include <frantic/channels/channel_map_adaptor.hpp>
+#include <frantic/graphics/boundbox3f.hpp>
+#include <frantic/graphics/transform4f.hpp>
+#include <frantic/graphics/vector3f.hpp>
+#include <frantic/particles/streams/particle_istream.hpp>
+
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include <cstddef>
+#include <vector>
+
+namespace frantic {
+namespace maya {
+namespace particles {
+
+/**
+ * The region of space a renderer needs particles from, such as a camera's frustum or a list of regions of interest.
+ * Particles outside of it can be discarded before they are converted.
+ *
+ * A point is inside the region if it is on the inner side of every plane, and inside at least one of the boxes.  With
+ * no planes, every point is on the inner side of the planes, and with no boxes, every point is inside the boxes, so an
+ * empty region keeps every particle.
+ */
+class particle_culling_region {
+    struct plane {
+        frantic::graphics::vector3f normal;
+        float offset;
+    };
+
+    struct box {
+        frantic::graphics::transform4f toBoxSpace;
+        bool isOriented;
+        frantic::graphics::boundbox3f bounds;
+    };
+
+    std::vector<plane> m_planes;
+    std::vector<box> m_boxes;
+
+  public:
+    /**
+     * Adds a half-space, which keeps the points p with dot( normal, p ) + offset >= 0.  A frustum is given by its six
+     * planes, with their normals pointing into the frustum.
+     */
+    void add_plane( const frantic::graphics::vector3f& normal, float offset );
+
+    /**
+     * Adds an axis-aligned box to the list of boxes.
+     */
+    void add_box( const frantic::graphics::boundbox3f& bounds );
+
+    /**
+     * Adds an oriented box to the list of boxes.
+     * @param bounds the box, in its own space.
+     * @param boxTransform the transform from the box's space to the space of the region.
+     */
+    void add_box( const frantic::graphics::boundbox3f& bounds, const frantic::graphics::transform4f& boxTransform );
+
+    /**
+     * @return true if the region has no planes or boxes, and keeps every particle.
+     */
+    bool keeps_all() const { return m_planes.empty() && m_boxes.empty(); }
+
+    bool contains( const frantic::graphics::vector3f& p ) const {
+        for( std::vector<plane>::const_iterator it = m_planes.begin(); it != m_planes.end(); ++it ) {
+            if( !( it->normal.x * p.x + it->normal.y * p.y + it->normal.z * p.z + it->offset >= 0 ) ) {
+                return false;
+            }
+        }
+        if( m_boxes.empty() ) {
+            return true;
+        }
+        for( std::vector<box>::const_iterator it = m_boxes.begin(); it != m_boxes.end(); ++it ) {
+            const frantic::graphics::vector3f q = it->isOriented ? it->toBoxSpace * p : p;
+            const frantic::graphics::vector3f& minimum = it->bounds.minimum();
+            const frantic::graphics::vector3f& maximum = it->bounds.maximum();
+            if( q.x >= minimum.x && q.x <= maximum.x && q.y >= minimum.y && q.y <= maximum.y && q.z >= minimum.z &&
+                q.z <= maximum.z ) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+/**
+ * Tests whether the particles of a per-particle position array are inside a particle_culling_region, in parallel.
+ * VectorArray must provide operator[] returning a value with x, y and z members, such as MVectorArray.
+ */
+template <class VectorArray>
+class region_test_body {
+    const VectorArray& m_positions;
+    const frantic::graphics::transform4f& m_toRegionSpace;
+    const particle_culling_region& m_region;
+    const std::vector<unsigned int>* m_candidates;
+    std::vector<char>& m_outInside;
+
+    region_test_body& operator=( const region_test_body& ); // not implemented
+
+  public:
+    region_test_body( const VectorArray& positions, const frantic::graphics::transform4f& toRegionSpace,
+                      const particle_culling_region& region, const std::vector<unsigned int>* candidates,
+                      std::vector<char>& outInside )
+        : m_positions( positions )
+        , m_toRegionSpace( toRegionSpace )
+        , m_region( region )
+        , m_candidates( candidates )
+        , m_outInside( outInside ) {}
+
+    void operator()( const tbb::blocked_range<std::size_t>& range ) const {
+        for( std::size_t i = range.begin(); i != range.end(); ++i ) {
+            const unsigned int index = m_candidates ? ( *m_candidates )[i] : static_cast<unsigned int>( i );
+            // Convert to float before transforming, as the particle streams do
+            const frantic::graphics::vector3f p( (float)m_positions[index].x, (float)m_positions[index].y,
+                                                 (float)m_positions[index].z );
+            m_outInside[i] = m_region.contains( m_toRegionSpace * p );
+        }
+    }
+};
+
+/**
+ * Finds the particles of a per-particle position array that are inside a region.  The positions are tested in
+ * parallel.
+ * @param positions the particles' positions, see region_test_body.
+ * @param count the number of particles.
+ * @param toRegionSpace the transform from the space of the positions to the space of the region.
+ * @param region the region to keep the particles of.
+ * @param candidates the indices of the particles to test, in increasing order, or NULL to test every particle.  It
+ *                   must not be outSelection.
+ * @param[out] outSelection the indices of the particles inside the region, in increasing order.
+ */
+template <class VectorArray>
+void select_particles_in_region( const VectorArray& positions, std::size_t count,
+                                 const frantic::graphics::transform4f& toRegionSpace,
+                                 const particle_culling_region& region, const std::vector<unsigned int>* candidates,
+                                 std::vector<unsigned int>& outSelection ) {
+    const std::size_t testCount = candidates ? candidates->size() : count;
+    std::vector<char> inside( testCount );
+    tbb::parallel_for( tbb::blocked_range<std::size_t>( 0, testCount, 4096 ),
+                       region_test_body<VectorArray>( positions, toRegionSpace, region, candidates, inside ) );
+
+    outSelection.clear();
+    for( std::size_t i = 0; i < testCount; ++i ) {
+        if( inside[i] ) {
+            outSelection.push_back( candidates ? ( *candidates )[i] : static_cast<unsigned int>( i ) );
+        }
+    }
+}
+
+/**
+ * A stream that only passes on the particles of its delegate whose Position is inside a particle_culling_region.
+ * Sources that can test the positions before converting their particles should do so instead, this stream is the
+ * fallback for those that can't.
+ */
+class region_culling_particle_istream : public frantic::particles::streams::particle_istream {
+    boost::shared_ptr<frantic::particles::streams::particle_istream> m_delegate;
+
+    particle_culling_region m_region;
+    frantic::tstring m_positionChannelName;
+
+    boost::int64_t m_particleIndex; // index of the last particle returned
+
+    frantic::channels::channel_map m_channelMap;
+    frantic::channels::channel_map m_delegateChannelMap;
+    frantic::channels::channel_map_adaptor m_cma; // m_delegateChannelMap to m_channelMap
+
+    bool m_hasPosition;
+    frantic::channels::channel_cvt_accessor<frantic::graphics::vector3f> m_positionAccessor;
+
+    std::vector<char> m_delegateParticle;
+    std::vector<char> m_defaultParticle;
+
+  public:
+    /**
+     * @param pin the stream to cull.
+     * @param region the region to keep the particles of, in the space of the delegate's particles.
+     * @param positionChannelName the channel tested against the region.  If the delegate doesn't have it, every
+     *                            particle is kept.
+     */
+    region_culling_particle_istream( boost::shared_ptr<frantic::particles::streams::particle_istream> pin,
+                                     const particle_culling_region& region,
+                                     const frantic::tstring& positionChannelName = _T("Position") );
+
+    virtual ~region_culling_particle_istream() {}
+
+    void close() { m_delegate->close(); }
+    boost::int64_t particle_count() const { return is_passthrough() ? m_delegate->particle_count() : -1; }
+    boost::int64_t particle_index() const { return m_particleIndex; }
+    boost::int64_t particle_count_left() const { return is_passthrough() ? m_delegate->particle_count_left() : -1; }
+    boost::int64_t particle_progress_count() const { return m_delegate->particle_progress_count(); }
+    boost::int64_t particle_progress_index() const { return m_delegate->particle_progress_index(); }
+    boost::int64_t particle_count_guess() const { return m_delegate->particle_count_guess(); }
+    frantic::tstring name() const { return m_delegate->name(); }
+    std::size_t particle_size() const { return m_channelMap.structure_size(); }
+
+    void set_channel_map( const frantic::channels::channel_map& particleChannelMap );
+    void set_default_particle( char* rawParticleBuffer );
+    const frantic::channels::channel_map& get_channel_map() const { return m_channelMap; }
+    const frantic::channels::channel_map& get_native_channel_map() const {
+        return m_delegate->get_native_channel_map();
+    }
+
+    bool get_particle( char* outParticleBuffer );
+    bool get_particles( char* buffer, std::size_t& numParticles );
+
+  private:
+    bool is_passthrough() const { return m_region.keeps_all() || !m_hasPosition; }
+};
+
+} // namespace particles
+} // namespace maya
+} // namespace frantic
@@ -0,0 +1,52 @@
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+#pragma once
+
+#include <frantic/channels/channel_map.hpp>
+#include <frantic/graphics/vector3f.hpp>
+#include <frantic/particles/particle_array.hpp>
+#include <frantic/strings/tstring.hpp>
+
+#include <boost/cstdint.hpp>
+
+#include <cstddef>
+#include <vector>
+
+// The spatial sort in this file works on particle arrays and does not use the Maya API, so that the benchmarks
+// directory can measure it.
+
+namespace frantic {
+namespace maya {
+namespace particles {
+
+/**
+ * Interleaves the bits of three 21-bit grid coordinates into a 63-bit Morton (Z-order) code.  Points with close
+ * codes are close together in space.
+ */
+boost::uint64_t morton_code( boost::uint32_t x, boost::uint32_t y, boost::uint32_t z );
+
+/**
+ * Finds the order that visits the particles along a Morton curve through their bounding box.  The bounding box is
+ * found, the codes are computed and sorted in parallel.  Particles with the same code keep their original order, so
+ * the result doesn't depend on the number of threads.
+ * @param particles the particles to order.
+ * @param positionChannelName the channel of the particles' positions.
+ * @param[out] outOrder the index in particles of each particle, in Morton order.
+ */
+void compute_morton_order( const frantic::particles::particle_array& particles,
+                           const frantic::tstring& positionChannelName, std::vector<std::size_t>& outOrder );
+
+/**
+ * Reorders the particles along a Morton curve through their bounding box, so that particles that are close together
+ * in space are also close together in memory.  Renderers that splat or voxelize the particles in the order they are
+ * stored then touch the same cells of their grids many times in a row, instead of jumping around the grid as they do
+ * in emission order.  Particles without the position channel are left unchanged.
+ * @param particles the particles to reorder.
+ * @param positionChannelName the channel of the particles' positions.
+ */
+void sort_particles_by_morton_code( frantic::particles::particle_array& particles,
+                                    const frantic::tstring& positionChannelName = _T("Position") );
+
+} // namespace particles
+} // namespace maya
+} // namespace frantic
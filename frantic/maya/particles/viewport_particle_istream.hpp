@@ -0,0 +1,200 @@
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+#pragma once
+
+#include <frantic/channels/channel_map.hpp>
+#include <frantic/channels/channel_map_adaptor.hpp>
+#include <frantic/particles/streams/particle_istream.hpp>
+
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace frantic {
+namespace maya {
+namespace particles {
+
+/**
+ * Chooses a stable subset of particles from their IDs.
+ * Each ID is hashed to a pseudo-random 64-bit value, and the particle is kept if that value falls in the first
+ * "fraction" of the hash range. The same IDs are kept from frame to frame, and reducing the fraction only removes
+ * particles from the displayed set.
+ */
+class id_hash_selector {
+    boost::uint64_t m_threshold;
+    double m_fraction;
+    bool m_keepAll;
+
+  public:
+    /**
+     * @param fraction the fraction of particles to keep, in [0,1].
+     */
+    explicit id_hash_selector( double fraction = 1.0 ) { set_fraction( fraction ); }
+
+    void set_fraction( double fraction ) {
+        m_fraction = std::max( 0.0, std::min( 1.0, fraction ) );
+        m_keepAll = !( fraction < 1.0 );
+        if( fraction <= 0.0 ) {
+            m_threshold = 0;
+        } else if( m_keepAll ) {
+            m_threshold = ~boost::uint64_t( 0 );
+        } else {
+            // 2^64 * fraction, computed without overflowing the double to integer conversion.
+            m_threshold = static_cast<boost::uint64_t>( fraction * 9223372036854775808.0 ) << 1;
+        }
+    }
+
+    double get_fraction() const { return m_fraction; }
+
+    bool keeps_all() const { return m_keepAll; }
+
+    bool operator()( boost::int64_t id ) const { return m_keepAll || hash( id ) < m_threshold; }
+
+    /**
+     * The SplitMix64 finalizer. It is cheap and mixes sequential IDs well enough that any contiguous range of IDs is
+     * thinned evenly.
+     */
+    static boost::uint64_t hash( boost::int64_t id ) {
+        boost::uint64_t z = static_cast<boost::uint64_t>( id ) + 0x9E3779B97F4A7C15ULL;
+        z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+        z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBULL;
+        return z ^ ( z >> 31 );
+    }
+};
+
+/**
+ * Gets the fraction of particles to display so that a particle limit is met by thinning the whole system evenly,
+ * rather than by cutting off the particles at the end of the system's order.
+ * @param fraction the fraction of particles to display, in [0,1].
+ * @param limit the maximum number of particles to display, or a negative value for no limit.
+ * @param count the number of particles in the system, or a guess at it.  If negative, the limit can't be applied.
+ * @return the smaller of fraction and limit / count.
+ */
+inline double get_viewport_fraction( double fraction, boost::int64_t limit, boost::int64_t count ) {
+    double result = std::max( 0.0, std::min( 1.0, fraction ) );
+    if( limit >= 0 && count > 0 ) {
+        result = std::min( result, static_cast<double>( limit ) / static_cast<double>( count ) );
+    }
+    return result;
+}
+
+/**
+ * Chooses which particles of a random access particle system to display in the viewport, so that a source can read
+ * and convert only those particles.  Particles are chosen by hashing their IDs with an id_hash_selector, with the
+ * fraction from get_viewport_fraction.  Without IDs, evenly strided samples are taken instead.
+ * IdArray must provide operator[] taking an unsigned int and returning an integer ID, such as MIntArray.
+ * @param ids the ID of each particle, or NULL if the system has no IDs.
+ * @param count the number of particles in the system.
+ * @param fraction the fraction of particles to display, in [0,1].
+ * @param limit the maximum number of particles to display, or a negative value for no limit.
+ * @param outSelection the indices of the selected particles, in increasing order.
+ * @return false if every particle should be displayed, in which case outSelection is empty.
+ */
+template <class IdArray>
+bool select_viewport_indices( const IdArray* ids, std::size_t count, double fraction, boost::int64_t limit,
+                              std::vector<unsigned int>& outSelection ) {
+    outSelection.clear();
+
+    if( fraction >= 1.0 && ( limit < 0 || static_cast<std::size_t>( limit ) >= count ) ) {
+        return false;
+    }
+
+    const double effectiveFraction = get_viewport_fraction( fraction, limit, static_cast<boost::int64_t>( count ) );
+    const std::size_t maxCount = limit >= 0 ? static_cast<std::size_t>( limit ) : count;
+
+    if( ids ) {
+        const id_hash_selector selector( effectiveFraction );
+        outSelection.reserve( static_cast<std::size_t>( effectiveFraction * static_cast<double>( count ) * 1.1 ) + 16 );
+        for( unsigned int i = 0; i < count && outSelection.size() < maxCount; ++i ) {
+            if( selector( ( *ids )[i] ) ) {
+                outSelection.push_back( i );
+            }
+        }
+    } else {
+        const std::size_t selectedCount =
+            std::min( maxCount, static_cast<std::size_t>( effectiveFraction * static_cast<double>( count ) + 0.5 ) );
+        outSelection.resize( selectedCount );
+        const double stride =
+            selectedCount > 0 ? static_cast<double>( count ) / static_cast<double>( selectedCount ) : 0;
+        for( std::size_t i = 0; i < selectedCount; ++i ) {
+            outSelection[i] = static_cast<unsigned int>( static_cast<double>( i ) * stride );
+        }
+    }
+
+    return true;
+}
+
+/**
+ * A stream that decimates its delegate for viewport display.
+ * Particles are selected by hashing their ID channel with an id_hash_selector, so the displayed subset is stable
+ * across frames. If the delegate has no ID channel, the particle's index in the delegate stream is used instead. When a
+ * limit is given, the fraction is reduced using the delegate's particle count guess, so that the displayed particles
+ * are spread over the whole system. The limit is still enforced if the guess was too low.
+ *
+ * Every particle of the delegate is still read and converted, so this is the fallback for sources that can't select
+ * particles before converting them. Sources with random access to their particles should select with
+ * select_viewport_indices instead, as PRTMayaParticle and prt_cache_particle_source do.
+ */
+class viewport_particle_istream : public frantic::particles::streams::particle_istream {
+    boost::shared_ptr<frantic::particles::streams::particle_istream> m_delegate;
+
+    id_hash_selector m_selector;
+    boost::int64_t m_limit;
+    frantic::tstring m_idChannelName;
+
+    boost::int64_t m_particleIndex;         // index of the last particle returned
+    boost::int64_t m_delegateParticleIndex; // index of the last particle read from the delegate
+
+    frantic::channels::channel_map m_channelMap;
+    frantic::channels::channel_map m_delegateChannelMap;
+    frantic::channels::channel_map_adaptor m_cma; // m_delegateChannelMap to m_channelMap
+
+    bool m_hasIdChannel;
+    frantic::channels::channel_cvt_accessor<boost::int64_t> m_idAccessor;
+
+    std::vector<char> m_delegateParticle;
+    std::vector<char> m_defaultParticle;
+
+  public:
+    /**
+     * @param pin the stream to decimate.
+     * @param fraction the fraction of the delegate's particles to display, in [0,1].
+     * @param limit the maximum number of particles to display, or a negative value for no limit.
+     * @param idChannelName the channel used to choose which particles are displayed.
+     */
+    viewport_particle_istream( boost::shared_ptr<frantic::particles::streams::particle_istream> pin, double fraction,
+                               boost::int64_t limit, const frantic::tstring& idChannelName = _T("ID") );
+
+    virtual ~viewport_particle_istream() {}
+
+    void close() { m_delegate->close(); }
+    boost::int64_t particle_count() const;
+    boost::int64_t particle_index() const { return m_particleIndex; }
+    boost::int64_t particle_count_left() const;
+    boost::int64_t particle_progress_count() const { return m_delegate->particle_progress_count(); }
+    boost::int64_t particle_progress_index() const { return m_delegate->particle_progress_index(); }
+    boost::int64_t particle_count_guess() const;
+    frantic::tstring name() const { return m_delegate->name(); }
+    std::size_t particle_size() const { return m_channelMap.structure_size(); }
+
+    void set_channel_map( const frantic::channels::channel_map& particleChannelMap );
+    void set_default_particle( char* rawParticleBuffer );
+    const frantic::channels::channel_map& get_channel_map() const { return m_channelMap; }
+    const frantic::channels::channel_map& get_native_channel_map() const {
+        return m_delegate->get_native_channel_map();
+    }
+
+    bool get_particle( char* outParticleBuffer );
+    bool get_particles( char* buffer, std::size_t& numParticles );
+
+  private:
+    bool is_limited() const { return m_limit >= 0; }
+    bool is_passthrough() const { return m_selector.keeps_all() && !is_limited(); }
+};
+
+} // namespace particles
+} // namespace maya
+} // namespace frantic
@@ -68,6 +68,8 @@ struct register_string_array_callback_t {
 ////////////////////////////////////////
 class plugin_manager {
   public:
+    typedef void ( *unload_function_t )();
+
     plugin_manager();
     ~plugin_manager();
 
@@ -76,6 +78,18 @@ class plugin_manager {
 
     template <typename T>
     MStatus register_callback( MSceneMessage::Message msg, typename T::function_t func, void* clientData = NULL );
+    MStatus register_node_added_callback( MMessage::MNodeFunction func, const MString& nodeType = "dependNode",
+                                          void* clientData = NULL );
+    MStatus register_node_removed_callback( MMessage::MNodeFunction func, const MString& nodeType = "dependNode",
+                                            void* clientData = NULL );
+    MStatus register_connection_callback( MMessage::MPlugFunction func, void* clientData = NULL );
+    MStatus register_event_callback( const MString& eventName, MMessage::MBasicFunction func,
+                                     void* clientData = NULL );
+    /**
+     * Registers a function that is called by unregister_all(), for example to stop using state that the plugin's
+     * callbacks kept up to date.
+     */
+    MStatus register_unload_function( unload_function_t func, const frantic::tstring& description );
     MStatus register_command( const MString& commandName, MCreatorFunction creator,
                               MCreateSyntaxFunction createSyntaxFunction = NULL );
     MStatus register_data( const MString& typeName, const MTypeId& typeId, MCreatorFunction creatorFunction,
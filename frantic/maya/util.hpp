@@ -13,35 +13,26 @@
 namespace frantic {
 namespace maya {
 
+class plugin_manager;
+
 inline double get_fps() { return MTime( 1.0, MTime::kSeconds ).as( MTime::uiUnit() ); }
 
-inline double get_scale_to_meters() {
-    MString units;
-    MGlobal::executeCommand( "currentUnit -q;", units );
-    if( units == "mm" )
-        return 0.001;
-    if( units == "cm" )
-        return 0.01;
-    if( units == "m" )
-        return 1.0;
-    if( units == "in" )
-        return 0.0254;
-    if( units == "ft" )
-        return 0.3048;
-    if( units == "yd" )
-        return 0.9144;
-    else
-        return 0.0;
-}
+/**
+ * @return the length of the scene's linear unit in meters, or 0 if the unit is not one of mm, cm, m, in, ft or yd.
+ *         If register_scene_unit_callbacks was called, the value is cached until the unit changes.
+ */
+double get_scale_to_meters();
 
-inline frantic::graphics::coordinate_system::option get_coordinate_system() {
-    MString upAxis;
-    MGlobal::executeCommand( "upAxis -q -axis;", upAxis );
-    if( upAxis == "y" )
-        return frantic::graphics::coordinate_system::right_handed_yup;
-    else
-        return frantic::graphics::coordinate_system::right_handed_zup;
-}
+/**
+ * @return the scene's coordinate system, according to its up axis.
+ */
+frantic::graphics::coordinate_system::option get_coordinate_system();
+
+/**
+ * Registers the callbacks that invalidate the cached scene unit, and enables the cache.  The callbacks are removed by
+ * pluginManager.unregister_all().
+ */
+MStatus register_scene_unit_callbacks( plugin_manager& pluginManager );
 
 inline bool is_batch_mode() {
     // this is one of at least three ways of detecting if you are in batch (i.e. non-ui) mode, however the other
@@ -27,6 +27,11 @@ class MPxParticleStream_impl : public MPxParticleStream {
     getRenderParticleStream( const frantic::graphics::transform4f& objectSpace,
                              const MDGContext& context = MDGContext::fsNormal ) const;
 
+    virtual frantic::particles::streams::particle_istream_ptr
+    getRenderParticleStream( const frantic::graphics::transform4f& objectSpace,
+                             const frantic::maya::particles::particle_culling_region& region,
+                             const MDGContext& context = MDGContext::fsNormal ) const;
+
     virtual frantic::particles::streams::particle_istream_ptr
     getViewportParticleStream( const frantic::graphics::transform4f& objectSpace,
                                const MDGContext& context = MDGContext::fsNormal ) const;
@@ -43,6 +48,18 @@ const MTypeId MPxParticleStream::id( 0x0011748c );
 const MString MPxParticleStream::typeName( "ParticleStreamMPxData" );
 
 void* MPxParticleStream::creator() { return new MPxParticleStream_impl; }
+
+frantic::particles::streams::particle_istream_ptr
+MPxParticleStream::getRenderParticleStream( const frantic::graphics::transform4f& objectSpace,
+                                            const frantic::maya::particles::particle_culling_region& region,
+                                            const MDGContext& context ) const {
+    frantic::particles::streams::particle_istream_ptr stream = getRenderParticleStream( objectSpace, context );
+    if( !stream || region.keeps_all() ) {
+        return stream;
+    }
+    return frantic::particles::streams::particle_istream_ptr(
+        new frantic::maya::particles::region_culling_particle_istream( stream, region ) );
+}
 #pragma endregion
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -75,6 +92,13 @@ MPxParticleStream_impl::getRenderParticleStream( const frantic::graphics::transf
     return m_particle_source->getRenderParticleStream( objectSpace, context );
 }
 
+frantic::particles::streams::particle_istream_ptr
+MPxParticleStream_impl::getRenderParticleStream( const frantic::graphics::transform4f& objectSpace,
+                                                 const frantic::maya::particles::particle_culling_region& region,
+                                                 const MDGContext& context ) const {
+    return m_particle_source->getRenderParticleStream( objectSpace, region, context );
+}
+
 frantic::particles::streams::particle_istream_ptr
 MPxParticleStream_impl::getViewportParticleStream( const frantic::graphics::transform4f& objectSpace,
                                                    const MDGContext& context ) const {
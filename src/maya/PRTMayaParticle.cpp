@@ -10,8 +10,12 @@
 #include <frantic/channels/channel_map.hpp>
 #include <frantic/maya/MPxParticleStream.hpp>
 #include <frantic/maya/convert.hpp>
+#include <frantic/maya/logging/instrumentation.hpp>
 #include <frantic/maya/maya_util.hpp>
+#include <frantic/maya/particles/constant_channel_particle_istream.hpp>
+#include <frantic/maya/particles/motion_extrapolation_particle_istream.hpp>
 #include <frantic/maya/particles/particles.hpp>
+#include <frantic/maya/particles/spatial_sort.hpp>
 #include <frantic/maya/util.hpp>
 #include <frantic/particles/particle_array.hpp>
 #include <frantic/particles/streams/empty_particle_istream.hpp>
@@ -24,6 +28,10 @@
 #include <maya/MPlug.h>
 #include <maya/MPlugArray.h>
 #include <maya/MStatus.h>
+#include <maya/MTime.h>
+
+#include <algorithm>
+#include <vector>
 
 namespace frantic {
 namespace maya {
@@ -39,6 +47,21 @@ inline frantic::particles::streams::particle_istream_ptr getEmptyStream() {
         new frantic::particles::streams::empty_particle_istream( lsChannelMap ) );
 }
 
+// Streams a snapshot taken by PRTMayaParticle::getParticleSnapshot, adding back the channels that were the same for
+// every particle.
+frantic::particles::streams::particle_istream_ptr
+make_snapshot_stream( const boost::shared_ptr<frantic::particles::particle_array>& particleArray,
+                      const frantic::maya::particles::constant_channel_table& constantChannels ) {
+    frantic::particles::streams::particle_istream_ptr outStream(
+        new frantic::particles::streams::shared_particle_container_particle_istream<frantic::particles::particle_array>(
+            particleArray ) );
+    if( !constantChannels.empty() ) {
+        outStream.reset(
+            new frantic::maya::particles::constant_channel_particle_istream( outStream, constantChannels ) );
+    }
+    return outStream;
+}
+
 } // namespace
 
 const MTypeId PRTMayaParticle::typeId( 0x0011748f );
@@ -47,6 +70,9 @@ const MString PRTMayaParticle::inParticleAttribute = "count";
 
 MObject PRTMayaParticle::inConnect;
 MObject PRTMayaParticle::outParticleStream;
+MObject PRTMayaParticle::viewportPercentage;
+MObject PRTMayaParticle::viewportLimit;
+MObject PRTMayaParticle::spatialSort;
 
 PRTMayaParticle::PRTMayaParticle() {}
 
@@ -85,6 +111,31 @@ MStatus PRTMayaParticle::initialize() {
         CHECK_MSTATUS_AND_RETURN_IT( status );
     }
 
+    // Viewport Display
+    {
+        MFnNumericAttribute fnNumericAttribute;
+        viewportPercentage =
+            fnNumericAttribute.create( "viewportPercentage", "viewportPercentage", MFnNumericData::kFloat, 100.0 );
+        fnNumericAttribute.setMin( 0.0 );
+        fnNumericAttribute.setMax( 100.0 );
+        status = addAttribute( viewportPercentage );
+        CHECK_MSTATUS_AND_RETURN_IT( status );
+
+        // A negative limit displays every particle selected by viewportPercentage
+        viewportLimit = fnNumericAttribute.create( "viewportLimit", "viewportLimit", MFnNumericData::kInt, -1 );
+        fnNumericAttribute.setMin( -1 );
+        status = addAttribute( viewportLimit );
+        CHECK_MSTATUS_AND_RETURN_IT( status );
+    }
+
+    // Particle Order
+    {
+        MFnNumericAttribute fnNumericAttribute;
+        spatialSort = fnNumericAttribute.create( "spatialSort", "spatialSort", MFnNumericData::kBoolean, false );
+        status = addAttribute( spatialSort );
+        CHECK_MSTATUS_AND_RETURN_IT( status );
+    }
+
     // attributeAffects( inParticleStreamName, outParticleStream );
 
     return MS::kSuccess;
@@ -158,23 +209,62 @@ MStatus PRTMayaParticle::compute( const MPlug& plug, MDataBlock& block ) {
 
 frantic::particles::streams::particle_istream_ptr
 PRTMayaParticle::getParticleStream( const frantic::graphics::transform4f& objectSpace, const MDGContext& context,
-                                    bool isViewport ) const {
+                                    bool isViewport,
+                                    const frantic::maya::particles::particle_culling_region* region ) const {
+    boost::shared_ptr<frantic::particles::particle_array> particleArray;
+    frantic::maya::particles::constant_channel_table constantChannels;
+    if( !getParticleSnapshot( objectSpace, context, isViewport, false, region, particleArray, constantChannels ) ) {
+        return getEmptyStream();
+    }
+    return make_snapshot_stream( particleArray, constantChannels );
+}
+
+void PRTMayaParticle::getMotionSampledParticleStreams( const frantic::graphics::transform4f& objectSpace,
+                                                       const std::vector<double>& sampleOffsets,
+                                                       std::vector<particle_istream_ptr>& outStreams,
+                                                       const MDGContext& context ) const {
+    outStreams.clear();
+    outStreams.reserve( sampleOffsets.size() );
+
+    // grab_maya_particles can only read the particles at the current time, so they are captured once and each sample
+    // is extrapolated from that capture.
+    boost::shared_ptr<frantic::particles::particle_array> particleArray;
+    frantic::maya::particles::constant_channel_table constantChannels;
+    if( !getParticleSnapshot( objectSpace, context, false, true, NULL, particleArray, constantChannels ) ) {
+        for( std::size_t i = 0; i < sampleOffsets.size(); ++i ) {
+            outStreams.push_back( getEmptyStream() );
+        }
+        return;
+    }
+
+    // Without a per-particle acceleration, the samples are extrapolated from the velocity alone
+    const bool hasAcceleration =
+        particleArray->get_channel_map().has_channel( frantic::maya::particles::PRTAccelerationChannelName );
+    const frantic::tstring accelerationChannelName =
+        hasAcceleration ? frantic::maya::particles::PRTAccelerationChannelName : frantic::tstring();
+
+    for( std::vector<double>::const_iterator it = sampleOffsets.begin(); it != sampleOffsets.end(); ++it ) {
+        particle_istream_ptr stream = make_snapshot_stream( particleArray, constantChannels );
+        const double seconds = MTime( *it, MTime::uiUnit() ).as( MTime::kSeconds );
+        if( seconds != 0 ) {
+            stream.reset( new frantic::maya::particles::motion_extrapolation_particle_istream(
+                stream, seconds, frantic::maya::particles::PRTVelocityChannelName, accelerationChannelName ) );
+        }
+        outStreams.push_back( stream );
+    }
+}
+
+bool PRTMayaParticle::getParticleSnapshot( const frantic::graphics::transform4f& objectSpace,
+                                           const MDGContext& context, bool isViewport, bool includeAcceleration,
+                                           const frantic::maya::particles::particle_culling_region* region,
+                                           boost::shared_ptr<frantic::particles::particle_array>& outParticles,
+                                           frantic::maya::particles::constant_channel_table& outConstants ) const {
     MStatus stat;
 
     // Get the input particle stream
-    MObject particleStream = getConnectedMayaParticleStream( &stat );
-    if( stat != MS::kSuccess ) {
-        FF_LOG( debug )
-            << ( ( "DEBUG: PRTMayaParticle: unable to get connected particle stream: " + stat.errorString() ).asChar() )
-            << std::endl;
-        return getEmptyStream();
-    }
-    MFnParticleSystem particleNode( particleStream, &stat );
-    if( stat != MS::kSuccess ) {
-        FF_LOG( debug )
-            << ( ( "DEBUG: PRTMayaParticle: unable to get connected particle stream: " + stat.errorString() ).asChar() )
-            << std::endl;
-        return getEmptyStream();
+    MFnParticleSystem particleNode;
+    if( !getConnectedParticleSystem( particleNode ) ) {
+        return false;
     }
 
     // Ignore if not visible
@@ -207,15 +297,49 @@ PRTMayaParticle::getParticleStream( const frantic::graphics::transform4f& object
     channels.define_channel( frantic::maya::particles::PRTAgeChannelName, 1, frantic::channels::data_type_float32 );
     channels.define_channel( frantic::maya::particles::PRTLifeSpanChannelName, 1,
                              frantic::channels::data_type_float32 );
+    if( includeAcceleration ) {
+        channels.define_channel( frantic::maya::particles::PRTAccelerationChannelName, 3,
+                                 frantic::channels::data_type_float32 );
+    }
     channels.end_channel_definition();
 
-    bool ok = frantic::maya::particles::grab_maya_particles( particleNode, context, channels, *particleArray );
+    // The particles are returned relative to the particle system's transform
+    const frantic::graphics::transform4f baseObjectSpace = getBaseObjectSpace( particleNode, objectSpace, context );
+
+    // In the viewport, choose the displayed particles up front so that only those are read from Maya's arrays and
+    // converted.
+    std::vector<unsigned int> selection;
+    bool useSelection = false;
+    if( isViewport ) {
+        useSelection = frantic::maya::particles::select_viewport_particles(
+            particleNode, getViewportFraction( context ), getViewportLimit( context ), selection );
+    }
+
+    // Likewise, test the raw positions against the culling region before any channel is converted, so that only the
+    // particles inside it are read from the other arrays.
+    if( region && !region->keeps_all() ) {
+        std::vector<unsigned int> regionSelection;
+        if( !frantic::maya::particles::select_maya_particles_in_region( particleNode, context,
+                                                                        baseObjectSpace.to_inverse(), *region,
+                                                                        useSelection ? &selection : NULL,
+                                                                        regionSelection ) ) {
+            FF_LOG( debug ) << ( ( "DEBUG: PRTMayaParticle: Unable to cull '" + particleNode.name() + "'" ).asChar() )
+                            << std::endl;
+            return false;
+        }
+        selection.swap( regionSelection );
+        useSelection = true;
+    }
+
+    // Channels with the same value for every particle are kept out of the array, and added back by the stream.
+    bool ok = frantic::maya::particles::grab_maya_particles(
+        particleNode, context, channels, useSelection ? &selection : NULL, *particleArray, &outConstants );
     if( !ok ) {
         FF_LOG( debug ) << ( ( "DEBUG: PRTMayaParticle: Unable to convert '" + particleNode.name() +
                                "' to PRT Particles: " + stat.errorString() )
                                  .asChar() )
                         << std::endl;
-        return getEmptyStream();
+        return false;
     }
 
     // Transform code transferred from maya_ksr
@@ -227,9 +351,98 @@ PRTMayaParticle::getParticleStream( const frantic::graphics::transform4f& object
     // stabilized, this should go into the 'enableMotionBlur' condition in the if below and then the
     // non-motion-blur-case will just pass an identity transform.
     std::map<frantic::tstring, frantic::particles::prt::channel_interpretation::option> channelInterpretations;
+    channelInterpretations[frantic::maya::particles::PRTAccelerationChannelName] =
+        frantic::particles::prt::channel_interpretation::vector;
+    frantic::particles::streams::transform_impl<float> transformer(
+        baseObjectSpace.to_inverse(), frantic::graphics::transform4f::zero(), particleArray->get_channel_map(),
+        channelInterpretations );
+    for( frantic::particles::particle_array::iterator it = particleArray->begin(); it != particleArray->end(); ++it ) {
+        transformer( *it );
+    }
+
+    // Optionally reorder the particles so that renderers that splat them in order get better cache locality
+    if( getSpatialSort( context ) ) {
+        FRANTIC_MAYA_SCOPED_TIMER( "sort_particles_by_morton_code" );
+        frantic::maya::particles::sort_particles_by_morton_code( *particleArray,
+                                                                 frantic::maya::particles::PRTPositionChannelName );
+    }
+
+    outParticles = particleArray;
+    return true;
+}
+
+void PRTMayaParticle::getParticleStreamStatistics( const frantic::graphics::transform4f& objectSpace,
+                                                   frantic::maya::particles::particle_stream_statistics& outStats,
+                                                   const MDGContext& context ) const {
+    outStats.clear();
+
+    MFnParticleSystem particleNode;
+    if( !getConnectedParticleSystem( particleNode ) ) {
+        return;
+    }
+
+    MTime time;
+    context.getTime( time );
+    const frantic::graphics::transform4f baseObjectSpace = getBaseObjectSpace( particleNode, objectSpace, context );
+    const std::size_t particleCount = particleNode.count();
+    {
+        std::lock_guard<std::mutex> lock( m_statisticsMutex );
+        if( m_statisticsCache.matches( time, baseObjectSpace, particleCount ) ) {
+            outStats = m_statisticsCache.statistics;
+            return;
+        }
+    }
+
+    // The statistics are found from Maya's arrays, without converting the particles.
+    if( !frantic::maya::particles::get_maya_particle_statistics( particleNode, context, baseObjectSpace.to_inverse(),
+                                                                 outStats ) ) {
+        FF_LOG( debug ) << ( ( "DEBUG: PRTMayaParticle: Unable to get the statistics of '" + particleNode.name() +
+                               "'" )
+                                 .asChar() )
+                        << std::endl;
+        outStats.clear();
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock( m_statisticsMutex );
+    m_statisticsCache.valid = true;
+    m_statisticsCache.time = time;
+    m_statisticsCache.baseObjectSpace = baseObjectSpace;
+    m_statisticsCache.particleCount = particleCount;
+    m_statisticsCache.statistics = outStats;
+}
+
+MStatus PRTMayaParticle::setDependentsDirty( const MPlug& plug, MPlugArray& plugArray ) {
+    // Any change to the connected particle system, or to this node, may change the particles
+    {
+        std::lock_guard<std::mutex> lock( m_statisticsMutex );
+        m_statisticsCache.valid = false;
+    }
+    return MPxNode::setDependentsDirty( plug, plugArray );
+}
+
+bool PRTMayaParticle::getConnectedParticleSystem( MFnParticleSystem& outParticleSystem ) const {
+    MStatus stat;
+    MObject particleStream = getConnectedMayaParticleStream( &stat );
+    if( stat == MS::kSuccess ) {
+        stat = outParticleSystem.setObject( particleStream );
+    }
+    if( stat != MS::kSuccess ) {
+        FF_LOG( debug )
+            << ( ( "DEBUG: PRTMayaParticle: unable to get connected particle stream: " + stat.errorString() ).asChar() )
+            << std::endl;
+        return false;
+    }
+    return true;
+}
+
+frantic::graphics::transform4f PRTMayaParticle::getBaseObjectSpace( const MFnParticleSystem& particleNode,
+                                                                    const frantic::graphics::transform4f& objectSpace,
+                                                                    const MDGContext& context ) const {
     frantic::graphics::transform4f baseObjectSpace;
+    bool ok;
     MDagPath particleNodePath;
-    stat = particleNode.getPath( particleNodePath );
+    MStatus stat = particleNode.getPath( particleNodePath );
     if( stat == MS::kSuccess ) {
         // We need to use the original particle object's transform to support instancing
         ok = maya_util::get_object_world_matrix( particleNodePath, context, baseObjectSpace );
@@ -242,18 +455,34 @@ PRTMayaParticle::getParticleStream( const frantic::graphics::transform4f& object
             << ( ( "DEBUG: PRTMayaParticle: Unable to get base transform for '" + particleNode.name() + "'" ).asChar() )
             << std::endl;
     }
-    frantic::particles::streams::transform_impl<float> transformer(
-        baseObjectSpace.to_inverse(), frantic::graphics::transform4f::zero(), particleArray->get_channel_map(),
-        channelInterpretations );
-    for( frantic::particles::particle_array::iterator it = particleArray->begin(); it != particleArray->end(); ++it ) {
-        transformer( *it );
-    }
+    return baseObjectSpace;
+}
 
-    // Done
-    frantic::maya::PRTObjectBase::particle_istream_ptr outStream = frantic::maya::PRTObjectBase::particle_istream_ptr(
-        new frantic::particles::streams::shared_particle_container_particle_istream<frantic::particles::particle_array>(
-            particleArray ) );
-    return outStream;
+double PRTMayaParticle::getViewportFraction( const MDGContext& context ) const {
+    MStatus stat;
+    MPlug plug( thisMObject(), viewportPercentage );
+    const float percentage = plug.asFloat( const_cast<MDGContext&>( context ), &stat );
+    if( stat != MS::kSuccess )
+        return 1.0;
+    return std::max( 0.0, std::min( 1.0, percentage / 100.0 ) );
+}
+
+boost::int64_t PRTMayaParticle::getViewportLimit( const MDGContext& context ) const {
+    MStatus stat;
+    MPlug plug( thisMObject(), viewportLimit );
+    const int limit = plug.asInt( const_cast<MDGContext&>( context ), &stat );
+    if( stat != MS::kSuccess )
+        return -1;
+    return limit;
+}
+
+bool PRTMayaParticle::getSpatialSort( const MDGContext& context ) const {
+    MStatus stat;
+    MPlug plug( thisMObject(), spatialSort );
+    const bool sort = plug.asBool( const_cast<MDGContext&>( context ), &stat );
+    if( stat != MS::kSuccess )
+        return false;
+    return sort;
 }
 
 MObject PRTMayaParticle::getConnectedMayaParticleStream( MStatus* status ) const {
@@ -4,74 +4,144 @@
 
 #include <frantic/maya/MPxParticleStream.hpp>
 #include <frantic/maya/PRTObject_base.hpp>
+#include <frantic/maya/attributes.hpp>
 #include <frantic/maya/maya_util.hpp>
+#include <frantic/maya/particles/viewport_particle_istream.hpp>
+#include <frantic/maya/plugin_manager.hpp>
 #include <frantic/maya/util.hpp>
 
+#include <maya/MFnAttribute.h>
 #include <maya/MFnPluginData.h>
+#include <maya/MObjectHandle.h>
 #include <maya/MPlugArray.h>
+#include <maya/MTime.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
 
 namespace frantic {
 namespace maya {
 
-PRTObjectBase::particle_istream_ptr
-PRTObjectBase::getViewportParticleStream( const frantic::graphics::transform4f& objectSpace,
-                                          const MDGContext& context ) const {
-    return getRenderParticleStream( objectSpace, context );
-}
+namespace {
 
-PRTObjectBase::particle_istream_ptr
-PRTObjectBase::getFinalParticleStream( const MFnDependencyNode& depNode,
-                                       const frantic::graphics::transform4f& objectSpace, const MDGContext& context,
-                                       bool isViewport, MString outParticleStreamAttr ) {
-    MStatus stat;
+struct stream_chain_entry {
+    MObjectHandle source;
+    std::vector<MObjectHandle> chain;
 
-    // Get the dependency node at the end of the chain
-    MObject finalNode = getEndOfStreamChain( depNode, outParticleStreamAttr );
-    if( stat != MStatus::kSuccess )
-        throw std::runtime_error( ( "DEBUG: could not find end of chain using attribute '" + outParticleStreamAttr +
-                                    "' from depNode '" + depNode.name() + "': " + stat.errorString() )
-                                      .asChar() );
+    // Returns false if any node of the chain has been deleted since it was cached
+    bool is_valid() const {
+        for( std::vector<MObjectHandle>::const_iterator it = chain.begin(); it != chain.end(); ++it ) {
+            if( !it->isValid() )
+                return false;
+        }
+        return true;
+    }
 
-    // Extract the final Particle Stream Data
-    return getParticleStreamFromMPxData( finalNode, objectSpace, context, isViewport, outParticleStreamAttr );
-}
+    void get_chain( std::vector<MObject>& outChain ) const {
+        outChain.clear();
+        outChain.reserve( chain.size() );
+        for( std::vector<MObjectHandle>::const_iterator it = chain.begin(); it != chain.end(); ++it ) {
+            outChain.push_back( it->object() );
+        }
+    }
 
-PRTObjectBase::particle_istream_ptr PRTObjectBase::getParticleStreamFromMPxData(
-    const MFnDependencyNode& depNode, const frantic::graphics::transform4f& objectSpace, const MDGContext& context,
-    bool isViewport, MString outParticleStreamAttr ) {
-    MStatus stat;
+    bool contains( const MObjectHandle& node ) const {
+        return std::find( chain.begin(), chain.end(), node ) != chain.end();
+    }
+};
 
-    MPlug plug = depNode.findPlug( outParticleStreamAttr, &stat );
-    if( stat != MStatus::kSuccess )
-        throw std::runtime_error( ( "DEBUG: could not find plug '" + outParticleStreamAttr + "' from depNode '" +
-                                    depNode.name() + "': " + stat.errorString() )
-                                      .asChar() );
+// Resolved chains, keyed by the stream attribute name and the MObjectHandle::hashCode() of their first node
+typedef std::map<std::pair<std::string, unsigned int>, std::vector<stream_chain_entry>> stream_chain_map_t;
 
-    MObject prtMpxData;
-    plug.getValue( prtMpxData );
-    MFnPluginData fnData( prtMpxData );
-    MPxParticleStream* streamMPxData = frantic::maya::mpx_cast<MPxParticleStream*>( fnData.data( &stat ) );
+struct stream_neighbor_entry {
+    MObjectHandle source;
+    MObjectHandle neighbor;
+    bool hasNeighbor;
 
-    if( stat != MStatus::kSuccess || streamMPxData == NULL )
-        throw std::runtime_error( ( "DEBUG: could not get MPxParticleStream from '" + outParticleStreamAttr +
-                                    "' from depNode '" + depNode.name() + "': " + stat.errorString() )
-                                      .asChar() );
+    bool contains( const MObjectHandle& node ) const { return source == node || ( hasNeighbor && neighbor == node ); }
+};
 
-    frantic::particles::streams::particle_istream_ptr outStream;
-    if( isViewport )
-        outStream = streamMPxData->getViewportParticleStream( objectSpace, context );
-    else
-        outStream = streamMPxData->getRenderParticleStream( objectSpace, context );
+// The node connected to one stream attribute of a node, keyed as the chains are
+typedef std::map<std::pair<std::string, unsigned int>, std::vector<stream_neighbor_entry>> stream_neighbor_map_t;
 
-    return outStream;
+struct stream_chain_cache {
+    stream_chain_map_t chains;
+    stream_neighbor_map_t nextElements;
+    stream_neighbor_map_t previousElements;
+    bool isActive;
+
+    stream_chain_cache()
+        : isActive( false ) {}
+
+    bool empty() const { return chains.empty() && nextElements.empty() && previousElements.empty(); }
+
+    void clear() {
+        chains.clear();
+        nextElements.clear();
+        previousElements.clear();
+    }
+
+    // Returns true if anything is cached for the stream attribute with the given name
+    bool uses_attribute( const std::string& attributeName ) const {
+        return has_attribute( chains, attributeName ) || has_attribute( nextElements, attributeName ) ||
+               has_attribute( previousElements, attributeName );
+    }
+
+    // Discards the cached chains and neighbors that include the given node
+    void evict( const MObjectHandle& node ) {
+        evict( chains, node );
+        evict( nextElements, node );
+        evict( previousElements, node );
+    }
+
+  private:
+    template <class Map>
+    static bool has_attribute( const Map& entries, const std::string& attributeName ) {
+        for( typename Map::const_iterator it = entries.begin(); it != entries.end(); ++it ) {
+            if( it->first.first == attributeName )
+                return true;
+        }
+        return false;
+    }
+
+    template <class Map>
+    static void evict( Map& entries, const MObjectHandle& node ) {
+        typename Map::iterator it = entries.begin();
+        while( it != entries.end() ) {
+            typename Map::mapped_type& bucket = it->second;
+            for( std::size_t i = 0; i < bucket.size(); ) {
+                if( bucket[i].contains( node ) )
+                    bucket.erase( bucket.begin() + i );
+                else
+                    ++i;
+            }
+
+            if( bucket.empty() )
+                entries.erase( it++ );
+            else
+                ++it;
+        }
+    }
+};
+
+stream_chain_cache& get_stream_chain_cache() {
+    static stream_chain_cache cache;
+    return cache;
 }
 
-MObject PRTObjectBase::getEndOfStreamChain( const MFnDependencyNode& depNode, MString outParticleStreamAttr ) {
+void walk_stream_chain( const MFnDependencyNode& depNode, const MString& outParticleStreamAttr,
+                        std::vector<MObject>& outChain ) {
     MStatus stat;
 
-    MPlug streamPlug = depNode.findPlug( outParticleStreamAttr, &stat );
+    outChain.clear();
+    outChain.push_back( depNode.object() );
+
+    // The stream attribute is a static attribute of each node type, so its lookups are cached per type
+    const attribute_accessor streamAttribute( outParticleStreamAttr );
+    MPlug streamPlug = streamAttribute.get_plug( depNode, &stat );
     if( stat != MStatus::kSuccess ) {
-        return depNode.object();
+        return;
     }
 
     // Traverse the connections graph
@@ -89,7 +159,7 @@ MObject PRTObjectBase::getEndOfStreamChain( const MFnDependencyNode& depNode, MS
                 continue;
             }
 
-            nextPlug = nextDepNode.findPlug( outParticleStreamAttr, &stat );
+            nextPlug = streamAttribute.get_plug( nextDepNode, &stat );
 
             if( stat == MStatus::kSuccess ) {
                 // We found a dependency node with the required attribute,
@@ -100,28 +170,59 @@ MObject PRTObjectBase::getEndOfStreamChain( const MFnDependencyNode& depNode, MS
 
         // We only want to continue here if we actually found a new node with the required attribute
         // at this level, otherwise, we're done.
-        if( stat == MStatus::kSuccess ) {
-            streamPlug = nextPlug;
-            streamPlug.connectedTo( plugs, false, true );
-        } else {
-            return streamPlug.node();
+        if( stat != MStatus::kSuccess )
+            return;
+
+        // Stop if the connections loop back into the chain
+        MObject nextObject = nextPlug.node();
+        if( std::find( outChain.begin(), outChain.end(), nextObject ) != outChain.end() )
+            return;
+
+        outChain.push_back( nextObject );
+        streamPlug = nextPlug;
+        streamPlug.connectedTo( plugs, false, true );
+    }
+}
+
+// Returns the cached chain that starts at depNode, walking and caching it first if it is not cached or one of its nodes
+// has been deleted
+const stream_chain_entry& get_cached_stream_chain( stream_chain_cache& cache, const MFnDependencyNode& depNode,
+                                                   const MString& outParticleStreamAttr ) {
+    const MObjectHandle sourceHandle( depNode.object() );
+    std::vector<stream_chain_entry>& bucket =
+        cache.chains[std::make_pair( std::string( outParticleStreamAttr.asChar() ), sourceHandle.hashCode() )];
+
+    for( std::vector<stream_chain_entry>::iterator it = bucket.begin(); it != bucket.end(); ++it ) {
+        if( it->source == sourceHandle ) {
+            if( it->is_valid() )
+                return *it;
+            bucket.erase( it );
+            break;
         }
     }
 
-    return streamPlug.node();
+    std::vector<MObject> chain;
+    walk_stream_chain( depNode, outParticleStreamAttr, chain );
+
+    stream_chain_entry entry;
+    entry.source = sourceHandle;
+    entry.chain.assign( chain.begin(), chain.end() );
+    bucket.push_back( entry );
+    return bucket.back();
 }
 
-MObject PRTObjectBase::nextElementInChain( const MFnDependencyNode& depNode, MString outParticleStreamAttr ) {
+// Gets the first node connected to a stream attribute, downstream for an output attribute or upstream for an input
+MObject find_stream_neighbor( const MFnDependencyNode& depNode, const MString& particleStreamAttr, bool upstream ) {
     MStatus stat;
 
-    MPlug streamPlug = depNode.findPlug( outParticleStreamAttr, &stat );
+    MPlug streamPlug = attribute_accessor( particleStreamAttr ).get_plug( depNode, &stat );
     if( stat != MStatus::kSuccess ) {
         return MObject::kNullObj;
     }
 
     // Traverse the connections graph
     MPlugArray plugs;
-    streamPlug.connectedTo( plugs, false, true );
+    streamPlug.connectedTo( plugs, upstream, !upstream );
     if( plugs.length() > 0 ) {
         MObject currentObject = plugs[0].node( &stat );
         MFnDependencyNode nextDepNode( currentObject, &stat );
@@ -132,31 +233,250 @@ MObject PRTObjectBase::nextElementInChain( const MFnDependencyNode& depNode, MSt
     return MObject::kNullObj;
 }
 
-MObject PRTObjectBase::previousElementInChain( const MFnDependencyNode& depNode, MString inParticleStreamAttr ) {
+MObject get_stream_neighbor( stream_neighbor_map_t& neighbors, const MFnDependencyNode& depNode,
+                             const MString& particleStreamAttr, bool upstream ) {
+    const MObjectHandle sourceHandle( depNode.object() );
+    std::vector<stream_neighbor_entry>& bucket =
+        neighbors[std::make_pair( std::string( particleStreamAttr.asChar() ), sourceHandle.hashCode() )];
+
+    for( std::vector<stream_neighbor_entry>::iterator it = bucket.begin(); it != bucket.end(); ++it ) {
+        if( it->source == sourceHandle ) {
+            if( !it->hasNeighbor )
+                return MObject::kNullObj;
+            if( it->neighbor.isValid() )
+                return it->neighbor.object();
+            bucket.erase( it );
+            break;
+        }
+    }
+
+    MObject neighbor = find_stream_neighbor( depNode, particleStreamAttr, upstream );
+
+    stream_neighbor_entry entry;
+    entry.source = sourceHandle;
+    entry.hasNeighbor = !neighbor.isNull();
+    if( entry.hasNeighbor )
+        entry.neighbor = MObjectHandle( neighbor );
+    bucket.push_back( entry );
+
+    return neighbor;
+}
+
+// A chain only changes when a connection to or from one of its stream attributes is made or broken, and then only the
+// chains and neighbors that pass through one of the connected nodes change.  Deleting a node breaks its connections, so
+// that is handled here too.
+void stream_chain_connection_callback( MPlug& srcPlug, MPlug& destPlug, bool /*made*/, void* /*clientData*/ ) {
+    stream_chain_cache& cache = get_stream_chain_cache();
+    if( cache.empty() )
+        return;
+
+    const std::string srcAttributeName( MFnAttribute( srcPlug.attribute() ).name().asChar() );
+    const std::string destAttributeName( MFnAttribute( destPlug.attribute() ).name().asChar() );
+    if( cache.uses_attribute( srcAttributeName ) || cache.uses_attribute( destAttributeName ) ) {
+        cache.evict( MObjectHandle( srcPlug.node() ) );
+        cache.evict( MObjectHandle( destPlug.node() ) );
+    }
+}
+
+void stream_chain_scene_callback( void* /*clientData*/ ) { PRTObjectBase::invalidateStreamChainCache(); }
+
+// Called by plugin_manager::unregister_all(), after which nothing invalidates the cached chains
+void deactivate_stream_chain_cache() {
+    stream_chain_cache& cache = get_stream_chain_cache();
+    cache.isActive = false;
+    cache.clear();
+}
+
+MPxParticleStream* get_particle_stream_mpx_data( const MFnDependencyNode& depNode,
+                                                 const MString& outParticleStreamAttr ) {
     MStatus stat;
 
-    MPlug streamPlug = depNode.findPlug( inParticleStreamAttr, &stat );
-    if( stat != MStatus::kSuccess ) {
-        return MObject::kNullObj;
+    MPlug plug = attribute_accessor( outParticleStreamAttr ).get_plug( depNode, &stat );
+    if( stat != MStatus::kSuccess )
+        throw std::runtime_error( ( "DEBUG: could not find plug '" + outParticleStreamAttr + "' from depNode '" +
+                                    depNode.name() + "': " + stat.errorString() )
+                                      .asChar() );
+
+    MObject prtMpxData;
+    plug.getValue( prtMpxData );
+    MFnPluginData fnData( prtMpxData );
+    MPxParticleStream* streamMPxData = frantic::maya::mpx_cast<MPxParticleStream*>( fnData.data( &stat ) );
+
+    if( stat != MStatus::kSuccess || streamMPxData == NULL )
+        throw std::runtime_error( ( "DEBUG: could not get MPxParticleStream from '" + outParticleStreamAttr +
+                                    "' from depNode '" + depNode.name() + "': " + stat.errorString() )
+                                      .asChar() );
+
+    return streamMPxData;
+}
+
+} // namespace
+
+frantic::particles::streams::particle_istream_ptr
+particle_stream_source::getRenderParticleStream( const frantic::graphics::transform4f& objectSpace,
+                                                 const frantic::maya::particles::particle_culling_region& region,
+                                                 const MDGContext& context ) const {
+    frantic::particles::streams::particle_istream_ptr stream = getRenderParticleStream( objectSpace, context );
+    if( !stream || region.keeps_all() ) {
+        return stream;
     }
+    return frantic::particles::streams::particle_istream_ptr(
+        new frantic::maya::particles::region_culling_particle_istream( stream, region ) );
+}
 
-    // Traverse the connections graph
-    MPlugArray plugs;
-    streamPlug.connectedTo( plugs, true, false );
-    if( plugs.length() > 0 ) {
-        MObject currentObject = plugs[0].node( &stat );
-        MFnDependencyNode nextDepNode( currentObject, &stat );
-        if( stat == MStatus::kSuccess )
-            return currentObject;
+void particle_stream_source::getParticleStreamStatistics(
+    const frantic::graphics::transform4f& objectSpace, frantic::maya::particles::particle_stream_statistics& outStats,
+    const MDGContext& context ) const {
+    frantic::particles::streams::particle_istream_ptr stream = getRenderParticleStream( objectSpace, context );
+    frantic::maya::particles::compute_particle_stream_statistics( *stream, outStats );
+    stream->close();
+}
+
+PRTObjectBase::particle_istream_ptr
+PRTObjectBase::getViewportParticleStream( const frantic::graphics::transform4f& objectSpace,
+                                          const MDGContext& context ) const {
+    particle_istream_ptr renderStream = getRenderParticleStream( objectSpace, context );
+
+    // Subclasses that can subsample more cheaply at the source should override this method.  The generic fallback
+    // still reads every particle, but only converts and returns the displayed ones.
+    const double fraction = getViewportFraction( context );
+    const boost::int64_t limit = getViewportLimit( context );
+    if( !renderStream || ( fraction >= 1.0 && limit < 0 ) )
+        return renderStream;
+
+    return particle_istream_ptr( new particles::viewport_particle_istream( renderStream, fraction, limit ) );
+}
+
+double PRTObjectBase::getViewportFraction( const MDGContext& /*context*/ ) const { return 1.0; }
+
+boost::int64_t PRTObjectBase::getViewportLimit( const MDGContext& /*context*/ ) const { return -1; }
+
+void PRTObjectBase::getMotionSampledParticleStreams( const frantic::graphics::transform4f& objectSpace,
+                                                     const std::vector<double>& sampleOffsets,
+                                                     std::vector<particle_istream_ptr>& outStreams,
+                                                     const MDGContext& context ) const {
+    MTime time;
+    context.getTime( time );
+
+    outStreams.clear();
+    outStreams.reserve( sampleOffsets.size() );
+    for( std::vector<double>::const_iterator it = sampleOffsets.begin(); it != sampleOffsets.end(); ++it ) {
+        MDGContext sampleContext( time + MTime( *it, MTime::uiUnit() ) );
+        outStreams.push_back( getRenderParticleStream( objectSpace, sampleContext ) );
     }
+}
 
-    return MObject::kNullObj;
+PRTObjectBase::particle_istream_ptr
+PRTObjectBase::getFinalParticleStream( const MFnDependencyNode& depNode,
+                                       const frantic::graphics::transform4f& objectSpace, const MDGContext& context,
+                                       bool isViewport, MString outParticleStreamAttr ) {
+    MStatus stat;
+
+    // Get the dependency node at the end of the chain
+    MObject finalNode = getEndOfStreamChain( depNode, outParticleStreamAttr );
+    if( stat != MStatus::kSuccess )
+        throw std::runtime_error( ( "DEBUG: could not find end of chain using attribute '" + outParticleStreamAttr +
+                                    "' from depNode '" + depNode.name() + "': " + stat.errorString() )
+                                      .asChar() );
+
+    // Extract the final Particle Stream Data
+    return getParticleStreamFromMPxData( finalNode, objectSpace, context, isViewport, outParticleStreamAttr );
+}
+
+PRTObjectBase::particle_istream_ptr
+PRTObjectBase::getFinalParticleStream( const MFnDependencyNode& depNode,
+                                       const frantic::graphics::transform4f& objectSpace,
+                                       const frantic::maya::particles::particle_culling_region& region,
+                                       const MDGContext& context, MString outParticleStreamAttr ) {
+    MObject finalNode = getEndOfStreamChain( depNode, outParticleStreamAttr );
+    return getParticleStreamFromMPxData( finalNode, objectSpace, region, context, outParticleStreamAttr );
+}
+
+PRTObjectBase::particle_istream_ptr PRTObjectBase::getParticleStreamFromMPxData(
+    const MFnDependencyNode& depNode, const frantic::graphics::transform4f& objectSpace, const MDGContext& context,
+    bool isViewport, MString outParticleStreamAttr ) {
+    MPxParticleStream* streamMPxData = get_particle_stream_mpx_data( depNode, outParticleStreamAttr );
+
+    frantic::particles::streams::particle_istream_ptr outStream;
+    if( isViewport )
+        outStream = streamMPxData->getViewportParticleStream( objectSpace, context );
+    else
+        outStream = streamMPxData->getRenderParticleStream( objectSpace, context );
+
+    return outStream;
+}
+
+PRTObjectBase::particle_istream_ptr PRTObjectBase::getParticleStreamFromMPxData(
+    const MFnDependencyNode& depNode, const frantic::graphics::transform4f& objectSpace,
+    const frantic::maya::particles::particle_culling_region& region, const MDGContext& context,
+    MString outParticleStreamAttr ) {
+    MPxParticleStream* streamMPxData = get_particle_stream_mpx_data( depNode, outParticleStreamAttr );
+    return streamMPxData->getRenderParticleStream( objectSpace, region, context );
+}
+
+MObject PRTObjectBase::getEndOfStreamChain( const MFnDependencyNode& depNode, MString outParticleStreamAttr ) {
+    stream_chain_cache& cache = get_stream_chain_cache();
+    if( !cache.isActive ) {
+        std::vector<MObject> chain;
+        walk_stream_chain( depNode, outParticleStreamAttr, chain );
+        return chain.back();
+    }
+
+    return get_cached_stream_chain( cache, depNode, outParticleStreamAttr ).chain.back().object();
+}
+
+void PRTObjectBase::getStreamChain( const MFnDependencyNode& depNode, std::vector<MObject>& outChain,
+                                    MString outParticleStreamAttr ) {
+    stream_chain_cache& cache = get_stream_chain_cache();
+    if( !cache.isActive ) {
+        walk_stream_chain( depNode, outParticleStreamAttr, outChain );
+        return;
+    }
+
+    get_cached_stream_chain( cache, depNode, outParticleStreamAttr ).get_chain( outChain );
+}
+
+MStatus PRTObjectBase::registerStreamChainCallbacks( plugin_manager& pluginManager ) {
+    using namespace std; // For CHECK_MSTATUS_AND_RETURN_IT
+    MStatus status;
+
+    invalidateStreamChainCache();
+
+    status = pluginManager.register_connection_callback( &stream_chain_connection_callback );
+    CHECK_MSTATUS_AND_RETURN_IT( status );
+    status = pluginManager.register_callback<detail::register_callback_t>( MSceneMessage::kBeforeNew,
+                                                                            &stream_chain_scene_callback );
+    CHECK_MSTATUS_AND_RETURN_IT( status );
+    status = pluginManager.register_callback<detail::register_callback_t>( MSceneMessage::kBeforeOpen,
+                                                                            &stream_chain_scene_callback );
+    CHECK_MSTATUS_AND_RETURN_IT( status );
+    status = pluginManager.register_unload_function( &deactivate_stream_chain_cache, _T("stream chain cache") );
+    CHECK_MSTATUS_AND_RETURN_IT( status );
+
+    get_stream_chain_cache().isActive = true;
+    return MS::kSuccess;
+}
+
+void PRTObjectBase::invalidateStreamChainCache() { get_stream_chain_cache().clear(); }
+
+MObject PRTObjectBase::nextElementInChain( const MFnDependencyNode& depNode, MString outParticleStreamAttr ) {
+    stream_chain_cache& cache = get_stream_chain_cache();
+    if( !cache.isActive )
+        return find_stream_neighbor( depNode, outParticleStreamAttr, false );
+    return get_stream_neighbor( cache.nextElements, depNode, outParticleStreamAttr, false );
+}
+
+MObject PRTObjectBase::previousElementInChain( const MFnDependencyNode& depNode, MString inParticleStreamAttr ) {
+    stream_chain_cache& cache = get_stream_chain_cache();
+    if( !cache.isActive )
+        return find_stream_neighbor( depNode, inParticleStreamAttr, true );
+    return get_stream_neighbor( cache.previousElements, depNode, inParticleStreamAttr, true );
 }
 
 bool PRTObjectBase::hasParticleStreamMPxData( const MFnDependencyNode& depNode, MString outParticleStreamAttr ) {
     MStatus stat;
 
-    MPlug plug = depNode.findPlug( outParticleStreamAttr, &stat );
+    MPlug plug = attribute_accessor( outParticleStreamAttr ).get_plug( depNode, &stat );
     if( stat != MStatus::kSuccess )
         return false;
 
@@ -0,0 +1,265 @@
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+#include "stdafx.h"
+
+#include <frantic/maya/attributes.hpp>
+
+#include <maya/MFnAttribute.h>
+#include <maya/MTypeId.h>
+
+#include <map>
+#include <string>
+
+namespace frantic {
+namespace maya {
+
+namespace {
+
+// What the first node of a type that was looked up had for an attribute name
+struct cached_attribute {
+    // The static attribute, or a null object if it is dynamic or absent
+    MObject attribute;
+    // True if the attribute was a dynamic attribute
+    bool isDynamic;
+
+    cached_attribute( const MObject& attribute, bool isDynamic )
+        : attribute( attribute )
+        , isDynamic( isDynamic ) {}
+};
+
+// Maps a node type's MTypeId and an attribute name to what the type has for that attribute
+typedef std::map<std::pair<unsigned int, std::string>, cached_attribute> attribute_map_t;
+
+struct attribute_cache {
+    attribute_map_t attributes;
+    // The number of static attributes of each node type, by MTypeId, to tell whether a node has dynamic attributes
+    std::map<unsigned int, unsigned int> staticAttributeCounts;
+
+    void clear() {
+        attributes.clear();
+        staticAttributeCounts.clear();
+    }
+};
+
+attribute_cache& get_attribute_cache() {
+    static attribute_cache cache;
+    return cache;
+}
+
+unsigned int count_static_attributes( const MFnDependencyNode& node ) {
+    unsigned int count = 0;
+    const unsigned int attributeCount = node.attributeCount();
+    for( unsigned int i = 0; i < attributeCount; ++i ) {
+        MStatus stat;
+        MFnAttribute fnAttribute( node.attribute( i ), &stat );
+        if( stat && !fnAttribute.isDynamic() )
+            ++count;
+    }
+    return count;
+}
+
+// Returns false if node has only the static attributes of its type, in which case findPlug cannot find an attribute
+// that is not one of them
+bool has_dynamic_attributes( const MFnDependencyNode& node, const MTypeId& typeId ) {
+    std::map<unsigned int, unsigned int>& counts = get_attribute_cache().staticAttributeCounts;
+
+    std::map<unsigned int, unsigned int>::const_iterator it = counts.find( typeId.id() );
+    if( it == counts.end() )
+        it = counts.insert( std::make_pair( typeId.id(), count_static_attributes( node ) ) ).first;
+
+    return node.attributeCount() > it->second;
+}
+
+} // anonymous namespace
+
+attribute_accessor::attribute_accessor( const MString& attributeName )
+    : m_attributeName( attributeName ) {}
+
+attribute_accessor::~attribute_accessor() {}
+
+void attribute_accessor::clear_cache() { get_attribute_cache().clear(); }
+
+MPlug attribute_accessor::get_plug( const MFnDependencyNode& node, MStatus* outStatus ) const {
+    MStatus stat;
+    const MTypeId typeId = node.typeId( &stat );
+    return get_plug( node, typeId, stat == MS::kSuccess, outStatus );
+}
+
+MPlug attribute_accessor::get_plug( const MFnDependencyNode& node, const MTypeId& typeId, bool hasTypeId,
+                                    MStatus* outStatus ) const {
+    MStatus stat;
+
+    if( hasTypeId ) {
+        attribute_map_t& attributes = get_attribute_cache().attributes;
+        const attribute_map_t::key_type key( typeId.id(), std::string( m_attributeName.asChar() ) );
+
+        attribute_map_t::const_iterator it = attributes.find( key );
+        if( it == attributes.end() ) {
+            MObject attribute = node.attribute( m_attributeName, &stat );
+            if( !stat )
+                attribute = MObject::kNullObj;
+            const bool isDynamic = !attribute.isNull() && MFnAttribute( attribute ).isDynamic();
+            if( isDynamic )
+                attribute = MObject::kNullObj;
+            it = attributes.insert( std::make_pair( key, cached_attribute( attribute, isDynamic ) ) ).first;
+        }
+
+        if( !it->second.attribute.isNull() ) {
+            if( outStatus != NULL )
+                *outStatus = MS::kSuccess;
+            return MPlug( node.object(), it->second.attribute );
+        }
+
+        // Absent from this type, so it can only be found on a node that has had attributes added to it
+        if( !it->second.isDynamic && !has_dynamic_attributes( node, typeId ) ) {
+            if( outStatus != NULL )
+                *outStatus = MS::kInvalidParameter;
+            return MPlug();
+        }
+    }
+
+    // Dynamic attribute, or a node without a type id
+    return node.findPlug( m_attributeName, outStatus );
+}
+
+float attribute_accessor::get_float( const MFnDependencyNode& node, const MDGContext& context,
+                                     MStatus* outStatus ) const {
+    MStatus stat;
+    MPlug plug = get_plug( node, &stat );
+    if( outStatus != NULL )
+        *outStatus = stat;
+    if( !stat )
+        return 0.0f;
+    return plug.asFloat( const_cast<MDGContext&>( context ), outStatus );
+}
+
+int attribute_accessor::get_int( const MFnDependencyNode& node, const MDGContext& context, MStatus* outStatus ) const {
+    MStatus stat;
+    MPlug plug = get_plug( node, &stat );
+    if( outStatus != NULL )
+        *outStatus = stat;
+    if( !stat )
+        return 0;
+    return plug.asInt( const_cast<MDGContext&>( context ), outStatus );
+}
+
+bool attribute_accessor::get_boolean( const MFnDependencyNode& node, const MDGContext& context,
+                                      MStatus* outStatus ) const {
+    return get_int( node, context, outStatus ) != 0;
+}
+
+MString attribute_accessor::get_string( const MFnDependencyNode& node, const MDGContext& context,
+                                        MStatus* outStatus ) const {
+    MStatus stat;
+    MPlug plug = get_plug( node, &stat );
+    if( outStatus != NULL )
+        *outStatus = stat;
+    if( !stat )
+        return MString();
+    return plug.asString( const_cast<MDGContext&>( context ), outStatus );
+}
+
+MString attribute_accessor::get_enum( const MFnDependencyNode& node, const MDGContext& context,
+                                      MStatus* outStatus ) const {
+    MStatus stat;
+    MPlug plug = get_plug( node, &stat );
+    if( stat && !plug.attribute().hasFn( MFn::kEnumAttribute ) )
+        stat = MS::kInvalidParameter;
+    if( outStatus != NULL )
+        *outStatus = stat;
+    if( !stat )
+        return MString();
+
+    const short value = plug.asShort( const_cast<MDGContext&>( context ), &stat );
+    if( !stat ) {
+        if( outStatus != NULL )
+            *outStatus = stat;
+        return MString();
+    }
+
+    MFnEnumAttribute fnEnum( plug.attribute() );
+    return fnEnum.fieldName( value, outStatus );
+}
+
+MAngle attribute_accessor::get_angle( const MFnDependencyNode& node, const MDGContext& context,
+                                      MStatus* outStatus ) const {
+    MStatus stat;
+    MPlug plug = get_plug( node, &stat );
+    if( outStatus != NULL )
+        *outStatus = stat;
+    if( !stat )
+        return MAngle();
+    return plug.asMAngle( const_cast<MDGContext&>( context ), outStatus );
+}
+
+frantic::graphics::color3f attribute_accessor::get_color( const MFnDependencyNode& node, const MDGContext& context,
+                                                          MStatus* outStatus ) const {
+    MStatus stat;
+    MPlug plug = get_plug( node, &stat );
+    if( outStatus != NULL )
+        *outStatus = stat;
+
+    frantic::graphics::color3f result;
+    if( stat && plug.numChildren() == 3 ) {
+        result.r = plug.child( 0 ).asFloat( const_cast<MDGContext&>( context ) );
+        result.g = plug.child( 1 ).asFloat( const_cast<MDGContext&>( context ) );
+        result.b = plug.child( 2 ).asFloat( const_cast<MDGContext&>( context ) );
+    }
+
+    return result;
+}
+
+attribute_set::attribute_set( const std::vector<MString>& attributeNames ) {
+    for( std::vector<MString>::const_iterator it = attributeNames.begin(); it != attributeNames.end(); ++it ) {
+        add( *it );
+    }
+}
+
+std::size_t attribute_set::add( const MString& attributeName ) {
+    m_accessors.push_back( boost::shared_ptr<attribute_accessor>( new attribute_accessor( attributeName ) ) );
+    return m_accessors.size() - 1;
+}
+
+bool attribute_set::get_plugs( const MFnDependencyNode& node, std::vector<MPlug>& outPlugs ) const {
+    bool result = true;
+
+    MStatus typeStatus;
+    const MTypeId typeId = node.typeId( &typeStatus );
+
+    outPlugs.resize( m_accessors.size() );
+    for( std::size_t i = 0; i < m_accessors.size(); ++i ) {
+        MStatus stat;
+        outPlugs[i] = m_accessors[i]->get_plug( node, typeId, typeStatus == MS::kSuccess, &stat );
+        if( !stat ) {
+            outPlugs[i] = MPlug();
+            result = false;
+        }
+    }
+
+    return result;
+}
+
+bool attribute_set::get_doubles( const MFnDependencyNode& node, std::vector<double>& outValues,
+                                 const MDGContext& context ) const {
+    std::vector<MPlug> plugs;
+    bool result = get_plugs( node, plugs );
+
+    outValues.resize( plugs.size() );
+    for( std::size_t i = 0; i < plugs.size(); ++i ) {
+        outValues[i] = 0.0;
+        if( plugs[i].isNull() )
+            continue;
+
+        MStatus stat;
+        const double value = plugs[i].asDouble( const_cast<MDGContext&>( context ), &stat );
+        if( stat )
+            outValues[i] = value;
+        else
+            result = false;
+    }
+
+    return result;
+}
+
+} // namespace maya
+} // namespace frantic
@@ -0,0 +1,1181 @@
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+#include "stdafx.h"
+
+#include <frantic/maya/geometry/color_graph.hpp>
+
+#if defined( WIN32 ) && defined( NDEBUG )
+#include <intrin.h>
+#pragma intrinsic( _BitScanForward )
+#endif
+
+#include <atomic>
+#include <cassert>
+#include <limits>
+#include <stack>
+#include <stdexcept>
+#include <vector>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_sort.h>
+
+namespace frantic {
+namespace maya {
+namespace geometry {
+
+using boost::uint32_t;
+
+// adjacency_list functions
+void adjacency_list::soft_insert( uint32_t left, uint32_t right ) {
+    // Ensure there is enough space in the vector
+    const uint32_t larger = std::max( left, right ) + 1;
+    const size_t size = m_softEntries.size();
+    if( larger >= size ) {
+        m_softEntries.resize( larger );
+        m_hardEntries.resize( larger ); // We need to keep these two vectors the same size
+        for( size_t i = size; i < larger; ++i ) {
+            m_softEntries[i].reserve( 4 );
+        }
+    } else if( m_softEntries[larger - 1].capacity() < 4 ) {
+        m_softEntries[larger - 1].reserve( 4 );
+    }
+
+    // Insert the elements
+    m_softEntries[left].push_back( right );
+    m_softEntries[right].push_back( left );
+}
+
+void adjacency_list::hard_insert( uint32_t left, uint32_t right ) {
+    // Ensure there is enough space in the vector
+    const uint32_t larger = std::max( left, right ) + 1;
+    const size_t size = m_hardEntries.size();
+    if( larger >= size ) {
+        m_softEntries.resize( larger ); // We need to keep these two vectors the same size
+        m_hardEntries.resize( larger );
+        for( size_t i = size; i < larger; ++i ) {
+            m_hardEntries[i].reserve( 4 );
+        }
+    } else if( m_hardEntries[larger - 1].capacity() < 4 ) {
+        m_hardEntries[larger - 1].reserve( 4 );
+    }
+
+    // Insert the elements
+    m_hardEntries[left].push_back( right );
+    m_hardEntries[right].push_back( left );
+}
+
+// Check bounds (See below)
+size_t adjacency_list::size() const {
+    assert( m_softEntries.size() == m_hardEntries.size() && "Entries must be same size!" );
+    return m_softEntries.size();
+}
+
+// group_list
+// Used to keep track of which groups the nodes belong to,
+// as well as the relationships between groups
+// NOTE: Group 0 is the default group: everything belongs to it in the beginning and nothing belongs to it in the end
+struct group_list {
+    typedef boost::unordered_set<uint32_t> set; // TODO: std::set<u32> might be faster, need to check
+    typedef boost::unordered_map<uint32_t, set> map;
+    typedef map::const_iterator map_iterator;
+    typedef std::vector<uint32_t>::const_iterator const_iterator;
+
+    std::vector<uint32_t> groups;               // Each index represents a node, the element its group
+    std::vector<std::vector<uint32_t>> members; // Each index represents a group, the elements its members
+    map softNodes;
+    map hardNodes;
+    uint32_t _min;
+    uint32_t _max; // The biggest and smallest group
+
+    explicit group_list( int numFaces );
+
+    inline bool has( uint32_t node ) const;
+    inline uint32_t get( uint32_t node ) const;
+
+    inline void join( uint32_t node, uint32_t group );
+
+    // These keep track of the number and bounds (groups don't need to start at 1) of the groups
+    inline uint32_t min() const;
+    inline uint32_t max() const;
+
+    inline uint32_t num_faces() const;
+};
+
+// Reserves memory for an unordered hashable data structure (unordered_map or unordered_set)
+// TODO: unordered map and set have reserve() member functions as of Boost 1.50
+template <typename T>
+void unordered_reserve( T& unordered, size_t numElems ) {
+    const size_t numBuckets = ( (size_t)( numElems / unordered.max_load_factor() ) ) + 1;
+    unordered.rehash( numBuckets );
+}
+
+group_list::group_list( int numFaces )
+    : groups( numFaces, 0 )
+    , _min( 0 )
+    , _max( 0 ) {
+    unordered_reserve( softNodes, numFaces );
+    unordered_reserve( hardNodes, numFaces );
+    members.reserve( numFaces );
+}
+
+inline bool group_list::has( uint32_t node ) const {
+    // Check if node is in the default group
+    return groups[node] != 0;
+}
+
+inline uint32_t group_list::get( uint32_t node ) const { return groups[node]; }
+
+// Assigns node a group, and includes all of its edges into the group
+inline void group_list::join( uint32_t node, uint32_t group ) {
+    // Assign the node the current group
+    groups[node] = group;
+
+    // Make sure there's enough space in members
+    const size_t size = members.size();
+    const size_t reqSize = group + 1;
+    if( reqSize >= size ) {
+        if( reqSize >= members.capacity() ) {
+            members.reserve( group + group / 2 + 7 ); // Get at least 8 members into the array when reserving
+        }
+        members.resize( reqSize );
+        for( size_t i = size; i < reqSize; ++i ) {
+            members[i].reserve( 4 );
+        }
+    }
+    members[group].push_back( node );
+
+    // Update group maxs and mins
+    if( _min == 0 && _max == 0 ) {
+        _min = _max = group;
+    } else if( _min > group ) {
+        _min = group;
+    } else if( _max < group ) {
+        _max = group;
+    }
+}
+
+inline uint32_t group_list::min() const { return _min; }
+inline uint32_t group_list::max() const { return _max; }
+
+inline uint32_t group_list::num_faces() const { return (uint32_t)groups.size(); }
+
+// collapsed_cmp
+// This is the functor used to compare groups while sorting
+struct collapsed_cmp {
+    const adjacency_list& edges;
+
+    explicit collapsed_cmp( const adjacency_list& edges )
+        : edges( edges ) {}
+
+    inline bool operator()( const uint32_t& lhs, const uint32_t& rhs ) const;
+};
+
+// Compare by number of soft edges a group hases, and use hard edges as a tie-breaker
+bool collapsed_cmp::operator()( const uint32_t& lhs, const uint32_t& rhs ) const {
+    const size_t ssize1 = edges.soft_count( lhs );
+    const size_t ssize2 = edges.soft_count( rhs );
+    return ssize1 < ssize2 || ( ssize1 == ssize2 && edges.hard_count( lhs ) < edges.hard_count( rhs ) );
+}
+
+/**
+ * Checks if a node can be safely added to a group
+ *
+ * @param begin
+ * @param end
+ * @param edges
+ * @param group
+ * @param groups
+ * @return false if adding the node would break things
+ */
+inline bool has_set_intersection( const adjacency_list::const_iterator& begin,
+                                  const adjacency_list::const_iterator& end, const group_list::set& edges,
+                                  uint32_t group, group_list& groups ) {
+    const size_t edgesSize = edges.size();
+    if( edgesSize == 0 ) {
+        // Every lookup will return edges.end(), so might as well bail out
+        return true;
+    }
+
+    adjacency_list::const_iterator it;
+    for( it = begin; it != end; ++it ) {
+        const uint32_t current = *it;
+
+        if( groups.groups[current] != group ) {
+
+            if( edges.find( current ) != edges.end() ) {
+                return false;
+            }
+
+            // Check the group of current to make sure there is no bad blood
+            const uint32_t groupNumber = groups.get( current );
+            if( groupNumber != 0 && groupNumber != group ) {
+                // TODO: Use boost::disjoint_set?
+                group_list::const_iterator git;
+
+                const std::vector<uint32_t>& members = groups.members[groupNumber];
+                for( git = members.begin(); git != members.end(); ++git ) {
+                    if( edges.find( *git ) != edges.end() ) {
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// Checks to see if the given graph_node is compatible with the given collapsed_node
+inline bool node_check_merge( uint32_t node, uint32_t group, const adjacency_list& inputs, group_list& groups,
+                              adjacency_list& outputs ) {
+    // node cannot have soft nodes that have a hard edge with result
+    if( !has_set_intersection( inputs.soft_begin( node ), inputs.soft_end( node ), groups.hardNodes[group], group,
+                               groups ) )
+        return false;
+    // node cannot have hard nodes that have a soft edge with result
+    if( !has_set_intersection( inputs.hard_begin( node ), inputs.hard_end( node ), groups.softNodes[group], group,
+                               groups ) )
+        return false;
+
+    return true;
+}
+
+// Go through the graph to find all
+inline void visit( uint32_t node, uint32_t group, const adjacency_list& inputs, group_list& groups,
+                   adjacency_list& outputs ) {
+    // TODO: Remember bad nodes?
+
+    // Use this stack to do a DFS
+    std::stack<uint32_t> to_visit;
+    to_visit.push( node );
+
+    group_list::set& softNodes = groups.softNodes[group];
+    group_list::set& hardNodes = groups.hardNodes[group];
+
+    while( to_visit.size() > 0 ) {
+        uint32_t current = to_visit.top();
+        to_visit.pop();
+
+        // If current has no group, attempt to merge
+        if( !groups.has( current ) && node_check_merge( current, group, inputs, groups, outputs ) ) {
+            const size_t softSize = inputs.soft_count( current );
+            const size_t hardSize = inputs.hard_count( current );
+
+            // Merge groups
+            adjacency_list::const_iterator it;
+            for( it = inputs.soft_begin( current ); it != inputs.soft_end( current ); ++it ) {
+                const uint32_t next = *it;
+                const uint32_t groupNumber = groups.get( next );
+                if( groupNumber == 0 ) {
+                    // Add all of its soft nodes without a group to the stack to check
+                    to_visit.push( next );
+                } else if( groupNumber != group ) {
+                    outputs.soft_insert( group, groupNumber );
+                }
+            }
+
+            for( it = inputs.hard_begin( current ); it != inputs.hard_end( current ); ++it ) {
+                const uint32_t next = *it;
+                const uint32_t groupNumber = groups.get( next );
+                if( groupNumber != 0 && groupNumber != group ) {
+                    outputs.hard_insert( group, groupNumber );
+                }
+            }
+
+            groups.join( current, group );
+
+            // Get any new neighbours for result
+            softNodes.insert( inputs.soft_begin( current ), inputs.soft_end( current ) );
+            hardNodes.insert( inputs.hard_begin( current ), inputs.hard_end( current ) );
+
+        } else if( groups.has( current ) && groups.get( current ) != group ) {
+            // This is an unreachable case since a node is only pushed on the stack if it has no group,
+            // and the only group it could have been given since it was pushed on the stack is 'group' (the variable)
+            throw std::runtime_error( std::string( "Error in visit() - " __FILE__ "@" ) +
+                                      boost::lexical_cast<std::string>( __LINE__ ) + ": Unreachable" );
+        }
+        // If 'current' has a group and it is equal to 'group', then it was done while waiting in the stack.
+    }
+}
+
+// Collapse the nodes into a simplfied graph we can colour
+inline adjacency_list collapse_graph( const adjacency_list& inputs, group_list& groups ) {
+    uint32_t id = 1; // Starts at 1, 0 means no group
+    adjacency_list outputs( groups.num_faces() );
+    // Iterate through each input and collapse it
+    unsigned i;
+    for( i = 0; i < inputs.size(); ++i ) {
+        // Only visit if it doesn't already have a group
+        if( !groups.has( i ) ) {
+            uint32_t groupNumber = id++;
+            visit( i, groupNumber, inputs, groups, outputs );
+        }
+    }
+
+    for( ; i < groups.num_faces(); ++i ) {
+        uint32_t groupNumber = id++;
+        groups.join( i, groupNumber );
+    }
+
+    // Make sure that the output has a vector to represent each node, even if it's empty
+    uint32_t numGroups = groups.max() + 1;
+    outputs.soft_ensure( numGroups );
+    outputs.hard_ensure( numGroups );
+
+    return outputs;
+}
+
+// Cross-platform wrapper for counting trailing zeros, undefined if mask is 0
+inline uint32_t ctz( uint32_t mask ) {
+    unsigned long index;
+#if defined( WIN32 ) || defined( WIN64 )
+    _BitScanForward( &index, mask );
+#else
+    index = __builtin_ctz( mask );
+#endif
+
+    return (uint32_t)index; // Index is less than 32, so the cast is fine
+}
+
+// This makes finding a flag fast
+inline boost::uint32_t next_flag( boost::uint32_t mask ) {
+    if( mask != ~0 ) {
+        unsigned long index = ctz( ~mask );
+        return (boost::uint32_t)1 << index;
+    }
+    return 0;
+}
+
+// The main function call
+void color_graph( const adjacency_list& inputs, uint32_t numFaces, std::vector<uint32_t>& out ) {
+    if( inputs.size() == 0 ) {
+        // This is necessary to prevent the zero face case from crashing,
+        // but it's helpful for all cases where there are no connections between nodes
+        out.clear();
+        out.resize( numFaces, 0 );
+        return;
+    }
+
+    group_list groups( numFaces );
+    adjacency_list collapsed = collapse_graph( inputs, groups );
+
+    const size_t size = groups.max() - groups.min() + 1;
+    std::vector<uint32_t> groupOrder;
+    groupOrder.reserve( size );
+    for( uint32_t j = groups.min(); j <= groups.max(); ++j ) {
+        groupOrder.push_back( j );
+    }
+
+    // Sort based on number of soft nodes
+    sort( groupOrder.rbegin(), groupOrder.rend(), collapsed_cmp( collapsed ) );
+
+    // Assign bitflags
+    std::vector<uint32_t>::iterator elem;
+    std::vector<uint32_t> flags( size, 0 );
+    std::vector<uint32_t> result( numFaces );
+    std::pair<adjacency_list::const_iterator, adjacency_list::const_iterator> iters, innerIters;
+    adjacency_list::const_iterator it, innerIt;
+    const uint32_t offset = groups.min(); // RFC:(SBD): Offset, or just pad the vector?
+    for( elem = groupOrder.begin(); elem != groupOrder.end() && collapsed.soft_count( *elem ) > 0; ++elem ) {
+        const uint32_t current = *elem - offset;
+        uint32_t bannedFlag = 0;
+
+        // Go through the current nodes hard nodes to find all of the flags it can't have
+        for( it = collapsed.hard_begin( *elem ); it != collapsed.hard_end( *elem ); ++it ) {
+            bannedFlag |= flags[*it - offset];
+        }
+
+        // Go through its soft nodes to assign each pair a flag
+        for( it = collapsed.soft_begin( *elem ); it != collapsed.soft_end( *elem ); ++it ) {
+            const uint32_t visited = *it - offset;
+            uint32_t otherBannedFlag = 0;
+
+            // if false, they already have a flag in common, so we're done here
+            if( ( flags[visited] & flags[current] ) == 0 ) {
+                for( innerIt = collapsed.hard_begin( *it ); innerIt != collapsed.hard_end( *it ); ++innerIt ) {
+                    otherBannedFlag |= flags[*innerIt - offset];
+                }
+
+                uint32_t currentFlag = next_flag( bannedFlag | otherBannedFlag );
+                if( currentFlag != 0 ) {
+                    flags[current] |= currentFlag;
+                    flags[visited] |= currentFlag;
+                } else {
+                    throw std::runtime_error( "Current mesh's topology is too complicated to save smoothing groups" );
+                }
+            }
+        }
+
+        // Assign the flag to all our members
+        const uint32_t flag = flags[current];
+        group_list::const_iterator members;
+        for( members = groups.members[*elem].begin(); members != groups.members[*elem].end(); ++members ) {
+            result[*members] = flag;
+        }
+    }
+
+    // This goes through all the nodes who only have hard nodes and sets their members smoothing groups
+    for( ; elem != groupOrder.end(); ++elem ) {
+        const uint32_t current = *elem - offset;
+        const size_t size = groups.members[*elem].size();
+        if( size <= 1 ) {
+            flags[current] = 0; // Mesh is by itself, all of its edges are hard
+        } else {
+            uint32_t bannedFlag = 0;
+
+            for( it = collapsed.hard_begin( *elem ); it != collapsed.hard_end( *elem ); ++it ) {
+                bannedFlag |= flags[*it - offset];
+            }
+
+            uint32_t flag = next_flag( bannedFlag );
+            if( flag != 0 ) {
+                flags[current] = flag;
+            } else {
+                throw std::runtime_error( "Current mesh's topology is too complicated to save smoothing groups" );
+            }
+        }
+
+        // Assign the flag to all our members
+        const uint32_t flag = flags[current];
+        group_list::const_iterator members;
+        for( members = groups.members[*elem].begin(); members != groups.members[*elem].end(); ++members ) {
+            result[*members] = flag;
+        }
+    }
+
+    out.swap( result );
+}
+
+// parallel_color_graph
+
+typedef std::vector<std::atomic<uint32_t>> atomic_uint32_array;
+
+// Grain size used by the loops over faces, groups and group pairs in parallel_color_graph.
+const std::size_t COLOR_GRAPH_GRAIN_SIZE = 1024;
+
+// Finds the root of node's set in a concurrent union-find forest, halving the path as it goes.
+// Every link points from a larger index to a smaller one, so the root of a set is its smallest member.
+inline uint32_t find_root( atomic_uint32_array& parents, uint32_t node ) {
+    for( ;; ) {
+        uint32_t parent = parents[node].load( std::memory_order_relaxed );
+        if( parent == node ) {
+            return node;
+        }
+        const uint32_t grandparent = parents[parent].load( std::memory_order_relaxed );
+        if( grandparent != parent ) {
+            // If this fails, another thread already moved node closer to its root
+            parents[node].compare_exchange_weak( parent, grandparent );
+        }
+        node = grandparent;
+    }
+}
+
+// Joins the sets of a and b in a concurrent union-find forest, by linking the larger root under the smaller one.
+inline void unite( atomic_uint32_array& parents, uint32_t a, uint32_t b ) {
+    for( ;; ) {
+        a = find_root( parents, a );
+        b = find_root( parents, b );
+        if( a == b ) {
+            return;
+        }
+        if( a < b ) {
+            std::swap( a, b );
+        }
+        uint32_t expected = a;
+        if( parents[a].compare_exchange_strong( expected, b ) ) {
+            return;
+        }
+    }
+}
+
+inline void atomic_min( std::atomic<uint32_t>& target, uint32_t value ) {
+    uint32_t current = target.load( std::memory_order_relaxed );
+    while( value < current && !target.compare_exchange_weak( current, value ) ) {
+    }
+}
+
+// Unites each face with its soft neighbours
+class soft_union_body {
+    const adjacency_list& m_inputs;
+    atomic_uint32_array& m_parents;
+
+    soft_union_body& operator=( const soft_union_body& ); // not implemented
+
+  public:
+    soft_union_body( const adjacency_list& inputs, atomic_uint32_array& parents )
+        : m_inputs( inputs )
+        , m_parents( parents ) {}
+
+    void operator()( const tbb::blocked_range<uint32_t>& range ) const {
+        for( uint32_t i = range.begin(); i != range.end(); ++i ) {
+            for( adjacency_list::const_iterator it = m_inputs.soft_begin( i ); it != m_inputs.soft_end( i ); ++it ) {
+                if( *it > i ) {
+                    unite( m_parents, i, *it );
+                }
+            }
+        }
+    }
+};
+
+// Records the component of each face, as the root of its set
+class component_body {
+    atomic_uint32_array& m_parents;
+    std::vector<uint32_t>& m_components;
+
+    component_body& operator=( const component_body& ); // not implemented
+
+  public:
+    component_body( atomic_uint32_array& parents, std::vector<uint32_t>& components )
+        : m_parents( parents )
+        , m_components( components ) {}
+
+    void operator()( const tbb::blocked_range<uint32_t>& range ) const {
+        for( uint32_t i = range.begin(); i != range.end(); ++i ) {
+            m_components[i] = find_root( m_parents, i );
+        }
+    }
+};
+
+// Marks the components that have a hard edge between two of their faces
+class unclean_component_body {
+    const adjacency_list& m_inputs;
+    const std::vector<uint32_t>& m_components;
+    std::vector<std::atomic<char>>& m_unclean;
+
+    unclean_component_body& operator=( const unclean_component_body& ); // not implemented
+
+  public:
+    unclean_component_body( const adjacency_list& inputs, const std::vector<uint32_t>& components,
+                            std::vector<std::atomic<char>>& unclean )
+        : m_inputs( inputs )
+        , m_components( components )
+        , m_unclean( unclean ) {}
+
+    void operator()( const tbb::blocked_range<uint32_t>& range ) const {
+        for( uint32_t i = range.begin(); i != range.end(); ++i ) {
+            for( adjacency_list::const_iterator it = m_inputs.hard_begin( i ); it != m_inputs.hard_end( i ); ++it ) {
+                if( m_components[*it] == m_components[i] ) {
+                    m_unclean[m_components[i]].store( 1, std::memory_order_relaxed );
+                    break;
+                }
+            }
+        }
+    }
+};
+
+// Splits the components that have internal hard edges into groups, using the same collapse_graph as color_graph.
+// Each component is collapsed on its own, so they can be processed in parallel.
+class split_component_body {
+    const adjacency_list& m_inputs;
+    const std::vector<uint32_t>& m_componentOffsets;
+    const std::vector<uint32_t>& m_componentFaces;
+    const std::vector<uint32_t>& m_localIndex;
+    std::vector<uint32_t>& m_labels;
+
+    split_component_body& operator=( const split_component_body& ); // not implemented
+
+  public:
+    split_component_body( const adjacency_list& inputs, const std::vector<uint32_t>& componentOffsets,
+                          const std::vector<uint32_t>& componentFaces, const std::vector<uint32_t>& localIndex,
+                          std::vector<uint32_t>& labels )
+        : m_inputs( inputs )
+        , m_componentOffsets( componentOffsets )
+        , m_componentFaces( componentFaces )
+        , m_localIndex( localIndex )
+        , m_labels( labels ) {}
+
+    void operator()( const tbb::blocked_range<std::size_t>& range ) const {
+        for( std::size_t c = range.begin(); c != range.end(); ++c ) {
+            const uint32_t* faces = &m_componentFaces[m_componentOffsets[c]];
+            const uint32_t count = m_componentOffsets[c + 1] - m_componentOffsets[c];
+
+            // Hard edges that leave the component never prevent a merge, so only the edges inside it are kept. The
+            // connections keep their order, since collapse_graph visits them in that order and is much slower on
+            // some orders than others.
+            adjacency_list local( count );
+            local.soft_ensure( count );
+            local.hard_ensure( count );
+            for( uint32_t i = 0; i < count; ++i ) {
+                const uint32_t face = faces[i];
+                adjacency_list::const_iterator it;
+                for( it = m_inputs.soft_begin( face ); it != m_inputs.soft_end( face ); ++it ) {
+                    local.soft_push_back( i, m_localIndex[*it] );
+                }
+                for( it = m_inputs.hard_begin( face ); it != m_inputs.hard_end( face ); ++it ) {
+                    if( m_localIndex[*it] < count && faces[m_localIndex[*it]] == *it ) {
+                        local.hard_push_back( i, m_localIndex[*it] );
+                    }
+                }
+            }
+
+            group_list groups( count );
+            collapse_graph( local, groups );
+
+            // Label each face with the first, and smallest, face of its group
+            for( uint32_t group = groups.min(); group <= groups.max(); ++group ) {
+                const std::vector<uint32_t>& members = groups.members[group];
+                if( !members.empty() ) {
+                    const uint32_t label = faces[members.front()];
+                    for( group_list::const_iterator it = members.begin(); it != members.end(); ++it ) {
+                        m_labels[faces[*it]] = label;
+                    }
+                }
+            }
+        }
+    }
+};
+
+// The connections between groups, stored as compressed rows: the neighbours of group g are
+// entries[offsets[g]] to entries[ends[g]].
+struct collapsed_rows {
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> ends;
+    std::vector<uint32_t> entries;
+
+    uint32_t count( uint32_t group ) const { return ends[group] - offsets[group]; }
+    const uint32_t* begin( uint32_t group ) const { return entries.empty() ? NULL : &entries[0] + offsets[group]; }
+    const uint32_t* end( uint32_t group ) const { return entries.empty() ? NULL : &entries[0] + ends[group]; }
+};
+
+// Counts (when filling is false) or gathers (when filling is true) the connections between the groups of each face
+class collapse_edges_body {
+    const adjacency_list& m_inputs;
+    const std::vector<uint32_t>& m_groups;
+    atomic_uint32_array& m_softCounts;
+    atomic_uint32_array& m_hardCounts;
+    collapsed_rows* m_soft;
+    collapsed_rows* m_hard;
+    std::vector<std::atomic<char>>* m_internal;
+
+    collapse_edges_body& operator=( const collapse_edges_body& ); // not implemented
+
+  public:
+    collapse_edges_body( const adjacency_list& inputs, const std::vector<uint32_t>& groups,
+                         atomic_uint32_array& softCounts, atomic_uint32_array& hardCounts, collapsed_rows* soft,
+                         collapsed_rows* hard, std::vector<std::atomic<char>>* internal )
+        : m_inputs( inputs )
+        , m_groups( groups )
+        , m_softCounts( softCounts )
+        , m_hardCounts( hardCounts )
+        , m_soft( soft )
+        , m_hard( hard )
+        , m_internal( internal ) {}
+
+    void operator()( const tbb::blocked_range<uint32_t>& range ) const {
+        for( uint32_t i = range.begin(); i != range.end(); ++i ) {
+            const uint32_t group = m_groups[i];
+            adjacency_list::const_iterator it;
+            for( it = m_inputs.soft_begin( i ); it != m_inputs.soft_end( i ); ++it ) {
+                const uint32_t other = m_groups[*it];
+                if( other != group ) {
+                    const uint32_t slot = m_softCounts[group].fetch_add( 1, std::memory_order_relaxed );
+                    if( m_soft ) {
+                        m_soft->entries[m_soft->offsets[group] + slot] = other;
+                    }
+                } else if( m_internal ) {
+                    ( *m_internal )[group].store( 1, std::memory_order_relaxed );
+                }
+            }
+            for( it = m_inputs.hard_begin( i ); it != m_inputs.hard_end( i ); ++it ) {
+                const uint32_t slot = m_hardCounts[group].fetch_add( 1, std::memory_order_relaxed );
+                if( m_hard ) {
+                    m_hard->entries[m_hard->offsets[group] + slot] = m_groups[*it];
+                }
+            }
+        }
+    }
+};
+
+// Sorts each row and removes duplicate connections, so that the rows no longer depend on thread scheduling
+class sort_rows_body {
+    collapsed_rows& m_rows;
+
+    sort_rows_body& operator=( const sort_rows_body& ); // not implemented
+
+  public:
+    explicit sort_rows_body( collapsed_rows& rows )
+        : m_rows( rows ) {}
+
+    void operator()( const tbb::blocked_range<uint32_t>& range ) const {
+        for( uint32_t group = range.begin(); group != range.end(); ++group ) {
+            uint32_t* begin = &m_rows.entries[0] + m_rows.offsets[group];
+            uint32_t* end = &m_rows.entries[0] + m_rows.ends[group];
+            std::sort( begin, end );
+            m_rows.ends[group] = static_cast<uint32_t>( std::unique( begin, end ) - &m_rows.entries[0] );
+        }
+    }
+};
+
+// Orders groups by their number of soft connections, then by their number of hard connections, like collapsed_cmp.
+// Ties are broken by the group index, so the order is always the same.
+struct collapsed_rows_cmp {
+    const collapsed_rows& soft;
+    const collapsed_rows& hard;
+
+    collapsed_rows_cmp( const collapsed_rows& soft, const collapsed_rows& hard )
+        : soft( soft )
+        , hard( hard ) {}
+
+    bool operator()( uint32_t lhs, uint32_t rhs ) const {
+        const uint32_t ssize1 = soft.count( lhs );
+        const uint32_t ssize2 = soft.count( rhs );
+        if( ssize1 != ssize2 ) {
+            return ssize1 > ssize2;
+        }
+        const uint32_t hsize1 = hard.count( lhs );
+        const uint32_t hsize2 = hard.count( rhs );
+        if( hsize1 != hsize2 ) {
+            return hsize1 > hsize2;
+        }
+        return lhs < rhs;
+    }
+};
+
+// Scrambles the bits of an index. It is a bijection, so distinct indices stay distinct.
+inline uint32_t scramble_index( uint32_t x ) {
+    x ^= x >> 16;
+    x *= 0x85ebca6bu;
+    x ^= x >> 13;
+    x *= 0xc2b2ae35u;
+    x ^= x >> 16;
+    return x;
+}
+
+// Orders requests so that those of the most connected groups come first, as in color_graph. Among requests of equally
+// connected groups, the order is scrambled. If it followed the order of the groups, which tends to follow the surface
+// of the mesh, long chains of conflicting requests would form, and each round would settle only a few of them.
+struct request_priority_cmp {
+    const std::vector<uint32_t>& softCounts;
+
+    explicit request_priority_cmp( const std::vector<uint32_t>& softCounts )
+        : softCounts( softCounts ) {}
+
+    bool operator()( uint32_t lhs, uint32_t rhs ) const {
+        if( softCounts[lhs] != softCounts[rhs] ) {
+            return softCounts[lhs] > softCounts[rhs];
+        }
+        return scramble_index( lhs ) < scramble_index( rhs );
+    }
+};
+
+// The pairs of groups that must share a flag. A pair of a group with itself requests a flag for a group that has
+// several faces but no soft connection to another group.
+struct flag_requests {
+    std::vector<uint32_t> first;
+    std::vector<uint32_t> second;
+    std::vector<uint32_t> flag; // the flag picked in the current round, or 0 if the request is not pending
+    collapsed_rows byGroup;     // the requests that involve each group, in order of priority
+};
+
+class pick_flags_body {
+    const collapsed_rows& m_hard;
+    const std::vector<uint32_t>& m_pending;
+    flag_requests& m_requests;
+    atomic_uint32_array& m_flags;
+    atomic_uint32_array& m_tentativeFlags;
+    atomic_uint32_array& m_tentativeMin;
+    std::atomic<bool>& m_failed;
+
+    pick_flags_body& operator=( const pick_flags_body& ); // not implemented
+
+    uint32_t banned_flags( uint32_t group ) const {
+        uint32_t banned = 0;
+        for( const uint32_t* it = m_hard.begin( group ); it != m_hard.end( group ); ++it ) {
+            banned |= m_flags[*it].load( std::memory_order_relaxed );
+        }
+        return banned;
+    }
+
+  public:
+    pick_flags_body( const collapsed_rows& hard, const std::vector<uint32_t>& pending, flag_requests& requests,
+                     atomic_uint32_array& flags, atomic_uint32_array& tentativeFlags,
+                     atomic_uint32_array& tentativeMin, std::atomic<bool>& failed )
+        : m_hard( hard )
+        , m_pending( pending )
+        , m_requests( requests )
+        , m_flags( flags )
+        , m_tentativeFlags( tentativeFlags )
+        , m_tentativeMin( tentativeMin )
+        , m_failed( failed ) {}
+
+    void operator()( const tbb::blocked_range<std::size_t>& range ) const {
+        for( std::size_t r = range.begin(); r != range.end(); ++r ) {
+            const uint32_t request = m_pending[r];
+            const uint32_t a = m_requests.first[request];
+            const uint32_t b = m_requests.second[request];
+
+            m_requests.flag[request] = 0;
+
+            // If they already have a flag in common, the request is satisfied
+            if( a != b &&
+                ( m_flags[a].load( std::memory_order_relaxed ) & m_flags[b].load( std::memory_order_relaxed ) ) != 0 ) {
+                continue;
+            }
+
+            const uint32_t banned = banned_flags( a ) | ( a != b ? banned_flags( b ) : 0 );
+            const uint32_t flag = next_flag( banned );
+            if( flag == 0 ) {
+                m_failed.store( true, std::memory_order_relaxed );
+                continue;
+            }
+
+            m_requests.flag[request] = flag;
+            m_tentativeFlags[a].fetch_or( flag, std::memory_order_relaxed );
+            m_tentativeFlags[b].fetch_or( flag, std::memory_order_relaxed );
+            atomic_min( m_tentativeMin[a], request );
+            atomic_min( m_tentativeMin[b], request );
+        }
+    }
+};
+
+// A request keeps its flag unless a hard neighbour of one of its groups was given the same flag in this round by a
+// request with a higher priority (a lower index).
+class resolve_flags_body {
+    const collapsed_rows& m_hard;
+    const std::vector<uint32_t>& m_pending;
+    const flag_requests& m_requests;
+    const atomic_uint32_array& m_tentativeFlags;
+    const atomic_uint32_array& m_tentativeMin;
+    std::vector<char>& m_lost;
+
+    resolve_flags_body& operator=( const resolve_flags_body& ); // not implemented
+
+    bool conflicts( uint32_t group, uint32_t request, uint32_t flag ) const {
+        for( const uint32_t* it = m_hard.begin( group ); it != m_hard.end( group ); ++it ) {
+            // Check the neighbour's own requests only if it could have been given this flag by one of them first
+            if( ( m_tentativeFlags[*it].load( std::memory_order_relaxed ) & flag ) != 0 &&
+                m_tentativeMin[*it].load( std::memory_order_relaxed ) < request ) {
+                const uint32_t* other = m_requests.byGroup.begin( *it );
+                const uint32_t* otherEnd = m_requests.byGroup.end( *it );
+                for( ; other != otherEnd && *other < request; ++other ) {
+                    if( m_requests.flag[*other] == flag ) {
+                        return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+  public:
+    resolve_flags_body( const collapsed_rows& hard, const std::vector<uint32_t>& pending,
+                        const flag_requests& requests, const atomic_uint32_array& tentativeFlags,
+                        const atomic_uint32_array& tentativeMin, std::vector<char>& lost )
+        : m_hard( hard )
+        , m_pending( pending )
+        , m_requests( requests )
+        , m_tentativeFlags( tentativeFlags )
+        , m_tentativeMin( tentativeMin )
+        , m_lost( lost ) {}
+
+    void operator()( const tbb::blocked_range<std::size_t>& range ) const {
+        for( std::size_t r = range.begin(); r != range.end(); ++r ) {
+            const uint32_t request = m_pending[r];
+            const uint32_t flag = m_requests.flag[request];
+            m_lost[r] = flag != 0 && ( conflicts( m_requests.first[request], request, flag ) ||
+                                       conflicts( m_requests.second[request], request, flag ) );
+        }
+    }
+};
+
+// Commits the flags of the requests that kept them, and clears the tentative state of every pending request
+class commit_flags_body {
+    const std::vector<uint32_t>& m_pending;
+    flag_requests& m_requests;
+    const std::vector<char>& m_lost;
+    atomic_uint32_array& m_flags;
+    atomic_uint32_array& m_tentativeFlags;
+    atomic_uint32_array& m_tentativeMin;
+
+    commit_flags_body& operator=( const commit_flags_body& ); // not implemented
+
+  public:
+    commit_flags_body( const std::vector<uint32_t>& pending, flag_requests& requests,
+                       const std::vector<char>& lost, atomic_uint32_array& flags, atomic_uint32_array& tentativeFlags,
+                       atomic_uint32_array& tentativeMin )
+        : m_pending( pending )
+        , m_requests( requests )
+        , m_lost( lost )
+        , m_flags( flags )
+        , m_tentativeFlags( tentativeFlags )
+        , m_tentativeMin( tentativeMin ) {}
+
+    void operator()( const tbb::blocked_range<std::size_t>& range ) const {
+        for( std::size_t r = range.begin(); r != range.end(); ++r ) {
+            const uint32_t request = m_pending[r];
+            const uint32_t a = m_requests.first[request];
+            const uint32_t b = m_requests.second[request];
+            const uint32_t flag = m_requests.flag[request];
+            if( flag != 0 && !m_lost[r] ) {
+                m_flags[a].fetch_or( flag, std::memory_order_relaxed );
+                m_flags[b].fetch_or( flag, std::memory_order_relaxed );
+            }
+            m_requests.flag[request] = 0;
+            m_tentativeFlags[a].store( 0, std::memory_order_relaxed );
+            m_tentativeFlags[b].store( 0, std::memory_order_relaxed );
+            m_tentativeMin[a].store( std::numeric_limits<uint32_t>::max(), std::memory_order_relaxed );
+            m_tentativeMin[b].store( std::numeric_limits<uint32_t>::max(), std::memory_order_relaxed );
+        }
+    }
+};
+
+class face_flags_body {
+    const std::vector<uint32_t>& m_groups;
+    const atomic_uint32_array& m_flags;
+    std::vector<uint32_t>& m_result;
+
+    face_flags_body& operator=( const face_flags_body& ); // not implemented
+
+  public:
+    face_flags_body( const std::vector<uint32_t>& groups, const atomic_uint32_array& flags,
+                     std::vector<uint32_t>& result )
+        : m_groups( groups )
+        , m_flags( flags )
+        , m_result( result ) {}
+
+    void operator()( const tbb::blocked_range<uint32_t>& range ) const {
+        for( uint32_t i = range.begin(); i != range.end(); ++i ) {
+            m_result[i] = m_flags[m_groups[i]].load( std::memory_order_relaxed );
+        }
+    }
+};
+
+// Converts counts into offsets, and resets the counts so they can be used as cursors
+inline void make_rows( atomic_uint32_array& counts, collapsed_rows& rows ) {
+    const std::size_t numGroups = counts.size();
+    rows.offsets.resize( numGroups + 1 );
+    rows.ends.resize( numGroups );
+    uint32_t total = 0;
+    for( std::size_t g = 0; g < numGroups; ++g ) {
+        rows.offsets[g] = total;
+        total += counts[g].load( std::memory_order_relaxed );
+        rows.ends[g] = total;
+        counts[g].store( 0, std::memory_order_relaxed );
+    }
+    rows.offsets[numGroups] = total;
+    rows.entries.resize( total );
+}
+
+void parallel_color_graph( const adjacency_list& inputs, uint32_t numFaces, std::vector<uint32_t>& out,
+                           bool deterministic ) {
+    const uint32_t numNodes = static_cast<uint32_t>( std::min<std::size_t>( inputs.size(), numFaces ) );
+    if( numNodes == 0 ) {
+        out.clear();
+        out.resize( numFaces, 0 );
+        return;
+    }
+
+    const tbb::blocked_range<uint32_t> nodeRange( 0, numNodes, COLOR_GRAPH_GRAIN_SIZE );
+
+    // Find the soft-connected components. Each is labelled by its smallest face.
+    std::vector<uint32_t> components( numNodes );
+    std::vector<std::atomic<char>> unclean( numNodes );
+    {
+        atomic_uint32_array parents( numNodes );
+        for( uint32_t i = 0; i < numNodes; ++i ) {
+            parents[i].store( i, std::memory_order_relaxed );
+            unclean[i].store( 0, std::memory_order_relaxed );
+        }
+        tbb::parallel_for( nodeRange, soft_union_body( inputs, parents ) );
+        tbb::parallel_for( nodeRange, component_body( parents, components ) );
+    }
+    tbb::parallel_for( nodeRange, unclean_component_body( inputs, components, unclean ) );
+
+    // A component without hard edges inside it is a single group, labelled by its smallest face. The others are
+    // collapsed as color_graph does, and each of their groups is labelled by its smallest face.
+    std::vector<uint32_t> labels( components );
+    {
+        std::vector<uint32_t> componentSlots( numNodes, 0 );
+        std::vector<uint32_t> componentOffsets( 1, 0 );
+        for( uint32_t i = 0; i < numNodes; ++i ) {
+            if( components[i] == i && unclean[i].load( std::memory_order_relaxed ) ) {
+                componentSlots[i] = static_cast<uint32_t>( componentOffsets.size() - 1 );
+                componentOffsets.push_back( 0 );
+            }
+        }
+
+        const std::size_t numUnclean = componentOffsets.size() - 1;
+        if( numUnclean > 0 ) {
+            for( uint32_t i = 0; i < numNodes; ++i ) {
+                if( unclean[components[i]].load( std::memory_order_relaxed ) ) {
+                    ++componentOffsets[componentSlots[components[i]] + 1];
+                }
+            }
+            for( std::size_t c = 0; c < numUnclean; ++c ) {
+                componentOffsets[c + 1] += componentOffsets[c];
+            }
+
+            // Faces are visited in order, so the faces of each component are sorted
+            std::vector<uint32_t> componentFaces( componentOffsets.back() );
+            std::vector<uint32_t> localIndex( numNodes, 0 );
+            std::vector<uint32_t> cursors( componentOffsets.begin(), componentOffsets.end() - 1 );
+            for( uint32_t i = 0; i < numNodes; ++i ) {
+                if( unclean[components[i]].load( std::memory_order_relaxed ) ) {
+                    const uint32_t slot = componentSlots[components[i]];
+                    localIndex[i] = cursors[slot] - componentOffsets[slot];
+                    componentFaces[cursors[slot]++] = i;
+                }
+            }
+
+            tbb::parallel_for( tbb::blocked_range<std::size_t>( 0, numUnclean ),
+                               split_component_body( inputs, componentOffsets, componentFaces, localIndex, labels ) );
+        }
+    }
+
+    // Number the groups in the order of their smallest face. A face's label is never larger than the face.
+    std::vector<uint32_t> groups( numNodes );
+    uint32_t numGroups = 0;
+    for( uint32_t i = 0; i < numNodes; ++i ) {
+        groups[i] = labels[i] == i ? numGroups++ : groups[labels[i]];
+    }
+
+    const tbb::blocked_range<uint32_t> groupRange( 0, numGroups, COLOR_GRAPH_GRAIN_SIZE );
+
+    // Gather the soft and hard connections between groups
+    collapsed_rows softRows;
+    collapsed_rows hardRows;
+    std::vector<std::atomic<char>> internal( numGroups );
+    {
+        atomic_uint32_array softCounts( numGroups );
+        atomic_uint32_array hardCounts( numGroups );
+        for( uint32_t g = 0; g < numGroups; ++g ) {
+            softCounts[g].store( 0, std::memory_order_relaxed );
+            hardCounts[g].store( 0, std::memory_order_relaxed );
+            internal[g].store( 0, std::memory_order_relaxed );
+        }
+        tbb::parallel_for( nodeRange,
+                           collapse_edges_body( inputs, groups, softCounts, hardCounts, NULL, NULL, &internal ) );
+        make_rows( softCounts, softRows );
+        make_rows( hardCounts, hardRows );
+        tbb::parallel_for( nodeRange, collapse_edges_body( inputs, groups, softCounts, hardCounts, &softRows,
+                                                           &hardRows, NULL ) );
+    }
+    if( deterministic ) {
+        tbb::parallel_for( groupRange, sort_rows_body( softRows ) );
+        tbb::parallel_for( groupRange, sort_rows_body( hardRows ) );
+    }
+
+    // Order the groups as color_graph does, most connected first, and list the pairs that need a common flag. The
+    // requests are then sorted by request_priority_cmp, and the position of a request is its priority.
+    std::vector<uint32_t> groupOrder( numGroups );
+    std::vector<uint32_t> groupRank( numGroups );
+    for( uint32_t g = 0; g < numGroups; ++g ) {
+        groupOrder[g] = g;
+    }
+    tbb::parallel_sort( groupOrder.begin(), groupOrder.end(), collapsed_rows_cmp( softRows, hardRows ) );
+    for( uint32_t k = 0; k < numGroups; ++k ) {
+        groupRank[groupOrder[k]] = k;
+    }
+
+    std::vector<uint32_t> pairFirst;
+    std::vector<uint32_t> pairSecond;
+    std::vector<uint32_t> pairSoftCounts;
+    for( uint32_t k = 0; k < numGroups; ++k ) {
+        const uint32_t group = groupOrder[k];
+        for( const uint32_t* it = softRows.begin( group ); it != softRows.end( group ); ++it ) {
+            if( groupRank[*it] > k ) {
+                pairFirst.push_back( group );
+                pairSecond.push_back( *it );
+                pairSoftCounts.push_back( softRows.count( group ) );
+            }
+        }
+    }
+    for( uint32_t k = 0; k < numGroups; ++k ) {
+        const uint32_t group = groupOrder[k];
+        if( softRows.count( group ) == 0 && internal[group].load( std::memory_order_relaxed ) ) {
+            pairFirst.push_back( group );
+            pairSecond.push_back( group );
+            pairSoftCounts.push_back( 0 );
+        }
+    }
+
+    std::vector<uint32_t> pairOrder( pairFirst.size() );
+    for( std::size_t r = 0; r < pairOrder.size(); ++r ) {
+        pairOrder[r] = static_cast<uint32_t>( r );
+    }
+    tbb::parallel_sort( pairOrder.begin(), pairOrder.end(), request_priority_cmp( pairSoftCounts ) );
+
+    flag_requests requests;
+    requests.first.resize( pairOrder.size() );
+    requests.second.resize( pairOrder.size() );
+    for( std::size_t r = 0; r < pairOrder.size(); ++r ) {
+        requests.first[r] = pairFirst[pairOrder[r]];
+        requests.second[r] = pairSecond[pairOrder[r]];
+    }
+    requests.flag.resize( requests.first.size(), 0 );
+
+    // Index the requests by group, so that conflicts can be traced to the request that caused them
+    {
+        atomic_uint32_array requestCounts( numGroups );
+        for( uint32_t g = 0; g < numGroups; ++g ) {
+            requestCounts[g].store( 0, std::memory_order_relaxed );
+        }
+        for( std::size_t r = 0; r < requests.first.size(); ++r ) {
+            ++requestCounts[requests.first[r]];
+            if( requests.second[r] != requests.first[r] ) {
+                ++requestCounts[requests.second[r]];
+            }
+        }
+        make_rows( requestCounts, requests.byGroup );
+        for( std::size_t r = 0; r < requests.first.size(); ++r ) {
+            const uint32_t a = requests.first[r];
+            const uint32_t b = requests.second[r];
+            requests.byGroup.entries[requests.byGroup.offsets[a] + requestCounts[a]++] = static_cast<uint32_t>( r );
+            if( b != a ) {
+                requests.byGroup.entries[requests.byGroup.offsets[b] + requestCounts[b]++] = static_cast<uint32_t>( r );
+            }
+        }
+    }
+
+    // Assign the flags in speculative rounds
+    atomic_uint32_array flags( numGroups );
+    atomic_uint32_array tentativeFlags( numGroups );
+    atomic_uint32_array tentativeMin( numGroups );
+    for( uint32_t g = 0; g < numGroups; ++g ) {
+        flags[g].store( 0, std::memory_order_relaxed );
+        tentativeFlags[g].store( 0, std::memory_order_relaxed );
+        tentativeMin[g].store( std::numeric_limits<uint32_t>::max(), std::memory_order_relaxed );
+    }
+
+    std::vector<uint32_t> pending( requests.first.size() );
+    for( std::size_t r = 0; r < pending.size(); ++r ) {
+        pending[r] = static_cast<uint32_t>( r );
+    }
+    std::vector<char> lost;
+    std::atomic<bool> failed( false );
+    while( !pending.empty() ) {
+        const tbb::blocked_range<std::size_t> pendingRange( 0, pending.size(), COLOR_GRAPH_GRAIN_SIZE );
+        lost.assign( pending.size(), 0 );
+
+        tbb::parallel_for( pendingRange, pick_flags_body( hardRows, pending, requests, flags, tentativeFlags,
+                                                          tentativeMin, failed ) );
+        if( failed.load() ) {
+            throw std::runtime_error( "Current mesh's topology is too complicated to save smoothing groups" );
+        }
+        tbb::parallel_for( pendingRange,
+                           resolve_flags_body( hardRows, pending, requests, tentativeFlags, tentativeMin, lost ) );
+        tbb::parallel_for( pendingRange,
+                           commit_flags_body( pending, requests, lost, flags, tentativeFlags, tentativeMin ) );
+
+        std::size_t next = 0;
+        for( std::size_t r = 0; r < pending.size(); ++r ) {
+            if( lost[r] ) {
+                pending[next++] = pending[r];
+            }
+        }
+        pending.resize( next );
+    }
+
+    std::vector<uint32_t> result( numFaces, 0 );
+    tbb::parallel_for( nodeRange, face_flags_body( groups, flags, result ) );
+
+    out.swap( result );
+}
+
+} // namespace geometry
+} // namespace maya
+} // namespace frantic
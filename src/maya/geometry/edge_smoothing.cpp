@@ -4,11 +4,6 @@
 
 #include <frantic/maya/geometry/edge_smoothing.hpp>
 
-#if defined( WIN32 ) && defined( NDEBUG )
-#include <intrin.h>
-#pragma intrinsic( _BitScanForward )
-#endif
-
 #include <iostream>
 #include <set>
 #include <stack>
@@ -37,426 +32,6 @@ namespace geometry {
 
 using boost::uint32_t;
 
-// adjacency_list functions
-void adjacency_list::soft_insert( uint32_t left, uint32_t right ) {
-    // Ensure there is enough space in the vector
-    const uint32_t larger = std::max( left, right ) + 1;
-    const size_t size = m_softEntries.size();
-    if( larger >= size ) {
-        m_softEntries.resize( larger );
-        m_hardEntries.resize( larger ); // We need to keep these two vectors the same size
-        for( size_t i = size; i < larger; ++i ) {
-            m_softEntries[i].reserve( 4 );
-        }
-    } else if( m_softEntries[larger - 1].capacity() < 4 ) {
-        m_softEntries[larger - 1].reserve( 4 );
-    }
-
-    // Insert the elements
-    m_softEntries[left].push_back( right );
-    m_softEntries[right].push_back( left );
-}
-
-void adjacency_list::hard_insert( uint32_t left, uint32_t right ) {
-    // Ensure there is enough space in the vector
-    const uint32_t larger = std::max( left, right ) + 1;
-    const size_t size = m_hardEntries.size();
-    if( larger >= size ) {
-        m_softEntries.resize( larger ); // We need to keep these two vectors the same size
-        m_hardEntries.resize( larger );
-        for( size_t i = size; i < larger; ++i ) {
-            m_hardEntries[i].reserve( 4 );
-        }
-    } else if( m_hardEntries[larger - 1].capacity() < 4 ) {
-        m_hardEntries[larger - 1].reserve( 4 );
-    }
-
-    // Insert the elements
-    m_hardEntries[left].push_back( right );
-    m_hardEntries[right].push_back( left );
-}
-
-// Check bounds (See below)
-size_t adjacency_list::size() const {
-    assert( m_softEntries.size() == m_hardEntries.size() && "Entries must be same size!" );
-    return m_softEntries.size();
-}
-
-// group_list
-// Used to keep track of which groups the nodes belong to,
-// as well as the relationships between groups
-// NOTE: Group 0 is the default group: everything belongs to it in the beginning and nothing belongs to it in the end
-struct group_list {
-    typedef boost::unordered_set<uint32_t> set; // TODO: std::set<u32> might be faster, need to check
-    typedef boost::unordered_map<uint32_t, set> map;
-    typedef map::const_iterator map_iterator;
-    typedef std::vector<uint32_t>::const_iterator const_iterator;
-
-    std::vector<uint32_t> groups;               // Each index represents a node, the element its group
-    std::vector<std::vector<uint32_t>> members; // Each index represents a group, the elements its members
-    map softNodes;
-    map hardNodes;
-    uint32_t _min;
-    uint32_t _max; // The biggest and smallest group
-
-    explicit group_list( int numFaces );
-
-    inline bool has( uint32_t node ) const;
-    inline uint32_t get( uint32_t node ) const;
-
-    inline void join( uint32_t node, uint32_t group );
-
-    // These keep track of the number and bounds (groups don't need to start at 1) of the groups
-    inline uint32_t min() const;
-    inline uint32_t max() const;
-
-    inline uint32_t num_faces() const;
-};
-
-// Reserves memory for an unordered hashable data structure (unordered_map or unordered_set)
-// TODO: unordered map and set have reserve() member functions as of Boost 1.50
-template <typename T>
-void unordered_reserve( T& unordered, size_t numElems ) {
-    const size_t numBuckets = ( (size_t)( numElems / unordered.max_load_factor() ) ) + 1;
-    unordered.rehash( numBuckets );
-}
-
-group_list::group_list( int numFaces )
-    : groups( numFaces, 0 )
-    , _min( 0 )
-    , _max( 0 ) {
-    unordered_reserve( softNodes, numFaces );
-    unordered_reserve( hardNodes, numFaces );
-    members.reserve( numFaces );
-}
-
-inline bool group_list::has( uint32_t node ) const {
-    // Check if node is in the default group
-    return groups[node] != 0;
-}
-
-inline uint32_t group_list::get( uint32_t node ) const { return groups[node]; }
-
-// Assigns node a group, and includes all of its edges into the group
-inline void group_list::join( uint32_t node, uint32_t group ) {
-    // Assign the node the current group
-    groups[node] = group;
-
-    // Make sure there's enough space in members
-    const size_t size = members.size();
-    const size_t reqSize = group + 1;
-    if( reqSize >= size ) {
-        if( reqSize >= members.capacity() ) {
-            members.reserve( group + group / 2 + 7 ); // Get at least 8 members into the array when reserving
-        }
-        members.resize( reqSize );
-        for( size_t i = size; i < reqSize; ++i ) {
-            members[i].reserve( 4 );
-        }
-    }
-    members[group].push_back( node );
-
-    // Update group maxs and mins
-    if( _min == 0 && _max == 0 ) {
-        _min = _max = group;
-    } else if( _min > group ) {
-        _min = group;
-    } else if( _max < group ) {
-        _max = group;
-    }
-}
-
-inline uint32_t group_list::min() const { return _min; }
-inline uint32_t group_list::max() const { return _max; }
-
-inline uint32_t group_list::num_faces() const { return (uint32_t)groups.size(); }
-
-// collapsed_cmp
-// This is the functor used to compare groups while sorting
-struct collapsed_cmp {
-    const adjacency_list& edges;
-
-    explicit collapsed_cmp( const adjacency_list& edges )
-        : edges( edges ) {}
-
-    inline bool operator()( const uint32_t& lhs, const uint32_t& rhs ) const;
-};
-
-// Compare by number of soft edges a group hases, and use hard edges as a tie-breaker
-bool collapsed_cmp::operator()( const uint32_t& lhs, const uint32_t& rhs ) const {
-    const size_t ssize1 = edges.soft_count( lhs );
-    const size_t ssize2 = edges.soft_count( rhs );
-    return ssize1 < ssize2 || ( ssize1 == ssize2 && edges.hard_count( lhs ) < edges.hard_count( rhs ) );
-}
-
-/**
- * Checks if a node can be safely added to a group
- *
- * @param begin
- * @param end
- * @param edges
- * @param group
- * @param groups
- * @return false if adding the node would break things
- */
-inline bool has_set_intersection( const adjacency_list::const_iterator& begin,
-                                  const adjacency_list::const_iterator& end, const group_list::set& edges,
-                                  uint32_t group, group_list& groups ) {
-    const size_t edgesSize = edges.size();
-    if( edgesSize == 0 ) {
-        // Every lookup will return edges.end(), so might as well bail out
-        return true;
-    }
-
-    adjacency_list::const_iterator it;
-    for( it = begin; it != end; ++it ) {
-        const uint32_t current = *it;
-
-        if( groups.groups[current] != group ) {
-
-            if( edges.find( current ) != edges.end() ) {
-                return false;
-            }
-
-            // Check the group of current to make sure there is no bad blood
-            const uint32_t groupNumber = groups.get( current );
-            if( groupNumber != 0 && groupNumber != group ) {
-                // TODO: Use boost::disjoint_set?
-                group_list::const_iterator git;
-
-                const std::vector<uint32_t>& members = groups.members[groupNumber];
-                for( git = members.begin(); git != members.end(); ++git ) {
-                    if( edges.find( *git ) != edges.end() ) {
-                        return false;
-                    }
-                }
-            }
-        }
-    }
-    return true;
-}
-
-// Checks to see if the given graph_node is compatible with the given collapsed_node
-inline bool node_check_merge( uint32_t node, uint32_t group, const adjacency_list& inputs, group_list& groups,
-                              adjacency_list& outputs ) {
-    // node cannot have soft nodes that have a hard edge with result
-    if( !has_set_intersection( inputs.soft_begin( node ), inputs.soft_end( node ), groups.hardNodes[group], group,
-                               groups ) )
-        return false;
-    // node cannot have hard nodes that have a soft edge with result
-    if( !has_set_intersection( inputs.hard_begin( node ), inputs.hard_end( node ), groups.softNodes[group], group,
-                               groups ) )
-        return false;
-
-    return true;
-}
-
-// Go through the graph to find all
-inline void visit( uint32_t node, uint32_t group, const adjacency_list& inputs, group_list& groups,
-                   adjacency_list& outputs ) {
-    // TODO: Remember bad nodes?
-
-    // Use this stack to do a DFS
-    std::stack<uint32_t> to_visit;
-    to_visit.push( node );
-
-    group_list::set& softNodes = groups.softNodes[group];
-    group_list::set& hardNodes = groups.hardNodes[group];
-
-    while( to_visit.size() > 0 ) {
-        uint32_t current = to_visit.top();
-        to_visit.pop();
-
-        // If current has no group, attempt to merge
-        if( !groups.has( current ) && node_check_merge( current, group, inputs, groups, outputs ) ) {
-            const size_t softSize = inputs.soft_count( current );
-            const size_t hardSize = inputs.hard_count( current );
-
-            // Merge groups
-            adjacency_list::const_iterator it;
-            for( it = inputs.soft_begin( current ); it != inputs.soft_end( current ); ++it ) {
-                const uint32_t next = *it;
-                const uint32_t groupNumber = groups.get( next );
-                if( groupNumber == 0 ) {
-                    // Add all of its soft nodes without a group to the stack to check
-                    to_visit.push( next );
-                } else if( groupNumber != group ) {
-                    outputs.soft_insert( group, groupNumber );
-                }
-            }
-
-            for( it = inputs.hard_begin( current ); it != inputs.hard_end( current ); ++it ) {
-                const uint32_t next = *it;
-                const uint32_t groupNumber = groups.get( next );
-                if( groupNumber != 0 && groupNumber != group ) {
-                    outputs.hard_insert( group, groupNumber );
-                }
-            }
-
-            groups.join( current, group );
-
-            // Get any new neighbours for result
-            softNodes.insert( inputs.soft_begin( current ), inputs.soft_end( current ) );
-            hardNodes.insert( inputs.hard_begin( current ), inputs.hard_end( current ) );
-
-        } else if( groups.has( current ) && groups.get( current ) != group ) {
-            // This is an unreachable case since a node is only pushed on the stack if it has no group,
-            // and the only group it could have been given since it was pushed on the stack is 'group' (the variable)
-            throw std::runtime_error( std::string( "Error in visit() - " __FILE__ "@" ) +
-                                      boost::lexical_cast<std::string>( __LINE__ ) + ": Unreachable" );
-        }
-        // If 'current' has a group and it is equal to 'group', then it was done while waiting in the stack.
-    }
-}
-
-// Collapse the nodes into a simplfied graph we can colour
-inline adjacency_list collapse_graph( const adjacency_list& inputs, group_list& groups ) {
-    uint32_t id = 1; // Starts at 1, 0 means no group
-    adjacency_list outputs( groups.num_faces() );
-    // Iterate through each input and collapse it
-    unsigned i;
-    for( i = 0; i < inputs.size(); ++i ) {
-        // Only visit if it doesn't already have a group
-        if( !groups.has( i ) ) {
-            uint32_t groupNumber = id++;
-            visit( i, groupNumber, inputs, groups, outputs );
-        }
-    }
-
-    for( ; i < groups.num_faces(); ++i ) {
-        uint32_t groupNumber = id++;
-        groups.join( i, groupNumber );
-    }
-
-    // Make sure that the output has a vector to represent each node, even if it's empty
-    uint32_t numGroups = groups.max() + 1;
-    outputs.soft_ensure( numGroups );
-    outputs.hard_ensure( numGroups );
-
-    return outputs;
-}
-
-// Cross-platform wrapper for counting trailing zeros, undefined if mask is 0
-inline uint32_t ctz( uint32_t mask ) {
-    unsigned long index;
-#if defined( WIN32 ) || defined( WIN64 )
-    _BitScanForward( &index, mask );
-#else
-    index = __builtin_ctz( mask );
-#endif
-
-    return (uint32_t)index; // Index is less than 32, so the cast is fine
-}
-
-// This makes finding a flag fast
-inline boost::uint32_t next_flag( boost::uint32_t mask ) {
-    if( mask != ~0 ) {
-        unsigned long index = ctz( ~mask );
-        return (boost::uint32_t)1 << index;
-    }
-    return 0;
-}
-
-// The main function call
-void color_graph( const adjacency_list& inputs, uint32_t numFaces, std::vector<uint32_t>& out ) {
-    if( inputs.size() == 0 ) {
-        // This is necessary to prevent the zero face case from crashing,
-        // but it's helpful for all cases where there are no connections between nodes
-        out.clear();
-        out.resize( numFaces, 0 );
-        return;
-    }
-
-    group_list groups( numFaces );
-    adjacency_list collapsed = collapse_graph( inputs, groups );
-
-    const size_t size = groups.max() - groups.min() + 1;
-    std::vector<uint32_t> groupOrder;
-    groupOrder.reserve( size );
-    for( uint32_t j = groups.min(); j <= groups.max(); ++j ) {
-        groupOrder.push_back( j );
-    }
-
-    // Sort based on number of soft nodes
-    sort( groupOrder.rbegin(), groupOrder.rend(), collapsed_cmp( collapsed ) );
-
-    // Assign bitflags
-    std::vector<uint32_t>::iterator elem;
-    std::vector<uint32_t> flags( size, 0 );
-    std::vector<uint32_t> result( numFaces );
-    std::pair<adjacency_list::const_iterator, adjacency_list::const_iterator> iters, innerIters;
-    adjacency_list::const_iterator it, innerIt;
-    const uint32_t offset = groups.min(); // RFC:(SBD): Offset, or just pad the vector?
-    for( elem = groupOrder.begin(); elem != groupOrder.end() && collapsed.soft_count( *elem ) > 0; ++elem ) {
-        const uint32_t current = *elem - offset;
-        uint32_t bannedFlag = 0;
-
-        // Go through the current nodes hard nodes to find all of the flags it can't have
-        for( it = collapsed.hard_begin( *elem ); it != collapsed.hard_end( *elem ); ++it ) {
-            bannedFlag |= flags[*it - offset];
-        }
-
-        // Go through its soft nodes to assign each pair a flag
-        for( it = collapsed.soft_begin( *elem ); it != collapsed.soft_end( *elem ); ++it ) {
-            const uint32_t visited = *it - offset;
-            uint32_t otherBannedFlag = 0;
-
-            // if false, they already have a flag in common, so we're done here
-            if( ( flags[visited] & flags[current] ) == 0 ) {
-                for( innerIt = collapsed.hard_begin( *it ); innerIt != collapsed.hard_end( *it ); ++innerIt ) {
-                    otherBannedFlag |= flags[*innerIt - offset];
-                }
-
-                uint32_t currentFlag = next_flag( bannedFlag | otherBannedFlag );
-                if( currentFlag != 0 ) {
-                    flags[current] |= currentFlag;
-                    flags[visited] |= currentFlag;
-                } else {
-                    throw std::runtime_error( "Current mesh's topology is too complicated to save smoothing groups" );
-                }
-            }
-        }
-
-        // Assign the flag to all our members
-        const uint32_t flag = flags[current];
-        group_list::const_iterator members;
-        for( members = groups.members[*elem].begin(); members != groups.members[*elem].end(); ++members ) {
-            result[*members] = flag;
-        }
-    }
-
-    // This goes through all the nodes who only have hard nodes and sets their members smoothing groups
-    for( ; elem != groupOrder.end(); ++elem ) {
-        const uint32_t current = *elem - offset;
-        const size_t size = groups.members[*elem].size();
-        if( size <= 1 ) {
-            flags[current] = 0; // Mesh is by itself, all of its edges are hard
-        } else {
-            uint32_t bannedFlag = 0;
-
-            for( it = collapsed.hard_begin( *elem ); it != collapsed.hard_end( *elem ); ++it ) {
-                bannedFlag |= flags[*it - offset];
-            }
-
-            uint32_t flag = next_flag( bannedFlag );
-            if( flag != 0 ) {
-                flags[current] = flag;
-            } else {
-                throw std::runtime_error( "Current mesh's topology is too complicated to save smoothing groups" );
-            }
-        }
-
-        // Assign the flag to all our members
-        const uint32_t flag = flags[current];
-        group_list::const_iterator members;
-        for( members = groups.members[*elem].begin(); members != groups.members[*elem].end(); ++members ) {
-            result[*members] = flag;
-        }
-    }
-
-    out.swap( result );
-}
-
 // Each index in the returned vector represents the same index in fnMesh's edges.
 // The index stores a pair, consisting of a pair of intergers representing the vertices,
 // and another vector, containing all of the faces connected to the edge (There should be 1 or 2 if the mesh is
@@ -6,10 +6,12 @@
 
 #include <maya/MAnimControl.h>
 #include <maya/MDagPath.h>
+#include <maya/MFnDagNode.h>
 #include <maya/MFloatArray.h>
 #include <maya/MFloatPointArray.h>
 #include <maya/MFloatVectorArray.h>
 #include <maya/MIntArray.h>
+#include <maya/MObjectHandle.h>
 #include <maya/MPointArray.h>
 #include <maya/MUintArray.h>
 
@@ -20,7 +22,11 @@
 #include <frantic/maya/attributes.hpp>
 #include <frantic/maya/convert.hpp>
 #include <frantic/maya/geometry/edge_smoothing.hpp>
+#include <frantic/maya/geometry/mesh_kernels.hpp>
+#include <frantic/maya/geometry/smoothing_groups.hpp>
 #include <frantic/maya/graphics/maya_space.hpp>
+#include <frantic/maya/logging/batch_progress_logger.hpp>
+#include <frantic/maya/logging/instrumentation.hpp>
 
 #include <frantic/graphics/vector3.hpp>
 #include <frantic/graphics/vector3f.hpp>
@@ -33,13 +39,17 @@
 #include <frantic/diagnostics/profiling_manager.hpp>
 
 #include <boost/algorithm/string.hpp>
-#include <boost/container/flat_set.hpp>
 #include <boost/cstdint.hpp>
-#include <boost/foreach.hpp>
+#include <boost/functional/hash.hpp>
 #include <boost/optional.hpp>
-#include <boost/pending/disjoint_sets.hpp>
 #include <boost/unordered_set.hpp>
 
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include <map>
+#include <vector>
+
 using namespace frantic::geometry;
 using namespace frantic::graphics;
 using namespace frantic::maya;
@@ -108,105 +118,250 @@ boost::optional<boost::int32_t> try_get_constant_smoothing_group( const MFnMesh&
     return boost::optional<boost::int32_t>();
 }
 
-boost::array<int, 2> make_array( int a, int b ) {
-    boost::array<int, 2> result = { a, b };
-    return result;
+// Copies a Maya int array into a std::vector, for the Maya-independent smoothing group engine.
+void copy_int_array( const MIntArray& array, std::vector<int>& outArray ) {
+    outArray.resize( array.length() );
+    if( !outArray.empty() ) {
+        array.get( &outArray[0] );
+    }
 }
 
-// In edgeToFaces, "no face" is indicated by the value -1.
-void get_edge_to_faces( const MFnMesh& fnMesh, std::vector<boost::array<int, 2>>& edgeToFaces ) {
-    MStatus stat;
+// Grain size used when filling Maya arrays from a trimesh3 in parallel.
+const std::size_t MESH_ARRAY_GRAIN_SIZE = 4096;
 
-    MIntArray mayaCounts;
-    MIntArray mayaIndices;
-    fnMesh.getVertices( mayaCounts, mayaIndices );
+/**
+ * Writes the trimesh3 vertices, offset by timeOffset * Velocity when a velocity accessor is supplied, into a
+ * pre-sized MFloatPointArray.
+ */
+class fill_vertex_array_body {
+    const frantic::geometry::trimesh3& m_mesh;
+    const frantic::geometry::const_trimesh3_vertex_channel_cvt_accessor<frantic::graphics::vector3f>* m_velocityAcc;
+    float m_timeOffset;
+    MFloatPointArray& m_vertexArray;
 
-    const int numEdges = fnMesh.numEdges();
-    const int numVerts = fnMesh.numVertices();
-    const int numFaces = fnMesh.numPolygons();
-    const int numFaceVerts = fnMesh.numFaceVertices();
+    fill_vertex_array_body& operator=( const fill_vertex_array_body& ); // not implemented
+
+  public:
+    fill_vertex_array_body(
+        const frantic::geometry::trimesh3& mesh,
+        const frantic::geometry::const_trimesh3_vertex_channel_cvt_accessor<frantic::graphics::vector3f>* velocityAcc,
+        float timeOffset, MFloatPointArray& vertexArray )
+        : m_mesh( mesh )
+        , m_velocityAcc( velocityAcc )
+        , m_timeOffset( timeOffset )
+        , m_vertexArray( vertexArray ) {}
+
+    void operator()( const tbb::blocked_range<std::size_t>& range ) const {
+        if( m_velocityAcc ) {
+            for( std::size_t i = range.begin(); i != range.end(); ++i ) {
+                const frantic::graphics::vector3f v( m_mesh.get_vertex( i ) + m_timeOffset * m_velocityAcc->get( i ) );
+                m_vertexArray[static_cast<unsigned int>( i )] = MFloatPoint( v.x, v.y, v.z );
+            }
+        } else {
+            for( std::size_t i = range.begin(); i != range.end(); ++i ) {
+                const frantic::graphics::vector3f& v = m_mesh.get_vertex( i );
+                m_vertexArray[static_cast<unsigned int>( i )] = MFloatPoint( v.x, v.y, v.z );
+            }
+        }
+    }
+};
+
+// Adapts the trimesh3 geometry faces to the face( faceIndex ) interface used by fill_face_corners.
+class trimesh3_geometry_faces {
+    const frantic::geometry::trimesh3& m_mesh;
+
+    trimesh3_geometry_faces& operator=( const trimesh3_geometry_faces& ); // not implemented
+
+  public:
+    trimesh3_geometry_faces( const frantic::geometry::trimesh3& mesh )
+        : m_mesh( mesh ) {}
+
+    const frantic::graphics::vector3& face( std::size_t faceIndex ) const { return m_mesh.get_face( faceIndex ); }
+};
 
-    edgeToFaces.resize( numEdges, make_array( -1, -1 ) );
+/**
+ * Fills the face-varying index array of a custom-faces channel, three entries per face, in parallel.
+ * @param faceCount the number of faces in the mesh.
+ * @param faces an accessor providing face( faceIndex ).
+ * @param[out] outIndices the index array. It is resized to 3 * faceCount.
+ */
+template <class FaceAccessor>
+void fill_face_corner_indices( std::size_t faceCount, const FaceAccessor& faces, MIntArray& outIndices ) {
+    outIndices.setLength( static_cast<unsigned int>( 3 * faceCount ) );
+    frantic::maya::geometry::fill_face_corners( faceCount, faces, MESH_ARRAY_GRAIN_SIZE,
+                                                static_cast<MIntArray*>( NULL ), outIndices );
+}
+
+/**
+ * Fills a MFloatPointArray with the trimesh3 vertices in parallel.
+ * @param mesh the source mesh.
+ * @param timeOffset if non-zero and the mesh has a Velocity channel, each vertex is moved by timeOffset * Velocity.
+ * @param[out] vertexArray the vertex positions. It is resized to the mesh's vertex count.
+ */
+void fill_vertex_array( const frantic::geometry::trimesh3& mesh, float timeOffset, MFloatPointArray& vertexArray ) {
+    const std::size_t vertexCount = mesh.vertex_count();
 
-    std::vector<std::vector<int>> faceMap( numVerts );
+    vertexArray.setLength( static_cast<unsigned int>( vertexCount ) );
 
-    for( int i = 0; i < numVerts; ++i ) {
-        faceMap[i].reserve( 6 );
+    const tbb::blocked_range<std::size_t> vertexRange( 0, vertexCount, MESH_ARRAY_GRAIN_SIZE );
+    if( timeOffset && mesh.has_vertex_channel( _T("Velocity") ) ) {
+        frantic::geometry::const_trimesh3_vertex_channel_cvt_accessor<frantic::graphics::vector3f> velocityAcc(
+            mesh.get_vertex_channel_cvt_accessor<frantic::graphics::vector3f>( _T("Velocity") ) );
+        tbb::parallel_for( vertexRange, fill_vertex_array_body( mesh, &velocityAcc, timeOffset, vertexArray ) );
+    } else {
+        tbb::parallel_for( vertexRange, fill_vertex_array_body( mesh, NULL, 0, vertexArray ) );
     }
+}
 
-    unsigned int counter = 0;
-    for( int i = 0; i < numFaces; ++i ) {
-        for( int j = 0, je = mayaCounts[i]; j < je; ++j ) {
-            int idx = mayaIndices[counter + j];
-            faceMap[idx].push_back( i );
+/**
+ * Builds every array required by MFnMesh::create in one pass over the trimesh3.
+ * Each array is sized exactly once, and the vertex and face ranges are filled in parallel.
+ * @param mesh the source mesh.
+ * @param timeOffset if non-zero and the mesh has a Velocity channel, each vertex is moved by timeOffset * Velocity.
+ * @param[out] vertexArray the vertex positions.
+ * @param[out] polygonCounts the number of corners in each face. These are always 3.
+ * @param[out] polygonConnects the vertex index of each face corner.
+ */
+void fill_mesh_arrays( const frantic::geometry::trimesh3& mesh, float timeOffset, MFloatPointArray& vertexArray,
+                       MIntArray& polygonCounts, MIntArray& polygonConnects ) {
+    const std::size_t faceCount = mesh.face_count();
+
+    polygonCounts.setLength( static_cast<unsigned int>( faceCount ) );
+    polygonConnects.setLength( static_cast<unsigned int>( 3 * faceCount ) );
+
+    fill_vertex_array( mesh, timeOffset, vertexArray );
+
+    const trimesh3_geometry_faces faces( mesh );
+    frantic::maya::geometry::fill_face_corners( faceCount, faces, MESH_ARRAY_GRAIN_SIZE, &polygonCounts,
+                                                polygonConnects );
+}
+
+// Identifies the topology of a trimesh3 without keeping a copy of its faces
+struct topology_fingerprint {
+    std::size_t vertexCount;
+    std::size_t faceCount;
+    std::size_t faceHash;
+
+    explicit topology_fingerprint( const frantic::geometry::trimesh3& mesh )
+        : vertexCount( mesh.vertex_count() )
+        , faceCount( mesh.face_count() )
+        , faceHash( 0 ) {
+        for( std::size_t faceIndex = 0; faceIndex < faceCount; ++faceIndex ) {
+            const frantic::graphics::vector3& f = mesh.get_face( faceIndex );
+            boost::hash_combine( faceHash, f.x );
+            boost::hash_combine( faceHash, f.y );
+            boost::hash_combine( faceHash, f.z );
         }
-        counter += mayaCounts[i];
     }
 
-    std::vector<int> commonFaces;
-    commonFaces.reserve( 3 );
-    for( int i = 0; i < numEdges; ++i ) {
-        commonFaces.clear();
+    bool operator==( const topology_fingerprint& other ) const {
+        return vertexCount == other.vertexCount && faceCount == other.faceCount && faceHash == other.faceHash;
+    }
+};
 
-        int2 vertices;
-        stat = fnMesh.getEdgeVertices( i, vertices );
-        if( !stat )
-            throw std::runtime_error( std::string( "Failed to get vertices: " ) + stat.errorString().asChar() );
+// A Maya mesh created by mesh_copy_time_offset(), and the topology of the trimesh3 it was created from
+struct created_mesh_entry {
+    MObjectHandle parentOrOwner;
+    MObjectHandle mesh;
+    topology_fingerprint topology;
 
-        const std::vector<int>& faces1 = faceMap[vertices[0]];
-        const std::vector<int>& faces2 = faceMap[vertices[1]];
+    created_mesh_entry( const MObject& parentOrOwner, const MObject& mesh, const topology_fingerprint& topology )
+        : parentOrOwner( parentOrOwner )
+        , mesh( mesh )
+        , topology( topology ) {}
+};
 
-        std::set_intersection( faces1.begin(), faces1.end(), faces2.begin(), faces2.end(),
-                               std::back_inserter( commonFaces ) );
+// The created meshes, keyed by the MObjectHandle::hashCode() of the parentOrOwner they were created for
+typedef std::map<unsigned int, std::vector<created_mesh_entry>> created_mesh_map_t;
+
+created_mesh_map_t& get_created_meshes() {
+    static created_mesh_map_t createdMeshes;
+    return createdMeshes;
+}
 
-        if( commonFaces.size() == 1 ) {
-            edgeToFaces[i] = make_array( commonFaces[0], -1 );
-        } else if( commonFaces.size() >= 2 ) {
-            edgeToFaces[i] = make_array( commonFaces[0], commonFaces[1] );
+/**
+ * Finds the Maya mesh that the last call to mesh_copy_time_offset() created for parentOrOwner.  Under a transform
+ * this is the shape that was created, rather than any other mesh shape the transform may have.
+ * @param parentOrOwner the parentOrOwner that was passed to mesh_copy_time_offset().
+ * @return the created mesh, or NULL if none was created or it has been deleted since.
+ */
+const created_mesh_entry* find_created_mesh( const MObject& parentOrOwner ) {
+    if( parentOrOwner.isNull() ) {
+        return NULL;
+    }
+
+    created_mesh_map_t& createdMeshes = get_created_meshes();
+    const MObjectHandle handle( parentOrOwner );
+    created_mesh_map_t::iterator it = createdMeshes.find( handle.hashCode() );
+    if( it == createdMeshes.end() ) {
+        return NULL;
+    }
+
+    std::vector<created_mesh_entry>& bucket = it->second;
+    for( std::size_t i = 0; i < bucket.size(); ++i ) {
+        if( bucket[i].parentOrOwner == handle ) {
+            if( bucket[i].mesh.isValid() ) {
+                return &bucket[i];
+            }
+            bucket.erase( bucket.begin() + i );
+            if( bucket.empty() ) {
+                createdMeshes.erase( it );
+            }
+            return NULL;
         }
     }
-}
 
-void copy_mesh_geometry( MFloatPointArray& vertexArray, const frantic::geometry::trimesh3& mesh ) {
-    const unsigned int vertexCount = static_cast<unsigned int>( mesh.vertex_count() );
+    return NULL;
+}
 
-    vertexArray.setLength( vertexCount );
+void set_created_mesh( const MObject& parentOrOwner, const MObject& mesh, const topology_fingerprint& topology ) {
+    if( parentOrOwner.isNull() ) {
+        return;
+    }
 
-    for( unsigned int i = 0; i < vertexCount; ++i ) {
-        const frantic::graphics::vector3f v( mesh.get_vertex( i ) );
-        vertexArray.set( i, v.x, v.y, v.z );
+    const MObjectHandle handle( parentOrOwner );
+    std::vector<created_mesh_entry>& bucket = get_created_meshes()[handle.hashCode()];
+    for( std::size_t i = 0; i < bucket.size(); ++i ) {
+        if( bucket[i].parentOrOwner == handle ) {
+            bucket.erase( bucket.begin() + i );
+            break;
+        }
     }
+    bucket.push_back( created_mesh_entry( parentOrOwner, mesh, topology ) );
 }
 
-void apply_velocity_offset( MFloatPointArray& vertexArray, const frantic::geometry::trimesh3& mesh, float timeOffset ) {
-    const unsigned int vertexCount = static_cast<unsigned int>( mesh.vertex_count() );
+/**
+ * Moves the vertices of the mesh created for parentOrOwner, if it was created from a trimesh3 with the given topology
+ * and it still has the same vertex and face counts.
+ * @return true if the mesh was updated.
+ */
+bool update_created_mesh( const MObject& parentOrOwner, const frantic::geometry::trimesh3& mesh,
+                          const topology_fingerprint& topology, float timeOffset ) {
+    MStatus stat;
 
-    frantic::geometry::const_trimesh3_vertex_channel_cvt_accessor<frantic::graphics::vector3f> acc(
-        mesh.get_vertex_channel_cvt_accessor<frantic::graphics::vector3f>( _T("Velocity") ) );
-    for( unsigned int i = 0; i < vertexCount; ++i ) {
-        const MFloatPoint& p = vertexArray[i];
-        const frantic::graphics::vector3f dp = timeOffset * acc.get( i );
-        vertexArray.set( i, p.x + dp.x, p.y + dp.y, p.z + dp.z );
+    const created_mesh_entry* createdMesh = find_created_mesh( parentOrOwner );
+    if( createdMesh == NULL || !( createdMesh->topology == topology ) ) {
+        return false;
     }
-}
 
-void copy_mesh_topology( MIntArray& polygonCounts, MIntArray& polygonConnects,
-                         const frantic::geometry::trimesh3& mesh ) {
-    const unsigned int faceCount = static_cast<unsigned int>( mesh.face_count() );
+    // The counts are cheap to check, and catch most edits made to the mesh in Maya since it was created
+    MFnMesh fnMesh( createdMesh->mesh.object(), &stat );
+    if( !stat || static_cast<std::size_t>( fnMesh.numVertices() ) != topology.vertexCount ||
+        static_cast<std::size_t>( fnMesh.numPolygons() ) != topology.faceCount ||
+        static_cast<std::size_t>( fnMesh.numFaceVertices() ) != 3 * topology.faceCount ) {
+        return false;
+    }
 
-    polygonCounts.setLength( faceCount );
-    polygonConnects.setLength( 3 * faceCount );
+    MFloatPointArray vertexArray;
+    fill_vertex_array( mesh, timeOffset, vertexArray );
 
-    for( unsigned int i = 0; i < faceCount; ++i ) {
-        polygonCounts[i] = 3;
+    stat = fnMesh.setPoints( vertexArray );
+    if( !stat ) {
+        throw std::runtime_error( "mesh_update_time_offset Error: unable to set points: " +
+                                  std::string( stat.errorString().asChar() ) );
     }
 
-    for( unsigned int faceIndex = 0; faceIndex < faceCount; ++faceIndex ) {
-        const frantic::graphics::vector3 f( mesh.get_face( faceIndex ) );
-        for( unsigned int corner = 0; corner < 3; ++corner ) {
-            polygonConnects[3 * faceIndex + corner] = f[corner];
-        }
-    }
+    return true;
 }
 
 class no_color_transform {
@@ -259,16 +414,8 @@ void copy_mesh_color( MFnMesh& fnMesh, const frantic::tstring destColorSetName,
                                   std::string( stat.errorString().asChar() ) );
     }
 
-    const unsigned int faceCount = static_cast<unsigned int>( mesh.face_count() );
-
     MIntArray colorIds;
-    colorIds.setLength( 3 * faceCount );
-    for( unsigned int faceIndex = 0; faceIndex < faceCount; ++faceIndex ) {
-        for( unsigned int corner = 0; corner < 3; ++corner ) {
-            const unsigned int i = 3 * faceIndex + corner;
-            colorIds[i] = acc.face( faceIndex )[corner];
-        }
-    }
+    fill_face_corner_indices( mesh.face_count(), acc, colorIds );
     stat = fnMesh.assignColors( colorIds, &colorSet );
     if( !stat ) {
         throw std::runtime_error( "copy_mesh_color Error: unable to assign colors: " +
@@ -281,7 +428,44 @@ void copy_mesh_color( MFnMesh& fnMesh, const frantic::tstring destColorSetName,
     copy_mesh_color( fnMesh, destColorSetName, mesh, srcChannelName, no_color_transform() );
 }
 
-void copy_mesh_normals( MFnMesh& fnMesh, const frantic::geometry::trimesh3& mesh,
+/**
+ * Expands the per-vertex normals of a custom-faces Normal channel into the face-vertex arrays expected by
+ * MFnMesh::setFaceVertexNormals.
+ */
+class expand_face_vertex_normals_body {
+    const frantic::geometry::const_trimesh3_vertex_channel_cvt_accessor<frantic::graphics::vector3f>& m_acc;
+    const MVectorArray& m_normalArray;
+    MVectorArray& m_expandedNormalArray;
+    MIntArray& m_expandedFaceArray;
+
+    expand_face_vertex_normals_body& operator=( const expand_face_vertex_normals_body& ); // not implemented
+
+  public:
+    expand_face_vertex_normals_body(
+        const frantic::geometry::const_trimesh3_vertex_channel_cvt_accessor<frantic::graphics::vector3f>& acc,
+        const MVectorArray& normalArray, MVectorArray& expandedNormalArray, MIntArray& expandedFaceArray )
+        : m_acc( acc )
+        , m_normalArray( normalArray )
+        , m_expandedNormalArray( expandedNormalArray )
+        , m_expandedFaceArray( expandedFaceArray ) {}
+
+    void operator()( const tbb::blocked_range<std::size_t>& range ) const {
+        for( std::size_t faceIndex = range.begin(); faceIndex != range.end(); ++faceIndex ) {
+            const frantic::graphics::vector3 f( m_acc.face( faceIndex ) );
+            for( unsigned int corner = 0; corner < 3; ++corner ) {
+                const unsigned int i = static_cast<unsigned int>( 3 * faceIndex + corner );
+                m_expandedNormalArray[i] = m_normalArray[f[corner]];
+                m_expandedFaceArray[i] = static_cast<int>( faceIndex );
+            }
+        }
+    }
+};
+
+/**
+ * Copies the mesh's Normal channel into fnMesh as face-vertex normals.
+ * @param polygonConnects the vertex index of each face corner, as passed to MFnMesh::create.
+ */
+void copy_mesh_normals( MFnMesh& fnMesh, const frantic::geometry::trimesh3& mesh, const MIntArray& polygonConnects,
                         const frantic::tstring srcChannelName = _T("Normal") ) {
     MStatus stat;
 
@@ -302,28 +486,20 @@ void copy_mesh_normals( MFnMesh& fnMesh, const frantic::geometry::trimesh3& mesh
         normalArray[i] = frantic::maya::to_maya_t( normal );
     }
 
-    const unsigned int faceCount = static_cast<unsigned int>( mesh.face_count() );
-
-    MIntArray vertexCounts;
-    MIntArray vertexIndices;
-    fnMesh.getVertices( vertexCounts, vertexIndices );
+    const std::size_t faceCount = mesh.face_count();
 
     MVectorArray expandedNormalArray;
     MIntArray expandedFaceArray;
 
-    unsigned int vertexIndicesLength = vertexIndices.length();
+    const unsigned int vertexIndicesLength = polygonConnects.length();
 
     expandedNormalArray.setLength( vertexIndicesLength );
     expandedFaceArray.setLength( vertexIndicesLength );
 
-    for( unsigned int faceIndex = 0; faceIndex < faceCount; ++faceIndex ) {
-        for( unsigned int corner = 0; corner < 3; ++corner ) {
-            expandedNormalArray[faceIndex * 3 + corner] = normalArray[acc.face( faceIndex )[corner]];
-            expandedFaceArray[faceIndex * 3 + corner] = faceIndex;
-        }
-    }
+    tbb::parallel_for( tbb::blocked_range<std::size_t>( 0, faceCount, MESH_ARRAY_GRAIN_SIZE ),
+                       expand_face_vertex_normals_body( acc, normalArray, expandedNormalArray, expandedFaceArray ) );
 
-    stat = fnMesh.setFaceVertexNormals( expandedNormalArray, expandedFaceArray, vertexIndices );
+    stat = fnMesh.setFaceVertexNormals( expandedNormalArray, expandedFaceArray, polygonConnects );
 
     if( !stat ) {
         throw std::runtime_error( "copy_mesh_normals Error: unable to assign normals: " +
@@ -331,7 +507,11 @@ void copy_mesh_normals( MFnMesh& fnMesh, const frantic::geometry::trimesh3& mesh
     }
 }
 
-void copy_mesh_texture_coord( MFnMesh& fnMesh, const frantic::geometry::trimesh3& mesh,
+/**
+ * Copies the mesh's TextureCoord channel into fnMesh's current UV set.
+ * @param polygonCounts the number of corners in each face, as passed to MFnMesh::create.
+ */
+void copy_mesh_texture_coord( MFnMesh& fnMesh, const frantic::geometry::trimesh3& mesh, const MIntArray& polygonCounts,
                               const frantic::tstring srcChannelName = _T("TextureCoord") ) {
     MStatus stat;
 
@@ -365,22 +545,10 @@ void copy_mesh_texture_coord( MFnMesh& fnMesh, const frantic::geometry::trimesh3
                                   std::string( stat.errorString().asChar() ) );
     }
 
-    const unsigned int faceCount = static_cast<unsigned int>( mesh.face_count() );
-
-    MIntArray uvCounts;
     MIntArray uvIds;
-    uvCounts.setLength( faceCount );
-    uvIds.setLength( 3 * faceCount );
-
-    for( unsigned int faceIndex = 0; faceIndex < faceCount; ++faceIndex ) {
-        uvCounts[faceIndex] = 3;
-        for( unsigned int corner = 0; corner < 3; ++corner ) {
-            const unsigned int i = 3 * faceIndex + corner;
-            uvIds[i] = acc.face( faceIndex )[corner];
-        }
-    }
+    fill_face_corner_indices( mesh.face_count(), acc, uvIds );
 
-    stat = fnMesh.assignUVs( uvCounts, uvIds );
+    stat = fnMesh.assignUVs( polygonCounts, uvIds );
     if( !stat ) {
         throw std::runtime_error( "copy_mesh_texture_coord Error: unable to assign UVs: " +
                                   std::string( stat.errorString().asChar() ) );
@@ -611,7 +779,9 @@ struct vector3f_hash {
 
 frantic::geometry::polymesh3_ptr polymesh_copy( const MDagPath& dagPath, bool worldSpace,
                                                 const frantic::channels::channel_propagation_policy& cpp,
-                                                bool colorFromCurrentColorSet, bool textureCoordFromCurrentUVSet ) {
+                                                bool colorFromCurrentColorSet, bool textureCoordFromCurrentUVSet,
+                                                frantic::logging::progress_logger* progress ) {
+    FRANTIC_MAYA_SCOPED_TIMER( "polymesh_copy" );
     MStatus stat;
 
     MFnMesh fnMesh( dagPath, &stat );
@@ -622,6 +792,7 @@ frantic::geometry::polymesh3_ptr polymesh_copy( const MDagPath& dagPath, bool wo
     const int numVerts = fnMesh.numVertices();
     const int numFaces = fnMesh.numPolygons();
     const int numFaceVerts = fnMesh.numFaceVertices();
+    FRANTIC_MAYA_ADD_COUNT( "polymesh_copy", numFaces );
 
     polymesh3_builder polyBuild;
 
@@ -774,6 +945,11 @@ frantic::geometry::polymesh3_ptr polymesh_copy( const MDagPath& dagPath, bool wo
         }
     }
 
+    if( progress ) {
+        frantic::maya::logging::add_progress_count( *progress, _T( "faces" ), numFaces );
+        frantic::maya::logging::add_progress_count( *progress, _T( "vertices" ), numVerts );
+    }
+
     return result;
 }
 
@@ -905,201 +1081,46 @@ void copy_vertex_creases( const MDagPath& dagPath, const MFnMesh& srcMesh, polym
                                  vertexCreaseChannelBuffer );
 }
 
-void create_smoothing_groups( const MFnMesh& fnMesh, polymesh3_ptr outMesh ) {
-    std::vector<boost::uint32_t> prevEncoding;
-
-    create_smoothing_groups( fnMesh, prevEncoding, outMesh );
-}
-
-// Could this vertex cause erroneous smoothing between incident faces?
-bool may_have_crosstalk( const std::vector<int>& vertexDiscontinuities, int vertexIndex ) {
-    return vertexDiscontinuities[vertexIndex] > 3;
-}
-
-bool has_hard_edge( const adjacency_list& inputs, int a, int b ) {
-    for( adjacency_list::const_iterator i = inputs.hard_begin( a ), ie = inputs.hard_end( a ); i != ie; ++i ) {
-        if( *i == b ) {
-            return true;
-        }
-    }
-    return false;
-}
-
-struct crosstalk_vertex_info {
-    typedef std::set<int> connected_faces_t;
-    typedef std::vector<int> connected_edges_t;
-
-    connected_faces_t faces;
-    connected_edges_t edges;
-};
-
-// Without this function, we can get the same smoothing group on two faces
-// which share the same vertex, and which are separated by a hard edge (or
-// by a boundary), but which do not share the same hard edge.  This can
-// happen if there are more than three hard edges incident on a vertex.
-//
-// For example (the lines are hard edges, and the number is the
-// resulting smoothing group):
-//
-// Before:
-// +---+---+
-// | 1 | 2 |
-// +---+---+
-// | 2 | 1 |
-// +---+---+
-//
-// And after this function adds a hard edge between diagonally-opposed faces:
-// +---+---+
-// | 1 | 2 |
-// +---+---+
-// | 3 | 4 |
-// +---+---+
-//
-void add_cross_vertex_hard_edges( const MFnMesh& fnMesh, const std::vector<boost::array<int, 2>>& edgeToFaces,
-                                  adjacency_list& inputs ) {
+void get_smoothing_group_mesh( const MFnMesh& fnMesh, smoothing_group_mesh& outMesh ) {
     MStatus stat;
 
-    const int numEdges = fnMesh.numEdges();
-    const int numVerts = fnMesh.numVertices();
-    const int numFaces = fnMesh.numPolygons();
-    const int numFaceVerts = fnMesh.numFaceVertices();
+    MIntArray mayaCounts;
+    MIntArray mayaIndices;
+    stat = fnMesh.getVertices( mayaCounts, mayaIndices );
+    if( !stat )
+        throw std::runtime_error( std::string( "Failed to get face vertices: " ) + stat.errorString().asChar() );
 
-    std::vector<int> vertexDiscontinuities( numVerts );
-    for( int edgeIndex = 0; edgeIndex < numEdges; ++edgeIndex ) {
-        bool smooth = fnMesh.isEdgeSmooth( edgeIndex, &stat );
-        if( !stat ) {
-            throw std::runtime_error( std::string( "Failed to get edge smoothness: " ) + stat.errorString().asChar() );
-        }
+    outMesh.vertexCount = fnMesh.numVertices();
+    copy_int_array( mayaCounts, outMesh.faceCounts );
+    copy_int_array( mayaIndices, outMesh.faceVertices );
 
-        boost::array<int, 2> faces = edgeToFaces[edgeIndex];
+    const int numEdges = fnMesh.numEdges();
 
-        const bool isBoundaryEdge = faces[0] >= 0 && faces[1] < 0;
-        if( isBoundaryEdge || !smooth ) {
-            int2 vertexList;
-            stat = fnMesh.getEdgeVertices( edgeIndex, vertexList );
-            for( int i = 0; i < 2; ++i ) {
-                ++vertexDiscontinuities[vertexList[i]];
-            }
-        }
-    }
+    outMesh.edgeVertices.resize( 2 * numEdges );
+    outMesh.edgeSmooth.resize( numEdges );
+    for( int i = 0; i < numEdges; ++i ) {
+        int2 vertices;
+        stat = fnMesh.getEdgeVertices( i, vertices );
+        if( !stat )
+            throw std::runtime_error( std::string( "Failed to get vertices: " ) + stat.errorString().asChar() );
+        outMesh.edgeVertices[2 * i] = vertices[0];
+        outMesh.edgeVertices[2 * i + 1] = vertices[1];
 
-    // I'm referring to the erroneous smoothing across faces that share
-    // the same vertex as "crosstalk".
-    std::vector<int> crosstalkToVertexIndex;
-    for( int i = 0; i < numVerts; ++i ) {
-        if( may_have_crosstalk( vertexDiscontinuities, i ) ) {
-            crosstalkToVertexIndex.push_back( i );
-        }
+        const bool smooth = fnMesh.isEdgeSmooth( i, &stat );
+        if( !stat )
+            throw std::runtime_error( std::string( "Failed to get edge smoothness: " ) + stat.errorString().asChar() );
+        outMesh.edgeSmooth[i] = smooth;
     }
+}
 
-    const std::size_t numCrosstalkVerts = crosstalkToVertexIndex.size();
-
-    if( numCrosstalkVerts > 0 ) {
-        typedef crosstalk_vertex_info::connected_faces_t connected_faces_t;
-        typedef crosstalk_vertex_info::connected_edges_t connected_edges_t;
-
-        std::vector<crosstalk_vertex_info> crosstalkVertexInfo( numCrosstalkVerts );
-        { // scope for vertexToCrosstalkIndex
-            std::vector<int> vertexToCrosstalkIndex( numVerts );
-            for( int i = 0; i < numCrosstalkVerts; ++i ) {
-                vertexToCrosstalkIndex[crosstalkToVertexIndex[i]] = i;
-            }
-
-            for( int edgeIndex = 0; edgeIndex < numEdges; ++edgeIndex ) {
-                int2 vertexList;
-                fnMesh.getEdgeVertices( edgeIndex, vertexList );
-                BOOST_FOREACH( int vertexIndex, vertexList ) {
-                    if( may_have_crosstalk( vertexDiscontinuities, vertexIndex ) ) {
-                        boost::array<int, 2> faces = edgeToFaces[edgeIndex];
-                        BOOST_FOREACH( int faceIndex, faces ) {
-                            // If soft_count() is zero, then the face isn't going to get
-                            // a smoothing group, so we can ignore it.
-                            if( faceIndex >= 0 && inputs.soft_count( faceIndex ) > 0 ) {
-                                const int crosstalkIndex = vertexToCrosstalkIndex[vertexIndex];
-                                crosstalkVertexInfo[crosstalkIndex].faces.insert( faceIndex );
-                                crosstalkVertexInfo[crosstalkIndex].edges.push_back( edgeIndex );
-                            }
-                        }
-                    }
-                }
-            }
-        }
-
-        // Want a data structure with random access iterators, so that we can
-        // map from a face index entry to its relative position in the
-        // collection (which is equal to its index in the disjointSets array).
-        typedef boost::container::flat_set<int> ordered_faces_t;
-        ordered_faces_t connectedFaces;
-
-        std::vector<int> ranks;
-        std::vector<int> parents;
-        std::vector<int> disjointSetFaces;
-
-        for( int crosstalkIndex = 0; crosstalkIndex < numCrosstalkVerts; ++crosstalkIndex ) {
-            const connected_faces_t& connectedFacesSet = crosstalkVertexInfo[crosstalkIndex].faces;
-            const connected_edges_t& edgeList = crosstalkVertexInfo[crosstalkIndex].edges;
-
-            connectedFaces.clear();
-            connectedFaces.insert( connectedFacesSet.begin(), connectedFacesSet.end() );
-
-            ranks.resize( connectedFaces.size() );
-            parents.resize( connectedFaces.size() );
-
-            // Disjoint set of the faces connected to this vertex
-            boost::disjoint_sets<int*, int*> disjointSets( &ranks[0], &parents[0] );
-            for( std::size_t i = 0, ie = connectedFaces.size(); i < ie; ++i ) {
-                disjointSets.make_set( static_cast<int>( i ) );
-            }
-
-            // Union faces together if they're connected by a smooth edge
-            BOOST_FOREACH( int edgeIndex, edgeList ) {
-                bool isSmooth = fnMesh.isEdgeSmooth( edgeIndex, &stat );
-                if( !stat ) {
-                    throw std::runtime_error( "Unable to get edge smoothness" );
-                }
-                if( isSmooth ) {
-                    boost::array<int, 2> edgeFaces = edgeToFaces[edgeIndex];
-                    if( edgeFaces[0] >= 0 && edgeFaces[1] >= 0 ) {
-                        boost::array<int, 2> disjointSetIndices;
-                        for( int side = 0; side < 2; ++side ) {
-                            const int faceIndex = edgeFaces[side];
-                            ordered_faces_t::iterator i = connectedFaces.find( faceIndex );
-                            if( i == connectedFaces.end() ) {
-                                throw std::runtime_error( "Unable to find face in connected faces" );
-                            }
-                            disjointSetIndices[side] = static_cast<int>( i - connectedFaces.begin() );
-                        }
-                        disjointSets.union_set( disjointSetIndices[0], disjointSetIndices[1] );
-                    }
-                }
-            }
-
-            // Choose one face from each disjoint set
-            disjointSetFaces.clear();
-            for( int i = 0, ie = static_cast<int>( connectedFaces.size() ); i < ie; ++i ) {
-                if( disjointSets.find_set( i ) == i ) {
-                    const int faceIndex = *( connectedFaces.begin() + i );
-                    disjointSetFaces.push_back( faceIndex );
-                }
-            }
+void create_smoothing_groups( const MFnMesh& fnMesh, polymesh3_ptr outMesh ) {
+    std::vector<boost::uint32_t> prevEncoding;
 
-            // Add a hard edge between each disjoint set
-            for( int b = 0, be = static_cast<int>( disjointSetFaces.size() ); b < be; ++b ) {
-                for( int a = 0; a < b; ++a ) {
-                    int faceA = disjointSetFaces[a];
-                    int faceB = disjointSetFaces[b];
-                    // TODO: we probably want to avoid a linear search here,
-                    // but normally the number of edges is small.
-                    if( !has_hard_edge( inputs, faceA, faceB ) ) {
-                        inputs.hard_insert( faceA, faceB );
-                    }
-                }
-            }
-        }
-    }
+    create_smoothing_groups( fnMesh, prevEncoding, outMesh );
 }
 
 void create_smoothing_groups( const MFnMesh& fnMesh, std::vector<boost::uint32_t>& encoding, polymesh3_ptr outMesh ) {
+    FRANTIC_MAYA_SCOPED_TIMER( "create_smoothing_groups" );
     MStatus stat;
 
     const frantic::tstring smoothingGroupChannelName = _T("SmoothingGroup");
@@ -1113,6 +1134,7 @@ void create_smoothing_groups( const MFnMesh& fnMesh, std::vector<boost::uint32_t
         throw std::runtime_error(
             "create_smoothing_groups Error: mismatch between number of faces in fnMesh and outMesh" );
     }
+    FRANTIC_MAYA_ADD_COUNT( "create_smoothing_groups", numFaces );
 
     frantic::graphics::raw_byte_buffer smoothingGroupChannelBuffer;
     smoothingGroupChannelBuffer.resize( numFaces * sizeof( boost::int32_t ) );
@@ -1125,49 +1147,10 @@ void create_smoothing_groups( const MFnMesh& fnMesh, std::vector<boost::uint32_t
             smoothingGroupChannel[i] = smoothingGroup;
         }
     } else {
-        std::vector<boost::array<int, 2>> edgeToFaces;
-        get_edge_to_faces( fnMesh, edgeToFaces );
-
-        // check if the old encoding works for this mesh
-        bool identicalGroups = encoding.size() == numFaces;
-        for( int i = 0; i < numEdges && identicalGroups; ++i ) {
-            bool smooth = fnMesh.isEdgeSmooth( i, &stat );
-            if( !stat )
-                throw std::runtime_error( std::string( "Failed to get edge smoothness: " ) +
-                                          stat.errorString().asChar() );
-
-            boost::array<int, 2> faces = edgeToFaces[i];
-            if( faces[0] >= 0 && faces[1] >= 0 ) {
-                const bool prevEncodingSmooth = ( encoding[faces[0]] & encoding[faces[1]] ) != 0;
-                if( prevEncodingSmooth != smooth ) {
-                    identicalGroups = false;
-                }
-            }
-        }
+        smoothing_group_mesh smoothingMesh;
+        get_smoothing_group_mesh( fnMesh, smoothingMesh );
 
-        // if the old encoding doesn't work, make a new one
-        if( !identicalGroups ) {
-            adjacency_list inputs( numFaces );
-            for( int i = 0; i < numEdges; ++i ) {
-                bool smooth = fnMesh.isEdgeSmooth( i, &stat );
-                if( !stat )
-                    throw std::runtime_error( std::string( "Failed to get edge smoothness: " ) +
-                                              stat.errorString().asChar() );
-
-                boost::array<int, 2> faces = edgeToFaces[i];
-                if( faces[0] >= 0 && faces[1] >= 0 ) {
-                    if( smooth ) {
-                        inputs.soft_insert( faces[0], faces[1] );
-                    } else {
-                        inputs.hard_insert( faces[0], faces[1] );
-                    }
-                }
-            }
-
-            add_cross_vertex_hard_edges( fnMesh, edgeToFaces, inputs );
-
-            color_graph( inputs, numFaces, encoding );
-        }
+        compute_smoothing_groups( smoothingMesh, encoding );
 
         for( size_t i = 0, iEnd = static_cast<std::size_t>( numFaces ); i < iEnd; ++i ) {
             smoothingGroupChannel[i] = encoding[i];
@@ -1415,21 +1398,20 @@ bool generate_vertex_velocities( const MFnMesh& fnNewMesh, frantic::geometry::tr
     outMesh.add_vertex_channel<vector3f>( _T("Velocity") );
     trimesh3_vertex_channel_accessor<vector3f> velAcc = outMesh.get_vertex_channel_accessor<vector3f>( _T("Velocity") );
 
-    MPointArray vertices;
-    fnNewMesh.getPoints( vertices );
+    const float* vertices = fnNewMesh.getRawPoints( &status );
+    if( !status ) {
+        throw std::runtime_error( "generate_vertex_velocities Error: unable to get the offset mesh's vertices: " +
+                                  std::string( status.errorString().asChar() ) );
+    }
 
     float fps = (float)MTime( 1.0, MTime::kSeconds ).as( MTime::uiUnit() );
     float timeStep = fps / timeStepInFrames;
 
     // use differencing to compute vertex velocity.
     bool foundNonZeroVelocity = false;
-    for( int i = 0; i < fnNewMesh.numVertices(); ++i ) {
-        const MPoint& newVertex = vertices[i];
-        velAcc[i] =
-            ( vector3f( (float)newVertex.x, (float)newVertex.y, (float)newVertex.z ) - outMesh.get_vertex( i ) ) *
-            timeStep;
-        if( !foundNonZeroVelocity && velAcc[i] != vector3f( 0.0f ) )
-            foundNonZeroVelocity = true;
+    if( newNumVerts > 0 ) {
+        foundNonZeroVelocity =
+            compute_vertex_velocities( &outMesh.get_vertex( 0 ), vertices, newNumVerts, timeStep, &velAcc[0] );
     }
 
     // don't bother keeping the velocity channel if it's all zero.
@@ -1445,7 +1427,9 @@ bool generate_vertex_velocities( const MFnMesh& fnNewMesh, frantic::geometry::tr
 }
 
 void copy_maya_mesh( MPlug inPlug, frantic::geometry::trimesh3& outMesh, bool generateNormals, bool generateUVCoords,
-                     bool generateVelocity, bool generateColors, bool useSmoothedMeshSubdivs ) {
+                     bool generateVelocity, bool generateColors, bool useSmoothedMeshSubdivs,
+                     frantic::logging::progress_logger* progress ) {
+    FRANTIC_MAYA_SCOPED_TIMER( "copy_maya_mesh" );
     MStatus status;
     MObject baseMeshObj;
     inPlug.getValue( baseMeshObj );
@@ -1462,7 +1446,8 @@ void copy_maya_mesh( MPlug inPlug, frantic::geometry::trimesh3& outMesh, bool ge
     // determine if it's a smoothed mesh.
     // The "displaySmoothMesh" option can be 0,1,2 based on the check box smooth mesh preview and the radio buttons for
     // Display.
-    bool isSmooth = useSmoothedMeshSubdivs && ( frantic::maya::get_int_attribute( baseMesh, "displaySmoothMesh" ) > 0 );
+    static const frantic::maya::attribute_accessor displaySmoothMeshAttribute( "displaySmoothMesh" );
+    bool isSmooth = useSmoothedMeshSubdivs && ( displaySmoothMeshAttribute.get_int( baseMesh ) > 0 );
 
     // get the smoothed mesh options
     MFnMeshData parentMeshData;
@@ -1485,6 +1470,15 @@ void copy_maya_mesh( MPlug inPlug, frantic::geometry::trimesh3& outMesh, bool ge
 
     FF_LOG( debug ) << "Retrieved a mesh that has " << outMesh.vertex_count() << " vertices and "
                     << outMesh.face_count() << " faces.\n";
+    FRANTIC_MAYA_ADD_COUNT( "copy_maya_mesh", outMesh.face_count() );
+    FRANTIC_MAYA_ADD_BYTES( "copy_maya_mesh",
+                            outMesh.vertex_count() * sizeof( vector3f ) + outMesh.face_count() * sizeof( vector3 ) );
+    if( progress ) {
+        frantic::maya::logging::add_progress_count( *progress, _T( "faces" ),
+                                                    static_cast<boost::int64_t>( outMesh.face_count() ) );
+        frantic::maya::logging::add_progress_count( *progress, _T( "vertices" ),
+                                                    static_cast<boost::int64_t>( outMesh.vertex_count() ) );
+    }
 
     // generate the vertex velocities if requested
     if( generateVelocity ) {
@@ -1547,12 +1541,22 @@ void copy_maya_mesh( MPlug inPlug, frantic::geometry::trimesh3& outMesh, bool ge
 }
 
 void mesh_copy( MObject parentOrOwner, const frantic::geometry::trimesh3& mesh ) {
-    mesh_copy_time_offset( parentOrOwner, mesh, 0.f );
+    mesh_copy_time_offset( parentOrOwner, mesh, 0.f, false );
+}
+
+bool mesh_update_time_offset( MObject parentOrOwner, const frantic::geometry::trimesh3& mesh, float timeOffset ) {
+    return update_created_mesh( parentOrOwner, mesh, topology_fingerprint( mesh ), timeOffset );
 }
 
-void mesh_copy_time_offset( MObject parentOrOwner, const frantic::geometry::trimesh3& mesh, float timeOffset ) {
+void mesh_copy_time_offset( MObject parentOrOwner, const frantic::geometry::trimesh3& mesh, float timeOffset,
+                            bool updateMatchingTopology ) {
     MStatus stat;
 
+    const topology_fingerprint topology( mesh );
+    if( updateMatchingTopology && update_created_mesh( parentOrOwner, mesh, topology, timeOffset ) ) {
+        return;
+    }
+
     MFnMesh fnMesh;
     fnMesh.setCheckSamePointTwice( false );
 
@@ -1560,13 +1564,7 @@ void mesh_copy_time_offset( MObject parentOrOwner, const frantic::geometry::trim
     MIntArray polygonCounts;
     MIntArray polygonConnects;
 
-    copy_mesh_geometry( vertexArray, mesh );
-
-    if( timeOffset && mesh.has_vertex_channel( _T("Velocity") ) ) {
-        apply_velocity_offset( vertexArray, mesh, timeOffset );
-    }
-
-    copy_mesh_topology( polygonCounts, polygonConnects, mesh );
+    fill_mesh_arrays( mesh, timeOffset, vertexArray, polygonCounts, polygonConnects );
 
     MObject meshData = fnMesh.create( vertexArray.length(), polygonCounts.length(), vertexArray, polygonCounts,
                                       polygonConnects, parentOrOwner, &stat );
@@ -1575,9 +1573,11 @@ void mesh_copy_time_offset( MObject parentOrOwner, const frantic::geometry::trim
                                   std::string( stat.errorString().asChar() ) );
     }
 
+    set_created_mesh( parentOrOwner, meshData, topology );
+
     const frantic::tstring normal( _T( "Normal" ) );
     if( mesh.has_vertex_channel( normal ) ) {
-        copy_mesh_normals( fnMesh, mesh );
+        copy_mesh_normals( fnMesh, mesh, polygonConnects );
     }
 
     const frantic::tstring color( _T("Color") );
@@ -1587,7 +1587,7 @@ void mesh_copy_time_offset( MObject parentOrOwner, const frantic::geometry::trim
 
     const frantic::tstring textureCoord( _T("TextureCoord") );
     if( mesh.has_vertex_channel( textureCoord ) ) {
-        copy_mesh_texture_coord( fnMesh, mesh, textureCoord );
+        copy_mesh_texture_coord( fnMesh, mesh, polygonCounts, textureCoord );
     }
 
     const frantic::tstring velocity( _T("Velocity") );
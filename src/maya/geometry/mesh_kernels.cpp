@@ -0,0 +1,226 @@
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+#include "stdafx.h"
+
+#include <frantic/maya/geometry/mesh_kernels.hpp>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+
+boost::array<int, 2> make_array( int a, int b ) {
+    boost::array<int, 2> result = { a, b };
+    return result;
+}
+
+typedef std::vector<std::atomic<std::size_t>> atomic_size_array;
+
+// Counts the corners that use each vertex
+class count_vertex_corners_body {
+    const frantic::graphics::vector3* m_faces;
+    std::size_t m_vertexCount;
+    atomic_size_array& m_counts;
+
+    count_vertex_corners_body& operator=( const count_vertex_corners_body& ); // not implemented
+
+  public:
+    count_vertex_corners_body( const frantic::graphics::vector3* faces, std::size_t vertexCount,
+                               atomic_size_array& counts )
+        : m_faces( faces )
+        , m_vertexCount( vertexCount )
+        , m_counts( counts ) {}
+
+    void operator()( const tbb::blocked_range<std::size_t>& range ) const {
+        for( std::size_t faceIndex = range.begin(); faceIndex != range.end(); ++faceIndex ) {
+            for( int corner = 0; corner < 3; ++corner ) {
+                const std::size_t vertex = static_cast<std::size_t>( m_faces[faceIndex][corner] );
+                if( vertex >= m_vertexCount ) {
+                    throw std::runtime_error( "build_vertex_corner_map Error: a face refers to a vertex that is not "
+                                              "in the mesh" );
+                }
+                m_counts[vertex].fetch_add( 1, std::memory_order_relaxed );
+            }
+        }
+    }
+};
+
+// Writes each corner into its vertex's range, in whatever order the threads reach it
+class place_vertex_corners_body {
+    const frantic::graphics::vector3* m_faces;
+    atomic_size_array& m_cursors;
+    std::vector<std::size_t>& m_corners;
+
+    place_vertex_corners_body& operator=( const place_vertex_corners_body& ); // not implemented
+
+  public:
+    place_vertex_corners_body( const frantic::graphics::vector3* faces, atomic_size_array& cursors,
+                               std::vector<std::size_t>& corners )
+        : m_faces( faces )
+        , m_cursors( cursors )
+        , m_corners( corners ) {}
+
+    void operator()( const tbb::blocked_range<std::size_t>& range ) const {
+        for( std::size_t faceIndex = range.begin(); faceIndex != range.end(); ++faceIndex ) {
+            for( int corner = 0; corner < 3; ++corner ) {
+                const std::size_t vertex = static_cast<std::size_t>( m_faces[faceIndex][corner] );
+                const std::size_t slot = m_cursors[vertex].fetch_add( 1, std::memory_order_relaxed );
+                m_corners[slot] = 3 * faceIndex + corner;
+            }
+        }
+    }
+};
+
+// Sorts the corners of each vertex, which makes the map independent of the order they were placed in
+class sort_vertex_corners_body {
+    const std::vector<std::size_t>& m_offsets;
+    std::vector<std::size_t>& m_corners;
+
+    sort_vertex_corners_body& operator=( const sort_vertex_corners_body& ); // not implemented
+
+  public:
+    sort_vertex_corners_body( const std::vector<std::size_t>& offsets, std::vector<std::size_t>& corners )
+        : m_offsets( offsets )
+        , m_corners( corners ) {}
+
+    void operator()( const tbb::blocked_range<std::size_t>& range ) const {
+        for( std::size_t vertex = range.begin(); vertex != range.end(); ++vertex ) {
+            std::sort( m_corners.begin() + m_offsets[vertex], m_corners.begin() + m_offsets[vertex + 1] );
+        }
+    }
+};
+
+} // anonymous namespace
+
+namespace frantic {
+namespace maya {
+namespace geometry {
+
+void build_edge_to_faces( std::size_t vertexCount, const std::vector<int>& faceCounts,
+                          const std::vector<int>& faceVertices, const std::vector<int>& edgeVertices,
+                          std::vector<boost::array<int, 2>>& outEdgeToFaces ) {
+    const std::size_t numEdges = edgeVertices.size() / 2;
+    const std::size_t numFaces = faceCounts.size();
+
+    outEdgeToFaces.assign( numEdges, make_array( -1, -1 ) );
+
+    // The faces incident on each vertex. Faces are visited in order, so each list is sorted.
+    std::vector<std::vector<int>> faceMap( vertexCount );
+
+    for( std::size_t i = 0; i < vertexCount; ++i ) {
+        faceMap[i].reserve( 6 );
+    }
+
+    std::size_t counter = 0;
+    for( std::size_t i = 0; i < numFaces; ++i ) {
+        const std::size_t count = static_cast<std::size_t>( faceCounts[i] );
+        if( counter + count > faceVertices.size() ) {
+            throw std::runtime_error( "build_edge_to_faces Error: the face counts refer to more corners than there "
+                                      "are face vertices" );
+        }
+        for( std::size_t j = 0; j < count; ++j ) {
+            faceMap[faceVertices[counter + j]].push_back( static_cast<int>( i ) );
+        }
+        counter += count;
+    }
+
+    std::vector<int> commonFaces;
+    commonFaces.reserve( 3 );
+    for( std::size_t i = 0; i < numEdges; ++i ) {
+        commonFaces.clear();
+
+        const std::vector<int>& faces1 = faceMap[edgeVertices[2 * i]];
+        const std::vector<int>& faces2 = faceMap[edgeVertices[2 * i + 1]];
+
+        std::set_intersection( faces1.begin(), faces1.end(), faces2.begin(), faces2.end(),
+                               std::back_inserter( commonFaces ) );
+
+        if( commonFaces.size() == 1 ) {
+            outEdgeToFaces[i] = make_array( commonFaces[0], -1 );
+        } else if( commonFaces.size() >= 2 ) {
+            outEdgeToFaces[i] = make_array( commonFaces[0], commonFaces[1] );
+        }
+    }
+}
+
+void build_face_adjacency( boost::uint32_t faceCount, const std::vector<boost::array<int, 2>>& edgeToFaces,
+                           const std::vector<char>& edgeSmooth, adjacency_list& outInputs ) {
+    adjacency_list inputs( faceCount );
+
+    for( std::size_t i = 0, ie = edgeToFaces.size(); i < ie; ++i ) {
+        const boost::array<int, 2>& faces = edgeToFaces[i];
+        if( faces[0] >= 0 && faces[1] >= 0 ) {
+            if( edgeSmooth[i] ) {
+                inputs.soft_insert( faces[0], faces[1] );
+            } else {
+                inputs.hard_insert( faces[0], faces[1] );
+            }
+        }
+    }
+
+    std::swap( outInputs, inputs );
+}
+
+bool is_smoothing_encoding_valid( std::size_t faceCount, const std::vector<boost::array<int, 2>>& edgeToFaces,
+                                  const std::vector<char>& edgeSmooth, const std::vector<boost::uint32_t>& encoding ) {
+    if( encoding.size() != faceCount ) {
+        return false;
+    }
+
+    for( std::size_t i = 0, ie = edgeToFaces.size(); i < ie; ++i ) {
+        const boost::array<int, 2>& faces = edgeToFaces[i];
+        if( faces[0] >= 0 && faces[1] >= 0 ) {
+            const bool encodingSmooth = ( encoding[faces[0]] & encoding[faces[1]] ) != 0;
+            if( encodingSmooth != ( edgeSmooth[i] != 0 ) ) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool compute_vertex_velocities( const frantic::graphics::vector3f* positions, const float* offsetPositions,
+                                std::size_t count, float scale, frantic::graphics::vector3f* outVelocities ) {
+    bool foundNonZeroVelocity = false;
+    for( std::size_t i = 0; i < count; ++i ) {
+        const float* p = offsetPositions + 3 * i;
+        outVelocities[i] = ( frantic::graphics::vector3f( p[0], p[1], p[2] ) - positions[i] ) * scale;
+        if( !foundNonZeroVelocity && outVelocities[i] != frantic::graphics::vector3f( 0.0f ) ) {
+            foundNonZeroVelocity = true;
+        }
+    }
+    return foundNonZeroVelocity;
+}
+
+void build_vertex_corner_map( std::size_t vertexCount, const frantic::graphics::vector3* faces, std::size_t faceCount,
+                              vertex_corner_map& outMap ) {
+    atomic_size_array counts( vertexCount );
+    tbb::parallel_for( tbb::blocked_range<std::size_t>( 0, faceCount, 4096 ),
+                       count_vertex_corners_body( faces, vertexCount, counts ) );
+
+    // Turn the counts into offsets, and start each vertex's cursor at its offset
+    outMap.offsets.resize( vertexCount + 1 );
+    std::size_t offset = 0;
+    for( std::size_t vertex = 0; vertex < vertexCount; ++vertex ) {
+        outMap.offsets[vertex] = offset;
+        offset += counts[vertex].load( std::memory_order_relaxed );
+        counts[vertex].store( outMap.offsets[vertex], std::memory_order_relaxed );
+    }
+    outMap.offsets[vertexCount] = offset;
+
+    outMap.corners.resize( offset );
+    tbb::parallel_for( tbb::blocked_range<std::size_t>( 0, faceCount, 4096 ),
+                       place_vertex_corners_body( faces, counts, outMap.corners ) );
+    tbb::parallel_for( tbb::blocked_range<std::size_t>( 0, vertexCount, 4096 ),
+                       sort_vertex_corners_body( outMap.offsets, outMap.corners ) );
+}
+
+} // namespace geometry
+} // namespace maya
+} // namespace frantic
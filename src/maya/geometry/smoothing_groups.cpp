@@ -0,0 +1,235 @@
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+#include "stdafx.h"
+
+#include <frantic/maya/geometry/smoothing_groups.hpp>
+
+#include <frantic/maya/geometry/mesh_kernels.hpp>
+
+#include <boost/container/flat_set.hpp>
+#include <boost/foreach.hpp>
+#include <boost/pending/disjoint_sets.hpp>
+
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// Meshes with at least this many faces are colored with parallel_color_graph. Below it, the sequential color_graph is
+// faster than the extra passes the parallel version makes.
+const std::size_t PARALLEL_COLORING_MIN_FACES = 65536;
+
+// Could this vertex cause erroneous smoothing between incident faces?
+bool may_have_crosstalk( const std::vector<int>& vertexDiscontinuities, int vertexIndex ) {
+    return vertexDiscontinuities[vertexIndex] > 3;
+}
+
+bool has_hard_edge( const frantic::maya::geometry::adjacency_list& inputs, int a, int b ) {
+    typedef frantic::maya::geometry::adjacency_list::const_iterator const_iterator;
+    for( const_iterator i = inputs.hard_begin( a ), ie = inputs.hard_end( a ); i != ie; ++i ) {
+        if( *i == b ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+struct crosstalk_vertex_info {
+    typedef std::set<int> connected_faces_t;
+    typedef std::vector<int> connected_edges_t;
+
+    connected_faces_t faces;
+    connected_edges_t edges;
+};
+
+} // anonymous namespace
+
+namespace frantic {
+namespace maya {
+namespace geometry {
+
+// Without this function, we can get the same smoothing group on two faces
+// which share the same vertex, and which are separated by a hard edge (or
+// by a boundary), but which do not share the same hard edge.  This can
+// happen if there are more than three hard edges incident on a vertex.
+//
+// For example (the lines are hard edges, and the number is the
+// resulting smoothing group):
+//
+// Before:
+// +---+---+
+// | 1 | 2 |
+// +---+---+
+// | 2 | 1 |
+// +---+---+
+//
+// And after this function adds a hard edge between diagonally-opposed faces:
+// +---+---+
+// | 1 | 2 |
+// +---+---+
+// | 3 | 4 |
+// +---+---+
+//
+void add_cross_vertex_hard_edges( const smoothing_group_mesh& mesh,
+                                  const std::vector<boost::array<int, 2>>& edgeToFaces, adjacency_list& inputs ) {
+    const int numEdges = static_cast<int>( mesh.edge_count() );
+    const int numVerts = static_cast<int>( mesh.vertexCount );
+
+    std::vector<int> vertexDiscontinuities( numVerts );
+    for( int edgeIndex = 0; edgeIndex < numEdges; ++edgeIndex ) {
+        const bool smooth = mesh.edgeSmooth[edgeIndex] != 0;
+
+        boost::array<int, 2> faces = edgeToFaces[edgeIndex];
+
+        const bool isBoundaryEdge = faces[0] >= 0 && faces[1] < 0;
+        if( isBoundaryEdge || !smooth ) {
+            for( int i = 0; i < 2; ++i ) {
+                ++vertexDiscontinuities[mesh.edgeVertices[2 * edgeIndex + i]];
+            }
+        }
+    }
+
+    // I'm referring to the erroneous smoothing across faces that share
+    // the same vertex as "crosstalk".
+    std::vector<int> crosstalkToVertexIndex;
+    for( int i = 0; i < numVerts; ++i ) {
+        if( may_have_crosstalk( vertexDiscontinuities, i ) ) {
+            crosstalkToVertexIndex.push_back( i );
+        }
+    }
+
+    const std::size_t numCrosstalkVerts = crosstalkToVertexIndex.size();
+
+    if( numCrosstalkVerts > 0 ) {
+        typedef crosstalk_vertex_info::connected_faces_t connected_faces_t;
+        typedef crosstalk_vertex_info::connected_edges_t connected_edges_t;
+
+        std::vector<crosstalk_vertex_info> crosstalkVertexInfo( numCrosstalkVerts );
+        { // scope for vertexToCrosstalkIndex
+            std::vector<int> vertexToCrosstalkIndex( numVerts );
+            for( int i = 0; i < numCrosstalkVerts; ++i ) {
+                vertexToCrosstalkIndex[crosstalkToVertexIndex[i]] = i;
+            }
+
+            for( int edgeIndex = 0; edgeIndex < numEdges; ++edgeIndex ) {
+                for( int i = 0; i < 2; ++i ) {
+                    const int vertexIndex = mesh.edgeVertices[2 * edgeIndex + i];
+                    if( may_have_crosstalk( vertexDiscontinuities, vertexIndex ) ) {
+                        boost::array<int, 2> faces = edgeToFaces[edgeIndex];
+                        BOOST_FOREACH( int faceIndex, faces ) {
+                            // If soft_count() is zero, then the face isn't going to get
+                            // a smoothing group, so we can ignore it.
+                            if( faceIndex >= 0 && inputs.soft_count( faceIndex ) > 0 ) {
+                                const int crosstalkIndex = vertexToCrosstalkIndex[vertexIndex];
+                                crosstalkVertexInfo[crosstalkIndex].faces.insert( faceIndex );
+                                crosstalkVertexInfo[crosstalkIndex].edges.push_back( edgeIndex );
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        // Want a data structure with random access iterators, so that we can
+        // map from a face index entry to its relative position in the
+        // collection (which is equal to its index in the disjointSets array).
+        typedef boost::container::flat_set<int> ordered_faces_t;
+        ordered_faces_t connectedFaces;
+
+        std::vector<int> ranks;
+        std::vector<int> parents;
+        std::vector<int> disjointSetFaces;
+
+        for( int crosstalkIndex = 0; crosstalkIndex < numCrosstalkVerts; ++crosstalkIndex ) {
+            const connected_faces_t& connectedFacesSet = crosstalkVertexInfo[crosstalkIndex].faces;
+            const connected_edges_t& edgeList = crosstalkVertexInfo[crosstalkIndex].edges;
+
+            connectedFaces.clear();
+            connectedFaces.insert( connectedFacesSet.begin(), connectedFacesSet.end() );
+
+            ranks.resize( connectedFaces.size() );
+            parents.resize( connectedFaces.size() );
+
+            // Disjoint set of the faces connected to this vertex
+            boost::disjoint_sets<int*, int*> disjointSets( &ranks[0], &parents[0] );
+            for( std::size_t i = 0, ie = connectedFaces.size(); i < ie; ++i ) {
+                disjointSets.make_set( static_cast<int>( i ) );
+            }
+
+            // Union faces together if they're connected by a smooth edge
+            BOOST_FOREACH( int edgeIndex, edgeList ) {
+                if( mesh.edgeSmooth[edgeIndex] ) {
+                    boost::array<int, 2> edgeFaces = edgeToFaces[edgeIndex];
+                    if( edgeFaces[0] >= 0 && edgeFaces[1] >= 0 ) {
+                        boost::array<int, 2> disjointSetIndices;
+                        for( int side = 0; side < 2; ++side ) {
+                            const int faceIndex = edgeFaces[side];
+                            ordered_faces_t::iterator i = connectedFaces.find( faceIndex );
+                            if( i == connectedFaces.end() ) {
+                                throw std::runtime_error( "Unable to find face in connected faces" );
+                            }
+                            disjointSetIndices[side] = static_cast<int>( i - connectedFaces.begin() );
+                        }
+                        disjointSets.union_set( disjointSetIndices[0], disjointSetIndices[1] );
+                    }
+                }
+            }
+
+            // Choose one face from each disjoint set
+            disjointSetFaces.clear();
+            for( int i = 0, ie = static_cast<int>( connectedFaces.size() ); i < ie; ++i ) {
+                if( disjointSets.find_set( i ) == i ) {
+                    const int faceIndex = *( connectedFaces.begin() + i );
+                    disjointSetFaces.push_back( faceIndex );
+                }
+            }
+
+            // Add a hard edge between each disjoint set
+            for( int b = 0, be = static_cast<int>( disjointSetFaces.size() ); b < be; ++b ) {
+                for( int a = 0; a < b; ++a ) {
+                    int faceA = disjointSetFaces[a];
+                    int faceB = disjointSetFaces[b];
+                    // TODO: we probably want to avoid a linear search here,
+                    // but normally the number of edges is small.
+                    if( !has_hard_edge( inputs, faceA, faceB ) ) {
+                        inputs.hard_insert( faceA, faceB );
+                    }
+                }
+            }
+        }
+    }
+}
+
+bool compute_smoothing_groups( const smoothing_group_mesh& mesh, std::vector<boost::uint32_t>& encoding ) {
+    if( mesh.edgeVertices.size() != 2 * mesh.edge_count() ) {
+        throw std::runtime_error( "compute_smoothing_groups Error: the mesh must have two edge vertices per edge" );
+    }
+
+    const boost::uint32_t numFaces = static_cast<boost::uint32_t>( mesh.face_count() );
+
+    std::vector<boost::array<int, 2>> edgeToFaces;
+    build_edge_to_faces( mesh.vertexCount, mesh.faceCounts, mesh.faceVertices, mesh.edgeVertices, edgeToFaces );
+
+    // check if the old encoding works for this mesh
+    if( is_smoothing_encoding_valid( numFaces, edgeToFaces, mesh.edgeSmooth, encoding ) ) {
+        return false;
+    }
+
+    adjacency_list inputs;
+    build_face_adjacency( numFaces, edgeToFaces, mesh.edgeSmooth, inputs );
+
+    add_cross_vertex_hard_edges( mesh, edgeToFaces, inputs );
+
+    if( numFaces >= PARALLEL_COLORING_MIN_FACES ) {
+        parallel_color_graph( inputs, numFaces, encoding );
+    } else {
+        color_graph( inputs, numFaces, encoding );
+    }
+
+    return true;
+}
+
+} // namespace geometry
+} // namespace maya
+} // namespace frantic
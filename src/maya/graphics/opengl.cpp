@@ -2,9 +2,35 @@
 // SPDX-License-Identifier: Apache-2.0
 #include "stdafx.h"
 
-#include <maya/M3dView.h> // for OpenGL includes
+#if defined( _WIN32 )
+#include <windows.h>
+#endif
+
+#if defined( __APPLE__ )
+#include <OpenGL/gl.h>
+#include <dlfcn.h>
+#else
+#include <GL/gl.h>
+#endif
 
 #include <frantic/maya/graphics/opengl.hpp>
+#include <frantic/maya/particles/viewport_particle_istream.hpp>
+
+#include <frantic/channels/channel_map.hpp>
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+#if !defined( _WIN32 ) && !defined( __APPLE__ )
+// Declared here rather than by including GL/glx.h, whose X11 headers define macros such as None and Bool.
+extern "C" void ( *glXGetProcAddressARB( const GLubyte* procName ) )( void );
+#endif
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
 
 using namespace frantic::graphics;
 
@@ -12,7 +38,14 @@ namespace frantic {
 namespace maya {
 namespace graphics {
 
-void gl_draw_wireframe( const frantic::geometry::trimesh3& mesh ) {
+namespace {
+
+/**
+ * Appends the vertex index pairs of every visible edge in the mesh to outIndices.
+ * Edge visibility is taken from the FaceEdgeVisibility channel, where bits 0x01, 0x02 and 0x04 mark the edges
+ * starting at the face's first, second and third corner. All edges are visible if the channel is missing.
+ */
+void build_wireframe_indices( const frantic::geometry::trimesh3& mesh, std::vector<boost::uint32_t>& outIndices ) {
     const frantic::tstring visibilityChannelName( _T("FaceEdgeVisibility") );
 
     frantic::geometry::const_trimesh3_face_channel_accessor<boost::int8_t> visibilityAcc;
@@ -21,67 +54,195 @@ void gl_draw_wireframe( const frantic::geometry::trimesh3& mesh ) {
         visibilityAcc = mesh.get_face_channel_accessor<boost::int8_t>( visibilityChannelName );
     }
 
-    glPushAttrib( GL_CURRENT_BIT );
-    glPushClientAttrib( GL_CLIENT_VERTEX_ARRAY_BIT );
-
-    glEnableClientState( GL_VERTEX_ARRAY );
-
-    glBegin( GL_LINES );
+    outIndices.reserve( outIndices.size() + 6 * mesh.face_count() );
 
     for( std::size_t i = 0; i < mesh.face_count(); ++i ) {
         const vector3& face = mesh.get_face( i );
 
-        const vector3f& v0 = mesh.get_vertex( face[0] );
-        const vector3f& v1 = mesh.get_vertex( face[1] );
-        const vector3f& v2 = mesh.get_vertex( face[2] );
-
         const boost::int8_t visibility = visibilityAcc.valid() ? visibilityAcc[i] : 0x07;
-        if( visibility & 0x01 ) {
-            glVertex3f( v0.x, v0.y, v0.z );
-            glVertex3f( v1.x, v1.y, v1.z );
+        for( int corner = 0; corner < 3; ++corner ) {
+            if( visibility & ( 1 << corner ) ) {
+                outIndices.push_back( static_cast<boost::uint32_t>( face[corner] ) );
+                outIndices.push_back( static_cast<boost::uint32_t>( face[( corner + 1 ) % 3] ) );
+            }
+        }
+    }
+}
+
+// The vertex buffer object tokens have the same values in OpenGL 1.5 and ARB_vertex_buffer_object
+const GLenum ARRAY_BUFFER = 0x8892;
+const GLenum ELEMENT_ARRAY_BUFFER = 0x8893;
+const GLenum STATIC_DRAW = 0x88E4;
+
+struct gl_buffer_functions {
+    typedef void( APIENTRY* gen_buffers_t )( GLsizei n, GLuint* buffers );
+    typedef void( APIENTRY* delete_buffers_t )( GLsizei n, const GLuint* buffers );
+    typedef void( APIENTRY* bind_buffer_t )( GLenum target, GLuint buffer );
+    typedef void( APIENTRY* buffer_data_t )( GLenum target, std::ptrdiff_t size, const void* data, GLenum usage );
+
+    gen_buffers_t genBuffers;
+    delete_buffers_t deleteBuffers;
+    bind_buffer_t bindBuffer;
+    buffer_data_t bufferData;
+
+    gl_buffer_functions()
+        : genBuffers( NULL )
+        , deleteBuffers( NULL )
+        , bindBuffer( NULL )
+        , bufferData( NULL ) {}
+};
+
+void* get_gl_proc_address( const std::string& name ) {
+#if defined( _WIN32 )
+    return reinterpret_cast<void*>( wglGetProcAddress( name.c_str() ) );
+#elif defined( __APPLE__ )
+    return dlsym( RTLD_DEFAULT, name.c_str() );
+#else
+    return reinterpret_cast<void*>( glXGetProcAddressARB( reinterpret_cast<const GLubyte*>( name.c_str() ) ) );
+#endif
+}
+
+bool has_gl_extension( const char* extension ) {
+    const char* extensions = reinterpret_cast<const char*>( glGetString( GL_EXTENSIONS ) );
+    if( !extensions ) {
+        return false;
+    }
+
+    const std::size_t length = std::strlen( extension );
+    for( const char* p = std::strstr( extensions, extension ); p; p = std::strstr( p + length, extension ) ) {
+        if( ( p == extensions || p[-1] == ' ' ) && ( p[length] == ' ' || p[length] == '\0' ) ) {
+            return true;
         }
-        if( visibility & 0x02 ) {
-            glVertex3f( v1.x, v1.y, v1.z );
-            glVertex3f( v2.x, v2.y, v2.z );
+    }
+    return false;
+}
+
+/**
+ * @return the vertex buffer object functions of the current OpenGL context, or NULL if it does not support them or
+ *         no context is current. They are loaded on the first call made with a context current.
+ */
+const gl_buffer_functions* get_gl_buffer_functions() {
+    static gl_buffer_functions functions;
+    static bool isLoaded = false;
+
+    if( !isLoaded ) {
+        const char* version = reinterpret_cast<const char*>( glGetString( GL_VERSION ) );
+        if( !version ) {
+            return NULL;
         }
-        if( visibility & 0x04 ) {
-            glVertex3f( v2.x, v2.y, v2.z );
-            glVertex3f( v0.x, v0.y, v0.z );
+        isLoaded = true;
+
+        int major = 0, minor = 0;
+        std::sscanf( version, "%d.%d", &major, &minor );
+
+        std::string suffix;
+        if( major > 1 || ( major == 1 && minor >= 5 ) ) {
+            suffix = "";
+        } else if( has_gl_extension( "GL_ARB_vertex_buffer_object" ) ) {
+            suffix = "ARB";
+        } else {
+            return NULL;
+        }
+
+        gl_buffer_functions loaded;
+        loaded.genBuffers =
+            reinterpret_cast<gl_buffer_functions::gen_buffers_t>( get_gl_proc_address( "glGenBuffers" + suffix ) );
+        loaded.deleteBuffers = reinterpret_cast<gl_buffer_functions::delete_buffers_t>(
+            get_gl_proc_address( "glDeleteBuffers" + suffix ) );
+        loaded.bindBuffer =
+            reinterpret_cast<gl_buffer_functions::bind_buffer_t>( get_gl_proc_address( "glBindBuffer" + suffix ) );
+        loaded.bufferData =
+            reinterpret_cast<gl_buffer_functions::buffer_data_t>( get_gl_proc_address( "glBufferData" + suffix ) );
+
+        if( loaded.genBuffers && loaded.deleteBuffers && loaded.bindBuffer && loaded.bufferData ) {
+            functions = loaded;
         }
     }
 
-    glEnd();
+    return functions.genBuffers ? &functions : NULL;
+}
 
-    glPopClientAttrib();
-    glPopAttrib();
+// The names of the buffer objects of destroyed buffers. They are deleted by the next draw, since the destructors may
+// run without the drawing context current, or on another thread.
+struct released_buffer_list {
+    std::mutex mutex;
+    std::vector<GLuint> buffers;
+};
+
+released_buffer_list& get_released_buffers() {
+    static released_buffer_list released;
+    return released;
 }
 
-void gl_draw( const frantic::geometry::trimesh3& mesh ) {
+void release_buffers( const unsigned int* buffers, std::size_t count ) {
+    released_buffer_list& released = get_released_buffers();
+    std::lock_guard<std::mutex> lock( released.mutex );
+    released.buffers.insert( released.buffers.end(), buffers, buffers + count );
+}
+
+void delete_released_buffers( const gl_buffer_functions& gl ) {
+    std::vector<GLuint> buffers;
+    {
+        released_buffer_list& released = get_released_buffers();
+        std::lock_guard<std::mutex> lock( released.mutex );
+        if( released.buffers.empty() ) {
+            return;
+        }
+        buffers.swap( released.buffers );
+    }
+    gl.deleteBuffers( static_cast<GLsizei>( buffers.size() ), &buffers[0] );
+}
+
+template <class T>
+void upload_buffer( const gl_buffer_functions& gl, GLenum target, GLuint buffer, std::vector<T>& data ) {
+    gl.bindBuffer( target, buffer );
+    gl.bufferData( target, static_cast<std::ptrdiff_t>( data.size() * sizeof( T ) ), data.empty() ? NULL : &data[0],
+                   STATIC_DRAW );
+    gl.bindBuffer( target, 0 );
+
+    // The buffer object holds the only copy from now on
+    std::vector<T>().swap( data );
+}
+
+} // anonymous namespace
+
+void gl_draw_wireframe( const frantic::geometry::trimesh3& mesh ) {
+    if( mesh.face_count() == 0 ) {
+        return;
+    }
+
+    std::vector<boost::uint32_t> indices;
+    build_wireframe_indices( mesh, indices );
+
+    if( indices.empty() ) {
+        return;
+    }
 
     glPushAttrib( GL_CURRENT_BIT );
     glPushClientAttrib( GL_CLIENT_VERTEX_ARRAY_BIT );
 
     glEnableClientState( GL_VERTEX_ARRAY );
 
-    glBegin( GL_TRIANGLES );
+    glVertexPointer( 3, GL_FLOAT, 0, &mesh.get_vertex( 0 )[0] );
+    glDrawElements( GL_LINES, static_cast<GLsizei>( indices.size() ), GL_UNSIGNED_INT, &indices[0] );
 
-    for( size_t i = 0; i < mesh.face_count(); ++i ) {
-        const vector3& face = mesh.get_face( i );
+    glPopClientAttrib();
+    glPopAttrib();
+}
 
-        const vector3f& v0 = mesh.get_vertex( face[0] );
-        const vector3f& v1 = mesh.get_vertex( face[1] );
-        const vector3f& v2 = mesh.get_vertex( face[2] );
-        glVertex3f( v0.x, v0.y, v0.z );
-        glVertex3f( v1.x, v1.y, v1.z );
-        glVertex3f( v2.x, v2.y, v2.z );
+void gl_draw( const frantic::geometry::trimesh3& mesh ) {
+    if( mesh.face_count() == 0 ) {
+        return;
     }
 
-    glEnd();
+    glPushAttrib( GL_CURRENT_BIT );
+    glPushClientAttrib( GL_CLIENT_VERTEX_ARRAY_BIT );
 
-    /*
-    glVertexPointer( 3, GL_FLOAT, 0, &mesh.get_vertex(0)[0] );
-    glDrawElements( GL_TRIANGLES, mesh.face_count() * 3, GL_UNSIGNED_INT, &mesh.get_face(0)[0] );
-    */
+    glEnableClientState( GL_VERTEX_ARRAY );
+
+    glVertexPointer( 3, GL_FLOAT, 0, &mesh.get_vertex( 0 )[0] );
+    glDrawElements( GL_TRIANGLES, static_cast<GLsizei>( mesh.face_count() * 3 ), GL_UNSIGNED_INT,
+                    &mesh.get_face( 0 )[0] );
 
     glPopClientAttrib();
     glPopAttrib();
@@ -126,6 +287,282 @@ void gl_draw_box_wireframe( const frantic::graphics::boundbox3f& box ) {
     glPopAttrib();
 }
 
+gl_mesh_buffer::gl_mesh_buffer()
+    : m_version( 0 )
+    , m_vertexCount( 0 )
+    , m_triangleIndexCount( 0 )
+    , m_edgeIndexCount( 0 )
+    , m_hasBuffers( false )
+    , m_needsUpload( false ) {
+    for( int i = 0; i < BUFFER_COUNT; ++i ) {
+        m_buffers[i] = 0;
+    }
+}
+
+gl_mesh_buffer::~gl_mesh_buffer() {
+    if( m_hasBuffers ) {
+        release_buffers( m_buffers, BUFFER_COUNT );
+    }
+}
+
+void gl_mesh_buffer::set_mesh( const frantic::geometry::trimesh3& mesh, boost::uint64_t version ) {
+    const std::size_t vertexCount = mesh.vertex_count();
+    const std::size_t faceCount = mesh.face_count();
+
+    m_vertices.resize( 3 * vertexCount );
+    for( std::size_t i = 0; i < vertexCount; ++i ) {
+        const vector3f& v = mesh.get_vertex( i );
+        m_vertices[3 * i] = v.x;
+        m_vertices[3 * i + 1] = v.y;
+        m_vertices[3 * i + 2] = v.z;
+    }
+
+    m_triangleIndices.resize( 3 * faceCount );
+    for( std::size_t i = 0; i < faceCount; ++i ) {
+        const vector3& face = mesh.get_face( i );
+        m_triangleIndices[3 * i] = static_cast<boost::uint32_t>( face.x );
+        m_triangleIndices[3 * i + 1] = static_cast<boost::uint32_t>( face.y );
+        m_triangleIndices[3 * i + 2] = static_cast<boost::uint32_t>( face.z );
+    }
+
+    m_edgeIndices.clear();
+    build_wireframe_indices( mesh, m_edgeIndices );
+
+    m_vertexCount = vertexCount;
+    m_triangleIndexCount = m_triangleIndices.size();
+    m_edgeIndexCount = m_edgeIndices.size();
+
+    m_version = version;
+    m_needsUpload = true;
+}
+
+void gl_mesh_buffer::draw_elements( unsigned int mode, buffer_index indexBuffer,
+                                    const std::vector<boost::uint32_t>& indices, std::size_t indexCount ) {
+    if( indexCount == 0 || m_vertexCount == 0 ) {
+        return;
+    }
+
+    const gl_buffer_functions* gl = get_gl_buffer_functions();
+    if( gl ) {
+        delete_released_buffers( *gl );
+
+        if( m_needsUpload ) {
+            if( !m_hasBuffers ) {
+                gl->genBuffers( BUFFER_COUNT, m_buffers );
+                m_hasBuffers = true;
+            }
+            upload_buffer( *gl, ARRAY_BUFFER, m_buffers[VERTEX_BUFFER], m_vertices );
+            upload_buffer( *gl, ELEMENT_ARRAY_BUFFER, m_buffers[TRIANGLE_BUFFER], m_triangleIndices );
+            upload_buffer( *gl, ELEMENT_ARRAY_BUFFER, m_buffers[EDGE_BUFFER], m_edgeIndices );
+            m_needsUpload = false;
+        }
+    } else if( is_uploaded() ) {
+        // The data only exists in the buffer objects, which can't be drawn without a current context
+        return;
+    }
+
+    glPushAttrib( GL_CURRENT_BIT );
+    glPushClientAttrib( GL_CLIENT_VERTEX_ARRAY_BIT );
+
+    glEnableClientState( GL_VERTEX_ARRAY );
+
+    if( is_uploaded() ) {
+        gl->bindBuffer( ARRAY_BUFFER, m_buffers[VERTEX_BUFFER] );
+        glVertexPointer( 3, GL_FLOAT, 0, NULL );
+
+        gl->bindBuffer( ELEMENT_ARRAY_BUFFER, m_buffers[indexBuffer] );
+        glDrawElements( mode, static_cast<GLsizei>( indexCount ), GL_UNSIGNED_INT, NULL );
+
+        gl->bindBuffer( ELEMENT_ARRAY_BUFFER, 0 );
+        gl->bindBuffer( ARRAY_BUFFER, 0 );
+    } else {
+        glVertexPointer( 3, GL_FLOAT, 0, &m_vertices[0] );
+        glDrawElements( mode, static_cast<GLsizei>( indexCount ), GL_UNSIGNED_INT, &indices[0] );
+    }
+
+    glPopClientAttrib();
+    glPopAttrib();
+}
+
+void gl_mesh_buffer::draw() { draw_elements( GL_TRIANGLES, TRIANGLE_BUFFER, m_triangleIndices, m_triangleIndexCount ); }
+
+void gl_mesh_buffer::draw_wireframe() { draw_elements( GL_LINES, EDGE_BUFFER, m_edgeIndices, m_edgeIndexCount ); }
+
+boost::shared_ptr<gl_mesh_buffer> gl_mesh_buffer_cache::get( const void* meshId, boost::uint64_t version,
+                                                             const frantic::geometry::trimesh3& mesh ) {
+    boost::shared_ptr<gl_mesh_buffer>& buffer = m_buffers[meshId];
+    if( !buffer ) {
+        buffer.reset( new gl_mesh_buffer );
+        buffer->set_mesh( mesh, version );
+    } else if( buffer->get_version() != version ) {
+        buffer->set_mesh( mesh, version );
+    }
+    return buffer;
+}
+
+void gl_mesh_buffer_cache::erase( const void* meshId ) { m_buffers.erase( meshId ); }
+
+void gl_mesh_buffer_cache::clear() { m_buffers.clear(); }
+
+gl_particle_buffer::gl_particle_buffer()
+    : m_version( 0 )
+    , m_pointCount( 0 )
+    , m_hasColors( false )
+    , m_hasBuffers( false )
+    , m_needsUpload( false ) {
+    for( int i = 0; i < BUFFER_COUNT; ++i ) {
+        m_buffers[i] = 0;
+    }
+}
+
+gl_particle_buffer::~gl_particle_buffer() {
+    if( m_hasBuffers ) {
+        release_buffers( m_buffers, BUFFER_COUNT );
+    }
+}
+
+void gl_particle_buffer::set_particles( boost::shared_ptr<frantic::particles::streams::particle_istream> pin,
+                                        double displayFraction, boost::int64_t maxPoints, boost::uint64_t version ) {
+    m_positions.clear();
+    m_colors.clear();
+    m_pointCount = 0;
+    m_hasColors = false;
+
+    m_version = version;
+    m_needsUpload = true;
+
+    if( !pin || !pin->get_native_channel_map().has_channel( _T("Position") ) ) {
+        return;
+    }
+
+    boost::shared_ptr<frantic::particles::streams::particle_istream> stream(
+        new frantic::maya::particles::viewport_particle_istream( pin, displayFraction, maxPoints ) );
+
+    const bool hasColor = stream->get_native_channel_map().has_channel( _T("Color") );
+
+    frantic::channels::channel_map channelMap;
+    channelMap.define_channel<vector3f>( _T("Position") );
+    if( hasColor ) {
+        channelMap.define_channel<vector3f>( _T("Color") );
+    }
+    channelMap.end_channel_definition();
+
+    stream->set_channel_map( channelMap );
+
+    frantic::channels::channel_accessor<vector3f> positionAcc = channelMap.get_accessor<vector3f>( _T("Position") );
+    frantic::channels::channel_accessor<vector3f> colorAcc;
+    if( hasColor ) {
+        colorAcc = channelMap.get_accessor<vector3f>( _T("Color") );
+    }
+
+    const boost::int64_t countGuess = stream->particle_count_guess();
+    if( countGuess > 0 ) {
+        m_positions.reserve( 3 * static_cast<std::size_t>( countGuess ) );
+        if( hasColor ) {
+            m_colors.reserve( 3 * static_cast<std::size_t>( countGuess ) );
+        }
+    }
+
+    const std::size_t blockSize = 16384;
+    const std::size_t particleSize = channelMap.structure_size();
+    std::vector<char> block( blockSize * particleSize );
+
+    bool more = true;
+    while( more ) {
+        std::size_t count = blockSize;
+        more = stream->get_particles( &block[0], count );
+        for( std::size_t i = 0; i < count; ++i ) {
+            const char* particle = &block[i * particleSize];
+            const vector3f& position = positionAcc.get( particle );
+            m_positions.push_back( position.x );
+            m_positions.push_back( position.y );
+            m_positions.push_back( position.z );
+            if( hasColor ) {
+                const vector3f& color = colorAcc.get( particle );
+                m_colors.push_back( color.x );
+                m_colors.push_back( color.y );
+                m_colors.push_back( color.z );
+            }
+        }
+    }
+
+    stream->close();
+
+    m_pointCount = m_positions.size() / 3;
+    m_hasColors = hasColor;
+}
+
+void gl_particle_buffer::draw( float pointSize ) {
+    if( m_pointCount == 0 ) {
+        return;
+    }
+
+    const gl_buffer_functions* gl = get_gl_buffer_functions();
+    if( gl ) {
+        delete_released_buffers( *gl );
+
+        if( m_needsUpload ) {
+            if( !m_hasBuffers ) {
+                gl->genBuffers( BUFFER_COUNT, m_buffers );
+                m_hasBuffers = true;
+            }
+            upload_buffer( *gl, ARRAY_BUFFER, m_buffers[POSITION_BUFFER], m_positions );
+            upload_buffer( *gl, ARRAY_BUFFER, m_buffers[COLOR_BUFFER], m_colors );
+            m_needsUpload = false;
+        }
+    } else if( is_uploaded() ) {
+        // The data only exists in the buffer objects, which can't be drawn without a current context
+        return;
+    }
+
+    const bool useBuffers = is_uploaded();
+
+    glPushAttrib( GL_CURRENT_BIT | GL_POINT_BIT );
+    glPushClientAttrib( GL_CLIENT_VERTEX_ARRAY_BIT );
+
+    glPointSize( pointSize );
+
+    glEnableClientState( GL_VERTEX_ARRAY );
+    if( useBuffers ) {
+        gl->bindBuffer( ARRAY_BUFFER, m_buffers[POSITION_BUFFER] );
+        glVertexPointer( 3, GL_FLOAT, 0, NULL );
+    } else {
+        glVertexPointer( 3, GL_FLOAT, 0, &m_positions[0] );
+    }
+
+    if( m_hasColors ) {
+        glEnableClientState( GL_COLOR_ARRAY );
+        if( useBuffers ) {
+            gl->bindBuffer( ARRAY_BUFFER, m_buffers[COLOR_BUFFER] );
+            glColorPointer( 3, GL_FLOAT, 0, NULL );
+        } else {
+            glColorPointer( 3, GL_FLOAT, 0, &m_colors[0] );
+        }
+    }
+
+    glDrawArrays( GL_POINTS, 0, static_cast<GLsizei>( m_pointCount ) );
+
+    if( useBuffers ) {
+        gl->bindBuffer( ARRAY_BUFFER, 0 );
+    }
+
+    glPopClientAttrib();
+    glPopAttrib();
+}
+
+void gl_delete_released_buffers() {
+    const gl_buffer_functions* gl = get_gl_buffer_functions();
+    if( gl ) {
+        delete_released_buffers( *gl );
+    }
+}
+
+void gl_draw( gl_mesh_buffer& buffer ) { buffer.draw(); }
+
+void gl_draw_wireframe( gl_mesh_buffer& buffer ) { buffer.draw_wireframe(); }
+
+void gl_draw_particles( gl_particle_buffer& buffer, float pointSize ) { buffer.draw( pointSize ); }
+
 } // namespace graphics
 } // namespace maya
 } // namespace frantic
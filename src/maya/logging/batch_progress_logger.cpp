@@ -0,0 +1,182 @@
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+#include "stdafx.h"
+
+#include <frantic/maya/logging/batch_progress_logger.hpp>
+#include <frantic/maya/logging/progress_bar_progress_logger.hpp>
+#include <frantic/maya/util.hpp>
+
+#include <frantic/logging/logging_level.hpp>
+
+#if defined( WIN32 ) || defined( WIN64 )
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+using namespace frantic::maya::logging;
+
+namespace {
+
+std::string escape_json_string( const frantic::tstring& inString ) {
+    const std::string str = frantic::strings::to_string( inString );
+
+    std::ostringstream os;
+    os << '\"';
+    for( std::string::const_iterator it = str.begin(); it != str.end(); ++it ) {
+        const unsigned char c = static_cast<unsigned char>( *it );
+        switch( c ) {
+        case '\"':
+            os << "\\\"";
+            break;
+        case '\\':
+            os << "\\\\";
+            break;
+        case '\n':
+            os << "\\n";
+            break;
+        case '\r':
+            os << "\\r";
+            break;
+        case '\t':
+            os << "\\t";
+            break;
+        default:
+            if( c < 0x20 ) {
+                os << "\\u" << std::hex << std::setw( 4 ) << std::setfill( '0' ) << static_cast<int>( c ) << std::dec;
+            } else {
+                os << *it;
+            }
+        }
+    }
+    os << '\"';
+    return os.str();
+}
+
+} // anonymous namespace
+
+batch_progress_logger::batch_progress_logger( const frantic::tstring& outputPath )
+    : m_stdout( &std::cout )
+    , m_startTime( tbb::tick_count::now() )
+    , m_inStage( false )
+    , m_stageProgress( 0.f ) {
+    if( !outputPath.empty() ) {
+        m_file.open( frantic::strings::to_string( outputPath ).c_str(), std::ios::out | std::ios::app );
+        if( !m_file.is_open() ) {
+            FF_LOG( warning ) << "batch_progress_logger: Unable to open \"" << outputPath
+                              << "\" for writing.  Writing to stdout instead." << std::endl;
+        }
+    }
+}
+
+batch_progress_logger::~batch_progress_logger() {
+    end_stage();
+
+    std::ostringstream os;
+    os << std::fixed << std::setprecision( 3 );
+    os << "{\"summary\":true,\"seconds\":" << ( tbb::tick_count::now() - m_startTime ).seconds()
+       << ",\"peak_memory_bytes\":" << get_peak_memory_usage() << "}";
+    out() << os.str() << std::endl;
+}
+
+void batch_progress_logger::set_title( const frantic::tstring& title ) { begin_stage( title ); }
+
+void batch_progress_logger::update_progress( long long completed, long long maximum ) {
+    update_progress( maximum > 0 ? 100.f * static_cast<float>( completed ) / maximum : 100.f );
+}
+
+void batch_progress_logger::update_progress( float percent ) { m_stageProgress = get_adjusted_progress( percent ); }
+
+void batch_progress_logger::begin_stage( const frantic::tstring& name ) {
+    end_stage();
+
+    m_inStage = true;
+    m_stageName = name;
+    m_stageStartTime = tbb::tick_count::now();
+    m_stageProgress = 0.f;
+    m_stageCounts.clear();
+}
+
+void batch_progress_logger::end_stage() {
+    if( !m_inStage ) {
+        return;
+    }
+    m_inStage = false;
+
+    const double seconds = ( tbb::tick_count::now() - m_stageStartTime ).seconds();
+
+    std::ostringstream os;
+    os << std::fixed << std::setprecision( 3 );
+    os << "{\"stage\":" << escape_json_string( m_stageName ) << ",\"seconds\":" << seconds
+       << ",\"progress\":" << m_stageProgress;
+
+    if( !m_stageCounts.empty() ) {
+        os << ",\"counts\":{";
+        for( std::map<frantic::tstring, boost::int64_t>::const_iterator it = m_stageCounts.begin();
+             it != m_stageCounts.end(); ++it ) {
+            os << ( it == m_stageCounts.begin() ? "" : "," ) << escape_json_string( it->first ) << ":" << it->second;
+        }
+        os << "},\"throughput\":{";
+        for( std::map<frantic::tstring, boost::int64_t>::const_iterator it = m_stageCounts.begin();
+             it != m_stageCounts.end(); ++it ) {
+            os << ( it == m_stageCounts.begin() ? "" : "," ) << escape_json_string( it->first + _T("_per_second") )
+               << ":" << ( seconds > 0.0 ? static_cast<double>( it->second ) / seconds : 0.0 );
+        }
+        os << "}";
+    }
+
+    os << ",\"peak_memory_bytes\":" << get_peak_memory_usage() << "}";
+    out() << os.str() << std::endl;
+}
+
+void batch_progress_logger::add_count( const frantic::tstring& unit, boost::int64_t count ) {
+    m_stageCounts[unit] += count;
+}
+
+boost::uint64_t batch_progress_logger::get_peak_memory_usage() {
+#if defined( WIN32 ) || defined( WIN64 )
+    PROCESS_MEMORY_COUNTERS counters;
+    if( GetProcessMemoryInfo( GetCurrentProcess(), &counters, sizeof( counters ) ) ) {
+        return static_cast<boost::uint64_t>( counters.PeakWorkingSetSize );
+    }
+    return 0;
+#else
+    struct rusage usage;
+    if( getrusage( RUSAGE_SELF, &usage ) != 0 ) {
+        return 0;
+    }
+#if defined( __APPLE__ )
+    // ru_maxrss is in bytes on OS X
+    return static_cast<boost::uint64_t>( usage.ru_maxrss );
+#else
+    // ru_maxrss is in kilobytes on Linux
+    return static_cast<boost::uint64_t>( usage.ru_maxrss ) * 1024;
+#endif
+#endif
+}
+
+void frantic::maya::logging::add_progress_count( frantic::logging::progress_logger& progress,
+                                                 const frantic::tstring& unit, boost::int64_t count ) {
+    batch_progress_logger* batchProgress = dynamic_cast<batch_progress_logger*>( &progress );
+    if( batchProgress ) {
+        batchProgress->add_count( unit, count );
+    }
+}
+
+boost::shared_ptr<frantic::logging::progress_logger>
+frantic::maya::logging::create_progress_logger( const frantic::tstring& batchOutputPath ) {
+    if( frantic::maya::is_batch_mode() ) {
+        return boost::shared_ptr<frantic::logging::progress_logger>( new batch_progress_logger( batchOutputPath ) );
+    } else {
+        return boost::shared_ptr<frantic::logging::progress_logger>( new progress_bar_progress_logger );
+    }
+}
@@ -0,0 +1,264 @@
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+#include "stdafx.h"
+
+#include <frantic/maya/logging/instrumentation.hpp>
+#include <frantic/maya/plugin_manager.hpp>
+
+#include <maya/MArgDatabase.h>
+#include <maya/MArgList.h>
+#include <maya/MPxCommand.h>
+#include <maya/MStringArray.h>
+#include <maya/MSyntax.h>
+
+#include <tbb/enumerable_thread_specific.h>
+
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <sstream>
+
+namespace frantic {
+namespace maya {
+namespace logging {
+
+namespace detail {
+std::atomic<bool> g_instrumentationEnabled( false );
+} // namespace detail
+
+namespace {
+
+const std::size_t MAX_TRACE_EVENTS_PER_THREAD = 1000000;
+
+struct trace_event {
+    const char* name;
+    tbb::tick_count start;
+    double seconds;
+};
+
+std::atomic<int> g_nextThreadId( 0 );
+
+struct thread_data {
+    // Keyed by the address of the name, which is cheaper than comparing strings.  Entries with equal names are merged
+    // when the data is queried.
+    typedef std::map<const char*, instrumentation_stat> stat_map_t;
+
+    int threadId;
+    stat_map_t stats;
+    std::vector<trace_event> events;
+
+    thread_data()
+        : threadId( g_nextThreadId++ ) {}
+
+    instrumentation_stat& get_stat( const char* name ) {
+        instrumentation_stat& stat = stats[name];
+        if( stat.name.empty() )
+            stat.name = name;
+        return stat;
+    }
+};
+
+typedef tbb::enumerable_thread_specific<thread_data> thread_data_t;
+
+thread_data_t& get_thread_data() {
+    static thread_data_t data;
+    return data;
+}
+
+tbb::tick_count& get_trace_start_time() {
+    static tbb::tick_count startTime = tbb::tick_count::now();
+    return startTime;
+}
+
+void merge_stat( instrumentation_stat& dest, const instrumentation_stat& src ) {
+    if( src.calls > 0 ) {
+        dest.minSeconds = dest.calls > 0 ? std::min( dest.minSeconds, src.minSeconds ) : src.minSeconds;
+        dest.maxSeconds = dest.calls > 0 ? std::max( dest.maxSeconds, src.maxSeconds ) : src.maxSeconds;
+    }
+    dest.calls += src.calls;
+    dest.totalSeconds += src.totalSeconds;
+    dest.count += src.count;
+    dest.bytes += src.bytes;
+}
+
+std::string escape_json_string( const std::string& str ) {
+    std::ostringstream os;
+    os << '\"';
+    for( std::string::const_iterator it = str.begin(); it != str.end(); ++it ) {
+        if( *it == '\"' || *it == '\\' )
+            os << '\\';
+        os << *it;
+    }
+    os << '\"';
+    return os.str();
+}
+
+std::string stat_to_json( const instrumentation_stat& stat ) {
+    std::ostringstream os;
+    os << std::setprecision( 9 );
+    os << "{\"name\":" << escape_json_string( stat.name ) << ",\"calls\":" << stat.calls
+       << ",\"total_seconds\":" << stat.totalSeconds << ",\"min_seconds\":" << stat.minSeconds
+       << ",\"max_seconds\":" << stat.maxSeconds << ",\"count\":" << stat.count << ",\"bytes\":" << stat.bytes << "}";
+    return os.str();
+}
+
+class instrumentation_command : public MPxCommand {
+  public:
+    static void* creator() { return new instrumentation_command; }
+
+    static MSyntax newSyntax() {
+        MSyntax syntax;
+        syntax.addFlag( "-e", "-enable", MSyntax::kBoolean );
+        syntax.addFlag( "-r", "-reset" );
+        syntax.addFlag( "-rp", "-report" );
+        syntax.addFlag( "-ct", "-chromeTrace", MSyntax::kString );
+        return syntax;
+    }
+
+    virtual MStatus doIt( const MArgList& args ) {
+        MStatus status;
+        MArgDatabase argData( syntax(), args, &status );
+        if( !status )
+            return status;
+
+        if( argData.isFlagSet( "-enable" ) ) {
+            bool enabled = false;
+            argData.getFlagArgument( "-enable", 0, enabled );
+            set_instrumentation_enabled( enabled );
+        }
+
+        if( argData.isFlagSet( "-chromeTrace" ) ) {
+            MString path;
+            argData.getFlagArgument( "-chromeTrace", 0, path );
+            std::ofstream out( path.asChar() );
+            if( !out ) {
+                displayError( "Unable to open \"" + path + "\" for writing." );
+                return MS::kFailure;
+            }
+            write_instrumentation_chrome_trace( out );
+        }
+
+        if( argData.isFlagSet( "-report" ) ) {
+            std::vector<instrumentation_stat> stats;
+            get_instrumentation_stats( stats );
+
+            MStringArray result;
+            for( std::size_t i = 0; i < stats.size(); ++i ) {
+                result.append( stat_to_json( stats[i] ).c_str() );
+            }
+            setResult( result );
+        } else {
+            setResult( is_instrumentation_enabled() );
+        }
+
+        // Reset last, so that a report can be taken and cleared in one call
+        if( argData.isFlagSet( "-reset" ) ) {
+            reset_instrumentation();
+        }
+
+        return MS::kSuccess;
+    }
+};
+
+} // anonymous namespace
+
+instrumentation_stat::instrumentation_stat()
+    : calls( 0 )
+    , totalSeconds( 0.0 )
+    , minSeconds( 0.0 )
+    , maxSeconds( 0.0 )
+    , count( 0 )
+    , bytes( 0 ) {}
+
+void set_instrumentation_enabled( bool enabled ) {
+    // Make sure the trace's time base is set before anything is recorded
+    get_trace_start_time();
+    detail::g_instrumentationEnabled.store( enabled );
+}
+
+void record_instrumentation_time( const char* name, const tbb::tick_count& start, const tbb::tick_count& end ) {
+    const double seconds = ( end - start ).seconds();
+
+    thread_data& data = get_thread_data().local();
+    instrumentation_stat& stat = data.get_stat( name );
+    stat.minSeconds = stat.calls > 0 ? std::min( stat.minSeconds, seconds ) : seconds;
+    stat.maxSeconds = stat.calls > 0 ? std::max( stat.maxSeconds, seconds ) : seconds;
+    stat.totalSeconds += seconds;
+    ++stat.calls;
+
+    if( data.events.size() < MAX_TRACE_EVENTS_PER_THREAD ) {
+        trace_event event;
+        event.name = name;
+        event.start = start;
+        event.seconds = seconds;
+        data.events.push_back( event );
+    }
+}
+
+void add_instrumentation_count( const char* name, boost::int64_t value ) {
+    get_thread_data().local().get_stat( name ).count += value;
+}
+
+void add_instrumentation_bytes( const char* name, boost::uint64_t value ) {
+    get_thread_data().local().get_stat( name ).bytes += value;
+}
+
+void get_instrumentation_stats( std::vector<instrumentation_stat>& outStats ) {
+    std::map<std::string, instrumentation_stat> merged;
+
+    thread_data_t& threads = get_thread_data();
+    for( thread_data_t::const_iterator thread = threads.begin(); thread != threads.end(); ++thread ) {
+        for( thread_data::stat_map_t::const_iterator it = thread->stats.begin(); it != thread->stats.end(); ++it ) {
+            instrumentation_stat& stat = merged[it->second.name];
+            stat.name = it->second.name;
+            merge_stat( stat, it->second );
+        }
+    }
+
+    outStats.clear();
+    outStats.reserve( merged.size() );
+    for( std::map<std::string, instrumentation_stat>::const_iterator it = merged.begin(); it != merged.end(); ++it ) {
+        outStats.push_back( it->second );
+    }
+}
+
+void reset_instrumentation() {
+    thread_data_t& threads = get_thread_data();
+    for( thread_data_t::iterator thread = threads.begin(); thread != threads.end(); ++thread ) {
+        thread->stats.clear();
+        thread->events.clear();
+    }
+    get_trace_start_time() = tbb::tick_count::now();
+}
+
+void write_instrumentation_chrome_trace( std::ostream& out ) {
+    const tbb::tick_count startTime = get_trace_start_time();
+
+    out << std::fixed << std::setprecision( 3 );
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    bool first = true;
+    thread_data_t& threads = get_thread_data();
+    for( thread_data_t::const_iterator thread = threads.begin(); thread != threads.end(); ++thread ) {
+        for( std::vector<trace_event>::const_iterator it = thread->events.begin(); it != thread->events.end(); ++it ) {
+            out << ( first ? "\n" : ",\n" );
+            first = false;
+            // Chrome trace times are in microseconds
+            out << "{\"name\":" << escape_json_string( it->name ) << ",\"cat\":\"frantic\",\"ph\":\"X\",\"pid\":0"
+                << ",\"tid\":" << thread->threadId << ",\"ts\":" << ( it->start - startTime ).seconds() * 1.0e6
+                << ",\"dur\":" << it->seconds * 1.0e6 << "}";
+        }
+    }
+
+    out << "\n]}\n";
+}
+
+MStatus register_instrumentation_command( plugin_manager& pluginManager, const MString& commandName ) {
+    return pluginManager.register_command( commandName, &instrumentation_command::creator,
+                                           &instrumentation_command::newSyntax );
+}
+
+} // namespace logging
+} // namespace maya
+} // namespace frantic
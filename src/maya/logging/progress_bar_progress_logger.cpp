@@ -10,6 +10,7 @@
 
 #include <maya/MGlobal.h>
 
+#include <algorithm>
 #include <sstream>
 
 using namespace frantic::maya::logging;
@@ -52,13 +53,16 @@ void end_display() {
     MGlobal::executeCommand( os.str().c_str() );
 }
 
-void set_progress( float progress ) {
+// The progress bar's range is [0,10000], so that its value can show hundredths of a percent
+int to_progress_value( float percent ) { return int( (percent)*100.0f ); }
+
+void set_progress( int progressValue ) {
     std::ostringstream os;
-    os << "progressBar -edit -progress " << int( (progress)*100.0f ) << " $gMainProgressBar;";
+    os << "progressBar -edit -progress " << progressValue << " $gMainProgressBar;";
     MGlobal::executeCommand( os.str().c_str() );
 }
 
-bool is_cancelled() {
+bool is_progress_bar_cancelled() {
     std::ostringstream os;
     os << "progressBar -query -isCancelled $gMainProgressBar;";
     int result;
@@ -68,18 +72,24 @@ bool is_cancelled() {
 
 } // anonymous namespace
 
-progress_bar_progress_logger::progress_bar_progress_logger() {
+progress_bar_progress_logger::progress_bar_progress_logger( int updateIntervalMilliseconds )
+    : m_lastUpdateTime( tbb::tick_count::now() )
+    , m_lastPollTime( m_lastUpdateTime )
+    , m_displayedProgress( 0 )
+    , m_cancelled( false ) {
+    set_update_interval( updateIntervalMilliseconds );
+
     set_progress_min_max( 0, 10000 );
 
     begin_display();
 
     // seems to get stuck sometimes? TODO: investigate this
-    if( is_cancelled() ) {
+    if( is_progress_bar_cancelled() ) {
         end_display();
         begin_display();
     }
 
-    set_progress( 0.f );
+    set_progress( 0 );
 }
 
 progress_bar_progress_logger::~progress_bar_progress_logger() { end_display(); }
@@ -96,12 +106,49 @@ void progress_bar_progress_logger::update_progress( long long completed, long lo
 }
 
 void progress_bar_progress_logger::update_progress( float percent ) {
-    check_for_abort();
-    set_progress( get_adjusted_progress( percent ) );
+    const tbb::tick_count now = tbb::tick_count::now();
+
+    if( poll_cancelled( now ) ) {
+        throw frantic::logging::progress_cancel_exception( "Operation cancelled" );
+    }
+
+    // The end of a stage is always displayed, so that the bar doesn't stay short of it when the operation finishes
+    // within the update interval of the previous update
+    const bool isStageEnd = percent >= 100.f;
+    if( !isStageEnd && ( now - m_lastUpdateTime ).seconds() < m_updateInterval ) {
+        return;
+    }
+
+    const int progressValue = to_progress_value( get_adjusted_progress( percent ) );
+    if( progressValue != m_displayedProgress ) {
+        set_progress( progressValue );
+        m_displayedProgress = progressValue;
+        m_lastUpdateTime = now;
+    }
 }
 
 void progress_bar_progress_logger::check_for_abort() {
-    if( is_cancelled() ) {
+    if( poll_cancelled( tbb::tick_count::now() ) ) {
         throw frantic::logging::progress_cancel_exception( "Operation cancelled" );
     }
 }
+
+void progress_bar_progress_logger::set_update_interval( int updateIntervalMilliseconds ) {
+    m_updateInterval = std::max( 0, updateIntervalMilliseconds ) / 1000.0;
+}
+
+bool progress_bar_progress_logger::poll_cancelled( const tbb::tick_count& now ) {
+    if( m_cancelled.load( std::memory_order_relaxed ) ) {
+        return true;
+    }
+
+    if( ( now - m_lastPollTime ).seconds() >= m_updateInterval ) {
+        m_lastPollTime = now;
+        if( is_progress_bar_cancelled() ) {
+            m_cancelled.store( true, std::memory_order_relaxed );
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -6,6 +6,7 @@
 #include <frantic/maya/PRTMayaParticle.hpp>
 #include <frantic/maya/PRTObject_base.hpp>
 #include <frantic/maya/maya_util.hpp>
+#include <frantic/maya/particles/particle_stream_source_registry.hpp>
 
 #include <maya/MCommonRenderSettingsData.h>
 #include <maya/MFloatVectorArray.h>
@@ -210,6 +211,8 @@ bool get_object_world_matrix( const MDagPath& dagNodePath, const MDGContext& cur
 }
 
 void find_all_renderable_cameras( std::vector<MDagPath>& outNodes ) {
+    static const attribute_accessor renderableAttribute( "renderable" );
+
     outNodes.clear();
 
     for( MItDag iter( MItDag::kDepthFirst, MFn::kCamera ); !iter.isDone(); iter.next() ) {
@@ -217,7 +220,7 @@ void find_all_renderable_cameras( std::vector<MDagPath>& outNodes ) {
         iter.getPath( dagPath );
         MFnDagNode cameraNode( dagPath );
 
-        if( frantic::maya::get_boolean_attribute( cameraNode, "renderable" ) ) {
+        if( renderableAttribute.get_boolean( cameraNode ) ) {
             outNodes.push_back( dagPath );
         }
     }
@@ -264,9 +267,67 @@ void find_nodes_with_type_id( MTypeId typeId, std::vector<MDagPath>& outNodes )
     }
 }
 
+/**
+ * Checks whether a node is a source of particle streams, either because it has a particle stream output attribute, or
+ * because it is a Maya particle system with a PRTMayaParticle wrapper.
+ * @param node the node to check
+ * @param isBeginning if true, outNode is the beginning of the node's particle stream chain.  Otherwise it is the end.
+ * @param outputStreamAttr Attribute to check for
+ * @param outNode the dependency node that provides the particle stream
+ * @return true if the node is a particle stream source
+ */
+bool get_output_stream_node( const MObject& node, bool isBeginning, const MString& outputStreamAttr,
+                             MObject& outNode ) {
+    MStatus status;
+    MFnDependencyNode fnNode( node, &status );
+    if( !status )
+        return false;
+
+    // Verify the attribute
+    if( PRTObjectBase::hasParticleStreamMPxData( fnNode, outputStreamAttr ) ) {
+        outNode = isBeginning ? node : PRTObjectBase::getEndOfStreamChain( fnNode, outputStreamAttr );
+        return true;
+    }
+
+    // Check if it's a maya particle system and get the wrapper
+    MFnParticleSystem mayaParticleSystem( node, &status );
+    if( !status )
+        return false;
+
+    frantic::tstring systemName = frantic::maya::from_maya_t( mayaParticleSystem.particleName() );
+    // deformed particles will show up with nondeformed particles, so that we only want
+    // to display deformed particles case
+    if( !mayaParticleSystem.isDeformedParticleShape( &status ) ) {
+        MObject deformedParticleShape = mayaParticleSystem.deformedParticleShape( &status );
+        /// current particleStream has its deformed cases, we won't render it
+        if( deformedParticleShape != MObject::kNullObj ) {
+            MFnParticleSystem deformedParticleSystem( deformedParticleShape, &status );
+            if( !status )
+                return false;
+            frantic::tstring deformedName = frantic::maya::from_maya_t( deformedParticleSystem.particleName() );
+            if( deformedName != systemName )
+                return false;
+        }
+    }
+
+    // Get the corresponding wrapper particle if possible
+    MObject prtmaya =
+        PRTMayaParticle::getPRTMayaParticleFromMayaParticleStreamCheckDeformed( mayaParticleSystem, &status );
+    if( status != MS::kSuccess )
+        return false;
+    MFnDependencyNode prtNode( prtmaya, &status );
+    if( status != MS::kSuccess )
+        return false;
+
+    outNode = isBeginning ? prtmaya : PRTObjectBase::getEndOfStreamChain( prtNode, outputStreamAttr );
+    return true;
+}
+
 /**
  * Gets nodes with an outParticleStream attribute
  * Adds the dagpaths and corresponding dependency nodes to the given lists
+ * If the particle_stream_source_registry is active, only the registered sources are checked.  Otherwise the whole DAG
+ * is searched.
  * @param outPaths DagPath of the dependency nodes found (see below)
  * @param outNodes Dependency Nodes with the given output stream attribute (see below)
  * @param outputStreamAttr Attribute to check for
@@ -275,72 +336,20 @@ void find_nodes_with_type_id( MTypeId typeId, std::vector<MDagPath>& outNodes )
  */
 void find_nodes_with_output_stream( std::vector<MDagPath>& outPaths, std::vector<MObject>& outNodes, bool isBeginning,
                                     MString outputStreamAttr ) {
+    if( particles::particle_stream_source_registry::find_nodes_with_output_stream( outPaths, outNodes, isBeginning,
+                                                                                   outputStreamAttr ) )
+        return;
+
     outPaths.clear();
     outNodes.clear();
-    MStatus status;
 
     for( MItDag iter( MItDag::kDepthFirst ); !iter.isDone(); iter.next() ) {
-        MObject exportObject = iter.currentItem();
-        MFnDependencyNode fnNode( exportObject, &status );
-        if( status ) {
-
-            // Verify the attribute
-            if( PRTObjectBase::hasParticleStreamMPxData( fnNode, outputStreamAttr ) ) {
-                MDagPath dagPath;
-                iter.getPath( dagPath );
-
-                if( isBeginning ) {
-                    outPaths.push_back( dagPath );
-                    outNodes.push_back( exportObject );
-                } else {
-                    outPaths.push_back( dagPath );
-                    outNodes.push_back( PRTObjectBase::getEndOfStreamChain( fnNode, outputStreamAttr ) );
-                }
-                continue;
-            }
-
-            // Check if it's a maya particle system and get the wrapper
-            MFnParticleSystem mayaParticleSystem( exportObject, &status );
-            if( status ) {
-                frantic::tstring systemName = frantic::maya::from_maya_t( mayaParticleSystem.particleName() );
-                // deformed particles will show up with nondeformed particles, so that we only want
-                // to display deformed particles case
-                if( !mayaParticleSystem.isDeformedParticleShape( &status ) ) {
-                    MObject deformedParticleShape = mayaParticleSystem.deformedParticleShape( &status );
-                    /// current particleStream has its deformed cases, we won't render it
-                    if( deformedParticleShape != MObject::kNullObj ) {
-                        MFnParticleSystem deformedParticleSystem( deformedParticleShape, &status );
-                        if( status ) {
-                            frantic::tstring deformedName =
-                                frantic::maya::from_maya_t( deformedParticleSystem.particleName() );
-                            if( deformedName != systemName ) {
-                                continue;
-                            }
-                        } else {
-                            continue;
-                        }
-                    }
-                }
-
-                // Get the corresponding wrapper particle if possible
-                MObject prtmaya = PRTMayaParticle::getPRTMayaParticleFromMayaParticleStreamCheckDeformed(
-                    mayaParticleSystem, &status );
-                if( status == MS::kSuccess ) {
-                    MFnDependencyNode prtNode( prtmaya, &status );
-                    if( status == MS::kSuccess ) {
-                        MDagPath dagPath;
-                        iter.getPath( dagPath );
-                        if( isBeginning ) {
-                            outPaths.push_back( dagPath );
-                            outNodes.push_back( prtmaya );
-                        } else {
-                            outPaths.push_back( dagPath );
-                            outNodes.push_back( PRTObjectBase::getEndOfStreamChain( prtNode, outputStreamAttr ) );
-                        }
-                    }
-                }
-                continue;
-            }
+        MObject streamNode;
+        if( get_output_stream_node( iter.currentItem(), isBeginning, outputStreamAttr, streamNode ) ) {
+            MDagPath dagPath;
+            iter.getPath( dagPath );
+            outPaths.push_back( dagPath );
+            outNodes.push_back( streamNode );
         }
     }
 }
@@ -0,0 +1,158 @@
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+#include "stdafx.h"
+
+#include <frantic/maya/particles/constant_channel_particle_istream.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace frantic {
+namespace maya {
+namespace particles {
+
+constant_channel_table::constant_channel_table() { m_channelMap.end_channel_definition(); }
+
+void constant_channel_table::clear() {
+    m_channelMap = frantic::channels::channel_map();
+    m_channelMap.end_channel_definition();
+    m_values.clear();
+}
+
+void constant_channel_table::add_channel( const frantic::tstring& name, std::size_t arity,
+                                          frantic::channels::data_type_t dataType ) {
+    frantic::channels::channel_map newChannelMap( m_channelMap );
+    newChannelMap.append_channel( name, arity, dataType );
+
+    std::vector<char> newValues( newChannelMap.structure_size(), 0 );
+    if( !m_values.empty() ) {
+        frantic::channels::channel_map_adaptor oldToNewChannelMapAdaptor( newChannelMap, m_channelMap );
+        oldToNewChannelMapAdaptor.copy_structure( &newValues[0], &m_values[0] );
+    }
+
+    m_channelMap = newChannelMap;
+    m_values.swap( newValues );
+}
+
+constant_channel_particle_istream::constant_channel_particle_istream(
+    boost::shared_ptr<frantic::particles::streams::particle_istream> pin, const constant_channel_table& constants )
+    : m_delegate( pin )
+    , m_constants( constants )
+    , m_particleIndex( -1 ) {
+    if( !m_delegate ) {
+        throw std::runtime_error( "constant_channel_particle_istream error: The delegate stream is NULL." );
+    }
+
+    m_nativeChannelMap = m_delegate->get_native_channel_map();
+    const frantic::channels::channel_map& constantChannelMap = m_constants.get_channel_map();
+    for( std::size_t i = 0; i < constantChannelMap.channel_count(); ++i ) {
+        const frantic::channels::channel& ch = constantChannelMap[i];
+        if( !m_nativeChannelMap.has_channel( ch.name() ) )
+            m_nativeChannelMap.append_channel( ch.name(), ch.arity(), ch.data_type() );
+    }
+
+    // Start out with the delegate's channels plus the constant ones, like the delegate's own current map
+    frantic::channels::channel_map initialChannelMap( m_delegate->get_channel_map() );
+    for( std::size_t i = 0; i < constantChannelMap.channel_count(); ++i ) {
+        const frantic::channels::channel& ch = constantChannelMap[i];
+        if( !initialChannelMap.has_channel( ch.name() ) )
+            initialChannelMap.append_channel( ch.name(), ch.arity(), ch.data_type() );
+    }
+    set_channel_map( initialChannelMap );
+}
+
+void constant_channel_particle_istream::set_channel_map( const frantic::channels::channel_map& particleChannelMap ) {
+    // Preserve any existing default particle values in the new layout.
+    std::vector<char> newDefaultParticle( particleChannelMap.structure_size() );
+    if( m_defaultParticle.size() > 0 ) {
+        frantic::channels::channel_map_adaptor oldToNewChannelMapAdaptor( particleChannelMap, m_channelMap );
+        oldToNewChannelMapAdaptor.copy_structure( &newDefaultParticle[0], &m_defaultParticle[0] );
+    } else if( !newDefaultParticle.empty() ) {
+        memset( &newDefaultParticle[0], 0, newDefaultParticle.size() );
+    }
+    m_defaultParticle.swap( newDefaultParticle );
+
+    m_channelMap = particleChannelMap;
+
+    // Only the requested channels that are not constant are read from the delegate.
+    const frantic::channels::channel_map& delegateNativeChannelMap = m_delegate->get_native_channel_map();
+    m_delegateChannelMap = frantic::channels::channel_map();
+    for( std::size_t i = 0; i < m_channelMap.channel_count(); ++i ) {
+        const frantic::channels::channel& ch = m_channelMap[i];
+        if( !m_constants.has_channel( ch.name() ) && delegateNativeChannelMap.has_channel( ch.name() ) )
+            m_delegateChannelMap.define_channel( ch.name(), ch.arity(), ch.data_type() );
+    }
+    m_delegateChannelMap.end_channel_definition();
+    m_delegate->set_channel_map( m_delegateChannelMap );
+
+    m_cma.set( m_channelMap, m_delegateChannelMap );
+
+    // Keep at least one byte, so the buffer can be passed to the delegate even if no channels are read from it.
+    m_delegateParticle.resize( std::max<std::size_t>( 1, m_delegateChannelMap.structure_size() ) );
+
+    set_default_particle( m_defaultParticle.empty() ? NULL : &m_defaultParticle[0] );
+}
+
+void constant_channel_particle_istream::set_default_particle( char* rawParticleBuffer ) {
+    if( rawParticleBuffer && !m_defaultParticle.empty() && rawParticleBuffer != &m_defaultParticle[0] ) {
+        memcpy( &m_defaultParticle[0], rawParticleBuffer, m_channelMap.structure_size() );
+    }
+
+    if( m_delegateChannelMap.structure_size() > 0 ) {
+        std::vector<char> delegateDefaultParticle( m_delegateChannelMap.structure_size() );
+        memset( &delegateDefaultParticle[0], 0, delegateDefaultParticle.size() );
+        if( !m_defaultParticle.empty() ) {
+            frantic::channels::channel_map_adaptor toDelegate( m_delegateChannelMap, m_channelMap );
+            toDelegate.copy_structure( &delegateDefaultParticle[0], &m_defaultParticle[0] );
+        }
+        m_delegate->set_default_particle( &delegateDefaultParticle[0] );
+    }
+
+    update_constant_particle();
+}
+
+void constant_channel_particle_istream::update_constant_particle() {
+    m_constantParticle = m_defaultParticle;
+    if( !m_constantParticle.empty() && !m_constants.empty() ) {
+        frantic::channels::channel_map_adaptor fromConstants( m_channelMap, m_constants.get_channel_map() );
+        fromConstants.copy_structure( &m_constantParticle[0], m_constants.get_values(), &m_defaultParticle[0] );
+    }
+}
+
+bool constant_channel_particle_istream::get_particle( char* outParticleBuffer ) {
+    // When the delegate is already providing our layout, none of the constant channels were requested.
+    if( m_cma.is_identity() ) {
+        if( !m_delegate->get_particle( outParticleBuffer ) ) {
+            return false;
+        }
+    } else {
+        if( !m_delegate->get_particle( &m_delegateParticle[0] ) ) {
+            return false;
+        }
+        m_cma.copy_structure( outParticleBuffer, &m_delegateParticle[0], &m_constantParticle[0] );
+    }
+
+    ++m_particleIndex;
+    return true;
+}
+
+bool constant_channel_particle_istream::get_particles( char* buffer, std::size_t& numParticles ) {
+    if( m_cma.is_identity() ) {
+        const bool result = m_delegate->get_particles( buffer, numParticles );
+        m_particleIndex += static_cast<boost::int64_t>( numParticles );
+        return result;
+    }
+
+    const std::size_t particleSize = m_channelMap.structure_size();
+    for( std::size_t i = 0; i < numParticles; ++i ) {
+        if( !get_particle( buffer + i * particleSize ) ) {
+            numParticles = i;
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace particles
+} // namespace maya
+} // namespace frantic
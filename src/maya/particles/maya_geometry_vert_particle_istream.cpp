@@ -4,13 +4,272 @@
 
 #include <frantic/maya/particles/maya_geometry_vert_particle_istream.hpp>
 
+#include <frantic/maya/attributes.hpp>
+#include <frantic/maya/logging/instrumentation.hpp>
+
 #include <frantic/channels/channel_map_adaptor.hpp>
 
 #include <boost/lexical_cast.hpp>
 #include <boost/make_shared.hpp>
+#include <boost/weak_ptr.hpp>
+
+#include <maya/MAnimControl.h>
+#include <maya/MColorArray.h>
+#include <maya/MFloatArray.h>
+#include <maya/MFnMesh.h>
+#include <maya/MIntArray.h>
+#include <maya/MMeshSmoothOptions.h>
+#include <maya/MObjectHandle.h>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
 
 using namespace frantic::maya::particles;
 
+namespace {
+
+// A converted mesh and the vertex to face corner map built from its topology
+struct mesh_vertex_topology {
+    frantic::geometry::trimesh3 mesh;
+    frantic::maya::geometry::vertex_corner_map vertexCorners;
+};
+
+// The number of bytes hashed by each task of hash_bytes
+const std::size_t HASH_CHUNK_SIZE = 64 * 1024;
+
+const boost::uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+const boost::uint64_t FNV_PRIME = 1099511628211ULL;
+
+inline boost::uint64_t fnv1a( boost::uint64_t hash, const unsigned char* data, std::size_t size ) {
+    for( std::size_t i = 0; i < size; ++i ) {
+        hash = ( hash ^ data[i] ) * FNV_PRIME;
+    }
+    return hash;
+}
+
+// Hashes each fixed-size chunk of a buffer
+class hash_chunks_body {
+    const unsigned char* m_data;
+    std::size_t m_size;
+    std::vector<boost::uint64_t>& m_chunkHashes;
+
+    hash_chunks_body& operator=( const hash_chunks_body& ); // not implemented
+
+  public:
+    hash_chunks_body( const unsigned char* data, std::size_t size, std::vector<boost::uint64_t>& chunkHashes )
+        : m_data( data )
+        , m_size( size )
+        , m_chunkHashes( chunkHashes ) {}
+
+    void operator()( const tbb::blocked_range<std::size_t>& range ) const {
+        for( std::size_t chunk = range.begin(); chunk != range.end(); ++chunk ) {
+            const std::size_t begin = chunk * HASH_CHUNK_SIZE;
+            const std::size_t end = std::min( begin + HASH_CHUNK_SIZE, m_size );
+            m_chunkHashes[chunk] = fnv1a( FNV_OFFSET_BASIS, m_data + begin, end - begin );
+        }
+    }
+};
+
+// Adds a buffer to a hash. The chunks are hashed in parallel and combined in order, so the result doesn't depend on
+// the number of threads.
+boost::uint64_t hash_bytes( boost::uint64_t hash, const void* data, std::size_t size ) {
+    hash = fnv1a( hash, reinterpret_cast<const unsigned char*>( &size ), sizeof( size ) );
+    if( size == 0 ) {
+        return hash;
+    }
+
+    std::vector<boost::uint64_t> chunkHashes( ( size + HASH_CHUNK_SIZE - 1 ) / HASH_CHUNK_SIZE );
+    tbb::parallel_for(
+        tbb::blocked_range<std::size_t>( 0, chunkHashes.size() ),
+        hash_chunks_body( reinterpret_cast<const unsigned char*>( data ), size, chunkHashes ) );
+    return fnv1a( hash, reinterpret_cast<const unsigned char*>( &chunkHashes[0] ),
+                  chunkHashes.size() * sizeof( boost::uint64_t ) );
+}
+
+template <class MayaArray, class T>
+boost::uint64_t hash_maya_array( boost::uint64_t hash, const MayaArray& values ) {
+    std::vector<T> buffer( values.length() );
+    if( !buffer.empty() ) {
+        values.get( &buffer[0] );
+    }
+    return hash_bytes( hash, buffer.empty() ? NULL : &buffer[0], buffer.size() * sizeof( T ) );
+}
+
+// Identifies the state of a Maya mesh that its conversion depends on: the counts, the smooth mesh preview settings,
+// and a hash of the positions, the face-vertex indices, and the normals, UVs and colors that are copied to the
+// trimesh3. Checking it lets a shared conversion be reused only if none of these have changed, even at the same frame.
+struct mesh_fingerprint {
+    int vertexCount;
+    int polygonCount;
+    int faceVertexCount;
+    int displaySmoothMesh;
+    int smoothDivisions;
+    int smoothBoundaryRule;
+    bool smoothUVs;
+    bool propEdgeHardness;
+    bool keepBorderEdge;
+    bool keepHardEdge;
+    boost::uint64_t dataHash;
+
+    bool operator==( const mesh_fingerprint& other ) const {
+        return vertexCount == other.vertexCount && polygonCount == other.polygonCount &&
+               faceVertexCount == other.faceVertexCount && displaySmoothMesh == other.displaySmoothMesh &&
+               smoothDivisions == other.smoothDivisions && smoothBoundaryRule == other.smoothBoundaryRule &&
+               smoothUVs == other.smoothUVs && propEdgeHardness == other.propEdgeHardness &&
+               keepBorderEdge == other.keepBorderEdge && keepHardEdge == other.keepHardEdge &&
+               dataHash == other.dataHash;
+    }
+};
+
+// Reads the mesh data that copy_maya_mesh reads, without converting it. It costs a copy of each of the arrays from
+// Maya and a parallel pass over them, which is much less than the conversion that a match saves. Maya keeps the plug's
+// value once it is evaluated, so copy_maya_mesh getting it again afterwards doesn't compute the mesh a second time.
+bool get_mesh_fingerprint( MPlug meshPlug, mesh_fingerprint& outFingerprint ) {
+    FRANTIC_MAYA_SCOPED_TIMER( "get_mesh_fingerprint" );
+    MStatus status;
+    MObject meshObj;
+    meshPlug.getValue( meshObj );
+    if( !meshObj.hasFn( MFn::kMesh ) ) {
+        return false;
+    }
+
+    MFnMesh fnMesh( meshObj, &status );
+    if( !status ) {
+        return false;
+    }
+
+    static const frantic::maya::attribute_accessor displaySmoothMeshAttribute( "displaySmoothMesh" );
+    outFingerprint.vertexCount = fnMesh.numVertices();
+    outFingerprint.polygonCount = fnMesh.numPolygons();
+    outFingerprint.faceVertexCount = fnMesh.numFaceVertices();
+    outFingerprint.displaySmoothMesh = displaySmoothMeshAttribute.get_int( fnMesh );
+
+    MMeshSmoothOptions smoothOptions;
+    fnMesh.getSmoothMeshDisplayOptions( smoothOptions );
+    outFingerprint.smoothDivisions = smoothOptions.divisions();
+    outFingerprint.smoothBoundaryRule = static_cast<int>( smoothOptions.boundaryRule() );
+    outFingerprint.smoothUVs = smoothOptions.smoothUVs();
+    outFingerprint.propEdgeHardness = smoothOptions.propEdgeHardness();
+    outFingerprint.keepBorderEdge = smoothOptions.keepBorderEdge();
+    outFingerprint.keepHardEdge = smoothOptions.keepHardEdge();
+
+    boost::uint64_t hash = FNV_OFFSET_BASIS;
+
+    const float* points = fnMesh.getRawPoints( &status );
+    hash = hash_bytes( hash, status ? points : NULL,
+                       status && points ? 3 * sizeof( float ) * static_cast<std::size_t>( fnMesh.numVertices() ) : 0 );
+
+    MIntArray faceCounts, faceVertices;
+    fnMesh.getVertices( faceCounts, faceVertices );
+    hash = hash_maya_array<MIntArray, int>( hash, faceCounts );
+    hash = hash_maya_array<MIntArray, int>( hash, faceVertices );
+
+    const float* normals = fnMesh.getRawNormals( &status );
+    hash = hash_bytes( hash, status ? normals : NULL,
+                       status && normals ? 3 * sizeof( float ) * static_cast<std::size_t>( fnMesh.numNormals() ) : 0 );
+    MIntArray normalCounts, normalIds;
+    fnMesh.getNormalIds( normalCounts, normalIds );
+    hash = hash_maya_array<MIntArray, int>( hash, normalIds );
+
+    MString uvSetName = fnMesh.currentUVSetName();
+    MFloatArray us, vs;
+    fnMesh.getUVs( us, vs, &uvSetName );
+    hash = hash_maya_array<MFloatArray, float>( hash, us );
+    hash = hash_maya_array<MFloatArray, float>( hash, vs );
+    MIntArray uvCounts, uvIds;
+    fnMesh.getAssignedUVs( uvCounts, uvIds, &uvSetName );
+    hash = hash_maya_array<MIntArray, int>( hash, uvCounts );
+    hash = hash_maya_array<MIntArray, int>( hash, uvIds );
+
+    MString colorSetName = fnMesh.currentColorSetName();
+    if( colorSetName.length() > 0 ) {
+        hash = fnv1a( hash, reinterpret_cast<const unsigned char*>( colorSetName.asChar() ), colorSetName.length() );
+        MColorArray colors;
+        fnMesh.getFaceVertexColors( colors, &colorSetName );
+        std::vector<float> colorBuffer( 4 * colors.length() );
+        for( unsigned int i = 0; i < colors.length(); ++i ) {
+            colorBuffer[4 * i] = colors[i].r;
+            colorBuffer[4 * i + 1] = colors[i].g;
+            colorBuffer[4 * i + 2] = colors[i].b;
+            colorBuffer[4 * i + 3] = colors[i].a;
+        }
+        hash = hash_bytes( hash, colorBuffer.empty() ? NULL : &colorBuffer[0], colorBuffer.size() * sizeof( float ) );
+    }
+
+    outFingerprint.dataHash = hash;
+    return true;
+}
+
+struct mesh_topology_entry {
+    MObjectHandle node;
+    std::string attribute;
+    double time;
+    mesh_fingerprint fingerprint;
+    boost::weak_ptr<mesh_vertex_topology> topology;
+};
+
+// The conversions in use by open streams. An entry is only kept alive by the streams that hold it, so the cache never
+// outlives the streams and needs no invalidation callbacks.
+struct mesh_topology_cache {
+    std::mutex mutex;
+    std::vector<mesh_topology_entry> entries;
+};
+
+mesh_topology_cache& get_mesh_topology_cache() {
+    static mesh_topology_cache cache;
+    return cache;
+}
+
+boost::shared_ptr<mesh_vertex_topology> get_mesh_vertex_topology( MPlug meshPlug ) {
+    mesh_topology_entry key;
+    key.node = MObjectHandle( meshPlug.node() );
+    key.attribute = meshPlug.partialName().asChar();
+    key.time = MAnimControl::currentTime().as( MTime::kSeconds );
+    const bool canShare = get_mesh_fingerprint( meshPlug, key.fingerprint );
+
+    mesh_topology_cache& cache = get_mesh_topology_cache();
+    if( canShare ) {
+        std::lock_guard<std::mutex> lock( cache.mutex );
+        for( std::vector<mesh_topology_entry>::iterator it = cache.entries.begin(); it != cache.entries.end(); ) {
+            boost::shared_ptr<mesh_vertex_topology> topology = it->topology.lock();
+            if( !topology || !it->node.isValid() ) {
+                it = cache.entries.erase( it );
+                continue;
+            }
+            if( it->node == key.node && it->attribute == key.attribute && it->time == key.time &&
+                it->fingerprint == key.fingerprint ) {
+                return topology;
+            }
+            ++it;
+        }
+    }
+
+    // Convert outside of the lock, so that streams on other meshes aren't held up
+    boost::shared_ptr<mesh_vertex_topology> topology = boost::make_shared<mesh_vertex_topology>();
+    frantic::maya::geometry::copy_maya_mesh( meshPlug, topology->mesh, true, true, true, true, true );
+    {
+        FRANTIC_MAYA_SCOPED_TIMER( "build_vertex_corner_map" );
+        const frantic::geometry::trimesh3& mesh = topology->mesh;
+        frantic::maya::geometry::build_vertex_corner_map( mesh.vertex_count(),
+                                                          mesh.face_count() > 0 ? &mesh.get_face( 0 ) : NULL,
+                                                          mesh.face_count(), topology->vertexCorners );
+        FRANTIC_MAYA_ADD_COUNT( "build_vertex_corner_map", mesh.face_count() );
+    }
+
+    if( canShare ) {
+        key.topology = topology;
+        std::lock_guard<std::mutex> lock( cache.mutex );
+        cache.entries.push_back( key );
+    }
+    return topology;
+}
+
+} // anonymous namespace
+
 const frantic::tstring maya_geometry_vert_particle_istream::s_positionChannel = _T( "Position" );
 const frantic::tstring maya_geometry_vert_particle_istream::s_velocityChannel = _T( "Velocity" );
 const frantic::tstring maya_geometry_vert_particle_istream::s_normalChannel = _T( "Normal" );
@@ -18,15 +277,19 @@ const frantic::tstring maya_geometry_vert_particle_istream::s_idChannel = _T( "I
 const frantic::tstring maya_geometry_vert_particle_istream::s_colorChannel = _T( "Color" );
 const frantic::tstring maya_geometry_vert_particle_istream::s_uvChannel = _T( "TextureCoord" );
 
-maya_geometry_vert_particle_istream::maya_geometry_vert_particle_istream( MPlug meshPlug )
-    : m_mesh( boost::make_shared<frantic::geometry::trimesh3>() ) {
+maya_geometry_vert_particle_istream::maya_geometry_vert_particle_istream( MPlug meshPlug,
+                                                                          bool averageFaceVaryingData )
+    : m_averageFaceVaryingData( averageFaceVaryingData ) {
     init_stream( meshPlug );
     set_channel_map( m_nativeMap );
 }
 
 maya_geometry_vert_particle_istream::~maya_geometry_vert_particle_istream() {}
 
-void maya_geometry_vert_particle_istream::close() { m_mesh.reset(); }
+void maya_geometry_vert_particle_istream::close() {
+    m_mesh.reset();
+    m_vertexCorners.reset();
+}
 
 frantic::tstring maya_geometry_vert_particle_istream::name() const { return _T( "maya_mesh_particle_istream" ); }
 
@@ -96,7 +359,10 @@ bool maya_geometry_vert_particle_istream::get_particle( char* rawParticleBuffer
     }
 
     if( m_particleAccessors.normal.is_valid() ) {
-        const frantic::graphics::vector3f normal = get_vertex_data( m_vertexAccessors.normal, m_currentParticle );
+        frantic::graphics::vector3f normal = get_vertex_data( m_vertexAccessors.normal, m_currentParticle );
+        if( m_averageFaceVaryingData && normal.get_magnitude_squared() > 0 ) {
+            normal.normalize();
+        }
         m_particleAccessors.normal.set( rawParticleBuffer, normal );
     }
 
@@ -131,9 +397,12 @@ bool maya_geometry_vert_particle_istream::get_particles( char* buffer, std::size
 }
 
 void maya_geometry_vert_particle_istream::init_stream( MPlug meshPlug ) {
-    frantic::maya::geometry::copy_maya_mesh( meshPlug, *m_mesh, true, true, true, true, true );
-
-    fill_vertex_to_face_and_corner_map();
+    // The mesh and map are shared, and only read from here on. The aliasing constructors keep the whole conversion
+    // alive for as long as either is held.
+    const boost::shared_ptr<mesh_vertex_topology> topology = get_mesh_vertex_topology( meshPlug );
+    m_mesh = boost::shared_ptr<frantic::geometry::trimesh3>( topology, &topology->mesh );
+    m_vertexCorners =
+        boost::shared_ptr<const frantic::maya::geometry::vertex_corner_map>( topology, &topology->vertexCorners );
 
     m_currentParticle = 0;
     m_totalParticles = m_mesh->vertex_count();
@@ -198,29 +467,29 @@ void maya_geometry_vert_particle_istream::init_accessors( const frantic::channel
     }
 }
 
-void maya_geometry_vert_particle_istream::fill_vertex_to_face_and_corner_map() {
-    m_vertexToFaceAndCorner.clear();
-    m_vertexToFaceAndCorner.resize( m_mesh->vertex_count() );
-
-    for( int faceIndex = 0; faceIndex < m_mesh->face_count(); ++faceIndex ) {
-        const frantic::graphics::vector3 face = m_mesh->get_face( faceIndex );
-        for( int corner = 0; corner < 3; ++corner ) {
-            const int vertIndex = face[corner];
-            m_vertexToFaceAndCorner[vertIndex].set( faceIndex, corner );
-        }
-    }
-}
-
 frantic::graphics::vector3f
 maya_geometry_vert_particle_istream::get_vertex_data( vertex_vector_acc_t& acc, boost::int64_t vertex,
                                                       frantic::graphics::vector3f fallback ) {
     if( acc.valid() ) {
         if( acc.has_custom_faces() ) {
-            face_and_corner mapping = m_vertexToFaceAndCorner[static_cast<std::size_t>( vertex )];
-            if( mapping.is_valid() ) {
-                const std::size_t faceIndex = static_cast<std::size_t>( mapping.face );
-                const std::size_t corner = static_cast<std::size_t>( mapping.corner );
-                return ( acc )[acc.face( faceIndex )[corner]];
+            const std::size_t vertexIndex = static_cast<std::size_t>( vertex );
+            if( m_averageFaceVaryingData ) {
+                const std::size_t cornerCount = m_vertexCorners->corner_count( vertexIndex );
+                if( cornerCount > 0 ) {
+                    frantic::graphics::vector3f sum( 0.0f, 0.0f, 0.0f );
+                    for( std::size_t i = m_vertexCorners->offsets[vertexIndex],
+                                     ie = m_vertexCorners->offsets[vertexIndex + 1];
+                         i != ie; ++i ) {
+                        const std::size_t faceCorner = m_vertexCorners->corners[i];
+                        sum += ( acc )[acc.face( faceCorner / 3 )[faceCorner % 3]];
+                    }
+                    return sum / static_cast<float>( cornerCount );
+                }
+            } else {
+                std::size_t faceIndex, corner;
+                if( m_vertexCorners->get_representative_corner( vertexIndex, faceIndex, corner ) ) {
+                    return ( acc )[acc.face( faceIndex )[corner]];
+                }
             }
             throw std::runtime_error( "maya_geometry_vert_particle_istream::get_vertex_data: invalid mapping" );
         } else {
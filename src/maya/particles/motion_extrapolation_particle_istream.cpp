@@ -0,0 +1,161 @@
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+#include "stdafx.h"
+
+#include <frantic/maya/particles/motion_extrapolation_particle_istream.hpp>
+
+#include <cstring>
+
+namespace frantic {
+namespace maya {
+namespace particles {
+
+motion_extrapolation_particle_istream::motion_extrapolation_particle_istream(
+    boost::shared_ptr<frantic::particles::streams::particle_istream> pin, double timeOffset,
+    const frantic::tstring& velocityChannelName, const frantic::tstring& accelerationChannelName )
+    : m_delegate( pin )
+    , m_timeOffset( static_cast<float>( timeOffset ) )
+    , m_velocityChannelName( velocityChannelName )
+    , m_accelerationChannelName( accelerationChannelName )
+    , m_particleIndex( -1 )
+    , m_isExtrapolating( false )
+    , m_hasVelocity( false )
+    , m_hasAcceleration( false )
+    , m_updateVelocity( false ) {
+    if( !m_delegate ) {
+        throw std::runtime_error( "motion_extrapolation_particle_istream error: The delegate stream is NULL." );
+    }
+
+    set_channel_map( m_delegate->get_channel_map() );
+}
+
+void motion_extrapolation_particle_istream::set_channel_map(
+    const frantic::channels::channel_map& particleChannelMap ) {
+    // Preserve any existing default particle values in the new layout.
+    std::vector<char> newDefaultParticle( particleChannelMap.structure_size() );
+    if( m_defaultParticle.size() > 0 ) {
+        frantic::channels::channel_map_adaptor oldToNewChannelMapAdaptor( particleChannelMap, m_channelMap );
+        oldToNewChannelMapAdaptor.copy_structure( &newDefaultParticle[0], &m_defaultParticle[0] );
+    } else if( !newDefaultParticle.empty() ) {
+        memset( &newDefaultParticle[0], 0, newDefaultParticle.size() );
+    }
+    m_defaultParticle.swap( newDefaultParticle );
+
+    m_channelMap = particleChannelMap;
+
+    const frantic::channels::channel_map& nativeChannelMap = m_delegate->get_native_channel_map();
+    m_hasVelocity = nativeChannelMap.has_channel( m_velocityChannelName );
+    m_hasAcceleration =
+        !m_accelerationChannelName.empty() && nativeChannelMap.has_channel( m_accelerationChannelName );
+    m_isExtrapolating =
+        m_timeOffset != 0 && m_channelMap.has_channel( _T("Position") ) && ( m_hasVelocity || m_hasAcceleration );
+
+    // The delegate must also provide the velocity and acceleration, even if they weren't requested.
+    m_delegateChannelMap = particleChannelMap;
+    if( m_isExtrapolating ) {
+        if( m_hasVelocity && !m_delegateChannelMap.has_channel( m_velocityChannelName ) ) {
+            m_delegateChannelMap.append_channel( m_velocityChannelName, 3, frantic::channels::data_type_float32 );
+        }
+        if( m_hasAcceleration && !m_delegateChannelMap.has_channel( m_accelerationChannelName ) ) {
+            m_delegateChannelMap.append_channel( m_accelerationChannelName, 3, frantic::channels::data_type_float32 );
+        }
+
+        m_positionAccessor = m_delegateChannelMap.get_cvt_accessor<frantic::graphics::vector3f>( _T("Position") );
+        if( m_hasVelocity ) {
+            m_velocityAccessor =
+                m_delegateChannelMap.get_cvt_accessor<frantic::graphics::vector3f>( m_velocityChannelName );
+        }
+        if( m_hasAcceleration ) {
+            m_accelerationAccessor =
+                m_delegateChannelMap.get_cvt_accessor<frantic::graphics::vector3f>( m_accelerationChannelName );
+        }
+    }
+    m_updateVelocity = m_isExtrapolating && m_hasVelocity && m_hasAcceleration &&
+                       m_channelMap.has_channel( m_velocityChannelName );
+    m_delegate->set_channel_map( m_delegateChannelMap );
+
+    m_cma.set( m_channelMap, m_delegateChannelMap );
+    m_delegateParticle.resize( m_delegateChannelMap.structure_size() );
+
+    set_default_particle( m_defaultParticle.empty() ? NULL : &m_defaultParticle[0] );
+}
+
+void motion_extrapolation_particle_istream::set_default_particle( char* rawParticleBuffer ) {
+    if( !rawParticleBuffer ) {
+        return;
+    }
+
+    if( rawParticleBuffer != &m_defaultParticle[0] ) {
+        memcpy( &m_defaultParticle[0], rawParticleBuffer, m_channelMap.structure_size() );
+    }
+
+    // Every channel we output comes through the delegate, so the default values are applied there.
+    std::vector<char> delegateDefaultParticle( m_delegateChannelMap.structure_size() );
+    memset( &delegateDefaultParticle[0], 0, delegateDefaultParticle.size() );
+    frantic::channels::channel_map_adaptor toDelegate( m_delegateChannelMap, m_channelMap );
+    toDelegate.copy_structure( &delegateDefaultParticle[0], &m_defaultParticle[0] );
+    m_delegate->set_default_particle( &delegateDefaultParticle[0] );
+}
+
+void motion_extrapolation_particle_istream::extrapolate( char* particle ) const {
+    const frantic::graphics::vector3f velocity =
+        m_hasVelocity ? m_velocityAccessor.get( particle ) : frantic::graphics::vector3f( 0 );
+
+    if( m_hasAcceleration ) {
+        const frantic::graphics::vector3f acceleration = m_accelerationAccessor.get( particle );
+        m_positionAccessor.set( particle, m_positionAccessor.get( particle ) + m_timeOffset * velocity +
+                                              ( 0.5f * m_timeOffset * m_timeOffset ) * acceleration );
+        if( m_updateVelocity ) {
+            m_velocityAccessor.set( particle, velocity + m_timeOffset * acceleration );
+        }
+    } else {
+        m_positionAccessor.set( particle, m_positionAccessor.get( particle ) + m_timeOffset * velocity );
+    }
+}
+
+bool motion_extrapolation_particle_istream::get_particle( char* outParticleBuffer ) {
+    // When the delegate is already providing our layout, read straight into the output buffer.
+    const bool directRead = m_cma.is_identity();
+    char* buffer = directRead ? outParticleBuffer : &m_delegateParticle[0];
+
+    if( !m_delegate->get_particle( buffer ) ) {
+        return false;
+    }
+
+    if( m_isExtrapolating ) {
+        extrapolate( buffer );
+    }
+    if( !directRead ) {
+        m_cma.copy_structure( outParticleBuffer, buffer );
+    }
+
+    ++m_particleIndex;
+    return true;
+}
+
+bool motion_extrapolation_particle_istream::get_particles( char* buffer, std::size_t& numParticles ) {
+    if( m_cma.is_identity() ) {
+        const bool result = m_delegate->get_particles( buffer, numParticles );
+        if( m_isExtrapolating ) {
+            const std::size_t particleSize = m_channelMap.structure_size();
+            for( std::size_t i = 0; i < numParticles; ++i ) {
+                extrapolate( buffer + i * particleSize );
+            }
+        }
+        m_particleIndex += static_cast<boost::int64_t>( numParticles );
+        return result;
+    }
+
+    const std::size_t particleSize = m_channelMap.structure_size();
+    for( std::size_t i = 0; i < numParticles; ++i ) {
+        if( !get_particle( buffer + i * particleSize ) ) {
+            numParticles = i;
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace particles
+} // namespace maya
+} // namespace frantic
@@ -0,0 +1,111 @@
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+#include "stdafx.h"
+
+#include <frantic/maya/particles/particle_statistics.hpp>
+
+#include <frantic/channels/channel_map.hpp>
+
+namespace {
+
+// The number of particles read from the stream at a time
+const std::size_t STATISTICS_BLOCK_SIZE = 4096;
+
+// Tracks the range of one channel of the particles read from a stream
+struct channel_range_tracker {
+    frantic::tstring name;
+    std::size_t arity;
+    frantic::channels::channel_cvt_accessor<double> scalarAccessor;
+    frantic::channels::channel_cvt_accessor<frantic::graphics::vector3f> vectorAccessor;
+    double minimum[3];
+    double maximum[3];
+
+    channel_range_tracker()
+        : arity( 0 ) {
+        for( int i = 0; i < 3; ++i ) {
+            minimum[i] = std::numeric_limits<double>::max();
+            maximum[i] = -std::numeric_limits<double>::max();
+        }
+    }
+
+    void add( const char* particle ) {
+        if( arity == 1 ) {
+            const double value = scalarAccessor.get( particle );
+            minimum[0] = std::min( minimum[0], value );
+            maximum[0] = std::max( maximum[0], value );
+        } else {
+            const frantic::graphics::vector3f value = vectorAccessor.get( particle );
+            for( int i = 0; i < 3; ++i ) {
+                minimum[i] = std::min( minimum[i], static_cast<double>( value[i] ) );
+                maximum[i] = std::max( maximum[i], static_cast<double>( value[i] ) );
+            }
+        }
+    }
+};
+
+} // anonymous namespace
+
+namespace frantic {
+namespace maya {
+namespace particles {
+
+void compute_particle_stream_statistics( frantic::particles::streams::particle_istream& stream,
+                                         particle_stream_statistics& outStats ) {
+    outStats.clear();
+
+    const frantic::channels::channel_map& channelMap = stream.get_native_channel_map();
+    stream.set_channel_map( channelMap );
+
+    std::vector<channel_range_tracker> trackers;
+    for( std::size_t i = 0; i < channelMap.channel_count(); ++i ) {
+        const frantic::channels::channel& ch = channelMap[i];
+        if( ch.arity() != 1 && ch.arity() != 3 ) {
+            continue;
+        }
+        channel_range_tracker tracker;
+        tracker.name = ch.name();
+        tracker.arity = ch.arity();
+        if( tracker.arity == 1 ) {
+            tracker.scalarAccessor = channelMap.get_cvt_accessor<double>( tracker.name );
+        } else {
+            tracker.vectorAccessor = channelMap.get_cvt_accessor<frantic::graphics::vector3f>( tracker.name );
+        }
+        trackers.push_back( tracker );
+    }
+
+    const std::size_t particleSize = channelMap.structure_size();
+    std::vector<char> buffer( STATISTICS_BLOCK_SIZE * particleSize );
+    boost::int64_t particleCount = 0;
+    bool more = !buffer.empty();
+    while( more ) {
+        std::size_t numParticles = STATISTICS_BLOCK_SIZE;
+        more = stream.get_particles( &buffer[0], numParticles );
+        for( std::size_t p = 0; p < numParticles; ++p ) {
+            const char* particle = &buffer[p * particleSize];
+            for( std::vector<channel_range_tracker>::iterator it = trackers.begin(); it != trackers.end(); ++it ) {
+                it->add( particle );
+            }
+        }
+        particleCount += static_cast<boost::int64_t>( numParticles );
+    }
+
+    outStats.particleCount = particleCount;
+    if( particleCount == 0 ) {
+        return;
+    }
+
+    for( std::vector<channel_range_tracker>::const_iterator it = trackers.begin(); it != trackers.end(); ++it ) {
+        particle_channel_range& range = outStats.channelRanges[it->name];
+        range.minimum.assign( it->minimum, it->minimum + it->arity );
+        range.maximum.assign( it->maximum, it->maximum + it->arity );
+        if( it->name == _T("Position") && it->arity == 3 ) {
+            outStats.bounds = frantic::graphics::boundbox3f(
+                frantic::graphics::vector3f( (float)it->minimum[0], (float)it->minimum[1], (float)it->minimum[2] ),
+                frantic::graphics::vector3f( (float)it->maximum[0], (float)it->maximum[1], (float)it->maximum[2] ) );
+        }
+    }
+}
+
+} // namespace particles
+} // namespace maya
+} // namespace frantic
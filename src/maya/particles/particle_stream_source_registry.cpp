@@ -0,0 +1,337 @@
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+#include "stdafx.h"
+
+#include <frantic/maya/maya_util.hpp>
+#include <frantic/maya/particles/particle_stream_source_registry.hpp>
+#include <frantic/maya/plugin_manager.hpp>
+
+#include <maya/MDagPathArray.h>
+#include <maya/MFnAttribute.h>
+#include <maya/MFnDependencyNode.h>
+#include <maya/MItDag.h>
+#include <maya/MNodeMessage.h>
+#include <maya/MObjectHandle.h>
+#include <maya/MPlug.h>
+
+#include <map>
+
+namespace frantic {
+namespace maya {
+namespace particles {
+
+namespace {
+
+// A tracked node.  Removed nodes are marked rather than erased, so that removing a node keeps the order of the others
+// without shifting them.
+struct source_entry {
+    MObjectHandle handle;
+    bool isRemoved;
+
+    explicit source_entry( const MObjectHandle& handle )
+        : handle( handle )
+        , isRemoved( false ) {}
+};
+
+// The positions in registry_state::sources of the tracked nodes, bucketed by MObjectHandle::hashCode() so that adding
+// and removing a node does not depend on the number of tracked nodes.
+typedef std::map<unsigned int, std::vector<std::size_t>> source_index_t;
+
+// An attribute added callback on a DAG node that does not have the particle stream output attribute yet
+struct attribute_callback_entry {
+    MObjectHandle handle;
+    MCallbackId callbackId;
+
+    attribute_callback_entry( const MObjectHandle& handle, MCallbackId callbackId )
+        : handle( handle )
+        , callbackId( callbackId ) {}
+};
+
+// The attribute added callbacks, bucketed by MObjectHandle::hashCode() like source_index_t
+typedef std::map<unsigned int, std::vector<attribute_callback_entry>> attribute_callback_index_t;
+
+struct registry_state {
+    // The tracked nodes in the order they were added, which is the depth-first order of the DAG after a rebuild
+    std::vector<source_entry> sources;
+    source_index_t index;
+    attribute_callback_index_t attributeCallbacks;
+    std::size_t removedCount;
+    MString outputStreamAttr;
+    bool isActive;
+    bool isDirty;
+
+    registry_state()
+        : removedCount( 0 )
+        , isActive( false )
+        , isDirty( true ) {}
+
+    void clear() {
+        sources.clear();
+        index.clear();
+        removedCount = 0;
+
+        for( attribute_callback_index_t::const_iterator it = attributeCallbacks.begin(); it != attributeCallbacks.end();
+             ++it ) {
+            for( std::size_t i = 0; i < it->second.size(); ++i ) {
+                MMessage::removeCallback( it->second[i].callbackId );
+            }
+        }
+        attributeCallbacks.clear();
+    }
+};
+
+registry_state& get_state() {
+    static registry_state state;
+    return state;
+}
+
+bool is_candidate( const MObject& node ) {
+    if( node.isNull() || !node.hasFn( MFn::kDagNode ) )
+        return false;
+    if( node.hasFn( MFn::kParticle ) )
+        return true;
+
+    MStatus status;
+    MFnDependencyNode fnNode( node, &status );
+    return status && fnNode.hasAttribute( get_state().outputStreamAttr );
+}
+
+// Erases the removed entries, keeping the order of the others, and rebuilds the index
+void compact_sources() {
+    registry_state& state = get_state();
+
+    std::vector<source_entry> sources;
+    sources.reserve( state.sources.size() - state.removedCount );
+    for( std::vector<source_entry>::const_iterator it = state.sources.begin(); it != state.sources.end(); ++it ) {
+        if( !it->isRemoved )
+            sources.push_back( *it );
+    }
+
+    state.sources.swap( sources );
+    state.index.clear();
+    state.removedCount = 0;
+    for( std::size_t i = 0; i < state.sources.size(); ++i ) {
+        state.index[state.sources[i].handle.hashCode()].push_back( i );
+    }
+}
+
+void attribute_callback( MNodeMessage::AttributeMessage msg, MPlug& plug, void* clientData );
+
+// Watches a DAG node that is not tracked for its particle stream output attribute being added as a dynamic attribute
+void watch_attributes( const MObject& node ) {
+    registry_state& state = get_state();
+    if( node.isNull() || !node.hasFn( MFn::kDagNode ) )
+        return;
+
+    MObjectHandle handle( node );
+    std::vector<attribute_callback_entry>& bucket = state.attributeCallbacks[handle.hashCode()];
+    for( std::size_t i = 0; i < bucket.size(); ++i ) {
+        if( bucket[i].handle == handle )
+            return;
+    }
+
+    MStatus status;
+    MObject watchedNode( node );
+    MCallbackId callbackId =
+        MNodeMessage::addAttributeAddedOrRemovedCallback( watchedNode, &attribute_callback, NULL, &status );
+    if( status )
+        bucket.push_back( attribute_callback_entry( handle, callbackId ) );
+    else if( bucket.empty() )
+        state.attributeCallbacks.erase( handle.hashCode() );
+}
+
+void unwatch_attributes( const MObject& node ) {
+    registry_state& state = get_state();
+
+    MObjectHandle handle( node );
+    attribute_callback_index_t::iterator it = state.attributeCallbacks.find( handle.hashCode() );
+    if( it == state.attributeCallbacks.end() )
+        return;
+
+    std::vector<attribute_callback_entry>& bucket = it->second;
+    for( std::size_t i = 0; i < bucket.size(); ++i ) {
+        if( bucket[i].handle == handle ) {
+            MMessage::removeCallback( bucket[i].callbackId );
+            bucket.erase( bucket.begin() + i );
+            break;
+        }
+    }
+    if( bucket.empty() )
+        state.attributeCallbacks.erase( it );
+}
+
+void add_source( const MObject& node ) {
+    registry_state& state = get_state();
+    if( state.isDirty )
+        return;
+    if( !is_candidate( node ) ) {
+        watch_attributes( node );
+        return;
+    }
+
+    MObjectHandle handle( node );
+    std::vector<std::size_t>& bucket = state.index[handle.hashCode()];
+    for( std::size_t i = 0; i < bucket.size(); ++i ) {
+        if( state.sources[bucket[i]].handle == handle )
+            return;
+    }
+    bucket.push_back( state.sources.size() );
+    state.sources.push_back( source_entry( handle ) );
+}
+
+void remove_source( const MObject& node ) {
+    registry_state& state = get_state();
+    if( state.isDirty )
+        return;
+    unwatch_attributes( node );
+    if( !is_candidate( node ) )
+        return;
+
+    MObjectHandle handle( node );
+    source_index_t::iterator it = state.index.find( handle.hashCode() );
+    if( it == state.index.end() )
+        return;
+
+    std::vector<std::size_t>& bucket = it->second;
+    for( std::size_t i = 0; i < bucket.size(); ++i ) {
+        if( state.sources[bucket[i]].handle == handle ) {
+            state.sources[bucket[i]].isRemoved = true;
+            ++state.removedCount;
+            bucket.erase( bucket.begin() + i );
+            break;
+        }
+    }
+    if( bucket.empty() )
+        state.index.erase( it );
+
+    // Compacting costs as much as the removals since the last one, so removing a node stays constant time on average
+    if( state.removedCount * 2 > state.sources.size() )
+        compact_sources();
+}
+
+void rebuild_sources() {
+    registry_state& state = get_state();
+    state.clear();
+    state.isDirty = false;
+
+    for( MItDag iter( MItDag::kDepthFirst ); !iter.isDone(); iter.next() ) {
+        add_source( iter.currentItem() );
+    }
+}
+
+void node_added_callback( MObject& node, void* /*clientData*/ ) { add_source( node ); }
+
+void node_removed_callback( MObject& node, void* /*clientData*/ ) { remove_source( node ); }
+
+// Dynamic particle stream attributes may be added after a node is created.  They are picked up here, on the nodes
+// watched by watch_attributes.
+void attribute_callback( MNodeMessage::AttributeMessage msg, MPlug& plug, void* /*clientData*/ ) {
+    if( ( msg & MNodeMessage::kAttributeAdded ) &&
+        MFnAttribute( plug.attribute() ).name() == get_state().outputStreamAttr )
+        add_source( plug.node() );
+}
+
+// Also picks up the nodes whose attribute added callback could not be registered, when their particle stream
+// attribute is first connected.
+void connection_callback( MPlug& srcPlug, MPlug& destPlug, bool made, void* /*clientData*/ ) {
+    if( made ) {
+        add_source( srcPlug.node() );
+        add_source( destPlug.node() );
+    }
+}
+
+void scene_reset_callback( void* /*clientData*/ ) { particle_stream_source_registry::invalidate(); }
+
+// Called by plugin_manager::unregister_all(), after which nothing keeps the registry up to date
+void deactivate_registry() {
+    get_state().isActive = false;
+    particle_stream_source_registry::invalidate();
+}
+
+} // namespace
+
+MStatus particle_stream_source_registry::register_callbacks( plugin_manager& pluginManager,
+                                                             const MString& outputStreamAttr ) {
+    using namespace std; // For CHECK_MSTATUS_AND_RETURN_IT
+    MStatus status;
+
+    registry_state& state = get_state();
+    state.outputStreamAttr = outputStreamAttr;
+    invalidate();
+
+    status = pluginManager.register_node_added_callback( &node_added_callback );
+    CHECK_MSTATUS_AND_RETURN_IT( status );
+    status = pluginManager.register_node_removed_callback( &node_removed_callback );
+    CHECK_MSTATUS_AND_RETURN_IT( status );
+    status = pluginManager.register_connection_callback( &connection_callback );
+    CHECK_MSTATUS_AND_RETURN_IT( status );
+    status = pluginManager.register_callback<detail::register_callback_t>( MSceneMessage::kBeforeNew,
+                                                                            &scene_reset_callback );
+    CHECK_MSTATUS_AND_RETURN_IT( status );
+    status = pluginManager.register_callback<detail::register_callback_t>( MSceneMessage::kBeforeOpen,
+                                                                            &scene_reset_callback );
+    CHECK_MSTATUS_AND_RETURN_IT( status );
+    status = pluginManager.register_unload_function( &deactivate_registry, _T("particle_stream_source_registry") );
+    CHECK_MSTATUS_AND_RETURN_IT( status );
+
+    state.isActive = true;
+    return MS::kSuccess;
+}
+
+bool particle_stream_source_registry::is_active() { return get_state().isActive; }
+
+void particle_stream_source_registry::invalidate() {
+    registry_state& state = get_state();
+    state.clear();
+    state.isDirty = true;
+}
+
+void particle_stream_source_registry::get_sources( std::vector<MObject>& outNodes ) {
+    outNodes.clear();
+
+    registry_state& state = get_state();
+    if( state.isDirty )
+        rebuild_sources();
+
+    for( std::vector<source_entry>::const_iterator it = state.sources.begin(); it != state.sources.end(); ++it ) {
+        // Deleted nodes may still be held by the undo queue, and are skipped until they are removed or restored
+        if( !it->isRemoved && it->handle.isValid() )
+            outNodes.push_back( it->handle.object() );
+    }
+}
+
+bool particle_stream_source_registry::find_nodes_with_output_stream( std::vector<MDagPath>& outPaths,
+                                                                     std::vector<MObject>& outNodes,
+                                                                     bool isBeginning,
+                                                                     const MString& outputStreamAttr ) {
+    registry_state& state = get_state();
+    if( !state.isActive || outputStreamAttr != state.outputStreamAttr )
+        return false;
+
+    // Take a copy of the sources, since checking them may create PRTMayaParticle wrapper nodes
+    std::vector<MObject> sources;
+    get_sources( sources );
+
+    outPaths.clear();
+    outNodes.clear();
+
+    MDagPathArray instancePaths;
+    for( std::vector<MObject>::const_iterator it = sources.begin(); it != sources.end(); ++it ) {
+        MObject streamNode;
+        if( !maya_util::get_output_stream_node( *it, isBeginning, outputStreamAttr, streamNode ) )
+            continue;
+
+        if( !MDagPath::getAllPathsTo( *it, instancePaths ) )
+            continue;
+        for( unsigned int i = 0; i < instancePaths.length(); ++i ) {
+            outPaths.push_back( instancePaths[i] );
+            outNodes.push_back( streamNode );
+        }
+    }
+
+    return true;
+}
+
+} // namespace particles
+} // namespace maya
+} // namespace frantic
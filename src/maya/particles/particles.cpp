@@ -4,20 +4,27 @@
 
 #include <frantic/maya/particles/particles.hpp>
 
+#include <frantic/maya/particles/channel_conversion.hpp>
+#include <frantic/maya/particles/viewport_particle_istream.hpp>
+
 #include <maya/MDGContext.h>
 #include <maya/MDoubleArray.h>
 #include <maya/MFnDoubleArrayData.h>
 #include <maya/MFnParticleSystem.h>
 #include <maya/MFnVectorArrayData.h>
 #include <maya/MGlobal.h>
+#include <maya/MIntArray.h>
 #include <maya/MPlug.h>
 #include <maya/MVectorArray.h>
 
 #include <frantic/channels/named_channel_data.hpp>
 #include <frantic/graphics/vector3f.hpp>
 #include <frantic/maya/convert.hpp>
+#include <frantic/maya/logging/instrumentation.hpp>
 
 #include <boost/bimap.hpp>
+
+#include <algorithm>
 #include <vector>
 
 using namespace frantic::channels;
@@ -58,6 +65,8 @@ void enusure_bimap_initialized() {
                                                            frantic::maya::particles::MayaAgeChannelName ) );
         PRTMayaBiMap.insert( prt_maya_bimap_t::value_type( frantic::maya::particles::PRTLifeSpanChannelName,
                                                            frantic::maya::particles::MayaLifeSpanChannelName ) );
+        PRTMayaBiMap.insert( prt_maya_bimap_t::value_type( frantic::maya::particles::PRTAccelerationChannelName,
+                                                           frantic::maya::particles::MayaAccelerationChannelName ) );
         initialized = true;
     }
 }
@@ -95,6 +104,111 @@ MStatus get_attribute_value( const MFnDependencyNode& fnNode, const frantic::tst
     return status;
 }
 
+// Finds the data a particle system holds for a channel, under both its 'Per Particle (PP)' name and its plain name
+void find_channel_data( const MFnParticleSystem& particleSystem, const MDGContext& currentContext,
+                        const frantic::tstring& mayaName, MObject& outPerParticleData, MObject& outParticleData ) {
+    particleSystem.findPlug( ( mayaName + _T( "PP" ) ).c_str() )
+        .getValue( outPerParticleData, const_cast<MDGContext&>( currentContext ) );
+    particleSystem.findPlug( mayaName.c_str() ).getValue( outParticleData, const_cast<MDGContext&>( currentContext ) );
+}
+
+// Whether a channel is read from one of the particle system's per-particle arrays. The other channels have the same
+// value for every particle: a per-object attribute, or zero for a vector channel the particle system doesn't have.
+bool is_per_particle_channel( const channel& currentChannel, const MObject& perParticleData,
+                              const MObject& particleData ) {
+    using namespace frantic::maya::particles;
+
+    const frantic::tstring& channelName = currentChannel.name();
+    const channel_type currentType = std::make_pair( currentChannel.data_type(), currentChannel.arity() );
+    if( is_vector_channel_type( currentType ) ) {
+        return channelName == PRTPositionChannelName || channelName == PRTColorChannelName ||
+               channelName == PRTVelocityChannelName || perParticleData.apiType() == MFn::kVectorArrayData ||
+               particleData.apiType() == MFn::kVectorArrayData;
+    } else if( is_float_channel_type( currentType ) ) {
+        return channelName == PRTDensityChannelName || channelName == PRTAgeChannelName ||
+               channelName == PRTLifeSpanChannelName || perParticleData.apiType() == MFn::kDoubleArrayData ||
+               particleData.apiType() == MFn::kDoubleArrayData;
+    } else if( is_int_channel_type( currentType ) ) {
+        return perParticleData.apiType() == MFn::kDoubleArrayData || particleData.apiType() == MFn::kDoubleArrayData;
+    }
+    // channels of any other type are not filled in, so there is nothing to share between particles
+    return true;
+}
+
+// Reads the value of a channel that is the same for every particle into outConstants
+bool get_constant_channel_value( const MFnParticleSystem& particleSystem, const MDGContext& currentContext,
+                                 const channel& currentChannel, const frantic::tstring& mayaName,
+                                 frantic::maya::particles::constant_channel_table& outConstants ) {
+    const frantic::tstring& channelName = currentChannel.name();
+    const channel_type currentType = std::make_pair( currentChannel.data_type(), currentChannel.arity() );
+    MStatus getStatus = MStatus::kSuccess;
+
+    if( is_vector_channel_type( currentType ) ) {
+        frantic::tstring systemName = frantic::maya::from_maya_t( particleSystem.particleName() );
+        FF_LOG( debug ) << _T( "Neither \"" ) + mayaName + _T( "\" or \"" ) + mayaName +
+                               _T( "PP\" channels were found in the maya particle system \"" ) + systemName +
+                               _T( "\". The \"" ) + channelName + _T( "\" channel will default to [0,0,0]\n" );
+        // channel not found (often happens for normalDir), set the channel to all zeros.
+        outConstants.set_value( channelName, currentChannel.arity(), currentChannel.data_type(),
+                                vector3f( 0.0f, 0.0f, 0.0f ) );
+    } else if( is_float_channel_type( currentType ) ) {
+        double value = particleSystem.findPlug( mayaName.c_str() )
+                           .asDouble( const_cast<MDGContext&>( currentContext ), &getStatus );
+        if( getStatus == MStatus::kSuccess ) {
+            outConstants.set_value( channelName, currentChannel.arity(), currentChannel.data_type(), value );
+        }
+    } else if( is_int_channel_type( currentType ) ) {
+        boost::int64_t value = (boost::int64_t)particleSystem.findPlug( mayaName.c_str() )
+                                   .asInt( const_cast<MDGContext&>( currentContext ), &getStatus );
+        if( getStatus == MStatus::kSuccess ) {
+            outConstants.set_value( channelName, currentChannel.arity(), currentChannel.data_type(), value );
+        }
+    }
+
+    if( getStatus != MStatus::kSuccess ) {
+        // instead of erroring, maybe we should just set it to zero (that is what the "vector" type is
+        // doing, since KMY requests normalDir, and it's not usually there)
+        std::ostringstream errorText;
+        errorText << "Could not get \"" << frantic::strings::to_string( mayaName ) << "\" from NParticle object.";
+        MGlobal::displayError( errorText.str().c_str() );
+        return false;
+    }
+    return true;
+}
+
+// Copies the value of each constant channel into every particle
+void expand_constant_channels( const frantic::maya::particles::constant_channel_table& constants,
+                               particle_array& outParticleArray ) {
+    const channel_map& constantChannelMap = constants.get_channel_map();
+    const channel_map& particleChannelMap = outParticleArray.get_channel_map();
+    for( std::size_t i = 0; i < constantChannelMap.channel_count(); ++i ) {
+        const channel& currentChannel = constantChannelMap[i];
+        const frantic::tstring& channelName = currentChannel.name();
+        const channel_type currentType = std::make_pair( currentChannel.data_type(), currentChannel.arity() );
+
+        if( is_vector_channel_type( currentType ) ) {
+            channel_cvt_accessor<vector3f> accessor = particleChannelMap.get_cvt_accessor<vector3f>( channelName );
+            const vector3f value = constants.get_value<vector3f>( channelName );
+            for( particle_array::iterator it = outParticleArray.begin(); it != outParticleArray.end(); ++it ) {
+                accessor.set( *it, value );
+            }
+        } else if( is_float_channel_type( currentType ) ) {
+            channel_cvt_accessor<double> accessor = particleChannelMap.get_cvt_accessor<double>( channelName );
+            const double value = constants.get_value<double>( channelName );
+            for( particle_array::iterator it = outParticleArray.begin(); it != outParticleArray.end(); ++it ) {
+                accessor.set( *it, value );
+            }
+        } else if( is_int_channel_type( currentType ) ) {
+            channel_cvt_accessor<boost::int64_t> accessor =
+                particleChannelMap.get_cvt_accessor<boost::int64_t>( channelName );
+            const boost::int64_t value = constants.get_value<boost::int64_t>( channelName );
+            for( particle_array::iterator it = outParticleArray.begin(); it != outParticleArray.end(); ++it ) {
+                accessor.set( *it, value );
+            }
+        }
+    }
+}
+
 MStatus copy_value( const MObject& obj, MVectorArray& out ) {
     MStatus status;
 
@@ -145,6 +259,7 @@ const frantic::tstring MayaRotationChannelName = _T( "rotation" );
 const frantic::tstring MayaEmissionChannelName = _T( "incandescence" );
 const frantic::tstring MayaAgeChannelName = _T( "age" );
 const frantic::tstring MayaLifeSpanChannelName = _T( "lifespan" );
+const frantic::tstring MayaAccelerationChannelName = _T( "acceleration" );
 
 const frantic::tstring MayaGlobalRedChannelName = _T( "colorRed" );
 const frantic::tstring MayaGlobalGreenChannelName = _T( "colorGreen" );
@@ -162,6 +277,7 @@ const frantic::tstring PRTTangentChannelName = _T( "Tangent" );
 const frantic::tstring PRTAbsorptionChannelName = _T( "Absorption" );
 const frantic::tstring PRTAgeChannelName = _T( "Age" );
 const frantic::tstring PRTLifeSpanChannelName = _T( "LifeSpan" );
+const frantic::tstring PRTAccelerationChannelName = _T( "Acceleration" );
 
 /**
  * Get the standard PRT channel name, given a maya channel name. If no such
@@ -246,33 +362,79 @@ void get_maya_channel_name_default( const frantic::tstring& prtName, frantic::ts
  */
 bool grab_maya_particles( const MFnParticleSystem& particleSystem, const MDGContext& currentContext,
                           const channel_map& channelMap, particle_array& outParticleArray ) {
+    return grab_maya_particles( particleSystem, currentContext, channelMap, NULL, outParticleArray );
+}
+
+bool grab_maya_particles( const MFnParticleSystem& particleSystem, const MDGContext& currentContext,
+                          const channel_map& channelMap, const std::vector<unsigned int>* selection,
+                          particle_array& outParticleArray ) {
+    return grab_maya_particles( particleSystem, currentContext, channelMap, selection, outParticleArray, NULL );
+}
+
+bool grab_maya_particles( const MFnParticleSystem& particleSystem, const MDGContext& currentContext,
+                          const channel_map& channelMap, const std::vector<unsigned int>* selection,
+                          particle_array& outParticleArray, constant_channel_table* outConstants ) {
+    FRANTIC_MAYA_SCOPED_TIMER( "grab_maya_particles" );
+
+    const std::size_t sourceCount = particleSystem.count();
+    const std::size_t outCount = selection ? selection->size() : sourceCount;
+
+    if( selection && !selection->empty() && selection->back() >= sourceCount ) {
+        report_length_error( _T("selection"), selection->back() + 1, sourceCount );
+        return false;
+    }
+
+    // Find the data for each channel, and separate out the channels that have the same value for every particle
+    const std::size_t channelCount = channelMap.channel_count();
+    std::vector<MObject> perParticleData( channelCount );
+    std::vector<MObject> particleData( channelCount );
+    constant_channel_table constants;
+    channel_map perParticleChannelMap;
+    for( size_t i = 0; i < channelCount; ++i ) {
+        const channel& currentChannel = channelMap[i];
+        frantic::tstring mayaName;
+        get_maya_channel_name_default( currentChannel.name(), mayaName );
+        find_channel_data( particleSystem, currentContext, mayaName, perParticleData[i], particleData[i] );
+
+        if( is_per_particle_channel( currentChannel, perParticleData[i], particleData[i] ) ) {
+            perParticleChannelMap.define_channel( currentChannel.name(), currentChannel.arity(),
+                                                  currentChannel.data_type() );
+        } else if( !get_constant_channel_value( particleSystem, currentContext, currentChannel, mayaName,
+                                                constants ) ) {
+            return false;
+        }
+    }
+    perParticleChannelMap.end_channel_definition();
+
+    // Without a table to hold them, the constant channels are copied into every particle
+    const channel_map& outChannelMap = outConstants ? perParticleChannelMap : channelMap;
+    FRANTIC_MAYA_ADD_COUNT( "grab_maya_particles", outCount );
+    FRANTIC_MAYA_ADD_BYTES( "grab_maya_particles", outCount * outChannelMap.structure_size() );
+
     outParticleArray.clear();
-    outParticleArray.set_channel_map( channelMap );
-    outParticleArray.resize( particleSystem.count() );
+    outParticleArray.set_channel_map( outChannelMap );
+    outParticleArray.resize( outCount );
 
-    // cycle through all of the selected channels and copy out all requested information for each particle
-    for( size_t i = 0; i < channelMap.channel_count(); ++i ) {
+    // cycle through all of the per-particle channels and copy out all requested information for each particle
+    for( size_t i = 0; i < channelCount; ++i ) {
         const channel& currentChannel = channelMap[i];
         frantic::tstring channelName = currentChannel.name();
+        if( constants.has_channel( channelName ) ) {
+            continue;
+        }
         frantic::tstring mayaName;
         get_maya_channel_name_default( channelName, mayaName );
         channel_type currentType = std::make_pair( currentChannel.data_type(), currentChannel.arity() );
-        MObject targetPerParticleArray;
-        MObject targetParticleArray;
+        const MObject& targetPerParticleArray = perParticleData[i];
+        const MObject& targetParticleArray = particleData[i];
         MObject selectedArray = MObject::kNullObj;
-        // search both for a 'Per Particle (PP)' variant of the specified channel, and the raw channel name
-        particleSystem.findPlug( ( mayaName + _T( "PP" ) ).c_str() )
-            .getValue( targetPerParticleArray, const_cast<MDGContext&>( currentContext ) );
-        particleSystem.findPlug( mayaName.c_str() )
-            .getValue( targetParticleArray, const_cast<MDGContext&>( currentContext ) );
 
         if( is_vector_channel_type( currentType ) ) {
             MVectorArray vectorArray;
-            channel_cvt_accessor<vector3f> vectorAccessor = channelMap.get_cvt_accessor<vector3f>( channelName );
+            channel_cvt_accessor<vector3f> vectorAccessor = outChannelMap.get_cvt_accessor<vector3f>( channelName );
 
             // First check for default-defined maya particle channel names (we always expect these to be defined or have
             // reasonable default values)
-            bool channelFound = true;
             if( channelName == PRTPositionChannelName ) {
 #if MAYA_API_VERSION >= 202200
                 particleSystem.position( vectorArray );
@@ -291,39 +453,19 @@ bool grab_maya_particles( const MFnParticleSystem& particleSystem, const MDGCont
             } else if( targetPerParticleArray.apiType() == MFn::kVectorArrayData ) {
                 MFnVectorArrayData arrayVectorObject( targetPerParticleArray );
                 arrayVectorObject.copyTo( vectorArray );
-            } else if( targetParticleArray.apiType() == MFn::kVectorArrayData ) {
+            } else {
                 MFnVectorArrayData arrayVectorObject( targetParticleArray );
                 arrayVectorObject.copyTo( vectorArray );
-            } else {
-                channelFound = false;
             }
 
-            if( channelFound ) {
-                if( vectorArray.length() < outParticleArray.size() ) {
-                    report_length_error( mayaName, vectorArray.length(), outParticleArray.size() );
-                    return false;
-                }
-                unsigned int currentParticle = 0;
-                for( particle_array::iterator it = outParticleArray.begin(); it != outParticleArray.end(); ++it ) {
-                    vector3f vectorValue( (float)vectorArray[currentParticle].x, (float)vectorArray[currentParticle].y,
-                                          (float)vectorArray[currentParticle].z );
-                    vectorAccessor.set( *it, vectorValue );
-                    ++currentParticle;
-                }
-            } else {
-                frantic::tstring systemName = frantic::maya::from_maya_t( particleSystem.particleName() );
-                FF_LOG( debug ) << _T( "Neither \"" ) + mayaName + _T( "\" or \"" ) + mayaName +
-                                       _T( "PP\" channels were found in the maya particle system \"" ) + systemName +
-                                       _T( "\". The \"" ) + channelName + _T( "\" channel will default to [0,0,0]\n" );
-                // channel not found (often happens for normalDir), set the channel to all zeros.
-                vector3f defaultValue( 0.0f, 0.0f, 0.0f );
-                for( particle_array::iterator it = outParticleArray.begin(); it != outParticleArray.end(); ++it ) {
-                    vectorAccessor.set( *it, defaultValue );
-                }
+            if( vectorArray.length() < sourceCount ) {
+                report_length_error( mayaName, vectorArray.length(), sourceCount );
+                return false;
             }
+            copy_vector_channel( vectorArray, selection, vectorAccessor, outParticleArray );
         } else if( is_float_channel_type( currentType ) ) {
             MDoubleArray doubleArray;
-            channel_cvt_accessor<double> doubleAccessor = channelMap.get_cvt_accessor<double>( channelName );
+            channel_cvt_accessor<double> doubleAccessor = outChannelMap.get_cvt_accessor<double>( channelName );
 
             if( channelName == PRTDensityChannelName ) {
                 particleSystem.opacity( doubleArray );
@@ -334,102 +476,174 @@ bool grab_maya_particles( const MFnParticleSystem& particleSystem, const MDGCont
             } else if( targetPerParticleArray.apiType() == MFn::kDoubleArrayData ) {
                 MFnDoubleArrayData arrayDoubleObject( targetPerParticleArray );
                 arrayDoubleObject.copyTo( doubleArray );
-            } else if( targetParticleArray.apiType() == MFn::kDoubleArrayData ) {
-                MFnDoubleArrayData arrayDoubleObject( targetPerParticleArray );
-                arrayDoubleObject.copyTo( doubleArray );
             } else {
-                MStatus getStatus;
-                double value = particleSystem.findPlug( mayaName.c_str() )
-                                   .asDouble( const_cast<MDGContext&>( currentContext ), &getStatus );
-
-                if( getStatus == MStatus::kSuccess ) {
-                    doubleArray.setLength( (unsigned int)outParticleArray.size() );
-
-                    for( unsigned int i = 0; i < outParticleArray.size(); ++i ) {
-                        doubleArray[i] = value;
-                    }
-                } else {
-                    // instead of erroring, maybe we should just set it to zero (that is what the "vector" type is
-                    // doing, since KMY requests normalDir, and it's not usually there)
-                    std::ostringstream errorText;
-                    errorText << "Could not get \"" << frantic::strings::to_string( mayaName )
-                              << "\" from NParticle object.";
-                    MGlobal::displayError( errorText.str().c_str() );
-                    return false;
-                }
+                MFnDoubleArrayData arrayDoubleObject( targetParticleArray );
+                arrayDoubleObject.copyTo( doubleArray );
             }
 
-            if( doubleArray.length() < outParticleArray.size() ) {
-                report_length_error( mayaName, doubleArray.length(), outParticleArray.size() );
+            if( doubleArray.length() < sourceCount ) {
+                report_length_error( mayaName, doubleArray.length(), sourceCount );
                 return false;
             }
 
-            unsigned int currentParticle = 0;
-
-            for( particle_array::iterator it = outParticleArray.begin(); it != outParticleArray.end(); ++it ) {
-                double doubleValue = doubleArray[currentParticle];
-                doubleAccessor.set( *it, doubleValue );
-                ++currentParticle;
-            }
+            copy_scalar_channel( doubleArray, selection, doubleAccessor, outParticleArray );
         } else if( is_int_channel_type( currentType ) ) {
-            std::vector<boost::int64_t> intArray( outParticleArray.size() );
-            channel_cvt_accessor<boost::int64_t> intAccessor =
-                channelMap.get_cvt_accessor<boost::int64_t>( channelName );
-
             // Maya does not allow specifying integers as per-particle data, so they will always be found as floats
             // (even particleId)
             if( targetPerParticleArray.apiType() == MFn::kDoubleArrayData ) {
                 selectedArray = targetPerParticleArray;
-            } else if( targetParticleArray.apiType() == MFn::kDoubleArrayData ) {
+            } else {
                 selectedArray = targetParticleArray;
             }
 
-            if( selectedArray.apiType() != MFn::kInvalid ) {
-                MFnDoubleArrayData doubleArrayObject( selectedArray );
-
-                if( doubleArrayObject.length() < outParticleArray.size() ) {
-                    if( doubleArrayObject.length() == 0 && channelName == _T( "ID" ) ) {
-                        for( unsigned int i = 0; i < outParticleArray.size(); ++i ) {
-                            intArray[i] = static_cast<boost::int64_t>( i );
-                        }
-                    } else {
-                        report_length_error( mayaName, doubleArrayObject.length(), outParticleArray.size() );
-                        return false;
-                    }
+            MFnDoubleArrayData doubleArrayObject( selectedArray );
+            // this refers to the data object's values, rather than copying them
+            const MDoubleArray doubleArray = doubleArrayObject.array();
+
+            const bool synthesizeIds = doubleArray.length() == 0 && channelName == _T( "ID" );
+            if( doubleArray.length() < sourceCount && !synthesizeIds ) {
+                report_length_error( mayaName, doubleArray.length(), sourceCount );
+                return false;
+            }
+
+            // The values are written straight into the particles. When the channel is stored as int64, as IDs
+            // usually are, they don't go through a converting accessor either.
+            if( currentChannel.data_type() == data_type_int64 && currentChannel.arity() == 1 ) {
+                channel_accessor<boost::int64_t> intAccessor =
+                    outChannelMap.get_accessor<boost::int64_t>( channelName );
+                if( synthesizeIds ) {
+                    fill_index_channel( selection, intAccessor, outParticleArray );
                 } else {
-                    for( unsigned int i = 0; i < outParticleArray.size(); ++i ) {
-                        intArray[i] = (boost::int64_t)doubleArrayObject[i];
-                    }
+                    copy_integer_channel( doubleArray, selection, intAccessor, outParticleArray );
                 }
-
             } else {
-                MStatus getStatus;
-                boost::int64_t value = (boost::int64_t)particleSystem.findPlug( mayaName.c_str() )
-                                           .asInt( const_cast<MDGContext&>( currentContext ), &getStatus );
-
-                if( getStatus == MStatus::kSuccess ) {
-                    for( unsigned int i = 0; i < outParticleArray.size(); ++i ) {
-                        intArray[i] = value;
-                    }
+                channel_cvt_accessor<boost::int64_t> intAccessor =
+                    outChannelMap.get_cvt_accessor<boost::int64_t>( channelName );
+                if( synthesizeIds ) {
+                    fill_index_channel( selection, intAccessor, outParticleArray );
                 } else {
-                    // instead of erroring, maybe we should just set it to zero (that is what the "vector" type is
-                    // doing, since KMY requests normalDir, and it's not usually there)
-                    std::ostringstream errorText;
-                    errorText << "Could not get \"" << frantic::strings::to_string( mayaName )
-                              << "\" from NParticle object.";
-                    MGlobal::displayError( errorText.str().c_str() );
-                    return false;
+                    copy_integer_channel( doubleArray, selection, intAccessor, outParticleArray );
                 }
             }
+        }
+    }
 
-            size_t currentParticle = 0;
+    if( outConstants ) {
+        std::swap( *outConstants, constants );
+    } else {
+        expand_constant_channels( constants, outParticleArray );
+    }
 
-            for( particle_array::iterator it = outParticleArray.begin(); it != outParticleArray.end(); ++it ) {
-                boost::int64_t intValue = intArray[currentParticle];
-                intAccessor.set( *it, intValue );
-                ++currentParticle;
-            }
-        }
+    return true;
+}
+
+bool select_viewport_particles( const MFnParticleSystem& particleSystem, double fraction, boost::int64_t limit,
+                                std::vector<unsigned int>& outSelection ) {
+    const std::size_t count = particleSystem.count();
+    if( fraction >= 1.0 && ( limit < 0 || static_cast<std::size_t>( limit ) >= count ) ) {
+        outSelection.clear();
+        return false;
+    }
+
+    MIntArray particleIds;
+    particleSystem.particleIds( particleIds );
+
+    return select_viewport_indices( particleIds.length() == count ? &particleIds : NULL, count, fraction, limit,
+                                    outSelection );
+}
+
+bool select_maya_particles_in_region( const MFnParticleSystem& particleSystem, const MDGContext& currentContext,
+                                      const frantic::graphics::transform4f& toRegionSpace,
+                                      const particle_culling_region& region,
+                                      const std::vector<unsigned int>* candidates,
+                                      std::vector<unsigned int>& outSelection ) {
+    FRANTIC_MAYA_SCOPED_TIMER( "select_maya_particles_in_region" );
+
+    outSelection.clear();
+    const std::size_t count = particleSystem.count();
+    if( count == 0 ) {
+        return true;
+    }
+
+    MVectorArray positions;
+#if MAYA_API_VERSION >= 202200
+    particleSystem.position( positions );
+#else
+    if( !copy_position( particleSystem, currentContext, positions ) ) {
+        MGlobal::displayError( "Unable to get position from particle system" );
+        return false;
+    }
+#endif
+    if( positions.length() < count ) {
+        report_length_error( MayaPositionChannelName, positions.length(), count );
+        return false;
+    }
+    if( candidates && !candidates->empty() && candidates->back() >= count ) {
+        report_length_error( _T("selection"), candidates->back() + 1, count );
+        return false;
+    }
+
+    select_particles_in_region( positions, count, toRegionSpace, region, candidates, outSelection );
+    FRANTIC_MAYA_ADD_COUNT( "select_maya_particles_in_region", outSelection.size() );
+    return true;
+}
+
+bool get_maya_particle_statistics( const MFnParticleSystem& particleSystem, const MDGContext& currentContext,
+                                   const frantic::graphics::transform4f& toObjectSpace,
+                                   particle_stream_statistics& outStats ) {
+    FRANTIC_MAYA_SCOPED_TIMER( "get_maya_particle_statistics" );
+
+    outStats.clear();
+    const std::size_t count = particleSystem.count();
+    outStats.particleCount = static_cast<boost::int64_t>( count );
+    if( count == 0 ) {
+        return true;
+    }
+    FRANTIC_MAYA_ADD_COUNT( "get_maya_particle_statistics", count );
+
+    MVectorArray vectorArray;
+#if MAYA_API_VERSION >= 202200
+    particleSystem.position( vectorArray );
+#else
+    if( !copy_position( particleSystem, currentContext, vectorArray ) ) {
+        MGlobal::displayError( "Unable to get position from particle system" );
+        return false;
+    }
+#endif
+    if( vectorArray.length() < count ) {
+        report_length_error( MayaPositionChannelName, vectorArray.length(), count );
+        return false;
+    }
+    particle_channel_range& positionRange = outStats.channelRanges[PRTPositionChannelName];
+    compute_vector_range( vectorArray, count, toObjectSpace, true, positionRange );
+    outStats.bounds = frantic::graphics::boundbox3f(
+        vector3f( (float)positionRange.minimum[0], (float)positionRange.minimum[1], (float)positionRange.minimum[2] ),
+        vector3f( (float)positionRange.maximum[0], (float)positionRange.maximum[1], (float)positionRange.maximum[2] ) );
+
+    // The other channels are left out if the particle system doesn't have a value for every particle
+    particleSystem.velocity( vectorArray );
+    if( vectorArray.length() >= count ) {
+        compute_vector_range( vectorArray, count, toObjectSpace, false,
+                              outStats.channelRanges[PRTVelocityChannelName] );
+    }
+    particleSystem.rgb( vectorArray );
+    if( vectorArray.length() >= count ) {
+        compute_vector_range( vectorArray, count, frantic::graphics::transform4f::identity(), false,
+                              outStats.channelRanges[PRTColorChannelName] );
+    }
+
+    MDoubleArray doubleArray;
+    particleSystem.opacity( doubleArray );
+    if( doubleArray.length() >= count ) {
+        compute_scalar_range( doubleArray, count, outStats.channelRanges[PRTDensityChannelName] );
+    }
+    particleSystem.age( doubleArray );
+    if( doubleArray.length() >= count ) {
+        compute_scalar_range( doubleArray, count, outStats.channelRanges[PRTAgeChannelName] );
+    }
+    particleSystem.lifespan( doubleArray );
+    if( doubleArray.length() >= count ) {
+        compute_scalar_range( doubleArray, count, outStats.channelRanges[PRTLifeSpanChannelName] );
     }
 
     return true;
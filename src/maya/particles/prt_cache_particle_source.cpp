@@ -0,0 +1,307 @@
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+#include "stdafx.h"
+
+#include <frantic/maya/particles/prt_cache_particle_source.hpp>
+
+#include <frantic/maya/particles/prt_export.hpp>
+#include <frantic/maya/particles/viewport_particle_istream.hpp>
+
+#include <maya/MTime.h>
+
+#include <frantic/files/files.hpp>
+#include <frantic/logging/logging_level.hpp>
+#include <frantic/particles/particle_file_stream_factory.hpp>
+#include <frantic/particles/streams/empty_particle_istream.hpp>
+#include <frantic/particles/streams/shared_particle_container_particle_istream.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+// Requests more than this many frames apart are treated as a jump rather than as playback with a step, and only
+// set the direction of playback
+const int MAX_PLAYBACK_STEP = 4;
+
+// m_currentFrame before the first request
+const int NO_CURRENT_FRAME = std::numeric_limits<int>::min();
+
+int get_context_frame( const MDGContext& context ) {
+    MTime time;
+    context.getTime( time );
+    return static_cast<int>( std::floor( time.asUnits( MTime::uiUnit() ) + 0.5 ) );
+}
+
+// Reads the ID channel of a particle array, as select_viewport_indices expects
+class particle_id_array {
+    const frantic::particles::particle_array& m_particles;
+    frantic::channels::channel_cvt_accessor<boost::int64_t> m_id;
+
+    particle_id_array& operator=( const particle_id_array& ); // not implemented
+
+  public:
+    particle_id_array( const frantic::particles::particle_array& particles,
+                       const frantic::channels::channel_cvt_accessor<boost::int64_t>& id )
+        : m_particles( particles )
+        , m_id( id ) {}
+
+    boost::int64_t operator[]( unsigned int index ) const { return m_id.get( m_particles[index] ); }
+};
+
+frantic::particles::streams::particle_istream_ptr
+make_particle_array_stream( const boost::shared_ptr<frantic::particles::particle_array>& particles ) {
+    return frantic::particles::streams::particle_istream_ptr(
+        new frantic::particles::streams::shared_particle_container_particle_istream<frantic::particles::particle_array>(
+            particles ) );
+}
+
+} // anonymous namespace
+
+namespace frantic {
+namespace maya {
+namespace particles {
+
+prt_cache_options::prt_cache_options()
+    : prefetchFrames( 2 )
+    , maxCachedFrames( 8 )
+    , viewportFraction( 1.0 )
+    , viewportLimit( -1 ) {}
+
+prt_cache_particle_source::prt_cache_particle_source( const frantic::tstring& filenamePattern,
+                                                      const prt_cache_options& options )
+    : m_filenamePattern( filenamePattern )
+    , m_options( options )
+    , m_currentFrame( NO_CURRENT_FRAME )
+    , m_playbackStep( 1 )
+    , m_generation( 0 )
+    , m_stopping( false ) {
+    m_lastChannelMap.define_channel( _T("Position"), 3, frantic::channels::data_type_float32 );
+    m_lastChannelMap.end_channel_definition();
+
+    if( m_options.prefetchFrames > 0 ) {
+        m_prefetchThread = std::thread( &prt_cache_particle_source::prefetch_main, this );
+    }
+}
+
+prt_cache_particle_source::~prt_cache_particle_source() {
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        m_stopping = true;
+    }
+    m_requestsChanged.notify_all();
+    if( m_prefetchThread.joinable() ) {
+        m_prefetchThread.join();
+    }
+}
+
+frantic::particles::streams::particle_istream_ptr
+prt_cache_particle_source::getRenderParticleStream( const frantic::graphics::transform4f& /*objectSpace*/,
+                                                    const MDGContext& context ) const {
+    boost::shared_ptr<frantic::particles::particle_array> particles = get_frame( get_context_frame( context ) );
+    if( !particles ) {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        return frantic::particles::streams::particle_istream_ptr(
+            new frantic::particles::streams::empty_particle_istream( m_lastChannelMap ) );
+    }
+
+    return make_particle_array_stream( particles );
+}
+
+frantic::particles::streams::particle_istream_ptr
+prt_cache_particle_source::getViewportParticleStream( const frantic::graphics::transform4f& objectSpace,
+                                                      const MDGContext& context ) const {
+    if( m_options.viewportFraction >= 1.0 && m_options.viewportLimit < 0 ) {
+        return getRenderParticleStream( objectSpace, context );
+    }
+
+    boost::shared_ptr<frantic::particles::particle_array> particles = get_frame( get_context_frame( context ) );
+    if( !particles ) {
+        return getRenderParticleStream( objectSpace, context );
+    }
+
+    // The frame is in memory, so the displayed particles are chosen by index and only those are copied, rather than
+    // streaming every particle through a viewport_particle_istream
+    const frantic::channels::channel_map& channelMap = particles->get_channel_map();
+    std::vector<unsigned int> selection;
+    bool useSelection;
+    if( channelMap.has_channel( _T("ID") ) ) {
+        const particle_id_array ids( *particles, channelMap.get_cvt_accessor<boost::int64_t>( _T("ID") ) );
+        useSelection = select_viewport_indices( &ids, particles->size(), m_options.viewportFraction,
+                                                m_options.viewportLimit, selection );
+    } else {
+        useSelection = select_viewport_indices<particle_id_array>(
+            NULL, particles->size(), m_options.viewportFraction, m_options.viewportLimit, selection );
+    }
+    if( !useSelection ) {
+        return make_particle_array_stream( particles );
+    }
+
+    boost::shared_ptr<frantic::particles::particle_array> displayedParticles(
+        new frantic::particles::particle_array( channelMap ) );
+    displayedParticles->resize( selection.size() );
+    const std::size_t particleSize = channelMap.structure_size();
+    for( std::size_t i = 0; i < selection.size(); ++i ) {
+        memcpy( ( *displayedParticles )[i], ( *particles )[selection[i]], particleSize );
+    }
+    return make_particle_array_stream( displayedParticles );
+}
+
+boost::shared_ptr<frantic::particles::particle_array> prt_cache_particle_source::get_frame( int frame ) const {
+    std::unique_lock<std::mutex> lock( m_mutex );
+
+    // Start the background thread on the following frames before this one is read
+    update_prefetch_requests( frame );
+
+    for( ;; ) {
+        frame_map_t::const_iterator it = m_frames.find( frame );
+        if( it != m_frames.end() ) {
+            return it->second;
+        }
+        if( m_loadingFrames.count( frame ) == 0 ) {
+            break;
+        }
+        // Another thread is already reading this frame
+        m_frameLoaded.wait( lock );
+    }
+
+    m_loadingFrames.insert( frame );
+    const boost::uint64_t generation = m_generation;
+    lock.unlock();
+
+    boost::shared_ptr<frantic::particles::particle_array> particles;
+    try {
+        particles = load_frame( frame );
+    } catch( ... ) {
+        lock.lock();
+        m_loadingFrames.erase( frame );
+        m_frameLoaded.notify_all();
+        throw;
+    }
+
+    lock.lock();
+    m_loadingFrames.erase( frame );
+    if( particles && generation == m_generation ) {
+        insert_frame( frame, particles );
+    }
+    m_frameLoaded.notify_all();
+    return particles;
+}
+
+void prt_cache_particle_source::clear_cache() {
+    std::lock_guard<std::mutex> lock( m_mutex );
+    m_frames.clear();
+    m_prefetchRequests.clear();
+    ++m_generation;
+}
+
+boost::shared_ptr<frantic::particles::particle_array> prt_cache_particle_source::load_frame( int frame ) const {
+    const frantic::tstring path = get_prt_sequence_filename( m_filenamePattern, frame );
+    if( !frantic::files::file_exists( path ) ) {
+        return boost::shared_ptr<frantic::particles::particle_array>();
+    }
+
+    frantic::particles::particle_file_stream_factory_object factory;
+    frantic::particles::streams::particle_istream_ptr pin = factory.create_istream( path );
+    pin->set_channel_map( pin->get_native_channel_map() );
+
+    boost::shared_ptr<frantic::particles::particle_array> particles(
+        new frantic::particles::particle_array( pin->get_channel_map() ) );
+    particles->insert_particles( pin );
+    pin->close();
+
+    return particles;
+}
+
+void prt_cache_particle_source::update_prefetch_requests( int frame ) const {
+    if( m_currentFrame != NO_CURRENT_FRAME && frame != m_currentFrame ) {
+        const boost::int64_t step = static_cast<boost::int64_t>( frame ) - m_currentFrame;
+        if( std::abs( step ) <= MAX_PLAYBACK_STEP ) {
+            m_playbackStep = static_cast<int>( step );
+        } else {
+            m_playbackStep = step < 0 ? -1 : 1;
+        }
+    }
+    m_currentFrame = frame;
+
+    if( !m_prefetchThread.joinable() ) {
+        return;
+    }
+
+    // Requests for frames that are no longer ahead of playback are dropped
+    m_prefetchRequests.clear();
+    for( std::size_t i = 1; i <= m_options.prefetchFrames; ++i ) {
+        const boost::int64_t next = frame + static_cast<boost::int64_t>( i ) * m_playbackStep;
+        if( next < std::numeric_limits<int>::min() || next > std::numeric_limits<int>::max() ) {
+            break;
+        }
+        const int prefetchFrame = static_cast<int>( next );
+        if( m_frames.find( prefetchFrame ) == m_frames.end() && m_loadingFrames.count( prefetchFrame ) == 0 ) {
+            m_prefetchRequests.push_back( prefetchFrame );
+        }
+    }
+    if( !m_prefetchRequests.empty() ) {
+        m_requestsChanged.notify_one();
+    }
+}
+
+void prt_cache_particle_source::insert_frame(
+    int frame, const boost::shared_ptr<frantic::particles::particle_array>& particles ) const {
+    m_frames[frame] = particles;
+    m_lastChannelMap = particles->get_channel_map();
+
+    // The frames are ordered, so the one furthest from the current frame is either the first or the last
+    const std::size_t maxFrames = std::max( m_options.maxCachedFrames, m_options.prefetchFrames + 1 );
+    while( m_frames.size() > maxFrames ) {
+        frame_map_t::iterator first = m_frames.begin();
+        frame_map_t::iterator last = --m_frames.end();
+        const boost::int64_t firstDistance = std::abs( static_cast<boost::int64_t>( first->first ) - m_currentFrame );
+        const boost::int64_t lastDistance = std::abs( static_cast<boost::int64_t>( last->first ) - m_currentFrame );
+        m_frames.erase( firstDistance >= lastDistance ? first : last );
+    }
+}
+
+void prt_cache_particle_source::prefetch_main() {
+    std::unique_lock<std::mutex> lock( m_mutex );
+    for( ;; ) {
+        while( !m_stopping && m_prefetchRequests.empty() ) {
+            m_requestsChanged.wait( lock );
+        }
+        if( m_stopping ) {
+            return;
+        }
+
+        const int frame = m_prefetchRequests.front();
+        m_prefetchRequests.pop_front();
+        if( m_frames.find( frame ) != m_frames.end() || m_loadingFrames.count( frame ) != 0 ) {
+            continue;
+        }
+
+        m_loadingFrames.insert( frame );
+        const boost::uint64_t generation = m_generation;
+        lock.unlock();
+
+        boost::shared_ptr<frantic::particles::particle_array> particles;
+        try {
+            particles = load_frame( frame );
+        } catch( const std::exception& e ) {
+            // The frame will be read again, and the error reported, if it is requested
+            FF_LOG( debug ) << "prt_cache_particle_source: Unable to prefetch frame " << frame << ": " << e.what()
+                            << std::endl;
+        }
+
+        lock.lock();
+        m_loadingFrames.erase( frame );
+        if( particles && generation == m_generation ) {
+            insert_frame( frame, particles );
+        }
+        m_frameLoaded.notify_all();
+    }
+}
+
+} // namespace particles
+} // namespace maya
+} // namespace frantic
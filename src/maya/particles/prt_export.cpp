@@ -0,0 +1,561 @@
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+#include "stdafx.h"
+
+#include <frantic/maya/particles/prt_export.hpp>
+
+#include <frantic/maya/PRTObject_base.hpp>
+#include <frantic/maya/logging/batch_progress_logger.hpp>
+#include <frantic/maya/logging/instrumentation.hpp>
+
+#include <maya/MAnimControl.h>
+#include <maya/MDGContext.h>
+#include <maya/MTime.h>
+
+#include <frantic/channels/channel_map.hpp>
+#include <frantic/strings/tstring.hpp>
+
+#include <tbb/task_arena.h>
+#include <tbb/task_group.h>
+#include <tbb/tick_count.h>
+
+#include <boost/make_shared.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+
+namespace {
+
+const char PRT_MAGIC_NUMBER[8] = { '\xC0', 'P', 'R', 'T', '\r', '\n', '\x1A', '\n' };
+const boost::int32_t PRT_HEADER_LENGTH = 56;
+const char PRT_SIGNATURE[] = "Extensible Particle Format";
+const std::size_t PRT_SIGNATURE_LENGTH = 32;
+const boost::int32_t PRT_VERSION = 1;
+const boost::int32_t PRT_RESERVED = 4;
+const std::size_t PRT_CHANNEL_NAME_LENGTH = 32;
+const boost::int32_t PRT_CHANNEL_DEFINITION_LENGTH = 44;
+
+// The position of the particle count, after the magic number, header length, signature and version
+const std::streamoff PRT_PARTICLE_COUNT_OFFSET = 48;
+
+// The states of a prt_write_block
+enum prt_block_state { BLOCK_PENDING, BLOCK_CLAIMED, BLOCK_DONE };
+
+void write_int32( std::ostream& out, boost::int32_t value ) {
+    char bytes[4];
+    for( int i = 0; i < 4; ++i ) {
+        bytes[i] = static_cast<char>( ( static_cast<boost::uint32_t>( value ) >> ( 8 * i ) ) & 0xff );
+    }
+    out.write( bytes, 4 );
+}
+
+void write_int64( std::ostream& out, boost::int64_t value ) {
+    char bytes[8];
+    for( int i = 0; i < 8; ++i ) {
+        bytes[i] = static_cast<char>( ( static_cast<boost::uint64_t>( value ) >> ( 8 * i ) ) & 0xff );
+    }
+    out.write( bytes, 8 );
+}
+
+// Returns the PRT data type code of a channel data type, or -1 if PRT files can't store it
+boost::int32_t get_prt_data_type( frantic::channels::data_type_t dataType ) {
+    using namespace frantic::channels;
+
+    switch( dataType ) {
+    case data_type_int16:
+        return 0;
+    case data_type_int32:
+        return 1;
+    case data_type_int64:
+        return 2;
+    case data_type_float16:
+        return 3;
+    case data_type_float32:
+        return 4;
+    case data_type_float64:
+        return 5;
+    case data_type_uint16:
+        return 6;
+    case data_type_uint32:
+        return 7;
+    case data_type_uint64:
+        return 8;
+    case data_type_int8:
+        return 9;
+    case data_type_uint8:
+        return 10;
+    default:
+        return -1;
+    }
+}
+
+bool is_valid_prt_channel_name( const frantic::tstring& name ) {
+    if( name.empty() || name.size() >= PRT_CHANNEL_NAME_LENGTH )
+        return false;
+    for( std::size_t i = 0; i < name.size(); ++i ) {
+        const frantic::tchar c = name[i];
+        const bool isLetter =
+            ( c >= _T( 'a' ) && c <= _T( 'z' ) ) || ( c >= _T( 'A' ) && c <= _T( 'Z' ) ) || c == _T( '_' );
+        const bool isDigit = c >= _T( '0' ) && c <= _T( '9' );
+        if( !isLetter && !( isDigit && i > 0 ) )
+            return false;
+    }
+    return true;
+}
+
+void write_prt_header( std::ostream& out, const frantic::channels::channel_map& channelMap,
+                       boost::int64_t particleCount ) {
+    out.write( PRT_MAGIC_NUMBER, sizeof( PRT_MAGIC_NUMBER ) );
+    write_int32( out, PRT_HEADER_LENGTH );
+
+    char signature[PRT_SIGNATURE_LENGTH];
+    memset( signature, 0, sizeof( signature ) );
+    memcpy( signature, PRT_SIGNATURE, sizeof( PRT_SIGNATURE ) );
+    out.write( signature, sizeof( signature ) );
+
+    write_int32( out, PRT_VERSION );
+    write_int64( out, particleCount );
+    write_int32( out, PRT_RESERVED );
+
+    write_int32( out, static_cast<boost::int32_t>( channelMap.channel_count() ) );
+    write_int32( out, PRT_CHANNEL_DEFINITION_LENGTH );
+    for( std::size_t i = 0; i < channelMap.channel_count(); ++i ) {
+        const frantic::channels::channel& ch = channelMap[i];
+        const std::string name = frantic::strings::to_string( ch.name() );
+
+        char nameBuffer[PRT_CHANNEL_NAME_LENGTH];
+        memset( nameBuffer, 0, sizeof( nameBuffer ) );
+        memcpy( nameBuffer, name.c_str(), name.size() );
+        out.write( nameBuffer, sizeof( nameBuffer ) );
+
+        write_int32( out, get_prt_data_type( ch.data_type() ) );
+        write_int32( out, static_cast<boost::int32_t>( ch.arity() ) );
+        write_int32( out, static_cast<boost::int32_t>( ch.offset() ) );
+    }
+}
+
+// Wakes the writing thread when a worker finishes compressing a block
+struct prt_block_sync {
+    std::mutex mutex;
+    std::condition_variable blockDone;
+};
+
+frantic::tstring format_frame_number( int frame, std::size_t width ) {
+    const boost::int64_t magnitude = frame < 0 ? -static_cast<boost::int64_t>( frame ) : frame;
+    frantic::tstring digits = boost::lexical_cast<frantic::tstring>( magnitude );
+    if( digits.size() < width ) {
+        digits.insert( 0, width - digits.size(), _T( '0' ) );
+    }
+    return frame < 0 ? _T( "-" ) + digits : digits;
+}
+
+// Restores the scene time when it goes out of scope, including when an export throws
+class scoped_scene_time : boost::noncopyable {
+    MTime m_originalTime;
+
+  public:
+    scoped_scene_time()
+        : m_originalTime( MAnimControl::currentTime() ) {}
+
+    ~scoped_scene_time() { MAnimControl::setCurrentTime( m_originalTime ); }
+};
+
+} // anonymous namespace
+
+namespace frantic {
+namespace maya {
+namespace particles {
+
+namespace detail {
+
+/**
+ * One block of particle data, and its compressed form.  A block is compressed by whichever thread claims it first,
+ * either a worker, or the writing thread when it needs the block before any worker has started on it.  The writing
+ * thread therefore never waits for a block that no thread is compressing, even when TBB has no worker threads.
+ */
+class prt_write_block : boost::noncopyable {
+    z_stream m_stream;
+    bool m_isStreamInitialized;
+
+  public:
+    std::vector<char> input;
+    std::size_t inputSize;
+    bool isLast; // if true, this block finishes the zlib stream
+
+    std::vector<char> output;
+    std::size_t outputSize;
+    uLong checksum; // the adler32 of the input
+    std::string error;
+
+    std::atomic<int> state;
+
+    prt_write_block()
+        : m_isStreamInitialized( false )
+        , inputSize( 0 )
+        , isLast( false )
+        , outputSize( 0 )
+        , checksum( 0 )
+        , state( BLOCK_DONE ) {
+        memset( &m_stream, 0, sizeof( m_stream ) );
+    }
+
+    ~prt_write_block() {
+        if( m_isStreamInitialized )
+            deflateEnd( &m_stream );
+    }
+
+    /**
+     * Sets state to BLOCK_CLAIMED if it is BLOCK_PENDING.
+     * @return true if the calling thread should compress the block.
+     */
+    bool claim() {
+        int expected = BLOCK_PENDING;
+        return state.compare_exchange_strong( expected, BLOCK_CLAIMED );
+    }
+
+    /**
+     * Compresses the input as a raw deflate stream.  Any error is stored in error, rather than thrown, so that it
+     * reaches the writing thread.
+     */
+    void compress( int compressionLevel ) {
+        try {
+            if( !m_isStreamInitialized ) {
+                // Negative window bits leave out the zlib header and checksum, so the blocks can be concatenated into
+                // a single zlib stream by the writing thread.
+                if( deflateInit2( &m_stream, compressionLevel, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY ) !=
+                    Z_OK ) {
+                    throw std::runtime_error( "prt_writer error: Unable to initialize the zlib compressor." );
+                }
+                m_isStreamInitialized = true;
+            } else {
+                deflateReset( &m_stream );
+            }
+
+            checksum = adler32( adler32( 0, Z_NULL, 0 ),
+                                inputSize > 0 ? reinterpret_cast<const Bytef*>( &input[0] ) : Z_NULL,
+                                static_cast<uInt>( inputSize ) );
+
+            // All blocks but the last end with a sync flush, which ends them on a byte boundary without ending the
+            // deflate stream, so that the next block can directly follow.
+            const int flush = isLast ? Z_FINISH : Z_SYNC_FLUSH;
+
+            const std::size_t bound = deflateBound( &m_stream, static_cast<uLong>( inputSize ) ) + 16;
+            if( output.size() < bound ) {
+                output.resize( bound );
+            }
+
+            m_stream.next_in = inputSize > 0 ? reinterpret_cast<Bytef*>( &input[0] ) : Z_NULL;
+            m_stream.avail_in = static_cast<uInt>( inputSize );
+            outputSize = 0;
+            for( ;; ) {
+                m_stream.next_out = reinterpret_cast<Bytef*>( &output[outputSize] );
+                m_stream.avail_out = static_cast<uInt>( output.size() - outputSize );
+                const int result = deflate( &m_stream, flush );
+                outputSize = output.size() - m_stream.avail_out;
+
+                if( result == Z_STREAM_ERROR ) {
+                    throw std::runtime_error( "prt_writer error: The zlib compressor failed." );
+                } else if( isLast ? result == Z_STREAM_END : ( m_stream.avail_in == 0 && m_stream.avail_out > 0 ) ) {
+                    break;
+                } else if( m_stream.avail_out == 0 ) {
+                    output.resize( 2 * output.size() );
+                } else {
+                    throw std::runtime_error( "prt_writer error: The zlib compressor made no progress." );
+                }
+            }
+            error.clear();
+        } catch( const std::exception& e ) {
+            error = e.what();
+        }
+    }
+};
+
+class compress_block_task {
+    detail::prt_write_block* m_block;
+    prt_block_sync* m_sync;
+    int m_compressionLevel;
+
+  public:
+    compress_block_task( detail::prt_write_block& block, prt_block_sync& sync, int compressionLevel )
+        : m_block( &block )
+        , m_sync( &sync )
+        , m_compressionLevel( compressionLevel ) {}
+
+    void operator()() const {
+        // The writing thread may have compressed the block itself already
+        if( !m_block->claim() )
+            return;
+
+        m_block->compress( m_compressionLevel );
+        {
+            std::lock_guard<std::mutex> lock( m_sync->mutex );
+            m_block->state.store( BLOCK_DONE );
+        }
+        m_sync->blockDone.notify_all();
+    }
+};
+
+// Waits until a block is compressed, compressing it on this thread if no worker has started on it
+void finish_block( detail::prt_write_block& block, prt_block_sync& sync, int compressionLevel ) {
+    if( block.claim() ) {
+        block.compress( compressionLevel );
+        block.state.store( BLOCK_DONE );
+    } else {
+        std::unique_lock<std::mutex> lock( sync.mutex );
+        while( block.state.load() != BLOCK_DONE ) {
+            sync.blockDone.wait( lock );
+        }
+    }
+
+    if( !block.error.empty() ) {
+        throw std::runtime_error( block.error );
+    }
+}
+
+} // namespace detail
+
+prt_writer_options::prt_writer_options()
+    : blockSize( 1 << 20 )
+    , maxBlocksInFlight( 2 * static_cast<std::size_t>( std::max( 1, tbb::this_task_arena::max_concurrency() ) ) )
+    , compressionLevel( Z_DEFAULT_COMPRESSION ) {}
+
+prt_write_stats::prt_write_stats()
+    : particleCount( 0 )
+    , uncompressedBytes( 0 )
+    , compressedBytes( 0 )
+    , seconds( 0 ) {}
+
+double prt_write_stats::particles_per_second() const {
+    return seconds > 0 ? static_cast<double>( particleCount ) / seconds : 0;
+}
+
+double prt_write_stats::uncompressed_bytes_per_second() const {
+    return seconds > 0 ? static_cast<double>( uncompressedBytes ) / seconds : 0;
+}
+
+prt_writer::prt_writer( const prt_writer_options& options )
+    : m_options( options ) {
+    if( m_options.compressionLevel < Z_DEFAULT_COMPRESSION || m_options.compressionLevel > Z_BEST_COMPRESSION ) {
+        throw std::runtime_error( "prt_writer error: The compression level must be between -1 and 9." );
+    }
+}
+
+prt_writer::~prt_writer() {}
+
+void prt_writer::release_buffers() { m_blocks.clear(); }
+
+prt_write_stats prt_writer::write( frantic::particles::streams::particle_istream& pin, const frantic::tstring& path ) {
+    FRANTIC_MAYA_SCOPED_TIMER( "prt_write" );
+
+    const tbb::tick_count startTime = tbb::tick_count::now();
+
+    // Read the particles in the layout they are written in, so each block can be compressed as it is
+    const frantic::channels::channel_map& sourceChannelMap = pin.get_channel_map();
+    frantic::channels::channel_map channelMap;
+    for( std::size_t i = 0; i < sourceChannelMap.channel_count(); ++i ) {
+        const frantic::channels::channel& ch = sourceChannelMap[i];
+        if( get_prt_data_type( ch.data_type() ) < 0 ) {
+            throw std::runtime_error( "prt_writer error: The channel \"" + frantic::strings::to_string( ch.name() ) +
+                                      "\" has a data type that can't be written to a PRT file." );
+        }
+        if( !is_valid_prt_channel_name( ch.name() ) ) {
+            throw std::runtime_error( "prt_writer error: The channel name \"" +
+                                      frantic::strings::to_string( ch.name() ) + "\" is not valid in a PRT file." );
+        }
+        channelMap.define_channel( ch.name(), ch.arity(), ch.data_type() );
+    }
+    // Pack the channels with no alignment padding, since readers derive the particle size from the channel sizes
+    channelMap.end_channel_definition( 1, true );
+
+    const std::size_t particleSize = channelMap.structure_size();
+    if( particleSize == 0 ) {
+        throw std::runtime_error( "prt_writer error: The particle stream \"" +
+                                  frantic::strings::to_string( pin.name() ) + "\" has no channels to write." );
+    }
+    pin.set_channel_map( channelMap );
+
+    std::ofstream out( path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+    if( !out ) {
+        throw std::runtime_error( "prt_writer error: Unable to open \"" + frantic::strings::to_string( path ) +
+                                  "\" for writing." );
+    }
+
+    // The particle count is written once all of the particles have been read
+    write_prt_header( out, channelMap, 0 );
+
+    // A zlib header for the default window size, with the blocks' raw deflate data following it
+    const char zlibHeader[2] = { '\x78', '\x9C' };
+    out.write( zlibHeader, sizeof( zlibHeader ) );
+
+    const std::size_t blockParticleCount = std::max<std::size_t>( 1, m_options.blockSize / particleSize );
+    const std::size_t blockCount = std::max<std::size_t>( 1, m_options.maxBlocksInFlight );
+    if( m_blocks.size() > blockCount ) {
+        m_blocks.resize( blockCount );
+    }
+    while( m_blocks.size() < blockCount ) {
+        m_blocks.push_back( boost::make_shared<detail::prt_write_block>() );
+    }
+
+    prt_write_stats stats;
+    stats.compressedBytes = sizeof( zlibHeader );
+    uLong checksum = adler32( 0, Z_NULL, 0 );
+
+    prt_block_sync sync;
+    tbb::task_group tasks;
+    try {
+        // Blocks are read and written in sequence, and the block for sequence number n is m_blocks[n % blockCount]
+        std::size_t readCount = 0;
+        std::size_t writeCount = 0;
+        bool isLast = false;
+        while( !isLast || writeCount < readCount ) {
+            if( isLast || readCount - writeCount == blockCount ) {
+                detail::prt_write_block& block = *m_blocks[writeCount % blockCount];
+                detail::finish_block( block, sync, m_options.compressionLevel );
+
+                out.write( &block.output[0], block.outputSize );
+                checksum = adler32_combine( checksum, block.checksum, static_cast<z_off_t>( block.inputSize ) );
+                stats.uncompressedBytes += block.inputSize;
+                stats.compressedBytes += block.outputSize;
+                ++writeCount;
+            } else {
+                detail::prt_write_block& block = *m_blocks[readCount % blockCount];
+                block.input.resize( blockParticleCount * particleSize );
+
+                std::size_t count = blockParticleCount;
+                isLast = !pin.get_particles( &block.input[0], count );
+                block.inputSize = count * particleSize;
+                block.isLast = isLast;
+                stats.particleCount += static_cast<boost::int64_t>( count );
+
+                block.state.store( BLOCK_PENDING );
+                tasks.run( detail::compress_block_task( block, sync, m_options.compressionLevel ) );
+                ++readCount;
+            }
+        }
+        tasks.wait();
+    } catch( ... ) {
+        tasks.cancel();
+        tasks.wait();
+        throw;
+    }
+
+    // The zlib stream ends with the adler32 of all of the particle data, most significant byte first
+    char checksumBytes[4];
+    for( int i = 0; i < 4; ++i ) {
+        checksumBytes[i] = static_cast<char>( ( checksum >> ( 8 * ( 3 - i ) ) ) & 0xff );
+    }
+    out.write( checksumBytes, sizeof( checksumBytes ) );
+    stats.compressedBytes += sizeof( checksumBytes );
+
+    out.seekp( PRT_PARTICLE_COUNT_OFFSET );
+    write_int64( out, stats.particleCount );
+    out.close();
+    if( out.fail() ) {
+        throw std::runtime_error( "prt_writer error: Failed to write \"" + frantic::strings::to_string( path ) +
+                                  "\"." );
+    }
+
+    stats.seconds = ( tbb::tick_count::now() - startTime ).seconds();
+
+    FRANTIC_MAYA_ADD_COUNT( "prt_write", stats.particleCount );
+    FRANTIC_MAYA_ADD_BYTES( "prt_write", stats.compressedBytes );
+
+    return stats;
+}
+
+frantic::tstring get_prt_sequence_filename( const frantic::tstring& filenamePattern, int frame ) {
+    // Only the file name is searched, so that a '#' or '.' in a directory name is left alone
+    const frantic::tstring::size_type separator = filenamePattern.find_last_of( _T( "/\\" ) );
+    const frantic::tstring::size_type nameStart = separator == frantic::tstring::npos ? 0 : separator + 1;
+
+    const frantic::tstring::size_type runEnd = filenamePattern.find_last_of( _T( '#' ) );
+    if( runEnd == frantic::tstring::npos || runEnd < nameStart ) {
+        frantic::tstring::size_type insertAt = filenamePattern.find_last_of( _T( '.' ) );
+        if( insertAt == frantic::tstring::npos || insertAt < nameStart ) {
+            insertAt = filenamePattern.size();
+        }
+        return filenamePattern.substr( 0, insertAt ) + format_frame_number( frame, 4 ) +
+               filenamePattern.substr( insertAt );
+    }
+
+    frantic::tstring::size_type runStart = runEnd;
+    while( runStart > nameStart && filenamePattern[runStart - 1] == _T( '#' ) ) {
+        --runStart;
+    }
+    return filenamePattern.substr( 0, runStart ) + format_frame_number( frame, runEnd - runStart + 1 ) +
+           filenamePattern.substr( runEnd + 1 );
+}
+
+void export_prt_sequence( const MFnDependencyNode& depNode, const frantic::graphics::transform4f& objectSpace,
+                          const frantic::tstring& filenamePattern, int startFrame, int endFrame, int frameStep,
+                          frantic::logging::progress_logger& progress,
+                          std::vector<prt_export_frame_stats>& outFrameStats, const prt_writer_options& options ) {
+    if( frameStep <= 0 ) {
+        throw std::runtime_error( "export_prt_sequence error: The frame step must be positive." );
+    }
+
+    outFrameStats.clear();
+    if( endFrame < startFrame ) {
+        return;
+    }
+
+    const int frameCount = ( endFrame - startFrame ) / frameStep + 1;
+    outFrameStats.reserve( frameCount );
+
+    // One writer for the whole range, so its blocks are allocated once rather than once per frame
+    prt_writer writer( options );
+
+    progress.set_title( _T( "Export PRT Sequence" ) );
+
+    // Maya particle systems only give back their particles at the current scene time, whatever the context says, so
+    // the scene is moved to each frame in turn
+    const scoped_scene_time restoreTime;
+    for( int i = 0; i < frameCount; ++i ) {
+        progress.check_for_abort();
+
+        prt_export_frame_stats frameStats;
+        frameStats.frame = startFrame + i * frameStep;
+        frameStats.path = get_prt_sequence_filename( filenamePattern, frameStats.frame );
+
+        MAnimControl::setCurrentTime( MTime( static_cast<double>( frameStats.frame ), MTime::uiUnit() ) );
+        frantic::particles::streams::particle_istream_ptr stream =
+            PRTObjectBase::getFinalParticleStream( depNode, objectSpace, MDGContext::fsNormal, false );
+        if( !stream ) {
+            throw std::runtime_error( "export_prt_sequence error: The node \"" +
+                                      std::string( depNode.name().asChar() ) + "\" has no particle stream at frame " +
+                                      boost::lexical_cast<std::string>( frameStats.frame ) + "." );
+        }
+
+        frameStats.stats = writer.write( *stream, frameStats.path );
+        stream->close();
+
+        frantic::maya::logging::add_progress_count( progress, _T( "particles" ), frameStats.stats.particleCount );
+        frantic::maya::logging::add_progress_count( progress, _T( "uncompressed_bytes" ),
+                                                    static_cast<boost::int64_t>( frameStats.stats.uncompressedBytes ) );
+        frantic::maya::logging::add_progress_count( progress, _T( "compressed_bytes" ),
+                                                    static_cast<boost::int64_t>( frameStats.stats.compressedBytes ) );
+
+        outFrameStats.push_back( frameStats );
+        progress.update_progress( static_cast<long long>( i + 1 ), static_cast<long long>( frameCount ) );
+    }
+}
+
+void export_prt_sequence( const MFnDependencyNode& depNode, const frantic::graphics::transform4f& objectSpace,
+                          const frantic::tstring& filenamePattern, int startFrame, int endFrame, int frameStep,
+                          std::vector<prt_export_frame_stats>& outFrameStats, const prt_writer_options& options ) {
+    boost::shared_ptr<frantic::logging::progress_logger> progress = frantic::maya::logging::create_progress_logger();
+    export_prt_sequence( depNode, objectSpace, filenamePattern, startFrame, endFrame, frameStep, *progress,
+                         outFrameStats, options );
+}
+
+} // namespace particles
+} // namespace maya
+} // namespace frantic
@@ -0,0 +1,141 @@
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+#include "stdafx.h"
+
+#include <frantic/maya/particles/region_culling_particle_istream.hpp>
+
+#include <cstring>
+
+namespace frantic {
+namespace maya {
+namespace particles {
+
+void particle_culling_region::add_plane( const frantic::graphics::vector3f& normal, float offset ) {
+    plane p;
+    p.normal = normal;
+    p.offset = offset;
+    m_planes.push_back( p );
+}
+
+void particle_culling_region::add_box( const frantic::graphics::boundbox3f& bounds ) {
+    box b;
+    b.isOriented = false;
+    b.bounds = bounds;
+    m_boxes.push_back( b );
+}
+
+void particle_culling_region::add_box( const frantic::graphics::boundbox3f& bounds,
+                                       const frantic::graphics::transform4f& boxTransform ) {
+    box b;
+    b.toBoxSpace = boxTransform.to_inverse();
+    b.isOriented = true;
+    b.bounds = bounds;
+    m_boxes.push_back( b );
+}
+
+region_culling_particle_istream::region_culling_particle_istream(
+    boost::shared_ptr<frantic::particles::streams::particle_istream> pin, const particle_culling_region& region,
+    const frantic::tstring& positionChannelName )
+    : m_delegate( pin )
+    , m_region( region )
+    , m_positionChannelName( positionChannelName )
+    , m_particleIndex( -1 )
+    , m_hasPosition( false ) {
+    if( !m_delegate ) {
+        throw std::runtime_error( "region_culling_particle_istream error: The delegate stream is NULL." );
+    }
+
+    set_channel_map( m_delegate->get_channel_map() );
+}
+
+void region_culling_particle_istream::set_channel_map( const frantic::channels::channel_map& particleChannelMap ) {
+    // Preserve any existing default particle values in the new layout.
+    std::vector<char> newDefaultParticle( particleChannelMap.structure_size() );
+    if( m_defaultParticle.size() > 0 ) {
+        frantic::channels::channel_map_adaptor oldToNewChannelMapAdaptor( particleChannelMap, m_channelMap );
+        oldToNewChannelMapAdaptor.copy_structure( &newDefaultParticle[0], &m_defaultParticle[0] );
+    } else if( !newDefaultParticle.empty() ) {
+        memset( &newDefaultParticle[0], 0, newDefaultParticle.size() );
+    }
+    m_defaultParticle.swap( newDefaultParticle );
+
+    m_channelMap = particleChannelMap;
+
+    // The delegate must also provide the position, even if it wasn't requested, so the particles can be tested.
+    m_delegateChannelMap = particleChannelMap;
+    m_hasPosition = m_delegate->get_native_channel_map().has_channel( m_positionChannelName );
+    if( m_hasPosition && !m_delegateChannelMap.has_channel( m_positionChannelName ) ) {
+        m_delegateChannelMap.append_channel( m_positionChannelName, 3, frantic::channels::data_type_float32 );
+    }
+    m_delegate->set_channel_map( m_delegateChannelMap );
+
+    if( m_hasPosition ) {
+        m_positionAccessor =
+            m_delegateChannelMap.get_cvt_accessor<frantic::graphics::vector3f>( m_positionChannelName );
+    }
+
+    m_cma.set( m_channelMap, m_delegateChannelMap );
+    m_delegateParticle.resize( m_delegateChannelMap.structure_size() );
+
+    set_default_particle( m_defaultParticle.empty() ? NULL : &m_defaultParticle[0] );
+}
+
+void region_culling_particle_istream::set_default_particle( char* rawParticleBuffer ) {
+    if( !rawParticleBuffer ) {
+        return;
+    }
+
+    if( rawParticleBuffer != &m_defaultParticle[0] ) {
+        memcpy( &m_defaultParticle[0], rawParticleBuffer, m_channelMap.structure_size() );
+    }
+
+    // Every channel we output comes through the delegate, so the default values are applied there.
+    std::vector<char> delegateDefaultParticle( m_delegateChannelMap.structure_size() );
+    memset( &delegateDefaultParticle[0], 0, delegateDefaultParticle.size() );
+    frantic::channels::channel_map_adaptor toDelegate( m_delegateChannelMap, m_channelMap );
+    toDelegate.copy_structure( &delegateDefaultParticle[0], &m_defaultParticle[0] );
+    m_delegate->set_default_particle( &delegateDefaultParticle[0] );
+}
+
+bool region_culling_particle_istream::get_particle( char* outParticleBuffer ) {
+    // When the delegate is already providing our layout, read straight into the output buffer.
+    const bool directRead = m_cma.is_identity();
+    char* buffer = directRead ? outParticleBuffer : &m_delegateParticle[0];
+
+    for( ;; ) {
+        if( !m_delegate->get_particle( buffer ) ) {
+            return false;
+        }
+        if( !m_hasPosition || m_region.contains( m_positionAccessor.get( buffer ) ) ) {
+            break;
+        }
+    }
+
+    if( !directRead ) {
+        m_cma.copy_structure( outParticleBuffer, buffer );
+    }
+
+    ++m_particleIndex;
+    return true;
+}
+
+bool region_culling_particle_istream::get_particles( char* buffer, std::size_t& numParticles ) {
+    if( is_passthrough() && m_cma.is_identity() ) {
+        const bool result = m_delegate->get_particles( buffer, numParticles );
+        m_particleIndex += static_cast<boost::int64_t>( numParticles );
+        return result;
+    }
+
+    const std::size_t particleSize = m_channelMap.structure_size();
+    for( std::size_t i = 0; i < numParticles; ++i ) {
+        if( !get_particle( buffer + i * particleSize ) ) {
+            numParticles = i;
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace particles
+} // namespace maya
+} // namespace frantic
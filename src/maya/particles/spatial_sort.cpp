@@ -0,0 +1,212 @@
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+#include "stdafx.h"
+
+#include <frantic/maya/particles/spatial_sort.hpp>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_reduce.h>
+#include <tbb/parallel_sort.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+using frantic::channels::channel_cvt_accessor;
+using frantic::graphics::vector3f;
+
+namespace {
+
+// The number of bits of each coordinate in a Morton code
+const int MORTON_BITS = 21;
+const boost::uint32_t MORTON_MAX = ( 1u << MORTON_BITS ) - 1;
+
+// Spreads the low 21 bits of a value out to every third bit
+inline boost::uint64_t spread_bits( boost::uint32_t value ) {
+    boost::uint64_t x = value & MORTON_MAX;
+    x = ( x | ( x << 32 ) ) & 0x1f00000000ffffULL;
+    x = ( x | ( x << 16 ) ) & 0x1f0000ff0000ffULL;
+    x = ( x | ( x << 8 ) ) & 0x100f00f00f00f00fULL;
+    x = ( x | ( x << 4 ) ) & 0x10c30c30c30c30c3ULL;
+    x = ( x | ( x << 2 ) ) & 0x1249249249249249ULL;
+    return x;
+}
+
+// Maps a coordinate into [0, MORTON_MAX], sending NaN to 0
+inline boost::uint32_t quantize( float value, float minimum, float scale ) {
+    const float q = ( value - minimum ) * scale;
+    if( !( q > 0 ) ) {
+        return 0;
+    }
+    return q >= static_cast<float>( MORTON_MAX ) ? MORTON_MAX : static_cast<boost::uint32_t>( q );
+}
+
+// Finds the bounding box of the particles' positions
+class position_bounds_body {
+    const frantic::particles::particle_array& m_particles;
+    const channel_cvt_accessor<vector3f>& m_position;
+
+    position_bounds_body& operator=( const position_bounds_body& ); // not implemented
+
+  public:
+    vector3f minimum;
+    vector3f maximum;
+
+    position_bounds_body( const frantic::particles::particle_array& particles,
+                          const channel_cvt_accessor<vector3f>& position )
+        : m_particles( particles )
+        , m_position( position )
+        , minimum( std::numeric_limits<float>::max() )
+        , maximum( -std::numeric_limits<float>::max() ) {}
+
+    position_bounds_body( position_bounds_body& other, tbb::split )
+        : m_particles( other.m_particles )
+        , m_position( other.m_position )
+        , minimum( std::numeric_limits<float>::max() )
+        , maximum( -std::numeric_limits<float>::max() ) {}
+
+    void operator()( const tbb::blocked_range<std::size_t>& range ) {
+        for( std::size_t i = range.begin(); i != range.end(); ++i ) {
+            const vector3f p = m_position.get( m_particles[i] );
+            // Written so that NaN coordinates are skipped
+            for( int axis = 0; axis < 3; ++axis ) {
+                if( p[axis] < minimum[axis] ) {
+                    minimum[axis] = p[axis];
+                }
+                if( p[axis] > maximum[axis] ) {
+                    maximum[axis] = p[axis];
+                }
+            }
+        }
+    }
+
+    void join( const position_bounds_body& other ) {
+        for( int axis = 0; axis < 3; ++axis ) {
+            minimum[axis] = std::min( minimum[axis], other.minimum[axis] );
+            maximum[axis] = std::max( maximum[axis], other.maximum[axis] );
+        }
+    }
+};
+
+struct morton_key {
+    boost::uint64_t code;
+    std::size_t index;
+
+    // Ties are broken by index, so that the order is the same as a stable sort
+    bool operator<( const morton_key& other ) const {
+        return code < other.code || ( code == other.code && index < other.index );
+    }
+};
+
+// Computes the Morton code of each particle
+class morton_key_body {
+    const frantic::particles::particle_array& m_particles;
+    const channel_cvt_accessor<vector3f>& m_position;
+    vector3f m_minimum;
+    float m_scale;
+    std::vector<morton_key>& m_keys;
+
+    morton_key_body& operator=( const morton_key_body& ); // not implemented
+
+  public:
+    morton_key_body( const frantic::particles::particle_array& particles,
+                     const channel_cvt_accessor<vector3f>& position, const vector3f& minimum, float scale,
+                     std::vector<morton_key>& keys )
+        : m_particles( particles )
+        , m_position( position )
+        , m_minimum( minimum )
+        , m_scale( scale )
+        , m_keys( keys ) {}
+
+    void operator()( const tbb::blocked_range<std::size_t>& range ) const {
+        for( std::size_t i = range.begin(); i != range.end(); ++i ) {
+            const vector3f p = m_position.get( m_particles[i] );
+            m_keys[i].code = frantic::maya::particles::morton_code( quantize( p.x, m_minimum.x, m_scale ),
+                                                                     quantize( p.y, m_minimum.y, m_scale ),
+                                                                     quantize( p.z, m_minimum.z, m_scale ) );
+            m_keys[i].index = i;
+        }
+    }
+};
+
+// Copies the particles into their sorted positions
+class permute_particles_body {
+    const frantic::particles::particle_array& m_particles;
+    const std::vector<std::size_t>& m_order;
+    frantic::particles::particle_array& m_outParticles;
+    std::size_t m_particleSize;
+
+    permute_particles_body& operator=( const permute_particles_body& ); // not implemented
+
+  public:
+    permute_particles_body( const frantic::particles::particle_array& particles, const std::vector<std::size_t>& order,
+                            frantic::particles::particle_array& outParticles )
+        : m_particles( particles )
+        , m_order( order )
+        , m_outParticles( outParticles )
+        , m_particleSize( particles.get_channel_map().structure_size() ) {}
+
+    void operator()( const tbb::blocked_range<std::size_t>& range ) const {
+        for( std::size_t i = range.begin(); i != range.end(); ++i ) {
+            memcpy( m_outParticles[i], m_particles[m_order[i]], m_particleSize );
+        }
+    }
+};
+
+} // anonymous namespace
+
+namespace frantic {
+namespace maya {
+namespace particles {
+
+boost::uint64_t morton_code( boost::uint32_t x, boost::uint32_t y, boost::uint32_t z ) {
+    return spread_bits( x ) | ( spread_bits( y ) << 1 ) | ( spread_bits( z ) << 2 );
+}
+
+void compute_morton_order( const frantic::particles::particle_array& particles,
+                           const frantic::tstring& positionChannelName, std::vector<std::size_t>& outOrder ) {
+    const std::size_t count = particles.size();
+    const channel_cvt_accessor<vector3f> position =
+        particles.get_channel_map().get_cvt_accessor<vector3f>( positionChannelName );
+
+    position_bounds_body bounds( particles, position );
+    tbb::parallel_reduce( tbb::blocked_range<std::size_t>( 0, count ), bounds );
+
+    // Use the same scale on every axis, so that the cells of the curve are cubes
+    float extent = 0;
+    for( int axis = 0; axis < 3; ++axis ) {
+        extent = std::max( extent, bounds.maximum[axis] - bounds.minimum[axis] );
+    }
+    const float scale = extent > 0 && extent <= std::numeric_limits<float>::max() ? MORTON_MAX / extent : 0.0f;
+
+    std::vector<morton_key> keys( count );
+    tbb::parallel_for( tbb::blocked_range<std::size_t>( 0, count ),
+                       morton_key_body( particles, position, bounds.minimum, scale, keys ) );
+    tbb::parallel_sort( keys.begin(), keys.end() );
+
+    outOrder.resize( count );
+    for( std::size_t i = 0; i < count; ++i ) {
+        outOrder[i] = keys[i].index;
+    }
+}
+
+void sort_particles_by_morton_code( frantic::particles::particle_array& particles,
+                                    const frantic::tstring& positionChannelName ) {
+    if( particles.size() < 2 || !particles.get_channel_map().has_channel( positionChannelName ) ) {
+        return;
+    }
+
+    std::vector<std::size_t> order;
+    compute_morton_order( particles, positionChannelName, order );
+
+    frantic::particles::particle_array sortedParticles( particles.get_channel_map() );
+    sortedParticles.resize( particles.size() );
+    tbb::parallel_for( tbb::blocked_range<std::size_t>( 0, order.size() ),
+                       permute_particles_body( particles, order, sortedParticles ) );
+    particles.swap( sortedParticles );
+}
+
+} // namespace particles
+} // namespace maya
+} // namespace frantic
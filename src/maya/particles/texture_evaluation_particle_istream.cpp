@@ -5,6 +5,7 @@
 #include <frantic/maya/particles/texture_evaluation_particle_istream.hpp>
 
 #include <frantic/channels/channel_map_adaptor.hpp>
+#include <frantic/maya/logging/instrumentation.hpp>
 #include <frantic/particles/particle_array.hpp>
 #include <frantic/particles/streams/particle_istream.hpp>
 #include <limits>
@@ -267,12 +268,25 @@ void texture_evaluation_particle_istream::init_channel_map( const frantic::chann
     // set our outgoing map to this requested map
     m_channelMap = inputChannelMap;
 
-    // set our delegate to it's own native map
-    m_delegate->set_channel_map( m_delegate->get_native_channel_map() );
-    m_delegateChannelMap = m_delegate->get_channel_map();
+    // only ask our delegate for the channels that will be passed on, plus the uvw channel that the texture is
+    // evaluated with. the result channel is left out, since the texture evaluation overwrites it. channels that the
+    // delegate can't provide are filled in from our default particle by the adaptor.
+    const frantic::channels::channel_map& delegateNativeChannelMap = m_delegate->get_native_channel_map();
+    m_delegateChannelMap = frantic::channels::channel_map();
+    for( std::size_t i = 0; i < m_channelMap.channel_count(); ++i ) {
+        const frantic::channels::channel& ch = m_channelMap[i];
+        if( ch.name() != m_resultChannelName && delegateNativeChannelMap.has_channel( ch.name() ) )
+            m_delegateChannelMap.define_channel( ch.name(), ch.arity(), ch.data_type() );
+    }
+    if( !m_delegateChannelMap.has_channel( m_uvwChannelName ) ) {
+        const frantic::channels::channel& uvwChannel = delegateNativeChannelMap[m_uvwChannelName];
+        m_delegateChannelMap.define_channel( m_uvwChannelName, uvwChannel.arity(), uvwChannel.data_type() );
+    }
+    m_delegateChannelMap.end_channel_definition();
+    m_delegate->set_channel_map( m_delegateChannelMap );
 
     // create native channel map for our stream. this is the delegate's native map, plus our new channels.
-    m_nativeChannelMap = m_delegate->get_channel_map();
+    m_nativeChannelMap = delegateNativeChannelMap;
     if( !m_nativeChannelMap.has_channel( m_resultChannelName ) ) {
         if( m_resultChannelName ==
             _T( "Density" ) ) // THIS *REALLY* needs to be done with a class template. what a hack. yuck.
@@ -282,7 +296,7 @@ void texture_evaluation_particle_istream::init_channel_map( const frantic::chann
     }
 
     // make adaptor
-    // delegate provides particles in their native form, so this adaptor switches them into our requested form
+    // delegate provides only the channels we need, so this adaptor switches them into our requested form
     m_cma.set( m_channelMap, m_delegateChannelMap );
 
     // create the buffer with the correct channel map, and size it to the right number of particles.
@@ -291,6 +305,7 @@ void texture_evaluation_particle_istream::init_channel_map( const frantic::chann
 }
 
 size_t texture_evaluation_particle_istream::texturemap_2d_fill_particle_buffer() {
+    FRANTIC_MAYA_SCOPED_TIMER( "texturemap_2d_fill_particle_buffer" );
     // This function is to fill the m_bufferedParticles, and apply the 2d texture map to the color channels
     size_t newBufferSize = m_maxBufferSize;
 
@@ -322,10 +337,12 @@ size_t texture_evaluation_particle_istream::texturemap_2d_fill_particle_buffer()
         apply_2d_texture_evaluation( m_bufferedParticles, newBufferSize, m_mayaMaterialNodeName, uArrayBuffer,
                                      vArrayBuffer, m_resultChannelName );
 
+    FRANTIC_MAYA_ADD_COUNT( "texturemap_2d_fill_particle_buffer", newBufferSize );
     return newBufferSize;
 }
 
 size_t texture_evaluation_particle_istream::texturemap_3d_fill_particle_buffer() {
+    FRANTIC_MAYA_SCOPED_TIMER( "texturemap_3d_fill_particle_buffer" );
     // This function is to fill the m_bufferedParticles, and apply the 3d texture map to the color channels
     size_t newBufferSize = m_maxBufferSize;
 
@@ -357,6 +374,7 @@ size_t texture_evaluation_particle_istream::texturemap_3d_fill_particle_buffer()
         apply_3d_texture_evaluation( m_bufferedParticles, newBufferSize, m_mayaMaterialNodeName, uvwArrayBuffer,
                                      m_resultChannelName );
 
+    FRANTIC_MAYA_ADD_COUNT( "texturemap_3d_fill_particle_buffer", newBufferSize );
     return newBufferSize;
 }
 
@@ -0,0 +1,164 @@
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+#include "stdafx.h"
+
+#include <frantic/maya/particles/viewport_particle_istream.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace frantic {
+namespace maya {
+namespace particles {
+
+viewport_particle_istream::viewport_particle_istream(
+    boost::shared_ptr<frantic::particles::streams::particle_istream> pin, double fraction, boost::int64_t limit,
+    const frantic::tstring& idChannelName )
+    : m_delegate( pin )
+    , m_selector( fraction )
+    , m_limit( limit )
+    , m_idChannelName( idChannelName )
+    , m_particleIndex( -1 )
+    , m_delegateParticleIndex( -1 )
+    , m_hasIdChannel( false ) {
+    if( !m_delegate ) {
+        throw std::runtime_error( "viewport_particle_istream error: The delegate stream is NULL." );
+    }
+
+    // Spread the limit over the whole delegate, rather than keeping the first particles in its order
+    if( is_limited() ) {
+        boost::int64_t count = m_delegate->particle_count();
+        if( count < 0 ) {
+            count = m_delegate->particle_count_guess();
+        }
+        m_selector.set_fraction( get_viewport_fraction( fraction, m_limit, count ) );
+    }
+
+    set_channel_map( m_delegate->get_channel_map() );
+}
+
+boost::int64_t viewport_particle_istream::particle_count() const {
+    const boost::int64_t delegateCount = m_delegate->particle_count();
+    if( !m_selector.keeps_all() || delegateCount < 0 ) {
+        return -1;
+    }
+    return is_limited() ? std::min( delegateCount, m_limit ) : delegateCount;
+}
+
+boost::int64_t viewport_particle_istream::particle_count_left() const {
+    const boost::int64_t count = particle_count();
+    if( count < 0 ) {
+        return -1;
+    }
+    return count - ( m_particleIndex + 1 );
+}
+
+boost::int64_t viewport_particle_istream::particle_count_guess() const {
+    boost::int64_t guess = m_delegate->particle_count_guess();
+    if( guess < 0 ) {
+        return is_limited() ? m_limit : -1;
+    }
+    if( !m_selector.keeps_all() ) {
+        guess = static_cast<boost::int64_t>( static_cast<double>( guess ) * m_selector.get_fraction() + 0.5 );
+    }
+    return is_limited() ? std::min( guess, m_limit ) : guess;
+}
+
+void viewport_particle_istream::set_channel_map( const frantic::channels::channel_map& particleChannelMap ) {
+    // Preserve any existing default particle values in the new layout.
+    std::vector<char> newDefaultParticle( particleChannelMap.structure_size() );
+    if( m_defaultParticle.size() > 0 ) {
+        frantic::channels::channel_map_adaptor oldToNewChannelMapAdaptor( particleChannelMap, m_channelMap );
+        oldToNewChannelMapAdaptor.copy_structure( &newDefaultParticle[0], &m_defaultParticle[0] );
+    } else if( !newDefaultParticle.empty() ) {
+        memset( &newDefaultParticle[0], 0, newDefaultParticle.size() );
+    }
+    m_defaultParticle.swap( newDefaultParticle );
+
+    m_channelMap = particleChannelMap;
+
+    // The delegate must also provide the ID channel, even if it wasn't requested, so the selection can be made.
+    m_delegateChannelMap = particleChannelMap;
+    m_hasIdChannel = m_delegate->get_native_channel_map().has_channel( m_idChannelName );
+    if( m_hasIdChannel && !m_delegateChannelMap.has_channel( m_idChannelName ) ) {
+        m_delegateChannelMap.append_channel( m_idChannelName, 1, frantic::channels::data_type_int64 );
+    }
+    m_delegate->set_channel_map( m_delegateChannelMap );
+
+    if( m_hasIdChannel ) {
+        m_idAccessor = m_delegateChannelMap.get_cvt_accessor<boost::int64_t>( m_idChannelName );
+    }
+
+    m_cma.set( m_channelMap, m_delegateChannelMap );
+    m_delegateParticle.resize( m_delegateChannelMap.structure_size() );
+
+    set_default_particle( m_defaultParticle.empty() ? NULL : &m_defaultParticle[0] );
+}
+
+void viewport_particle_istream::set_default_particle( char* rawParticleBuffer ) {
+    if( !rawParticleBuffer ) {
+        return;
+    }
+
+    if( rawParticleBuffer != &m_defaultParticle[0] ) {
+        memcpy( &m_defaultParticle[0], rawParticleBuffer, m_channelMap.structure_size() );
+    }
+
+    // Every channel we output comes through the delegate, so the default values are applied there.
+    std::vector<char> delegateDefaultParticle( m_delegateChannelMap.structure_size() );
+    memset( &delegateDefaultParticle[0], 0, delegateDefaultParticle.size() );
+    frantic::channels::channel_map_adaptor toDelegate( m_delegateChannelMap, m_channelMap );
+    toDelegate.copy_structure( &delegateDefaultParticle[0], &m_defaultParticle[0] );
+    m_delegate->set_default_particle( &delegateDefaultParticle[0] );
+}
+
+bool viewport_particle_istream::get_particle( char* outParticleBuffer ) {
+    if( is_limited() && m_particleIndex + 1 >= m_limit ) {
+        return false;
+    }
+
+    // When the delegate is already providing our layout, read straight into the output buffer.
+    const bool directRead = m_cma.is_identity();
+    char* buffer = directRead ? outParticleBuffer : &m_delegateParticle[0];
+
+    for( ;; ) {
+        if( !m_delegate->get_particle( buffer ) ) {
+            return false;
+        }
+        ++m_delegateParticleIndex;
+
+        const boost::int64_t id = m_hasIdChannel ? m_idAccessor.get( buffer ) : m_delegateParticleIndex;
+        if( m_selector( id ) ) {
+            break;
+        }
+    }
+
+    if( !directRead ) {
+        m_cma.copy_structure( outParticleBuffer, buffer );
+    }
+
+    ++m_particleIndex;
+    return true;
+}
+
+bool viewport_particle_istream::get_particles( char* buffer, std::size_t& numParticles ) {
+    if( is_passthrough() && m_cma.is_identity() ) {
+        const bool result = m_delegate->get_particles( buffer, numParticles );
+        m_particleIndex += static_cast<boost::int64_t>( numParticles );
+        m_delegateParticleIndex += static_cast<boost::int64_t>( numParticles );
+        return result;
+    }
+
+    const std::size_t particleSize = m_channelMap.structure_size();
+    for( std::size_t i = 0; i < numParticles; ++i ) {
+        if( !get_particle( buffer + i * particleSize ) ) {
+            numParticles = i;
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace particles
+} // namespace maya
+} // namespace frantic
@@ -6,9 +6,12 @@
 // dll main These defines get around that
 #define MNoPluginEntry
 #define MNoVersionString
+#include <maya/MDGMessage.h>
+#include <maya/MEventMessage.h>
 #include <maya/MFnPlugin.h>
 #include <maya/MGlobal.h>
 
+#include <frantic/maya/attributes.hpp>
 #include <frantic/maya/convert.hpp>
 #include <frantic/maya/plugin_manager.hpp>
 #include <frantic/maya/type.hpp>
@@ -61,6 +64,112 @@ class plugin_callback_item : public plugin_registry_item {
     MCallbackId m_callbackId;
 };
 
+class plugin_node_callback_item : public plugin_registry_item {
+  public:
+    enum node_message { NODE_ADDED, NODE_REMOVED };
+
+    plugin_node_callback_item( node_message msg, MMessage::MNodeFunction func, const MString& nodeType,
+                               void* clientData )
+        : m_message( msg )
+        , m_function( func )
+        , m_nodeType( nodeType )
+        , m_clientData( clientData )
+        , m_callbackId() {}
+
+    virtual MStatus init( MFnPlugin& /*plugin*/ ) {
+        MStatus status;
+        if( m_message == NODE_ADDED )
+            m_callbackId = MDGMessage::addNodeAddedCallback( m_function, m_nodeType, m_clientData, &status );
+        else
+            m_callbackId = MDGMessage::addNodeRemovedCallback( m_function, m_nodeType, m_clientData, &status );
+        return status;
+    }
+
+    virtual MStatus deinit( MFnPlugin& /*plugin*/ ) { return MMessage::removeCallback( m_callbackId ); }
+
+    virtual frantic::tstring description() {
+        return ( m_message == NODE_ADDED ? _T("Node Added Callback ") : _T("Node Removed Callback ") ) +
+               frantic::strings::to_tstring( m_nodeType.asChar() );
+    }
+
+  private:
+    node_message m_message;
+    MMessage::MNodeFunction m_function;
+    MString m_nodeType;
+    void* m_clientData;
+    MCallbackId m_callbackId;
+};
+
+class plugin_connection_callback_item : public plugin_registry_item {
+  public:
+    plugin_connection_callback_item( MMessage::MPlugFunction func, void* clientData )
+        : m_function( func )
+        , m_clientData( clientData )
+        , m_callbackId() {}
+
+    virtual MStatus init( MFnPlugin& /*plugin*/ ) {
+        MStatus status;
+        m_callbackId = MDGMessage::addConnectionCallback( m_function, m_clientData, &status );
+        return status;
+    }
+
+    virtual MStatus deinit( MFnPlugin& /*plugin*/ ) { return MMessage::removeCallback( m_callbackId ); }
+
+    virtual frantic::tstring description() { return _T("Connection Callback"); }
+
+  private:
+    MMessage::MPlugFunction m_function;
+    void* m_clientData;
+    MCallbackId m_callbackId;
+};
+
+class plugin_event_callback_item : public plugin_registry_item {
+  public:
+    plugin_event_callback_item( const MString& eventName, MMessage::MBasicFunction func, void* clientData )
+        : m_eventName( eventName )
+        , m_function( func )
+        , m_clientData( clientData )
+        , m_callbackId() {}
+
+    virtual MStatus init( MFnPlugin& /*plugin*/ ) {
+        MStatus status;
+        m_callbackId = MEventMessage::addEventCallback( m_eventName, m_function, m_clientData, &status );
+        return status;
+    }
+
+    virtual MStatus deinit( MFnPlugin& /*plugin*/ ) { return MMessage::removeCallback( m_callbackId ); }
+
+    virtual frantic::tstring description() {
+        return _T("Event Callback ") + frantic::strings::to_tstring( m_eventName.asChar() );
+    }
+
+  private:
+    MString m_eventName;
+    MMessage::MBasicFunction m_function;
+    void* m_clientData;
+    MCallbackId m_callbackId;
+};
+
+class plugin_unload_function_item : public plugin_registry_item {
+  public:
+    plugin_unload_function_item( plugin_manager::unload_function_t func, const frantic::tstring& description )
+        : m_function( func )
+        , m_description( description ) {}
+
+    virtual MStatus init( MFnPlugin& /*plugin*/ ) { return MStatus::kSuccess; }
+
+    virtual MStatus deinit( MFnPlugin& /*plugin*/ ) {
+        m_function();
+        return MStatus::kSuccess;
+    }
+
+    virtual frantic::tstring description() { return _T("Unload Function ") + m_description; }
+
+  private:
+    plugin_manager::unload_function_t m_function;
+    frantic::tstring m_description;
+};
+
 class plugin_command_item : public plugin_registry_item {
   public:
     plugin_command_item( const MString& commandName, MCreatorFunction creator,
@@ -332,6 +441,31 @@ template MStatus plugin_manager::register_callback<detail::register_check_file_c
 template MStatus plugin_manager::register_callback<detail::register_string_array_callback_t>(
     MSceneMessage::Message, detail::register_string_array_callback_t::function_t, void* );
 
+MStatus plugin_manager::register_node_added_callback( MMessage::MNodeFunction func, const MString& nodeType,
+                                                      void* clientData ) {
+    return add_registry_item( new detail::plugin_node_callback_item( detail::plugin_node_callback_item::NODE_ADDED,
+                                                                     func, nodeType, clientData ) );
+}
+
+MStatus plugin_manager::register_node_removed_callback( MMessage::MNodeFunction func, const MString& nodeType,
+                                                        void* clientData ) {
+    return add_registry_item( new detail::plugin_node_callback_item( detail::plugin_node_callback_item::NODE_REMOVED,
+                                                                     func, nodeType, clientData ) );
+}
+
+MStatus plugin_manager::register_connection_callback( MMessage::MPlugFunction func, void* clientData ) {
+    return add_registry_item( new detail::plugin_connection_callback_item( func, clientData ) );
+}
+
+MStatus plugin_manager::register_event_callback( const MString& eventName, MMessage::MBasicFunction func,
+                                                 void* clientData ) {
+    return add_registry_item( new detail::plugin_event_callback_item( eventName, func, clientData ) );
+}
+
+MStatus plugin_manager::register_unload_function( unload_function_t func, const frantic::tstring& description ) {
+    return add_registry_item( new detail::plugin_unload_function_item( func, description ) );
+}
+
 MStatus plugin_manager::register_command( const MString& commandName, MCreatorFunction creator,
                                           MCreateSyntaxFunction createSyntaxFunction ) {
     return add_registry_item( new detail::plugin_command_item( commandName, creator, createSyntaxFunction ) );
@@ -363,6 +497,8 @@ MStatus plugin_manager::register_python_scripts( const frantic::tstring& initScr
 MStatus plugin_manager::register_shape( const MString& nodeName, MTypeId typeId, MCreatorFunction nodeCreator,
                                         MInitializeFunction nodeInitializer, MCreatorFunction nodeUICreator,
                                         const MString* classification ) {
+    // A node type may be registered again with different attributes, e.g. after the plugin is reloaded
+    attribute_accessor::clear_cache();
     return add_registry_item( new detail::plugin_shape_item( nodeName, typeId, nodeCreator, nodeInitializer,
                                                              nodeUICreator, classification ) );
 }
@@ -370,6 +506,7 @@ MStatus plugin_manager::register_shape( const MString& nodeName, MTypeId typeId,
 MStatus plugin_manager::register_node( const MString& nodeName, MTypeId typeId, MCreatorFunction nodeCreator,
                                        MInitializeFunction nodeInitializer, MPxNode::Type nodeType,
                                        const MString* classification ) {
+    attribute_accessor::clear_cache();
     return add_registry_item(
         new detail::plugin_node_item( nodeName, typeId, nodeCreator, nodeInitializer, nodeType, classification ) );
 }
@@ -405,6 +542,9 @@ MStatus plugin_manager::unregister_all() {
 
     m_registeredItems.clear();
 
+    // The cached attribute objects may belong to the node types that were just deregistered
+    attribute_accessor::clear_cache();
+
     return returnStatus;
 }
 
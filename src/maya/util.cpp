@@ -2,16 +2,98 @@
 // SPDX-License-Identifier: Apache-2.0
 #include "stdafx.h"
 
+#include <maya/MDistance.h>
 #include <maya/MFnDagNode.h>
 #include <maya/MFnMatrixData.h>
 #include <maya/MPlug.h>
 
 #include <frantic/maya/convert.hpp>
+#include <frantic/maya/plugin_manager.hpp>
 #include <frantic/maya/util.hpp>
 
 namespace frantic {
 namespace maya {
 
+namespace {
+
+struct scene_unit_cache {
+    double scaleToMeters;
+    bool isValid;
+    bool isActive;
+
+    scene_unit_cache()
+        : scaleToMeters( 0.0 )
+        , isValid( false )
+        , isActive( false ) {}
+};
+
+scene_unit_cache& get_scene_unit_cache() {
+    static scene_unit_cache cache;
+    return cache;
+}
+
+void invalidate_scene_unit_callback( void* /*clientData*/ ) { get_scene_unit_cache().isValid = false; }
+
+double get_ui_unit_scale_to_meters() {
+    switch( MDistance::uiUnit() ) {
+    case MDistance::kMillimeters:
+        return 0.001;
+    case MDistance::kCentimeters:
+        return 0.01;
+    case MDistance::kMeters:
+        return 1.0;
+    case MDistance::kInches:
+        return 0.0254;
+    case MDistance::kFeet:
+        return 0.3048;
+    case MDistance::kYards:
+        return 0.9144;
+    default:
+        return 0.0;
+    }
+}
+
+} // namespace
+
+double get_scale_to_meters() {
+    scene_unit_cache& cache = get_scene_unit_cache();
+    if( !cache.isActive )
+        return get_ui_unit_scale_to_meters();
+
+    if( !cache.isValid ) {
+        cache.scaleToMeters = get_ui_unit_scale_to_meters();
+        cache.isValid = true;
+    }
+    return cache.scaleToMeters;
+}
+
+frantic::graphics::coordinate_system::option get_coordinate_system() {
+    if( MGlobal::isYAxisUp() )
+        return frantic::graphics::coordinate_system::right_handed_yup;
+    else
+        return frantic::graphics::coordinate_system::right_handed_zup;
+}
+
+MStatus register_scene_unit_callbacks( plugin_manager& pluginManager ) {
+    using namespace std; // For CHECK_MSTATUS_AND_RETURN_IT
+    MStatus status;
+
+    scene_unit_cache& cache = get_scene_unit_cache();
+    cache.isValid = false;
+
+    status = pluginManager.register_event_callback( "linearUnitChanged", &invalidate_scene_unit_callback );
+    CHECK_MSTATUS_AND_RETURN_IT( status );
+    status = pluginManager.register_callback<detail::register_callback_t>( MSceneMessage::kAfterNew,
+                                                                            &invalidate_scene_unit_callback );
+    CHECK_MSTATUS_AND_RETURN_IT( status );
+    status = pluginManager.register_callback<detail::register_callback_t>( MSceneMessage::kAfterOpen,
+                                                                            &invalidate_scene_unit_callback );
+    CHECK_MSTATUS_AND_RETURN_IT( status );
+
+    cache.isActive = true;
+    return MS::kSuccess;
+}
+
 bool get_object_world_matrix( const MDagPath& dagNodePath, const MDGContext& currentContext,
                               frantic::graphics::transform4f& outTransform ) {
     MStatus status;
@@ -0,0 +1,284 @@
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+//
+// Draws through gl_mesh_buffer, gl_mesh_buffer_cache and gl_particle_buffer in an offscreen EGL context, and checks
+// that they upload their data to buffer objects, draw it, and delete the buffer objects once they are destroyed. It
+// does not require Maya or a display, Mesa's software renderer is enough.
+//
+// Exits with 0 if every check passed, 1 if one failed, and 77 if no OpenGL context could be created.
+//
+#include "stdafx.h"
+
+#define GL_GLEXT_PROTOTYPES
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+#include <frantic/maya/graphics/opengl.hpp>
+
+#include <frantic/channels/channel_map.hpp>
+#include <frantic/geometry/trimesh3.hpp>
+#include <frantic/graphics/vector3f.hpp>
+#include <frantic/particles/particle_array.hpp>
+#include <frantic/particles/streams/shared_particle_container_particle_istream.hpp>
+
+#include <boost/shared_ptr.hpp>
+
+#include <cstdio>
+#include <cstring>
+
+using frantic::graphics::vector3f;
+using namespace frantic::maya::graphics;
+
+namespace {
+
+const int IMAGE_SIZE = 64;
+const int SKIPPED = 77;
+
+int failureCount = 0;
+
+void check( bool condition, const char* description ) {
+    if( !condition ) {
+        std::printf( "FAILED: %s\n", description );
+        ++failureCount;
+    }
+}
+
+/**
+ * Creates an offscreen OpenGL context and makes it current.
+ * @return false if EGL or desktop OpenGL are not available.
+ */
+bool create_offscreen_context() {
+    EGLDisplay display = EGL_NO_DISPLAY;
+
+    // Prefer Mesa's surfaceless platform, which needs neither a display server nor a GPU
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>( eglGetProcAddress( "eglGetPlatformDisplayEXT" ) );
+    if( getPlatformDisplay ) {
+        display = getPlatformDisplay( EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL );
+    }
+    if( display == EGL_NO_DISPLAY || !eglInitialize( display, NULL, NULL ) ) {
+        display = eglGetDisplay( EGL_DEFAULT_DISPLAY );
+        if( display == EGL_NO_DISPLAY || !eglInitialize( display, NULL, NULL ) ) {
+            return false;
+        }
+    }
+
+    if( !eglBindAPI( EGL_OPENGL_API ) ) {
+        return false;
+    }
+
+    const EGLint configAttributes[] = { EGL_SURFACE_TYPE,
+                                        EGL_PBUFFER_BIT,
+                                        EGL_RENDERABLE_TYPE,
+                                        EGL_OPENGL_BIT,
+                                        EGL_RED_SIZE,
+                                        8,
+                                        EGL_GREEN_SIZE,
+                                        8,
+                                        EGL_BLUE_SIZE,
+                                        8,
+                                        EGL_NONE };
+    EGLConfig config;
+    EGLint configCount = 0;
+    if( !eglChooseConfig( display, configAttributes, &config, 1, &configCount ) || configCount == 0 ) {
+        return false;
+    }
+
+    const EGLint surfaceAttributes[] = { EGL_WIDTH, IMAGE_SIZE, EGL_HEIGHT, IMAGE_SIZE, EGL_NONE };
+    EGLSurface surface = eglCreatePbufferSurface( display, config, surfaceAttributes );
+    if( surface == EGL_NO_SURFACE ) {
+        return false;
+    }
+
+    // The default context is a compatibility profile context, which the fixed-function drawing requires
+    EGLContext context = eglCreateContext( display, config, EGL_NO_CONTEXT, NULL );
+    if( context == EGL_NO_CONTEXT ) {
+        return false;
+    }
+
+    return eglMakeCurrent( display, surface, surface, context ) == EGL_TRUE;
+}
+
+void clear_image() {
+    glViewport( 0, 0, IMAGE_SIZE, IMAGE_SIZE );
+    glClearColor( 0.0f, 0.0f, 0.0f, 1.0f );
+    glClear( GL_COLOR_BUFFER_BIT );
+}
+
+vector3f read_pixel( int x, int y ) {
+    glFinish();
+    unsigned char pixel[4];
+    glReadPixels( x, y, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel );
+    return vector3f( pixel[0] / 255.0f, pixel[1] / 255.0f, pixel[2] / 255.0f );
+}
+
+std::size_t count_lit_pixels() {
+    glFinish();
+    std::vector<unsigned char> pixels( 4 * IMAGE_SIZE * IMAGE_SIZE );
+    glReadPixels( 0, 0, IMAGE_SIZE, IMAGE_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0] );
+
+    std::size_t count = 0;
+    for( std::size_t i = 0; i < pixels.size(); i += 4 ) {
+        if( pixels[i] != 0 || pixels[i + 1] != 0 || pixels[i + 2] != 0 ) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+bool is_color( const vector3f& pixel, float r, float g, float b ) {
+    const float tolerance = 0.02f;
+    return std::abs( pixel.x - r ) < tolerance && std::abs( pixel.y - g ) < tolerance &&
+           std::abs( pixel.z - b ) < tolerance;
+}
+
+// A square covering the whole image, which is [-1,1] on x and y with the identity transforms
+void build_square( frantic::geometry::trimesh3& outMesh ) {
+    outMesh.clear();
+    outMesh.add_vertex( -1.0f, -1.0f, 0.0f );
+    outMesh.add_vertex( 1.0f, -1.0f, 0.0f );
+    outMesh.add_vertex( 1.0f, 1.0f, 0.0f );
+    outMesh.add_vertex( -1.0f, 1.0f, 0.0f );
+    outMesh.add_face( 0, 1, 2 );
+    outMesh.add_face( 0, 2, 3 );
+}
+
+void test_mesh_buffer() {
+    frantic::geometry::trimesh3 mesh;
+    build_square( mesh );
+
+    // Names are handed out from 1 in a new context
+    const GLuint firstBufferName = 1;
+    {
+        gl_mesh_buffer buffer;
+        buffer.set_mesh( mesh, 1 );
+        check( !buffer.is_uploaded(), "the mesh is not uploaded before it is drawn" );
+
+        clear_image();
+        glColor3f( 1.0f, 0.5f, 0.25f );
+        gl_draw( buffer );
+        check( buffer.is_uploaded(), "the mesh is uploaded to buffer objects by the first draw" );
+        check( is_color( read_pixel( IMAGE_SIZE / 2, IMAGE_SIZE / 2 ), 1.0f, 0.5f, 0.25f ),
+               "the mesh's triangles are drawn from buffer objects" );
+        check( is_color( read_pixel( 1, IMAGE_SIZE - 2 ), 1.0f, 0.5f, 0.25f ), "both triangles are drawn" );
+
+        clear_image();
+        glColor3f( 1.0f, 1.0f, 1.0f );
+        gl_draw_wireframe( buffer );
+        const std::size_t litCount = count_lit_pixels();
+        check( litCount > 0 && litCount < IMAGE_SIZE * IMAGE_SIZE / 4, "the mesh's edges are drawn as lines" );
+
+        // Replacing the mesh re-uploads it into the same buffer objects
+        mesh.get_vertex( 2 ) = vector3f( 0.0f, 0.0f, 0.0f );
+        buffer.set_mesh( mesh, 2 );
+        clear_image();
+        glColor3f( 1.0f, 1.0f, 1.0f );
+        gl_draw( buffer );
+        check( buffer.is_uploaded(), "a replaced mesh is uploaded by the next draw" );
+        check( is_color( read_pixel( IMAGE_SIZE - 2, IMAGE_SIZE - 2 ), 0.0f, 0.0f, 0.0f ),
+               "the replaced mesh is drawn" );
+
+        check( glIsBuffer( firstBufferName ) == GL_TRUE, "the buffer objects exist while the mesh buffer does" );
+    }
+
+    gl_delete_released_buffers();
+    check( glIsBuffer( firstBufferName ) == GL_FALSE, "the buffer objects are deleted after the mesh buffer is" );
+}
+
+void test_mesh_buffer_cache() {
+    frantic::geometry::trimesh3 mesh;
+    build_square( mesh );
+
+    const int meshOwner = 0;
+
+    gl_mesh_buffer_cache cache;
+    boost::shared_ptr<gl_mesh_buffer> buffer = cache.get( &meshOwner, 1, mesh );
+    check( cache.get( &meshOwner, 1, mesh ) == buffer, "the cached buffer is returned while its version is unchanged" );
+
+    clear_image();
+    glColor3f( 1.0f, 1.0f, 1.0f );
+    gl_draw( *buffer );
+    check( buffer->is_uploaded(), "the cached mesh is uploaded" );
+
+    // Erasing only drops the cache's reference, so a holder can keep drawing the buffer
+    cache.erase( &meshOwner );
+    clear_image();
+    gl_draw( *buffer );
+    check( buffer->is_uploaded(), "an erased buffer keeps its buffer objects" );
+    check( is_color( read_pixel( IMAGE_SIZE / 2, IMAGE_SIZE / 2 ), 1.0f, 1.0f, 1.0f ),
+           "an erased buffer that is still held can be drawn" );
+
+    check( cache.get( &meshOwner, 1, mesh ) != buffer, "an erased buffer is rebuilt by the next get" );
+    cache.clear();
+    buffer.reset();
+    gl_delete_released_buffers();
+}
+
+void test_particle_buffer() {
+    frantic::channels::channel_map channelMap;
+    channelMap.define_channel<vector3f>( _T("Position") );
+    channelMap.define_channel<vector3f>( _T("Color") );
+    channelMap.end_channel_definition();
+
+    frantic::channels::channel_accessor<vector3f> positionAcc = channelMap.get_accessor<vector3f>( _T("Position") );
+    frantic::channels::channel_accessor<vector3f> colorAcc = channelMap.get_accessor<vector3f>( _T("Color") );
+
+    boost::shared_ptr<frantic::particles::particle_array> particles(
+        new frantic::particles::particle_array( channelMap ) );
+    std::vector<char> particle( channelMap.structure_size() );
+    positionAcc.get( &particle[0] ) = vector3f( 0.0f, 0.0f, 0.0f );
+    colorAcc.get( &particle[0] ) = vector3f( 0.0f, 1.0f, 0.0f );
+    particles->push_back( &particle[0] );
+    positionAcc.get( &particle[0] ) = vector3f( -0.5f, -0.5f, 0.0f );
+    colorAcc.get( &particle[0] ) = vector3f( 0.0f, 0.0f, 1.0f );
+    particles->push_back( &particle[0] );
+
+    gl_particle_buffer buffer;
+    buffer.set_particles( frantic::particles::streams::particle_istream_ptr(
+                              new frantic::particles::streams::shared_particle_container_particle_istream<
+                                  frantic::particles::particle_array>( particles ) ),
+                          1.0, -1, 1 );
+    check( buffer.point_count() == 2, "every particle is read" );
+    check( buffer.has_colors(), "the particles' colors are read" );
+
+    clear_image();
+    gl_draw_particles( buffer, 4.0f );
+    check( buffer.is_uploaded(), "the particles are uploaded to buffer objects by the first draw" );
+    check( is_color( read_pixel( IMAGE_SIZE / 2, IMAGE_SIZE / 2 ), 0.0f, 1.0f, 0.0f ),
+           "a particle is drawn with its color" );
+    check( is_color( read_pixel( IMAGE_SIZE / 4, IMAGE_SIZE / 4 ), 0.0f, 0.0f, 1.0f ),
+           "every particle is drawn at its position" );
+    check( count_lit_pixels() == 2 * 4 * 4, "only the particles are drawn, at the requested size" );
+}
+
+} // anonymous namespace
+
+int main() {
+    if( !create_offscreen_context() ) {
+        std::printf( "SKIPPED: no OpenGL context could be created\n" );
+        return SKIPPED;
+    }
+
+    std::printf( "OpenGL %s (%s)\n", reinterpret_cast<const char*>( glGetString( GL_VERSION ) ),
+                 reinterpret_cast<const char*>( glGetString( GL_RENDERER ) ) );
+
+    glMatrixMode( GL_PROJECTION );
+    glLoadIdentity();
+    glMatrixMode( GL_MODELVIEW );
+    glLoadIdentity();
+
+    test_mesh_buffer();
+    test_mesh_buffer_cache();
+    test_particle_buffer();
+
+    check( glGetError() == GL_NO_ERROR, "no OpenGL errors were raised" );
+
+    if( failureCount != 0 ) {
+        std::printf( "%d checks failed\n", failureCount );
+        return 1;
+    }
+    std::printf( "All checks passed\n" );
+    return 0;
+}
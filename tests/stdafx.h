@@ -0,0 +1,32 @@
+// Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+// stdafx.h : stands in for the library's precompiled header when the Maya-independent sources are compiled into the
+// tests. The library's version includes the Maya API headers, which the tests must not depend on.
+//
+
+#pragma once
+
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#pragma warning( push )
+#pragma warning( disable : 4267 )
+#include <algorithm>
+#pragma warning( pop )
+
+#include <boost/config.hpp>
+#include <boost/integer_fwd.hpp>
+#include <boost/smart_ptr.hpp>
+
+#pragma warning( push, 3 )
+#pragma warning( disable : 4701 4702 4267 )
+#include <boost/lexical_cast.hpp>
+#pragma warning( pop )
+
+#ifdef max
+#undef max
+#endif
+#ifdef min
+#undef min
+#endif